@@ -299,10 +299,15 @@ static bool tb_cmp(const void *p, const void *d)
     return false;
 }
 
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+TranslationBlock *tb_htable_lookup(CPUState *cpu, target_ulong pc,
+                                   target_ulong cs_base, uint32_t flags)
+#else
 static TranslationBlock *tb_htable_lookup(CPUState *cpu,
                                           target_ulong pc,
                                           target_ulong cs_base,
                                           uint32_t flags)
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
 {
     tb_page_addr_t phys_pc;
     struct tb_desc desc;
@@ -128,6 +128,15 @@ static QEMUTimer *icount_rt_timer;
 static QEMUTimer *icount_vm_timer;
 static QEMUTimer *icount_warp_timer;
 
+/* Idle fast-forward, protected by BQL.  */
+static bool idle_fast_forward;
+static int64_t idle_fast_forward_skipped_ns;
+static int64_t idle_fast_forward_count;
+
+/* Cycle model: the counter is in core clock cycles, converted to
+   nanoseconds with the core frequency. Protected by TimersState seqlock.  */
+static uint32_t icount_cycle_hz;
+
 typedef struct TimersState {
     /* Protected by BQL.  */
     int64_t cpu_ticks_prev;
@@ -187,9 +196,31 @@ int64_t cpu_get_icount(void)
 
 int64_t cpu_icount_to_ns(int64_t icount)
 {
+    if (icount_cycle_hz) {
+        return muldiv64(icount, NANOSECONDS_PER_SECOND, icount_cycle_hz);
+    }
     return icount << icount_time_shift;
 }
 
+/* Set the frequency of the cycle counter; the virtual clock remains
+   continuous, only the rate of future cycles changes.  */
+void cpu_icount_set_cycle_hz(uint32_t hz)
+{
+    int64_t icount;
+    int64_t now;
+
+    if (!use_icount_cycles || hz == 0 || hz == icount_cycle_hz) {
+        return;
+    }
+
+    seqlock_write_begin(&timers_state.vm_clock_seqlock);
+    icount = cpu_get_icount_raw();
+    now = timers_state.qemu_icount_bias + cpu_icount_to_ns(icount);
+    icount_cycle_hz = hz;
+    timers_state.qemu_icount_bias = now - cpu_icount_to_ns(icount);
+    seqlock_write_end(&timers_state.vm_clock_seqlock);
+}
+
 /* return the time elapsed in VM between vm_start and vm_stop.  Unless
  * icount is active, cpu_get_ticks() uses units of the host CPU cycle
  * counter.
@@ -340,6 +371,14 @@ static void icount_adjust_vm(void *opaque)
 
 static int64_t qemu_icount_round(int64_t count)
 {
+    if (icount_cycle_hz) {
+        int64_t cycles = muldiv64(count, icount_cycle_hz,
+                                  NANOSECONDS_PER_SECOND);
+        if (cpu_icount_to_ns(cycles) < count) {
+            cycles++;
+        }
+        return cycles;
+    }
     return (count + (1 << icount_time_shift) - 1) >> icount_time_shift;
 }
 
@@ -415,12 +454,73 @@ void qtest_clock_warp(int64_t dest)
     qemu_clock_notify(QEMU_CLOCK_VIRTUAL);
 }
 
+void configure_idle_fast_forward(bool enabled)
+{
+    idle_fast_forward = enabled;
+}
+
+/*
+ * Without icount, QEMU_CLOCK_VIRTUAL follows the host clock, so a guest
+ * sleeping in WFI waits in real time for its next timer. If enabled,
+ * when all vCPUs are idle, advance the virtual clock directly to the
+ * next QEMU_CLOCK_VIRTUAL deadline, like icount does with sleep=off.
+ * The skipped time is visible to the guest, but not to the host.
+ *
+ * Called with the BQL held, from the vCPU thread before it goes to
+ * sleep and from the main loop, to handle timers that expire without
+ * waking up the vCPU.
+ */
+static void qemu_idle_fast_forward(void)
+{
+    int64_t deadline;
+
+    if (!idle_fast_forward || use_icount) {
+        return;
+    }
+
+    if (!runstate_is_running() || qtest_enabled()) {
+        return;
+    }
+
+    if (!all_cpu_threads_idle()) {
+        return;
+    }
+
+    deadline = qemu_clock_deadline_ns_all(QEMU_CLOCK_VIRTUAL);
+    if (deadline <= 0) {
+        /* No timers, or already expired. */
+        return;
+    }
+
+    seqlock_write_begin(&timers_state.vm_clock_seqlock);
+    timers_state.cpu_clock_offset += deadline;
+    seqlock_write_end(&timers_state.vm_clock_seqlock);
+
+    idle_fast_forward_skipped_ns += deadline;
+    idle_fast_forward_count++;
+
+    /* Wake up the main loop, to run the expired timers. */
+    qemu_clock_notify(QEMU_CLOCK_VIRTUAL);
+}
+
+IdleFastForwardInfo *qmp_query_idle_fast_forward(Error **errp)
+{
+    IdleFastForwardInfo *info = g_malloc0(sizeof(*info));
+
+    info->enabled = idle_fast_forward;
+    info->skipped_ns = idle_fast_forward_skipped_ns;
+    info->count = idle_fast_forward_count;
+
+    return info;
+}
+
 void qemu_start_warp_timer(void)
 {
     int64_t clock;
     int64_t deadline;
 
     if (!use_icount) {
+        qemu_idle_fast_forward();
         return;
     }
 
@@ -692,6 +792,23 @@ void configure_icount(QemuOpts *opts, Error **errp)
                    NANOSECONDS_PER_SECOND / 10);
 }
 
+/* Count core clock cycles instead of instructions; the cost of each
+   translation block is computed by the target.  Without sleep, idle
+   periods are skipped, as with -icount sleep=off.  */
+void configure_icount_cycles(bool sleep)
+{
+    icount_sleep = sleep;
+    if (icount_sleep) {
+        icount_warp_timer = timer_new_ns(QEMU_CLOCK_VIRTUAL_RT,
+                                         icount_timer_cb, NULL);
+    }
+
+    /* Until the clock tree is configured, the same default as SysTick.  */
+    icount_cycle_hz = 8000000;
+    use_icount_cycles = true;
+    use_icount = 1;
+}
+
 /***********************************************************/
 void hw_error(const char *fmt, ...)
 {
@@ -946,6 +1063,7 @@ static void qemu_wait_io_event_common(CPUState *cpu)
 static void qemu_tcg_wait_io_event(CPUState *cpu)
 {
     while (all_cpu_threads_idle()) {
+        qemu_idle_fast_forward();
         qemu_cond_wait(cpu->halt_cond, &qemu_global_mutex);
     }
 
@@ -20,4 +20,9 @@ CONFIG_LPC=n
 CONFIG_TIVA=n
 CONFIG_XMC=n
 CONFIG_SAM=n
+
+# Slaves for the STM32 SPI and I2C.
+CONFIG_SSI=y
+CONFIG_SSI_M25P80=y
+CONFIG_TMP105=y
 # [GNU MCU Eclipse]
@@ -106,6 +106,12 @@ __thread CPUState *current_cpu;
    1 = Precise instruction counting.
    2 = Adaptive rate instruction counting.  */
 int use_icount;
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+/* The counter is in core clock cycles, as estimated by the target.  */
+bool use_icount_cycles;
+/* The target may compute the condition flags only when needed.  */
+bool use_lazy_flags = true;
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
 
 bool set_preferred_target_page_bits(int bits)
 {
@@ -742,6 +748,11 @@ int cpu_watchpoint_insert(CPUState *cpu, vaddr addr, vaddr len,
     }
 
     tlb_flush_page(cpu, addr);
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+    /* Blocks translated without watchpoints may not restore the exact
+       CPU state in the middle of the block (lazy flags in target-arm).  */
+    tb_flush(cpu);
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
 
     if (watchpoint)
         *watchpoint = wp;
@@ -259,6 +259,44 @@ STEXI
 @item info mtree
 @findex mtree
 Show memory tree.
+ETEXI
+
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+    {
+        .name       = "peripherals",
+        .args_type  = "",
+        .params     = "",
+        .help       = "show peripherals and their registers lookup tables",
+        .cmd        = hmp_info_peripherals,
+    },
+#endif
+
+STEXI
+@item info peripherals
+@findex peripherals
+Show the emulated MCU peripherals, with the address, the number of registers
+and the layout of the registers lookup table (dense, paged, or lazy if not
+yet created), its size in bytes, and the number of accesses to addresses
+without registers.
+ETEXI
+
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+    {
+        .name       = "graphic",
+        .args_type  = "",
+        .params     = "",
+        .help       = "show board graphic events statistics",
+        .cmd        = hmp_info_graphic,
+    },
+#endif
+
+STEXI
+@item info graphic
+@findex graphic
+Show the number of LED changes passed to the board graphic window,
+the number of changes coalesced with changes not yet drawn, the
+number of frames drawn, and the number of LED messages not displayed
+because of rate limiting.
 ETEXI
 
     {
@@ -132,6 +132,22 @@ static void machine_set_image(Object *obj, const char *value, Error **errp)
     ms->image_filename = g_strdup(value);
 }
 
+static char *machine_get_flash_image(Object *obj, Error **errp)
+{
+    MachineState *ms = MACHINE(obj);
+
+    return g_strdup(ms->flash_image_filename);
+}
+
+static void machine_set_flash_image(Object *obj, const char *value,
+                                    Error **errp)
+{
+    MachineState *ms = MACHINE(obj);
+
+    g_free((void*)ms->flash_image_filename);
+    ms->flash_image_filename = g_strdup(value);
+}
+
 #endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
 
 static char *machine_get_initrd(Object *obj, Error **errp)
@@ -510,6 +526,13 @@ static void machine_initfn(Object *obj)
     object_property_set_description(obj, "image",
                                     "Bare-bone image file",
                                     NULL);
+    object_property_add_str(obj, "flash-image",
+                            machine_get_flash_image, machine_set_flash_image,
+                            NULL);
+    object_property_set_description(obj, "flash-image",
+                                    "File backing the MCU flash, persistent "
+                                    "across runs",
+                                    NULL);
 #endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
 
     /* Register notifier when init is done for sysbus sanity checks */
@@ -528,6 +551,7 @@ static void machine_finalize(Object *obj)
 
 #if defined(CONFIG_GNU_MCU_ECLIPSE)
     g_free((void*)ms->image_filename);
+    g_free((void*)ms->flash_image_filename);
 #endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
 
     g_free(ms->dtb);
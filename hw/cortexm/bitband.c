@@ -21,6 +21,8 @@
 #include <hw/cortexm/bitband.h>
 
 #include "cpu.h"
+#include "exec/address-spaces.h"
+#include "exec/ram_addr.h"
 
 // Bitbanded IO.  Each word corresponds to a single bit.
 
@@ -43,119 +45,232 @@ void cortexm_bitband_init(Object *parent, const char *node_name,
 // ----- Private --------------------------------------------------------------
 
 // Get the byte address of the real memory for a bitband access.
-static inline uint32_t cortexm_bitband_addr(void * opaque, uint32_t addr)
+static inline uint32_t cortexm_bitband_addr(CortexMBitBandState *s,
+        hwaddr offset)
 {
-    uint32_t res;
+    return s->base | ((offset & 0x1ffffff) >> 5);
+}
 
-    res = *(uint32_t *) opaque;
-    res |= (addr & 0x1ffffff) >> 5;
+// Target endian load/store, as seen by the CPU.
+static inline uint64_t cortexm_bitband_ldn(const void *ptr, unsigned size)
+{
+    switch (size) {
+    case 1:
+        return ldub_p(ptr);
+    case 2:
+        return lduw_p(ptr);
+    default:
+        return ldl_p(ptr);
+    }
+}
 
-    return res;
+static inline void cortexm_bitband_stn(void *ptr, unsigned size, uint64_t v)
+{
+    switch (size) {
+    case 1:
+        stb_p(ptr, v);
+        break;
+    case 2:
+        stw_p(ptr, v);
+        break;
+    default:
+        stl_p(ptr, v);
+        break;
+    }
 }
 
-static uint32_t cortexm_bitband_readb(void *opaque, hwaddr offset)
+static void cortexm_bitband_cache_invalidate(CortexMBitBandState *s)
 {
-    uint8_t v;
-    cpu_physical_memory_read(cortexm_bitband_addr(opaque, offset), &v, 1);
+    int i;
 
-    return (v & (1 << ((offset >> 2) & 7))) != 0;
+    for (i = 0; i < CORTEXM_BITBAND_CACHE_SIZE; ++i) {
+        if (s->cache[i].mr != NULL) {
+            memory_region_unref(s->cache[i].mr);
+            s->cache[i].mr = NULL;
+        }
+    }
+    s->cache_next = 0;
 }
 
-static void cortexm_bitband_writeb(void *opaque, hwaddr offset, uint32_t value)
+static void cortexm_bitband_memory_commit_callback(MemoryListener *listener)
 {
-    uint32_t addr;
-    uint8_t mask;
-    uint8_t v;
+    CortexMBitBandState *s = container_of(listener, CortexMBitBandState,
+            listener);
 
-    addr = cortexm_bitband_addr(opaque, offset);
-    mask = (1 << ((offset >> 2) & 7));
-    cpu_physical_memory_read(addr, &v, 1);
-    if (value & 1)
-        v |= mask;
-    else
-        v &= ~mask;
-
-    cpu_physical_memory_write(addr, &v, 1);
+    cortexm_bitband_cache_invalidate(s);
 }
 
-static uint32_t cortexm_bitband_readw(void *opaque, hwaddr offset)
+// Return the target region for the given address, from the cache or
+// looked up in the system memory; NULL if nothing is mapped there.
+static CortexMBitBandTarget *cortexm_bitband_find_target(
+        CortexMBitBandState *s, hwaddr addr, unsigned size)
 {
-    uint32_t addr;
-    uint16_t mask;
-    uint16_t v;
+    CortexMBitBandTarget *target;
+    int i;
+
+    for (i = 0; i < CORTEXM_BITBAND_CACHE_SIZE; ++i) {
+        target = &s->cache[i];
+        if (target->mr != NULL && addr >= target->start
+                && addr + size <= target->start + target->size) {
+            return target;
+        }
+    }
+
+    // The section is clipped to the given range, so the cached range
+    // starts at this address and goes up to the end of the region.
+    MemoryRegionSection section = memory_region_find(get_system_memory(),
+            addr, s->base + CORTEXM_BITBAND_SOURCE_SIZE - addr);
+    if (section.mr == NULL) {
+        return NULL;
+    }
+    if (section.offset_within_address_space != addr
+            || int128_get64(section.size) < size) {
+        memory_region_unref(section.mr);
+        return NULL;
+    }
 
-    addr = cortexm_bitband_addr(opaque, offset) & ~1;
-    mask = (1 << ((offset >> 2) & 15));
-    mask = tswap16(mask);
-    cpu_physical_memory_read(addr, &v, 2);
+    target = &s->cache[s->cache_next];
+    s->cache_next = (s->cache_next + 1) % CORTEXM_BITBAND_CACHE_SIZE;
+    if (target->mr != NULL) {
+        memory_region_unref(target->mr);
+    }
 
-    return (v & mask) != 0;
+    // Keep the reference returned by memory_region_find().
+    target->mr = section.mr;
+    target->start = addr;
+    target->size = int128_get64(section.size);
+    target->offset_within_region = section.offset_within_region;
+    target->readonly = section.readonly || memory_region_is_rom(section.mr);
+    if (memory_region_is_ram(section.mr)) {
+        target->host = (uint8_t *) memory_region_get_ram_ptr(section.mr)
+                + section.offset_within_region;
+        target->ram_addr = memory_region_get_ram_addr(section.mr)
+                + section.offset_within_region;
+    } else {
+        target->host = NULL;
+        target->ram_addr = 0;
+    }
+
+    return target;
 }
 
-static void cortexm_bitband_writew(void *opaque, hwaddr offset, uint32_t value)
+static uint64_t cortexm_bitband_target_read(CortexMBitBandTarget *target,
+        hwaddr addr, unsigned size)
 {
-    uint32_t addr;
-    uint16_t mask;
-    uint16_t v;
+    hwaddr delta = addr - target->start;
+    uint64_t v = 0;
 
-    addr = cortexm_bitband_addr(opaque, offset) & ~1;
-    mask = (1 << ((offset >> 2) & 15));
-    mask = tswap16(mask);
-    cpu_physical_memory_read(addr, &v, 2);
-    if (value & 1)
-        v |= mask;
-    else
-        v &= ~mask;
+    if (target->host != NULL) {
+        // RAM, access the host memory directly.
+        return cortexm_bitband_ldn(target->host + delta, size);
+    }
 
-    cpu_physical_memory_write(addr, &v, 2);
+    // Peripheral, dispatch straight to the region.
+    memory_region_dispatch_read(target->mr,
+            target->offset_within_region + delta, &v, size,
+            MEMTXATTRS_UNSPECIFIED);
+    return v;
 }
 
-static uint32_t cortexm_bitband_readl(void *opaque, hwaddr offset)
+static void cortexm_bitband_target_write(CortexMBitBandTarget *target,
+        hwaddr addr, uint64_t v, unsigned size)
 {
-    uint32_t addr;
-    uint32_t mask;
-    uint32_t v;
+    hwaddr delta = addr - target->start;
+
+    if (target->host != NULL) {
+        if (target->readonly) {
+            return;
+        }
+
+        // If the page holds translated code, or a dirty log client
+        // still has it clean, take the slow path, which invalidates
+        // the translated blocks and sets the dirty bits.
+        uint8_t dirty_log_mask = memory_region_get_dirty_log_mask(target->mr);
+        if (dirty_log_mask != 0
+                && cpu_physical_memory_range_includes_clean(
+                        target->ram_addr + delta, size, dirty_log_mask)) {
+            uint8_t buf[4];
+            cortexm_bitband_stn(buf, size, v);
+            cpu_physical_memory_write(addr, buf, size);
+            return;
+        }
+
+        cortexm_bitband_stn(target->host + delta, size, v);
+        return;
+    }
+
+    memory_region_dispatch_write(target->mr,
+            target->offset_within_region + delta, v, size,
+            MEMTXATTRS_UNSPECIFIED);
+}
 
-    addr = cortexm_bitband_addr(opaque, offset) & ~3;
-    mask = (1 << ((offset >> 2) & 31));
-    mask = tswap32(mask);
-    cpu_physical_memory_read(addr, &v, 4);
+// Each word of the alias corresponds to a single bit; the access size
+// defines the size of the access to the real memory.
+static uint64_t cortexm_bitband_read_callback(void *opaque, hwaddr offset,
+        unsigned size)
+{
+    CortexMBitBandState *s = (CortexMBitBandState *) opaque;
+
+    hwaddr addr = cortexm_bitband_addr(s, offset) & ~(hwaddr) (size - 1);
+    uint32_t mask = 1U << ((offset >> 2) & (size * 8 - 1));
+    uint64_t v;
+
+    CortexMBitBandTarget *target = cortexm_bitband_find_target(s, addr, size);
+    if (target != NULL) {
+        v = cortexm_bitband_target_read(target, addr, size);
+    } else {
+        uint8_t buf[4];
+        cpu_physical_memory_read(addr, buf, size);
+        v = cortexm_bitband_ldn(buf, size);
+    }
 
     return (v & mask) != 0;
 }
 
-static void cortexm_bitband_writel(void *opaque, hwaddr offset, uint32_t value)
+static void cortexm_bitband_write_callback(void *opaque, hwaddr offset,
+        uint64_t value, unsigned size)
 {
-    uint32_t addr;
-    uint32_t mask;
-    uint32_t v;
+    CortexMBitBandState *s = (CortexMBitBandState *) opaque;
+
+    hwaddr addr = cortexm_bitband_addr(s, offset) & ~(hwaddr) (size - 1);
+    uint32_t mask = 1U << ((offset >> 2) & (size * 8 - 1));
+    uint64_t v;
+
+    CortexMBitBandTarget *target = cortexm_bitband_find_target(s, addr, size);
+    if (target != NULL) {
+        v = cortexm_bitband_target_read(target, addr, size);
+    } else {
+        uint8_t buf[4];
+        cpu_physical_memory_read(addr, buf, size);
+        v = cortexm_bitband_ldn(buf, size);
+    }
 
-    addr = cortexm_bitband_addr(opaque, offset) & ~3;
-    mask = (1 << ((offset >> 2) & 31));
-    mask = tswap32(mask);
-    cpu_physical_memory_read(addr, &v, 4);
-    if (value & 1)
+    if (value & 1) {
         v |= mask;
-    else
+    } else {
         v &= ~mask;
+    }
 
-    cpu_physical_memory_write(addr, &v, 4);
+    if (target != NULL && target->mr == NULL) {
+        // The read changed the memory map and invalidated the cache.
+        target = cortexm_bitband_find_target(s, addr, size);
+    }
+
+    if (target != NULL) {
+        cortexm_bitband_target_write(target, addr, v, size);
+    } else {
+        uint8_t buf[4];
+        cortexm_bitband_stn(buf, size, v);
+        cpu_physical_memory_write(addr, buf, size);
+    }
 }
 
 static const MemoryRegionOps cortexm_bitband_ops = {
-    .old_mmio = {
-        .read = {
-            cortexm_bitband_readb,
-            cortexm_bitband_readw,
-            cortexm_bitband_readl,
-        /**/
-        },
-        .write = {
-            cortexm_bitband_writeb,
-            cortexm_bitband_writew,
-            cortexm_bitband_writel,
-        /**/
-        },
+    .read = cortexm_bitband_read_callback,
+    .write = cortexm_bitband_write_callback,
+    .valid = {
+        .min_access_size = 1,
+        .max_access_size = 4,
     /**/
     },
     .endianness = DEVICE_NATIVE_ENDIAN,
@@ -171,7 +286,7 @@ static void cortexm_bitband_instance_init_callback(Object *obj)
     CortexMBitBandState *s = CORTEXM_BITBAND_STATE(obj);
     SysBusDevice *dev = SYS_BUS_DEVICE(obj);
 
-    memory_region_init_io(&s->iomem, obj, &cortexm_bitband_ops, &s->base,
+    memory_region_init_io(&s->iomem, obj, &cortexm_bitband_ops, s,
             "bitband", 0x02000000);
     sysbus_init_mmio(dev, &s->iomem);
 }
@@ -185,14 +300,17 @@ static void cortexm_bitband_realize_callback(DeviceState *dev, Error **errp)
         return;
     }
 
-    // Currently nothing to do.
+    CortexMBitBandState *s = CORTEXM_BITBAND_STATE(dev);
+
+    s->listener.commit = cortexm_bitband_memory_commit_callback;
+    memory_listener_register(&s->listener, &address_space_memory);
 }
 
 static void cortexm_bitband_reset_callback(DeviceState *dev)
 {
     qemu_log_function_name();
 
-    // Currently nothing to do.
+    cortexm_bitband_cache_invalidate(CORTEXM_BITBAND_STATE(dev));
 }
 
 static Property cortexm_bitband_properties[] = {
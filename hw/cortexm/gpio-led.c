@@ -20,6 +20,8 @@
 #include <hw/cortexm/gpio-led.h>
 #include <hw/cortexm/helper.h>
 
+#include "qemu/timer.h"
+
 #if defined(CONFIG_VERBOSE)
 #include "verbosity.h"
 #endif
@@ -28,6 +30,9 @@
  * This class implements a LED connected to a GPIO device.
  */
 
+// Total number of messages not displayed, for all LEDs.
+static uint64_t gpio_led_suppressed_messages;
+
 // ----- Public ---------------------------------------------------------------
 // Create a number of LEDs, using details from an array of Info structures.
 Object **gpio_led_create_from_info(Object *parent, GPIOLEDInfo *info_array,
@@ -147,20 +152,55 @@ Object **gpio_led_create_from_info(Object *parent, GPIOLEDInfo *info_array,
     return arr;
 }
 
+uint64_t gpio_led_get_suppressed_messages(void)
+{
+    return gpio_led_suppressed_messages;
+}
+
 // ----- Private --------------------------------------------------------------
 
 #define LED_ON true
 #define LED_OFF false
 
+// Display the on/off message, unless the LED changes too often
+// (like when driven by a software PWM), in which case only the
+// number of messages not displayed is shown, once per second.
+static void gpio_led_display_message(GPIOLEDState *state, bool is_on)
+{
+    int64_t now_ms = qemu_clock_get_ms(QEMU_CLOCK_REALTIME);
+
+    if (now_ms - state->messages_window_start_ms >= 1000) {
+        if (state->messages_suppressed > 0) {
+            char *name = object_get_canonical_path_component(OBJECT(state));
+            printf("[%s: %u more on/off changes]\n", name,
+                    state->messages_suppressed);
+            g_free(name);
+        }
+        state->messages_window_start_ms = now_ms;
+        state->messages_in_window = 0;
+        state->messages_suppressed = 0;
+    }
+
+    if (state->messages_in_window < GPIO_LED_MESSAGES_PER_SECOND) {
+        state->messages_in_window++;
+        printf("%s", is_on ? state->on_message : state->off_message);
+    } else {
+        state->messages_suppressed++;
+        gpio_led_suppressed_messages++;
+    }
+}
+
 static void gpio_led_turn(GPIOLEDState *state, bool is_on)
 {
-    printf("%s", is_on ? state->on_message : state->off_message);
+    gpio_led_display_message(state, is_on);
 
 #if defined(CONFIG_SDL)
 
     if (state->board_graphic_context != NULL) {
-        cortexm_graphic_enqueue_event(GRAPHIC_EVENT_LED_TURN, state,
-                (void*) is_on);
+        // Does not block; the graphic thread draws the last state
+        // once per frame.
+        cortexm_graphic_led_enqueue_turn(&(state->led_graphic_context),
+                is_on);
     }
 
 #endif /* defined(CONFIG_SDL) */
@@ -26,6 +26,7 @@
 
 #include "qemu/timer.h"
 #include "qemu/error-report.h"
+#include "qemu/atomic.h"
 
 #if defined(CONFIG_VERBOSE)
 #include "verbosity.h"
@@ -41,9 +42,14 @@ static void cortexm_graphic_led_init_graphic_context(
         LEDGraphicContext *led_graphic_context, uint8_t red, uint8_t green,
         uint8_t blue);
 
-static void cortexm_graphic_led_turn(BoardGraphicContext *board_graphic_context,
+static void cortexm_graphic_led_draw(BoardGraphicContext *board_graphic_context,
         LEDGraphicContext *led_graphic_context, bool is_on);
 
+static void cortexm_graphic_board_present(
+        BoardGraphicContext *board_graphic_context);
+
+static void cortexm_graphic_led_flush(void);
+
 static void cortexm_graphic_process_mouse_motion(void);
 
 static void cortexm_graphic_process_mouse_button_down(void);
@@ -59,6 +65,18 @@ static SDL_Cursor *button_cursor = NULL;
 static ButtonState *current_button = NULL;
 static ButtonState *pushed_button = NULL;
 
+// Single producer, single consumer ring of LEDs with pending changes;
+// the indices are free running, and wrap only when used to index.
+static struct {
+    LEDGraphicContext *entries[GRAPHIC_LED_RING_SIZE];
+    // Written only by the producer.
+    uint32_t head;
+    // Written only by the consumer.
+    uint32_t tail;
+} led_ring;
+
+static GraphicStatistics graphic_statistics;
+
 // ----------------------------------------------------------------------------
 
 typedef struct {
@@ -71,7 +89,6 @@ static BoardGraphicContext *board_graphic_context;
 static void cortexm_graphic_process_event(SDL_Event* event)
 {
     GPIOLEDState *state;
-    bool is_on;
     int exit_code;
 
     switch (event->type) {
@@ -157,12 +174,8 @@ static void cortexm_graphic_process_event(SDL_Event* event)
             }
             break;
 
-        case GRAPHIC_EVENT_LED_TURN:
-            state = (GPIOLEDState *) event->user.data1;
-            is_on = (bool) event->user.data2;
-
-            cortexm_graphic_led_turn(state->board_graphic_context,
-                    &(state->led_graphic_context), is_on);
+        case GRAPHIC_EVENT_LED_FLUSH:
+            cortexm_graphic_led_flush();
             break;
 
         case GRAPHIC_EVENT_QUIT:
@@ -234,6 +247,10 @@ void cortexm_graphic_event_loop(void)
         cortexm_graphic_process_event(&event);
     }
 
+    // Each timer tick is a frame; all LED changes since the
+    // previous frame are drawn at once.
+    cortexm_graphic_led_flush();
+
     timer_mod(event_loop_timer, qemu_clock_get_ms(QEMU_CLOCK_REALTIME) + 10);
 
 #endif /* !defined(defined(USE_GRAPHIC_POLL_EVENT)) */
@@ -256,15 +273,9 @@ int cortexm_graphic_enqueue_event(int code, void *data1, void *data2)
     event.user.data1 = data1;
     event.user.data2 = data2;
 
-    // TODO: if multi-thread access is needed, add a mutex.
-    int ret = SDL_PushEvent(&event);
-
-#if defined(CONFIG_SDLABI_2_0)
-    // Used to give the scheduler a chance to yield.
-    SDL_Delay(1);
-#endif
-
-    return ret;
+    // SDL_PushEvent() is thread safe, and there is no need to yield,
+    // the frequent events (LED changes) no longer use this path.
+    return SDL_PushEvent(&event);
 
 #else
 
@@ -273,6 +284,21 @@ int cortexm_graphic_enqueue_event(int code, void *data1, void *data2)
 #endif /* defined(CONFIG_SDL) */
 }
 
+// Display the graphic pipeline statistics; called by the
+// 'info graphic' monitor command.
+void cortexm_graphic_info(fprintf_function fprintf_func, void *f)
+{
+    fprintf_func(f, "LED changes queued: %"PRIu64"\n",
+            graphic_statistics.led_queued);
+    fprintf_func(f, "LED changes coalesced: %"PRIu64"\n",
+            graphic_statistics.led_coalesced);
+    fprintf_func(f, "LED changes dropped: %"PRIu64"\n",
+            graphic_statistics.led_dropped);
+    fprintf_func(f, "Frames drawn: %"PRIu64"\n", graphic_statistics.frames);
+    fprintf_func(f, "LED messages suppressed: %"PRIu64"\n",
+            gpio_led_get_suppressed_messages());
+}
+
 // ----------------------------------------------------------------------------
 
 static inline bool cortexm_graphic_mouse_is_in_button(MousePosition *mp,
@@ -633,6 +659,10 @@ void cortexm_graphic_led_clear_graphic_context(
 
     led_graphic_context->crop_on = NULL;
     led_graphic_context->crop_off = NULL;
+
+    led_graphic_context->pending_is_on = false;
+    led_graphic_context->is_queued = false;
+    led_graphic_context->is_drawn_on = false;
 }
 
 bool cortexm_graphic_led_is_graphic_context_initialised(
@@ -688,7 +718,82 @@ static void cortexm_graphic_led_init_graphic_context(
 #endif /* defined(CONFIG_SDL) */
 }
 
-static void cortexm_graphic_led_turn(BoardGraphicContext *board_graphic_context,
+// Called on the producer thread, for each LED change. The change
+// is recorded in the LED context and the LED is added to the ring,
+// unless it is already there, waiting to be drawn, in which case the
+// new state will be used when the ring is drained.
+void cortexm_graphic_led_enqueue_turn(LEDGraphicContext *led_graphic_context,
+        bool is_on)
+{
+    atomic_set(&led_graphic_context->pending_is_on, is_on);
+
+    // Full barrier, the consumer clears the flag before reading the state.
+    if (atomic_xchg(&led_graphic_context->is_queued, true)) {
+        graphic_statistics.led_coalesced++;
+        return;
+    }
+
+    uint32_t head = led_ring.head;
+    if (head - atomic_load_acquire(&led_ring.tail) >= GRAPHIC_LED_RING_SIZE) {
+        // Cannot happen with less LEDs than entries.
+        atomic_set(&led_graphic_context->is_queued, false);
+        graphic_statistics.led_dropped++;
+        return;
+    }
+
+    led_ring.entries[head & (GRAPHIC_LED_RING_SIZE - 1)] = led_graphic_context;
+    atomic_store_release(&led_ring.head, head + 1);
+    graphic_statistics.led_queued++;
+
+#if !defined(USE_GRAPHIC_POLL_EVENT)
+    // Wake up the graphic thread.
+    cortexm_graphic_enqueue_event(GRAPHIC_EVENT_LED_FLUSH, NULL, NULL);
+#endif
+}
+
+// Called on the graphic thread, to draw all LEDs in the ring and
+// present the result once.
+static void cortexm_graphic_led_flush(void)
+{
+    uint32_t tail = led_ring.tail;
+    uint32_t head = atomic_load_acquire(&led_ring.head);
+
+    if (tail == head) {
+        return;
+    }
+
+    bool is_changed = false;
+    for (; tail != head; ++tail) {
+        LEDGraphicContext *led_graphic_context =
+                led_ring.entries[tail & (GRAPHIC_LED_RING_SIZE - 1)];
+
+        // Clear the flag first; later changes will queue the LED again.
+        atomic_xchg(&led_graphic_context->is_queued, false);
+        bool is_on = atomic_read(&led_graphic_context->pending_is_on);
+
+        if (board_graphic_context == NULL
+                || !cortexm_graphic_led_is_graphic_context_initialised(
+                        led_graphic_context)) {
+            continue;
+        }
+
+        // Multiple changes may cancel each other.
+        if (is_on != led_graphic_context->is_drawn_on) {
+            cortexm_graphic_led_draw(board_graphic_context, led_graphic_context,
+                    is_on);
+            led_graphic_context->is_drawn_on = is_on;
+            is_changed = true;
+        }
+    }
+    atomic_store_release(&led_ring.tail, tail);
+
+    if (is_changed) {
+        cortexm_graphic_board_present(board_graphic_context);
+        graphic_statistics.frames++;
+    }
+}
+
+static void cortexm_graphic_led_draw(BoardGraphicContext *board_graphic_context,
         LEDGraphicContext *led_graphic_context, bool is_on)
 {
     qemu_log_mask(LOG_FUNC, "%s(%s)\n", __FUNCTION__, is_on ? "on" : "off");
@@ -703,13 +808,26 @@ static void cortexm_graphic_led_turn(BoardGraphicContext *board_graphic_context,
 #if defined(CONFIG_SDLABI_2_0)
     SDL_UpdateTexture(board_graphic_context->texture,
             &(led_graphic_context->rectangle), crop->pixels, crop->pitch);
+#elif defined(CONFIG_SDLABI_1_2)
+    SDL_BlitSurface(crop, NULL, board_graphic_context->surface,
+            &(led_graphic_context->rectangle));
+#endif
+
+#endif /* defined(CONFIG_SDL) */
+}
+
+// Show the result of all draws since the previous call.
+static void cortexm_graphic_board_present(
+        BoardGraphicContext *board_graphic_context)
+{
+#if defined(CONFIG_SDL)
+
+#if defined(CONFIG_SDLABI_2_0)
     SDL_RenderCopy(board_graphic_context->renderer,
             board_graphic_context->texture,
             NULL, NULL);
     SDL_RenderPresent(board_graphic_context->renderer);
 #elif defined(CONFIG_SDLABI_1_2)
-    SDL_BlitSurface(crop, NULL, board_graphic_context->surface,
-            &(led_graphic_context->rectangle));
     SDL_Flip(board_graphic_context->surface);
 #endif
 
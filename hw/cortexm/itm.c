@@ -19,12 +19,105 @@
 
 #include <hw/cortexm/itm.h>
 
+#include "qemu-common.h"
+#include "sysemu/sysemu.h"
+
 /*
- * This file implements a minimal ITM peripheral, intended to display
- * the trace messages sent via byte writes to stimulus port 0.
+ * This file implements a minimal ITM peripheral, intended to forward
+ * the trace messages sent via 8/16/32-bit writes to the stimulus ports.
+ *
+ * The output goes to the character device set via the "chardev"
+ * property or, if not set, to stderr; it is buffered, to avoid a
+ * system call for each write.
+ *
+ * With the "swo" property set, each write is framed as an ITM software
+ * source packet, as sent on the SWO pin, preceded after reset by
+ * a synchronisation packet.
  */
 
 // ----- Private --------------------------------------------------------------
+
+// Write the buffered output.
+static void cortexm_itm_flush(CortexMITMState *state)
+{
+    if (state->out_count == 0) {
+        return;
+    }
+
+    if (qemu_chr_fe_get_driver(&state->chr) != NULL) {
+        qemu_chr_fe_write_all(&state->chr, state->out_buffer,
+                state->out_count);
+    } else {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-result"
+        qemu_write_full(2, state->out_buffer, state->out_count); /* stderr */
+#pragma GCC diagnostic pop
+    }
+
+    state->out_count = 0;
+}
+
+static void cortexm_itm_flush_timer_callback(void *opaque)
+{
+    cortexm_itm_flush((CortexMITMState *) opaque);
+}
+
+static void cortexm_itm_exit_notifier_callback(Notifier *notifier, void *data)
+{
+    CortexMITMState *state = container_of(notifier, CortexMITMState,
+            exit_notifier);
+
+    cortexm_itm_flush(state);
+}
+
+// Add a stimulus port write to the output buffer.
+static void cortexm_itm_output(CortexMITMState *state, int port,
+        uint32_t value, unsigned size)
+{
+    // Worst case: sync packet (6 bytes), header and 4 bytes payload.
+    if (state->out_count + 11 > CORTEXM_ITM_OUT_BUFFER_SIZE) {
+        cortexm_itm_flush(state);
+    }
+
+    uint8_t *p = &state->out_buffer[state->out_count];
+    bool is_eol = false;
+
+    if (state->swo_framing) {
+        if (state->needs_sync) {
+            // At least 47 zero bits followed by a one.
+            *p++ = 0x00;
+            *p++ = 0x00;
+            *p++ = 0x00;
+            *p++ = 0x00;
+            *p++ = 0x00;
+            *p++ = 0x80;
+            state->needs_sync = false;
+        }
+        // Software source packet: A[7:3] port, [2] 0, SS[1:0] size.
+        *p++ = (port << 3) | ((size == 4) ? 3 : size);
+    }
+
+    // Little endian payload.
+    unsigned i;
+    for (i = 0; i < size; ++i) {
+        uint8_t byte = value >> (8 * i);
+        *p++ = byte;
+        is_eol |= (byte == '\n');
+    }
+
+    state->out_count = p - state->out_buffer;
+
+    if (is_eol && !state->swo_framing) {
+        // Keep text lines visible as soon as they are complete.
+        cortexm_itm_flush(state);
+        timer_del(state->flush_timer);
+    } else if (!timer_pending(state->flush_timer)) {
+        timer_mod(state->flush_timer,
+                qemu_clock_get_ms(QEMU_CLOCK_REALTIME)
+                        + CORTEXM_ITM_FLUSH_DELAY_MS);
+    }
+}
+
 // Read from ITM registers.
 //
 // Only word operations are currently supported.
@@ -67,7 +160,8 @@ static uint64_t cortexm_itm_read_callback(void *opaque, hwaddr addr,
 
 // Write to ITM registers.
 //
-// Byte writes to stimulus port 0 are forwarded to stderr.
+// Byte, half-word and word writes to the enabled stimulus ports
+// are forwarded to the output.
 //
 // Word writes to the other registers
 static void cortexm_itm_write_callback(void *opaque, hwaddr addr,
@@ -91,32 +185,17 @@ static void cortexm_itm_write_callback(void *opaque, hwaddr addr,
         // Compute index of Enable register (32 stimulus ports / register)
         int eix = ix / 32;
         uint32_t mask = 1 << (ix - eix * 32);
-        if ((state->reg.ter[ix] & mask) == 0) {
+        if ((state->reg.ter[eix] & mask) == 0) {
             return; // Ignore not enabled stimulus ports
         }
 
-        if (ix == 0) {
-            // Currently only stimulus port 0 is used for trace, byte size
-            if (size == 1) {
-                uint8_t byte;
-                byte = value;
-
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wunused-result"
-                write(2, &byte, 1); /* Write on stderr */
-#pragma GCC diagnostic pop
-
-            } else {
-                qemu_log_mask(LOG_GUEST_ERROR,
-                        "ITM: Stimulus write size %d at offset 0x%x not implemented\n",
-                        size, offset);
-            }
+        if (state->swo_framing && ix >= CORTEXM_ITM_SWO_MAX_NUM_PORTS) {
+            qemu_log_mask(LOG_GUEST_ERROR,
+                    "ITM: Stimulus port %d cannot be framed\n", ix);
             return;
         }
 
-        qemu_log_mask(LOG_GUEST_ERROR,
-                "ITM: Stimulus write size %d at offset 0x%x not implemented\n",
-                size, offset);
+        cortexm_itm_output(state, ix, value, size);
         return;
     }
 
@@ -179,6 +258,14 @@ static void cortexm_itm_realize_callback(DeviceState *dev, Error **errp)
 
     sysbus_init_mmio(SYS_BUS_DEVICE(dev), &state->mmio);
     sysbus_mmio_map(SYS_BUS_DEVICE(dev), 0, addr);
+
+    state->out_count = 0;
+    state->flush_timer = timer_new_ms(QEMU_CLOCK_REALTIME,
+            cortexm_itm_flush_timer_callback, state);
+
+    // Do not lose the last buffered bytes.
+    state->exit_notifier.notify = cortexm_itm_exit_notifier_callback;
+    qemu_add_exit_notifier(&state->exit_notifier);
 }
 
 static void cortexm_itm_reset_callback(DeviceState *dev)
@@ -186,6 +273,11 @@ static void cortexm_itm_reset_callback(DeviceState *dev)
     qemu_log_function_name();
 
     CortexMITMState *state = CORTEXM_ITM_STATE(dev);
+
+    // Output from before the reset is still valid.
+    cortexm_itm_flush(state);
+    state->needs_sync = true;
+
     int i;
     for (i = 0; i < state->num_ports; ++i) {
         state->reg.stim[i] = 0x00000000;
@@ -205,10 +297,17 @@ static void cortexm_itm_reset_callback(DeviceState *dev)
     state->reg.tcr = 0x00000001; /* ITMENA=1 */
 }
 
+static Property cortexm_itm_properties[] = {
+        DEFINE_PROP_CHR("chardev", CortexMITMState, chr),
+        DEFINE_PROP_BOOL("swo", CortexMITMState, swo_framing, false),
+    DEFINE_PROP_END_OF_LIST(), };
+
 static void cortexm_itm_class_init_callback(ObjectClass *klass, void *data)
 {
     DeviceClass *dc = DEVICE_CLASS(klass);
 
+    dc->props = cortexm_itm_properties;
+
     dc->reset = cortexm_itm_reset_callback;
     dc->realize = cortexm_itm_realize_callback;
 }
@@ -42,6 +42,10 @@
 #include "verbosity.h"
 #endif
 
+#if defined(CONFIG_POSIX)
+#include <sys/mman.h>
+#endif
+
 #define DEFAULT_NUM_IRQ		256
 
 // ----- Private --------------------------------------------------------------
@@ -121,17 +125,15 @@ static void cortexm_mcu_realize_callback(DeviceState *dev, Error **errp)
         }
 #endif
 
-        JSON_Value *value = json_parse_file(svd_full_name);
-        cm_state->svd_json = json_value_get_object(value);
+        // Use the processed device from the binary cache; the JSON
+        // file is parsed only when the cache is missing or outdated.
+        cm_state->svd_device = svd_cache_load(svd_full_name);
 
-        svd_validate_device_name(cm_state->svd_json,
-                capabilities->svd_device_name);
+        svd_validate_device_name(cm_state->svd_device, capabilities->svd_device_name);
 
-        svd_process_cpu(cm_state->svd_json, core_capabilities);
+        svd_process_cpu(cm_state->svd_device, core_capabilities);
 
-        JSON_Object *device = json_object_get_object(cm_state->svd_json,
-                "device");
-        svd_set_register_properties_group(device, OBJECT(dev));
+        svd_set_device_properties_group(cm_state->svd_device, OBJECT(dev));
     }
 
     const MachineState *machine = MACHINE(cortexm_board_get());
@@ -144,6 +146,7 @@ static void cortexm_mcu_realize_callback(DeviceState *dev, Error **errp)
     }
 
     cm_state->image_filename = image_filename;
+    cm_state->flash_image_filename = machine->flash_image_filename;
 
     const char *cpu_model = "?";
     if (machine->cpu_model) {
@@ -328,8 +331,11 @@ static void cortexm_mcu_realize_callback(DeviceState *dev, Error **errp)
         num_irq = (num_irq + 31) & (~31);
         cm_state->num_irq = num_irq;
 
-        // This currently goes to GIC, which uses a different numbering.
-        object_property_set_int(nvic, num_irq + 32, "num-irq", NULL);
+        object_property_set_int(nvic, num_irq, "num-irq", NULL);
+        if (capabilities->core->nvic_bits != 0) {
+            object_property_set_int(nvic, capabilities->core->nvic_bits,
+                    "priority-bits", NULL);
+        }
 
         cm_object_realize(nvic);
         cm_state->nvic = DEVICE(nvic);
@@ -340,8 +346,7 @@ static void cortexm_mcu_realize_callback(DeviceState *dev, Error **errp)
         sysbus_connect_irq(SYS_BUS_DEVICE(cm_state->nvic), 0,
                 qdev_get_gpio_in(DEVICE(cm_state->cpu), ARM_CPU_IRQ));
 
-        GICState *gs = ARM_GIC_COMMON(nvic);
-        gs->basepri_ptr = &env->v7m.basepri;
+        CORTEXM_NVIC_STATE(nvic)->basepri_ptr = &env->v7m.basepri;
 
 #if 0
         // Create the CPU exception handler interrupts. Peripherals
@@ -445,6 +450,86 @@ static void cortexm_mcu_reset_callback(DeviceState *dev)
     object_child_foreach(cm_state->container, cortexm_mcu_reset_object, NULL);
 }
 
+// Reads are served from the host memory (ROMD mode), only writes
+// get here, to be passed to the vendor flash controller.
+static uint64_t cortexm_mcu_flash_read_callback(void *opaque, hwaddr addr,
+        unsigned size)
+{
+    CortexMState *cm_state = CORTEXM_MCU_STATE(opaque);
+
+    uint8_t *ptr = memory_region_get_ram_ptr(&cm_state->flash_mem) + addr;
+    switch (size) {
+    case 1:
+        return ldub_p(ptr);
+    case 2:
+        return lduw_le_p(ptr);
+    default:
+        return ldl_le_p(ptr);
+    }
+}
+
+static void cortexm_mcu_flash_write_callback(void *opaque, hwaddr addr,
+        uint64_t value, unsigned size)
+{
+    CortexMState *cm_state = CORTEXM_MCU_STATE(opaque);
+
+    if (cm_state->flash_write) {
+        cm_state->flash_write(cm_state->flash_write_opaque, addr, value, size);
+    } else {
+        qemu_log_mask(LOG_GUEST_ERROR,
+                "Flash write of %d bytes at 0x%08"PRIX64" ignored.\n", size,
+                addr);
+    }
+}
+
+static const MemoryRegionOps cortexm_mcu_flash_ops = {
+    .read = cortexm_mcu_flash_read_callback,
+    .write = cortexm_mcu_flash_write_callback,
+    .endianness = DEVICE_NATIVE_ENDIAN,
+/**/
+};
+
+// Map the flash image file, extended to the flash size if needed;
+// the new area is erased (0xFF). Pages are loaded on first access and
+// written back by the host, no copy is made at start or exit.
+static void *cortexm_mcu_map_flash_image(const char *file_name, size_t size)
+{
+#if defined(CONFIG_POSIX)
+    int fd = qemu_open(file_name, O_RDWR | O_CREAT | O_BINARY, 0644);
+    if (fd < 0) {
+        error_report("Could not open flash image '%s'", file_name);
+        exit(1);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        error_report("Could not stat flash image '%s'", file_name);
+        exit(1);
+    }
+
+    size_t old_size = st.st_size;
+    if (old_size < size && ftruncate(fd, size) < 0) {
+        error_report("Could not resize flash image '%s'", file_name);
+        exit(1);
+    }
+
+    void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    qemu_close(fd);
+    if (ptr == MAP_FAILED) {
+        error_report("Could not map flash image '%s'", file_name);
+        exit(1);
+    }
+
+    if (old_size < size) {
+        memset((uint8_t *) ptr + old_size, 0xFF, size - old_size);
+    }
+    return ptr;
+#else
+    error_report("Flash image files are not supported on this host");
+    exit(1);
+#endif
+}
+
 static void cortexm_mcu_memory_regions_create_callback(DeviceState *dev)
 {
     qemu_log_function_name();
@@ -460,11 +545,21 @@ static void cortexm_mcu_memory_regions_create_callback(DeviceState *dev)
     Object *mem_container = container_get(cm_state->container, "/memory");
 
     MemoryRegion *flash_mem = &cm_state->flash_mem;
-    // Flash programming is done via the SCU, so pretend it is ROM.
-    memory_region_init_ram(flash_mem, mem_container, "flash", flash_size,
-            &error_fatal);
+    // Flash is a ROM device: reads go directly to the host memory,
+    // writes are trapped, for the vendor flash controller to program.
+    if (cm_state->flash_image_filename) {
+        void *ptr = cortexm_mcu_map_flash_image(
+                cm_state->flash_image_filename, flash_size);
+        memory_region_init_rom_device_ptr(flash_mem, mem_container,
+                &cortexm_mcu_flash_ops, cm_state, "flash", flash_size, ptr);
+    } else {
+        memory_region_init_rom_device(flash_mem, mem_container,
+                &cortexm_mcu_flash_ops, cm_state, "flash", flash_size,
+                &error_fatal);
+        // Erased flash.
+        memset(memory_region_get_ram_ptr(flash_mem), 0xFF, flash_size);
+    }
     vmstate_register_ram_global(flash_mem);
-    memory_region_set_readonly(flash_mem, true);
     memory_region_add_subregion(system_memory, 0x00000000, flash_mem);
 
     MemoryRegion *sram_mem = &cm_state->sram_mem;
@@ -0,0 +1,255 @@
+/*
+ * Cortex-M NVIC priority engine.
+ *
+ * Copyright (c) 2017 Liviu Ionescu.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <hw/cortexm/nvic-prio.h>
+
+static inline void nvic_prio_level_add(unsigned long *levels, uint16_t *count,
+        int level);
+static inline void nvic_prio_level_remove(unsigned long *levels,
+        uint16_t *count, int level);
+static void nvic_prio_ready_insert(NVICPrio *p, int vector);
+static void nvic_prio_ready_remove(NVICPrio *p, int vector);
+
+// ----- Public ---------------------------------------------------------------
+
+// Set the number of vectors (16 + number of interrupts) and the number
+// of implemented priority bits (3-8), then reset.
+void nvic_prio_init(NVICPrio *p, uint32_t num_vectors, int priority_bits)
+{
+    assert(num_vectors <= NVIC_PRIO_MAX_VECTORS);
+
+    memset(p, 0, sizeof(*p));
+
+    p->num_vectors = num_vectors;
+    if (priority_bits < 1 || priority_bits > 8) {
+        priority_bits = 8;
+    }
+    p->priority_mask = (0xFF << (8 - priority_bits)) & 0xFF;
+
+    nvic_prio_reset(p);
+}
+
+void nvic_prio_reset(NVICPrio *p)
+{
+    int vector;
+
+    bitmap_zero(p->enabled, NVIC_PRIO_MAX_VECTORS);
+    bitmap_zero(p->pending, NVIC_PRIO_MAX_VECTORS);
+    bitmap_zero(p->active, NVIC_PRIO_MAX_VECTORS);
+
+    memset(p->ready, 0, sizeof(p->ready));
+    memset(p->ready_count, 0, sizeof(p->ready_count));
+    bitmap_zero(p->ready_levels, NVIC_PRIO_NUM_LEVELS);
+
+    memset(p->active_count, 0, sizeof(p->active_count));
+    bitmap_zero(p->active_levels, NVIC_PRIO_NUM_LEVELS);
+    p->num_active = 0;
+
+    p->prigroup = 0;
+
+    memset(p->raw_priority, 0, sizeof(p->raw_priority));
+    for (vector = 0; vector < NVIC_PRIO_MAX_VECTORS; ++vector) {
+        p->priority[vector] = 0;
+    }
+    p->priority[NVIC_EXCEPTION_RESET] = NVIC_PRIO_RESET;
+    p->priority[NVIC_EXCEPTION_NMI] = NVIC_PRIO_NMI;
+    p->priority[NVIC_EXCEPTION_HARD_FAULT] = NVIC_PRIO_HARD_FAULT;
+
+    // System exceptions are always enabled, except the configurable
+    // faults, enabled via SHCSR.
+    for (vector = 1; vector < 16; ++vector) {
+        set_bit(vector, p->enabled);
+    }
+    clear_bit(NVIC_EXCEPTION_MEM_MANAGE, p->enabled);
+    clear_bit(NVIC_EXCEPTION_BUS_FAULT, p->enabled);
+    clear_bit(NVIC_EXCEPTION_USAGE_FAULT, p->enabled);
+}
+
+// Set the priority from the 8-bit register value; the fixed priorities
+// cannot be changed.
+void nvic_prio_set_priority(NVICPrio *p, int vector, uint8_t raw)
+{
+    assert(vector > 0 && vector < p->num_vectors);
+
+    if (vector <= NVIC_EXCEPTION_HARD_FAULT) {
+        return;
+    }
+
+    raw &= p->priority_mask;
+    p->raw_priority[vector] = raw;
+
+    if (p->priority[vector] == raw) {
+        return;
+    }
+
+    // Move the exception to the new level.
+    bool is_ready = nvic_prio_is_pending(p, vector)
+            && nvic_prio_is_enabled(p, vector);
+    bool is_active = nvic_prio_is_active(p, vector);
+
+    if (is_ready) {
+        nvic_prio_ready_remove(p, vector);
+    }
+    if (is_active) {
+        nvic_prio_level_remove(p->active_levels, p->active_count,
+                p->priority[vector] + NVIC_PRIO_LEVEL_OFFSET);
+    }
+
+    p->priority[vector] = raw;
+
+    if (is_ready) {
+        nvic_prio_ready_insert(p, vector);
+    }
+    if (is_active) {
+        nvic_prio_level_add(p->active_levels, p->active_count,
+                p->priority[vector] + NVIC_PRIO_LEVEL_OFFSET);
+    }
+}
+
+// Since the levels use the full priority, a new grouping does not
+// require any changes, only the comparisons with the execution
+// priority are affected.
+void nvic_prio_set_prigroup(NVICPrio *p, int prigroup)
+{
+    p->prigroup = prigroup & 0x7;
+}
+
+void nvic_prio_set_enabled(NVICPrio *p, int vector, bool enabled)
+{
+    assert(vector > 0 && vector < p->num_vectors);
+
+    if (nvic_prio_is_enabled(p, vector) == enabled) {
+        return;
+    }
+
+    if (enabled) {
+        set_bit(vector, p->enabled);
+        if (nvic_prio_is_pending(p, vector)) {
+            nvic_prio_ready_insert(p, vector);
+        }
+    } else {
+        if (nvic_prio_is_pending(p, vector)) {
+            nvic_prio_ready_remove(p, vector);
+        }
+        clear_bit(vector, p->enabled);
+    }
+}
+
+void nvic_prio_set_pending(NVICPrio *p, int vector, bool pending)
+{
+    assert(vector > 0 && vector < p->num_vectors);
+
+    if (nvic_prio_is_pending(p, vector) == pending) {
+        return;
+    }
+
+    if (pending) {
+        set_bit(vector, p->pending);
+        if (nvic_prio_is_enabled(p, vector)) {
+            nvic_prio_ready_insert(p, vector);
+        }
+    } else {
+        if (nvic_prio_is_enabled(p, vector)) {
+            nvic_prio_ready_remove(p, vector);
+        }
+        clear_bit(vector, p->pending);
+    }
+}
+
+void nvic_prio_set_active(NVICPrio *p, int vector, bool active)
+{
+    assert(vector > 0 && vector < p->num_vectors);
+
+    if (nvic_prio_is_active(p, vector) == active) {
+        return;
+    }
+
+    int level = p->priority[vector] + NVIC_PRIO_LEVEL_OFFSET;
+    if (active) {
+        set_bit(vector, p->active);
+        nvic_prio_level_add(p->active_levels, p->active_count, level);
+        p->num_active++;
+    } else {
+        clear_bit(vector, p->active);
+        nvic_prio_level_remove(p->active_levels, p->active_count, level);
+        p->num_active--;
+    }
+}
+
+// The execution priority is the group priority of the highest priority
+// active exception, boosted by BASEPRI; PRIMASK and FAULTMASK are
+// checked by the CPU.
+int nvic_prio_execution_priority(NVICPrio *p, uint32_t basepri)
+{
+    int priority = NVIC_PRIO_THREAD;
+
+    unsigned long level = find_first_bit(p->active_levels,
+            NVIC_PRIO_NUM_LEVELS);
+    if (level < NVIC_PRIO_NUM_LEVELS) {
+        priority = nvic_prio_group_priority(p,
+                (int) level - NVIC_PRIO_LEVEL_OFFSET);
+    }
+
+    basepri &= p->priority_mask;
+    if (basepri != 0) {
+        int boosted = nvic_prio_group_priority(p, basepri);
+        if (boosted < priority) {
+            priority = boosted;
+        }
+    }
+
+    return priority;
+}
+
+// ----- Private --------------------------------------------------------------
+
+static inline void nvic_prio_level_add(unsigned long *levels, uint16_t *count,
+        int level)
+{
+    if (count[level]++ == 0) {
+        set_bit(level, levels);
+    }
+}
+
+static inline void nvic_prio_level_remove(unsigned long *levels,
+        uint16_t *count, int level)
+{
+    assert(count[level] > 0);
+    if (--count[level] == 0) {
+        clear_bit(level, levels);
+    }
+}
+
+static void nvic_prio_ready_insert(NVICPrio *p, int vector)
+{
+    int level = p->priority[vector] + NVIC_PRIO_LEVEL_OFFSET;
+
+    set_bit(vector, p->ready[level]);
+    nvic_prio_level_add(p->ready_levels, p->ready_count, level);
+}
+
+static void nvic_prio_ready_remove(NVICPrio *p, int vector)
+{
+    int level = p->priority[vector] + NVIC_PRIO_LEVEL_OFFSET;
+
+    clear_bit(vector, p->ready[level]);
+    nvic_prio_level_remove(p->ready_levels, p->ready_count, level);
+}
+
+// ----------------------------------------------------------------------------
@@ -46,10 +46,18 @@
  *
  * Preferably keep them apart and number each from 0.
  *
- * GIC interrupts are numbered differently, the first 32 are for the system
- * and the higher ones are for the user, so gic->num_irq = nvic->num_irq+32.
+ * Internally, the priority engine uses the vector numbers, the system
+ * exceptions are 1-15, and the interrupts start at 16.
  */
 
+static void cortexm_nvic_escalate(CortexMNVICState *s, int *exception);
+
+/* BASEPRI is not available until the NVIC is connected to the CPU. */
+static inline uint32_t cortexm_nvic_basepri(CortexMNVICState *s)
+{
+    return s->basepri_ptr ? *(s->basepri_ptr) : 0;
+}
+
 /* ----- Public ------------------------------------------------------------ */
 
 int system_clock_scale;
@@ -60,8 +68,12 @@ int system_clock_scale;
 void cortexm_nvic_set_pending_exception(void *opaque, int exception)
 {
     CortexMNVICState *s = (CortexMNVICState *) opaque;
-    assert(exception >= 0 && exception < 16);
-    gic_set_pending_private(&s->gic, 0, exception);
+    assert(exception > 0 && exception < 16);
+
+    cortexm_nvic_escalate(s, &exception);
+
+    nvic_prio_set_pending(&s->prio, exception, true);
+    cortexm_nvic_update(s);
 }
 
 /* Interrupt numbers reflect CMSIS IRQn values;
@@ -69,46 +81,117 @@ void cortexm_nvic_set_pending_exception(void *opaque, int exception)
 void cortexm_nvic_set_pending_interrupt(void *opaque, int interrupt)
 {
     CortexMNVICState *s = (CortexMNVICState *) opaque;
-    assert(interrupt >= 0);
-    gic_set_pending_private(&s->gic, 0, interrupt + 32);
+    assert(interrupt >= 0 && interrupt < s->num_irq);
+
+    nvic_prio_set_pending(&s->prio, interrupt + 16, true);
+    cortexm_nvic_update(s);
 }
 
-#if 0
-/* The external routines use the hardware vector numbering, ie. the first
- IRQ is #16.  The internal GIC routines use #32 as the first IRQ.  */
-void cortexm_nvic_set_pending(void *opaque, int irq)
+/* Make pending IRQ active; return the vector number.  */
+int cortexm_nvic_acknowledge_irq(void *opaque)
 {
     CortexMNVICState *s = (CortexMNVICState *) opaque;
-    if (irq >= 16) {
-        irq += 16;
+
+    int vector = nvic_prio_acknowledge(&s->prio);
+    if (vector == 0) {
+        hw_error("Interrupt but no vector\n");
     }
-    gic_set_pending_private(&s->gic, 0, irq);
+
+    cortexm_nvic_update(s);
+    return vector;
 }
-#endif
 
-/* Make pending IRQ active.  */
-int cortexm_nvic_acknowledge_irq(void *opaque)
+/* Deactivate the exception, on return from handler. */
+void cortexm_nvic_complete_irq(void *opaque, int irq)
 {
     CortexMNVICState *s = (CortexMNVICState *) opaque;
-    uint32_t irq;
 
-    irq = gic_acknowledge_irq(&s->gic, 0, MEMTXATTRS_UNSPECIFIED);
-    if (irq == 1023) {
-        hw_error("Interrupt but no vector\n");
+    if (!nvic_prio_is_active(&s->prio, irq)) {
+        qemu_log_mask(LOG_GUEST_ERROR,
+                "NVIC: Return from inactive exception %d\n", irq);
+        return;
     }
-    if (irq >= 32) {
-        irq -= 16;
+
+    nvic_prio_set_active(&s->prio, irq, false);
+
+    /* Level sensitive; if the line is still high, pend it again. */
+    if (irq >= 16 && test_bit(irq - 16, s->level)) {
+        nvic_prio_set_pending(&s->prio, irq, true);
     }
-    return irq;
+
+    cortexm_nvic_update(s);
 }
 
-void cortexm_nvic_complete_irq(void *opaque, int irq)
+/*
+ * Called on exception return, after the exception was completed;
+ * if a pending exception can preempt the context that would be
+ * restored, it can be taken directly, without unstacking and
+ * stacking again the same registers (tail-chaining).
+ */
+bool cortexm_nvic_can_tail_chain(void *opaque)
+{
+    CortexMNVICState *s = (CortexMNVICState *) opaque;
+
+    return nvic_prio_preempting(&s->prio, cortexm_nvic_basepri(s)) != 0;
+}
+
+/*
+ * Raise the CPU interrupt line if there is a pending exception with
+ * enough priority to preempt the current execution; must be called
+ * after each change of the pending/enabled/active state, of the
+ * priorities, or of BASEPRI.
+ */
+void cortexm_nvic_update(void *opaque)
 {
     CortexMNVICState *s = (CortexMNVICState *) opaque;
-    if (irq >= 16) {
-        irq += 16;
+
+    int vector = nvic_prio_preempting(&s->prio, cortexm_nvic_basepri(s));
+    qemu_set_irq(s->cpu_irq, vector != 0);
+}
+
+/* ------------------------------------------------------------------------- */
+
+/*
+ * Synchronous faults and SVC cannot wait; if the handler is disabled or
+ * its group priority does not allow it to preempt the current execution,
+ * the exception is escalated to HardFault (HFSR.FORCED).
+ */
+static void cortexm_nvic_escalate(CortexMNVICState *s, int *exception)
+{
+    switch (*exception) {
+    case NVIC_EXCEPTION_MEM_MANAGE:
+    case NVIC_EXCEPTION_BUS_FAULT:
+    case NVIC_EXCEPTION_USAGE_FAULT:
+    case NVIC_EXCEPTION_SVCALL:
+        break;
+    default:
+        return;
+    }
+
+    int execution_priority = nvic_prio_execution_priority(&s->prio,
+            cortexm_nvic_basepri(s));
+
+    if (!nvic_prio_is_enabled(&s->prio, *exception)
+            || nvic_prio_group_priority(&s->prio,
+                    s->prio.priority[*exception]) >= execution_priority) {
+        qemu_log_mask(CPU_LOG_INT, "NVIC: exception %d escalated to "
+                "HardFault\n", *exception);
+        s->scb.hfsr |= (1 << 30); /* FORCED */
+        *exception = NVIC_EXCEPTION_HARD_FAULT;
+    }
+}
+
+/* Incoming interrupt lines, numbered from 0 (CMSIS IRQn). */
+static void cortexm_nvic_irq_handler(void *opaque, int n, int level)
+{
+    CortexMNVICState *s = (CortexMNVICState *) opaque;
+
+    if (level) {
+        set_bit(n, s->level);
+        cortexm_nvic_set_pending_interrupt(s, n);
+    } else {
+        clear_bit(n, s->level);
     }
-    gic_complete_irq(&s->gic, 0, irq, MEMTXATTRS_UNSPECIFIED);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -198,11 +281,41 @@ static void systick_reset(CortexMNVICState *s)
 
 /* ------------------------------------------------------------------------- */
 
+/* One bit per interrupt; word 0 covers interrupts 0-31 (vectors 16-47). */
+static uint32_t nvic_irq_bits_read(CortexMNVICState *s,
+        const unsigned long *bitmap, uint32_t index)
+{
+    uint32_t val = 0;
+    int vector = 16 + index * 32;
+    int i;
+
+    for (i = 0; i < 32 && vector + i < s->prio.num_vectors; i++) {
+        if (test_bit(vector + i, bitmap)) {
+            val |= (1U << i);
+        }
+    }
+    return val;
+}
+
+static void nvic_irq_bits_write(CortexMNVICState *s, uint32_t index,
+        uint32_t value, void (*set)(NVICPrio *p, int vector, bool state),
+        bool state)
+{
+    int vector = 16 + index * 32;
+    int i;
+
+    for (i = 0; i < 32 && vector + i < s->prio.num_vectors; i++) {
+        if (value & (1U << i)) {
+            set(&s->prio, vector + i, state);
+        }
+    }
+    cortexm_nvic_update(s);
+}
+
 static uint32_t nvic_readl(CortexMNVICState *s, uint32_t offset)
 {
     ARMCPU *cpu;
     uint32_t val;
-    int irq;
 
     /* Relative to System control registers (0xE000E000) */
     switch (offset) {
@@ -235,6 +348,19 @@ static uint32_t nvic_readl(CortexMNVICState *s, uint32_t offset)
     case 0x1c: /* SysTick Calibration Value.  */
         return 10000;
 
+        // NVIC 0xE000E100 - 0xE000ECFF
+
+    case 0x100 ... 0x13f: /* Interrupt Set-Enable.  */
+        return nvic_irq_bits_read(s, s->prio.enabled, (offset - 0x100) >> 2);
+    case 0x180 ... 0x1bf: /* Interrupt Clear-Enable.  */
+        return nvic_irq_bits_read(s, s->prio.enabled, (offset - 0x180) >> 2);
+    case 0x200 ... 0x23f: /* Interrupt Set-Pending.  */
+        return nvic_irq_bits_read(s, s->prio.pending, (offset - 0x200) >> 2);
+    case 0x280 ... 0x2bf: /* Interrupt Clear-Pending.  */
+        return nvic_irq_bits_read(s, s->prio.pending, (offset - 0x280) >> 2);
+    case 0x300 ... 0x33f: /* Interrupt Active Bit.  */
+        return nvic_irq_bits_read(s, s->prio.active, (offset - 0x300) >> 2);
+
         // System Control Block 0xE000ED00 - 0xE000ED8C
 
     case 0xd00: /* CPUID Base.  */
@@ -243,40 +369,33 @@ static uint32_t nvic_readl(CortexMNVICState *s, uint32_t offset)
     case 0xd04: /* Interrupt Control State.  */
         /* VECTACTIVE */
         cpu = ARM_CPU(qemu_get_cpu(0));
-        val = cpu->env.v7m.exception;
-        if (val == 1023) {
-            val = 0;
-        } else if (val >= 32) {
-            val -= 16;
-        }
+        val = cpu->env.v7m.exception & 0x1ff;
         /* VECTPENDING */
-        if (s->gic.current_pending[0] != 1023)
-            val |= (s->gic.current_pending[0] << 12);
-        /* ISRPENDING and RETTOBASE */
-        for (irq = 32; irq < s->num_irq; irq++) {
-            if (s->gic.irq_state[irq].pending) {
-                val |= (1 << 22);
-                break;
-            }
-            if (irq != cpu->env.v7m.exception && s->gic.irq_state[irq].active) {
-                val |= (1 << 11);
-            }
+        val |= (nvic_prio_highest_pending(&s->prio) & 0x1ff) << 12;
+        /* ISRPENDING */
+        if (find_next_bit(s->prio.pending, s->prio.num_vectors, 16)
+                < s->prio.num_vectors) {
+            val |= (1 << 22);
+        }
+        /* RETTOBASE, no other active exception */
+        if (s->prio.num_active <= 1) {
+            val |= (1 << 11);
         }
         /* PENDSTSET */
-        if (s->gic.irq_state[ARMV7M_EXCP_SYSTICK].pending)
+        if (nvic_prio_is_pending(&s->prio, NVIC_EXCEPTION_SYSTICK))
             val |= (1 << 26);
         /* PENDSVSET */
-        if (s->gic.irq_state[ARMV7M_EXCP_PENDSV].pending)
+        if (nvic_prio_is_pending(&s->prio, NVIC_EXCEPTION_PENDSV))
             val |= (1 << 28);
         /* NMIPENDSET */
-        if (s->gic.irq_state[ARMV7M_EXCP_NMI].pending)
+        if (nvic_prio_is_pending(&s->prio, NVIC_EXCEPTION_NMI))
             val |= (1 << 31);
         return val;
     case 0xd08: /* Vector Table Offset.  */
         cpu = ARM_CPU(qemu_get_cpu(0));
         return cpu->env.v7m.vecbase;
     case 0xd0c: /* Application Interrupt/Reset Control.  */
-        return 0xfa050000;
+        return 0xfa050000 | (s->prio.prigroup << 8);
     case 0xd10: /* System Control.  */
         /* TODO: Implement SLEEPONEXIT.  */
         return 0;
@@ -285,33 +404,33 @@ static uint32_t nvic_readl(CortexMNVICState *s, uint32_t offset)
         return 0;
     case 0xd24: /* System Handler Status.  */
         val = 0;
-        if (s->gic.irq_state[ARMV7M_EXCP_MEM].active)
+        if (nvic_prio_is_active(&s->prio, NVIC_EXCEPTION_MEM_MANAGE))
             val |= (1 << 0);
-        if (s->gic.irq_state[ARMV7M_EXCP_BUS].active)
+        if (nvic_prio_is_active(&s->prio, NVIC_EXCEPTION_BUS_FAULT))
             val |= (1 << 1);
-        if (s->gic.irq_state[ARMV7M_EXCP_USAGE].active)
+        if (nvic_prio_is_active(&s->prio, NVIC_EXCEPTION_USAGE_FAULT))
             val |= (1 << 3);
-        if (s->gic.irq_state[ARMV7M_EXCP_SVC].active)
+        if (nvic_prio_is_active(&s->prio, NVIC_EXCEPTION_SVCALL))
             val |= (1 << 7);
-        if (s->gic.irq_state[ARMV7M_EXCP_DEBUG].active)
+        if (nvic_prio_is_active(&s->prio, NVIC_EXCEPTION_DEBUG_MONITOR))
             val |= (1 << 8);
-        if (s->gic.irq_state[ARMV7M_EXCP_PENDSV].active)
+        if (nvic_prio_is_active(&s->prio, NVIC_EXCEPTION_PENDSV))
             val |= (1 << 10);
-        if (s->gic.irq_state[ARMV7M_EXCP_SYSTICK].active)
+        if (nvic_prio_is_active(&s->prio, NVIC_EXCEPTION_SYSTICK))
             val |= (1 << 11);
-        if (s->gic.irq_state[ARMV7M_EXCP_USAGE].pending)
+        if (nvic_prio_is_pending(&s->prio, NVIC_EXCEPTION_USAGE_FAULT))
             val |= (1 << 12);
-        if (s->gic.irq_state[ARMV7M_EXCP_MEM].pending)
+        if (nvic_prio_is_pending(&s->prio, NVIC_EXCEPTION_MEM_MANAGE))
             val |= (1 << 13);
-        if (s->gic.irq_state[ARMV7M_EXCP_BUS].pending)
+        if (nvic_prio_is_pending(&s->prio, NVIC_EXCEPTION_BUS_FAULT))
             val |= (1 << 14);
-        if (s->gic.irq_state[ARMV7M_EXCP_SVC].pending)
+        if (nvic_prio_is_pending(&s->prio, NVIC_EXCEPTION_SVCALL))
             val |= (1 << 15);
-        if (s->gic.irq_state[ARMV7M_EXCP_MEM].enabled)
+        if (nvic_prio_is_enabled(&s->prio, NVIC_EXCEPTION_MEM_MANAGE))
             val |= (1 << 16);
-        if (s->gic.irq_state[ARMV7M_EXCP_BUS].enabled)
+        if (nvic_prio_is_enabled(&s->prio, NVIC_EXCEPTION_BUS_FAULT))
             val |= (1 << 17);
-        if (s->gic.irq_state[ARMV7M_EXCP_USAGE].enabled)
+        if (nvic_prio_is_enabled(&s->prio, NVIC_EXCEPTION_USAGE_FAULT))
             val |= (1 << 18);
         return val;
 
@@ -420,6 +539,27 @@ static void nvic_writel(CortexMNVICState *s, uint32_t offset, uint32_t value)
         s->systick.control &= ~SYSTICK_COUNTFLAG;
         break;
 
+        // NVIC 0xE000E100 - 0xE000ECFF
+
+    case 0x100 ... 0x13f: /* Interrupt Set-Enable.  */
+        nvic_irq_bits_write(s, (offset - 0x100) >> 2, value,
+                nvic_prio_set_enabled, true);
+        break;
+    case 0x180 ... 0x1bf: /* Interrupt Clear-Enable.  */
+        nvic_irq_bits_write(s, (offset - 0x180) >> 2, value,
+                nvic_prio_set_enabled, false);
+        break;
+    case 0x200 ... 0x23f: /* Interrupt Set-Pending.  */
+        nvic_irq_bits_write(s, (offset - 0x200) >> 2, value,
+                nvic_prio_set_pending, true);
+        break;
+    case 0x280 ... 0x2bf: /* Interrupt Clear-Pending.  */
+        nvic_irq_bits_write(s, (offset - 0x280) >> 2, value,
+                nvic_prio_set_pending, false);
+        break;
+    case 0x300 ... 0x33f: /* Interrupt Active Bit, read only.  */
+        break;
+
         // System Control Block 0xE000ED00 - 0xE000ED8C
     case 0xd04: /* Interrupt Control State.  */
         if (value & (1 << 31)) {
@@ -428,14 +568,14 @@ static void nvic_writel(CortexMNVICState *s, uint32_t offset, uint32_t value)
         if (value & (1 << 28)) {
             cortexm_nvic_set_pending_exception(s, NVIC_EXCEPTION_PENDSV);
         } else if (value & (1 << 27)) {
-            s->gic.irq_state[ARMV7M_EXCP_PENDSV].pending = 0;
-            gic_update(&s->gic);
+            nvic_prio_set_pending(&s->prio, NVIC_EXCEPTION_PENDSV, false);
+            cortexm_nvic_update(s);
         }
         if (value & (1 << 26)) {
             cortexm_nvic_set_pending_exception(s, NVIC_EXCEPTION_SYSTICK);
         } else if (value & (1 << 25)) {
-            s->gic.irq_state[ARMV7M_EXCP_SYSTICK].pending = 0;
-            gic_update(&s->gic);
+            nvic_prio_set_pending(&s->prio, NVIC_EXCEPTION_SYSTICK, false);
+            cortexm_nvic_update(s);
         }
         break;
     case 0xd08: /* Vector Table Offset.  */
@@ -453,9 +593,8 @@ static void nvic_writel(CortexMNVICState *s, uint32_t offset, uint32_t value)
             if (value & 1) {
                 qemu_log_mask(LOG_UNIMP, "AIRCR system reset unimplemented\n");
             }
-            if (value & 0x700) {
-                qemu_log_mask(LOG_UNIMP, "PRIGROUP unimplemented\n");
-            }
+            nvic_prio_set_prigroup(&s->prio, (value >> 8) & 0x7);
+            cortexm_nvic_update(s);
         }
         break;
     case 0xd10: /* System Control.  */
@@ -466,9 +605,21 @@ static void nvic_writel(CortexMNVICState *s, uint32_t offset, uint32_t value)
     case 0xd24: /* System Handler Control.  */
         /* TODO: Real hardware allows you to set/clear the active bits
          under some circumstances.  We don't implement this.  */
-        s->gic.irq_state[ARMV7M_EXCP_MEM].enabled = (value & (1 << 16)) != 0;
-        s->gic.irq_state[ARMV7M_EXCP_BUS].enabled = (value & (1 << 17)) != 0;
-        s->gic.irq_state[ARMV7M_EXCP_USAGE].enabled = (value & (1 << 18)) != 0;
+        nvic_prio_set_pending(&s->prio, NVIC_EXCEPTION_USAGE_FAULT,
+                (value & (1 << 12)) != 0);
+        nvic_prio_set_pending(&s->prio, NVIC_EXCEPTION_MEM_MANAGE,
+                (value & (1 << 13)) != 0);
+        nvic_prio_set_pending(&s->prio, NVIC_EXCEPTION_BUS_FAULT,
+                (value & (1 << 14)) != 0);
+        nvic_prio_set_pending(&s->prio, NVIC_EXCEPTION_SVCALL,
+                (value & (1 << 15)) != 0);
+        nvic_prio_set_enabled(&s->prio, NVIC_EXCEPTION_MEM_MANAGE,
+                (value & (1 << 16)) != 0);
+        nvic_prio_set_enabled(&s->prio, NVIC_EXCEPTION_BUS_FAULT,
+                (value & (1 << 17)) != 0);
+        nvic_prio_set_enabled(&s->prio, NVIC_EXCEPTION_USAGE_FAULT,
+                (value & (1 << 18)) != 0);
+        cortexm_nvic_update(s);
         break;
     case 0xd28: /* Configurable Fault Status.  */
     case 0xd2c: /* Hard Fault Status.  */
@@ -514,7 +665,7 @@ static void nvic_writel(CortexMNVICState *s, uint32_t offset, uint32_t value)
 
     case 0xf00: /* Software Triggered Interrupt Register */
         if ((value & 0x1ff) < s->num_irq) {
-            gic_set_pending_private(&s->gic, 0, value & 0x1ff);
+            cortexm_nvic_set_pending_interrupt(s, value & 0x1ff);
         }
         break;
     default:
@@ -527,13 +678,23 @@ static uint64_t nvic_sysreg_read(void *opaque, hwaddr addr, unsigned size)
     CortexMNVICState *s = (CortexMNVICState *) opaque;
     uint32_t offset = addr;
     int i;
+    int vector;
     uint32_t val;
 
     switch (offset) {
+    case 0x400 ... 0x5ef: /* Interrupt Priority.  */
+        val = 0;
+        for (i = 0; i < size; i++) {
+            vector = 16 + (offset - 0x400) + i;
+            if (vector < s->prio.num_vectors) {
+                val |= s->prio.raw_priority[vector] << (i * 8);
+            }
+        }
+        return val;
     case 0xd18 ... 0xd23: /* System Handler Priority.  */
         val = 0;
         for (i = 0; i < size; i++) {
-            val |= s->gic.priority1[(offset - 0xd14) + i][0] << (i * 8);
+            val |= s->prio.raw_priority[(offset - 0xd14) + i] << (i * 8);
         }
         return val;
     case 0xfe0 ... 0xfff: /* ID.  */
@@ -556,14 +717,25 @@ static void nvic_sysreg_write(void *opaque, hwaddr addr, uint64_t value,
     CortexMNVICState *s = (CortexMNVICState *) opaque;
     uint32_t offset = addr;
     int i;
+    int vector;
 
     switch (offset) {
+    case 0x400 ... 0x5ef: /* Interrupt Priority.  */
+        for (i = 0; i < size; i++) {
+            vector = 16 + (offset - 0x400) + i;
+            if (vector < s->prio.num_vectors) {
+                nvic_prio_set_priority(&s->prio, vector,
+                        (value >> (i * 8)) & 0xff);
+            }
+        }
+        cortexm_nvic_update(s);
+        return;
     case 0xd18 ... 0xd23: /* System Handler Priority.  */
         for (i = 0; i < size; i++) {
-            s->gic.priority1[(offset - 0xd14) + i][0] = (value >> (i * 8))
-                    & 0xff;
+            nvic_prio_set_priority(&s->prio, (offset - 0xd14) + i,
+                    (value >> (i * 8)) & 0xff);
         }
-        gic_update(&s->gic);
+        cortexm_nvic_update(s);
         return;
     }
     if (size == 4) {
@@ -581,37 +753,103 @@ static const MemoryRegionOps nvic_sysreg_ops = {
 
 /* ------------------------------------------------------------------------- */
 
+static void cortexm_nvic_pre_save_callback(void *opaque)
+{
+    CortexMNVICState *s = (CortexMNVICState *) opaque;
+    int vector;
+
+    memset(&s->saved, 0, sizeof(s->saved));
+    for (vector = 1; vector < s->prio.num_vectors; vector++) {
+        uint32_t bit = 1U << (vector % 32);
+        if (nvic_prio_is_enabled(&s->prio, vector)) {
+            s->saved.enabled[vector / 32] |= bit;
+        }
+        if (nvic_prio_is_pending(&s->prio, vector)) {
+            s->saved.pending[vector / 32] |= bit;
+        }
+        if (nvic_prio_is_active(&s->prio, vector)) {
+            s->saved.active[vector / 32] |= bit;
+        }
+        if (vector >= 16 && test_bit(vector - 16, s->level)) {
+            s->saved.level[(vector - 16) / 32] |= (1U << ((vector - 16) % 32));
+        }
+        s->saved.priority[vector] = s->prio.raw_priority[vector];
+    }
+    s->saved.prigroup = s->prio.prigroup;
+}
+
+/* Rebuild the priority engine state via the setters. */
+static int cortexm_nvic_post_load_callback(void *opaque, int version_id)
+{
+    CortexMNVICState *s = (CortexMNVICState *) opaque;
+    int vector;
+
+    nvic_prio_reset(&s->prio);
+    nvic_prio_set_prigroup(&s->prio, s->saved.prigroup);
+    bitmap_zero(s->level, NVIC_PRIO_MAX_IRQ);
+
+    for (vector = 1; vector < s->prio.num_vectors; vector++) {
+        uint32_t bit = 1U << (vector % 32);
+        nvic_prio_set_priority(&s->prio, vector, s->saved.priority[vector]);
+        nvic_prio_set_enabled(&s->prio, vector,
+                (s->saved.enabled[vector / 32] & bit) != 0);
+        nvic_prio_set_pending(&s->prio, vector,
+                (s->saved.pending[vector / 32] & bit) != 0);
+        nvic_prio_set_active(&s->prio, vector,
+                (s->saved.active[vector / 32] & bit) != 0);
+        if (vector >= 16
+                && (s->saved.level[(vector - 16) / 32]
+                        & (1U << ((vector - 16) % 32)))) {
+            set_bit(vector - 16, s->level);
+        }
+    }
+
+    cortexm_nvic_update(s);
+    return 0;
+}
+
 static const VMStateDescription vmstate_nvic = {
     .name = "cortexm-nvic",
-    .version_id = 1,
-    .minimum_version_id = 1,
+    .version_id = 2,
+    .minimum_version_id = 2,
+    .pre_save = cortexm_nvic_pre_save_callback,
+    .post_load = cortexm_nvic_post_load_callback,
     .fields = (VMStateField[] ) {
                     VMSTATE_UINT32(systick.control, CortexMNVICState),
                     VMSTATE_UINT32(systick.reload, CortexMNVICState),
                     VMSTATE_INT64(systick.tick, CortexMNVICState),
                     VMSTATE_TIMER_PTR(systick.timer, CortexMNVICState),
+                    VMSTATE_UINT32_ARRAY(saved.enabled, CortexMNVICState,
+                            CORTEXM_NVIC_VMSTATE_WORDS),
+                    VMSTATE_UINT32_ARRAY(saved.pending, CortexMNVICState,
+                            CORTEXM_NVIC_VMSTATE_WORDS),
+                    VMSTATE_UINT32_ARRAY(saved.active, CortexMNVICState,
+                            CORTEXM_NVIC_VMSTATE_WORDS),
+                    VMSTATE_UINT32_ARRAY(saved.level, CortexMNVICState,
+                            CORTEXM_NVIC_VMSTATE_WORDS),
+                    VMSTATE_UINT8_ARRAY(saved.priority, CortexMNVICState,
+                            NVIC_PRIO_MAX_VECTORS),
+                    VMSTATE_UINT8(saved.prigroup, CortexMNVICState),
                 VMSTATE_END_OF_LIST() } };
 
+static Property cortexm_nvic_properties[] = {
+        /*
+         * The ARM v7m may have anything from 0 to 496 external interrupt
+         * IRQ lines. We default to 64. Other boards may differ and should
+         * set the num-irq property appropriately.
+         */
+        DEFINE_PROP_UINT32("num-irq", CortexMNVICState, num_irq,
+                CORTEXM_NVIC_DEFAULT_NUM_IRQ),
+        DEFINE_PROP_UINT8("priority-bits", CortexMNVICState, priority_bits, 8),
+    DEFINE_PROP_END_OF_LIST() };
+
 static void cortexm_nvic_instance_init_callback(Object *obj)
 {
     qemu_log_function_name();
 
-    /*
-     * We have a different default value for the num-irq property
-     * than our superclass. This function runs after qdev init
-     * has set the defaults from the Property array and before
-     * any user-specified property setting, so just modify the
-     * value in the GICState struct.
-     */
-    GICState *gic = ARM_GIC_COMMON(obj);
     DeviceState *dev = DEVICE(obj);
     CortexMNVICState *nvic = CORTEXM_NVIC_STATE(obj);
-    /*
-     * The ARM v7m may have anything from 0 to 496 external interrupt
-     * IRQ lines. We default to 64. Other boards may differ and should
-     * set the num-irq property appropriately.
-     */
-    gic->num_irq = 64;
+
     qdev_init_gpio_out_named(dev, &nvic->sysresetreq, "SYSRESETREQ", 1);
 }
 
@@ -625,45 +863,32 @@ static void cortexm_nvic_realize_callback(DeviceState *dev, Error **errp)
 
     CortexMNVICState *s = CORTEXM_NVIC_STATE(dev);
 
-    /* The NVIC always has only one CPU */
-    s->gic.num_cpu = 1;
-    /* Tell the common code we're an NVIC */
-    s->gic.revision = 0xffffffff;
+    if (s->num_irq > NVIC_PRIO_MAX_IRQ) {
+        error_setg(errp, "NVIC: num-irq %d exceeds the maximum %d",
+                s->num_irq, NVIC_PRIO_MAX_IRQ);
+        return;
+    }
 
-    /* Adjust back, GIC uses a different numbering scheme. */
-    s->num_irq = s->gic.num_irq - 32;
+    qemu_log_mask(LOG_FUNC, "NVIC: %d irqs, %d priority bits\n", s->num_irq,
+            s->priority_bits);
 
-    qemu_log_mask(LOG_FUNC, "NVIC: %d irqs\n", s->num_irq);
+    nvic_prio_init(&s->prio, 16 + s->num_irq, s->priority_bits);
 
-    /* Call parent realize() early, to complete GIC construction. */
-    if (!cm_device_parent_realize(dev, NULL, TYPE_CORTEXM_NVIC)) {
-        return;
-    }
+    /* Outgoing, to the CPU, and incoming, from the peripherals. */
+    sysbus_init_irq(SYS_BUS_DEVICE(dev), &s->cpu_irq);
+    qdev_init_gpio_in(dev, cortexm_nvic_irq_handler, s->num_irq);
 
-    gic_init_irqs_and_distributor(&s->gic);
     /*
      * The NVIC and system controller register area looks like this:
      *  0..0xff : system control registers, including systick
-     *  0x100..0xcff : GIC-like registers
+     *  0x100..0xcff : NVIC registers
      *  0xd00..0xfff : system control registers
-     * We use overlaying to put the GIC like registers
-     * over the top of the system control register region.
+     * All are implemented by a single region.
      */
     memory_region_init(&s->container, OBJECT(s), "nvic", 0x1000);
-    /*
-     * The system register region goes at the bottom of the priority
-     * stack as it covers the whole page.
-     */
     memory_region_init_io(&s->sysregmem, OBJECT(s), &nvic_sysreg_ops, s,
             "nvic_sysregs", 0x1000);
     memory_region_add_subregion(&s->container, 0, &s->sysregmem);
-    /* Alias the GIC region so we can get only the section of it
-     * we need, and layer it on top of the system register region.
-     */
-    memory_region_init_alias(&s->gic_iomem_alias, OBJECT(s), "nvic-gic",
-            &s->gic.iomem, 0x100, 0xc00);
-    memory_region_add_subregion_overlap(&s->container, 0x100,
-            &s->gic_iomem_alias, 1);
     /*
      * Map the whole thing into system memory at the location required
      * by the v7M architecture.
@@ -680,15 +905,11 @@ static void cortexm_nvic_reset_callback(DeviceState *dev)
     cm_device_parent_reset(dev, TYPE_CORTEXM_NVIC);
 
     CortexMNVICState *s = CORTEXM_NVIC_STATE(dev);
-    /* Common GIC reset resets to disabled; the NVIC doesn't have
-     * per-CPU interfaces so mark our non-existent CPU interface
-     * as enabled by default, and with a priority mask which allows
-     * all interrupts through.
-     */
-    s->gic.cpu_ctlr[0] = GICC_CTLR_EN_GRP0;
-    s->gic.priority_mask[0] = 0x100;
-    /* The NVIC as a whole is always enabled. */
-    s->gic.ctlr = 1;
+
+    /* All disabled, except the system exceptions. */
+    nvic_prio_reset(&s->prio);
+    bitmap_zero(s->level, NVIC_PRIO_MAX_IRQ);
+
     systick_reset(s);
 
     // System Control Block
@@ -708,12 +929,15 @@ static void cortexm_nvic_reset_callback(DeviceState *dev)
     s->dcb.dcrsr = 0;
     s->dcb.dcrdr = 0;
     s->dcb.demcr = 0;
+
+    cortexm_nvic_update(s);
 }
 
 static void cortexm_nvic_class_init_callback(ObjectClass *klass, void *data)
 {
     DeviceClass *dc = DEVICE_CLASS(klass);
     dc->vmsd = &vmstate_nvic;
+    dc->props = cortexm_nvic_properties;
     dc->reset = cortexm_nvic_reset_callback;
     dc->realize = cortexm_nvic_realize_callback;
 }
@@ -0,0 +1,109 @@
+/*
+ * Peripheral register auto bits.
+ *
+ * Copyright (c) 2017 Liviu Ionescu.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <hw/cortexm/peripheral-auto-bits.h>
+
+static PeripheralAutoBitsStep *peripheral_auto_bits_compile_type(
+        const PeripheralRegisterAutoBits *rules,
+        peripheral_register_auto_bits_type_t type, PeripheralAutoBitsStep *step,
+        uint32_t *count);
+
+// ----- Public ---------------------------------------------------------------
+
+// Compile the zero mask terminated array of rules into a program,
+// with one step per rule, grouped by type. Rules with no shift
+// have no effect and are dropped.
+//
+// Return NULL if there is nothing to do; the result must be freed
+// with g_free().
+
+PeripheralAutoBitsProgram *peripheral_auto_bits_compile(
+        const PeripheralRegisterAutoBits *rules)
+{
+    const PeripheralRegisterAutoBits *rule;
+
+    uint32_t count = 0;
+    for (rule = rules; rule && rule->mask; ++rule) {
+        if (rule->shift != 0) {
+            ++count;
+        }
+    }
+
+    if (count == 0) {
+        return NULL;
+    }
+
+    PeripheralAutoBitsProgram *program = g_malloc0(
+            sizeof(PeripheralAutoBitsProgram)
+                    + count * sizeof(PeripheralAutoBitsStep));
+
+    PeripheralAutoBitsStep *step = program->steps;
+    step = peripheral_auto_bits_compile_type(rules,
+            PERIPHERAL_REGISTER_AUTO_BITS_TYPE_FOLLOWS, step,
+            &program->num_follows);
+    step = peripheral_auto_bits_compile_type(rules,
+            PERIPHERAL_REGISTER_AUTO_BITS_TYPE_CLEARED_BY, step,
+            &program->num_cleared_by);
+    step = peripheral_auto_bits_compile_type(rules,
+            PERIPHERAL_REGISTER_AUTO_BITS_TYPE_SET_BY, step,
+            &program->num_set_by);
+
+    if (program->num_follows + program->num_cleared_by + program->num_set_by
+            == 0) {
+        // Only unknown types.
+        g_free(program);
+        return NULL;
+    }
+
+    return program;
+}
+
+// ----- Private --------------------------------------------------------------
+
+// Append the steps of one type, in the order of the rules.
+static PeripheralAutoBitsStep *peripheral_auto_bits_compile_type(
+        const PeripheralRegisterAutoBits *rules,
+        peripheral_register_auto_bits_type_t type, PeripheralAutoBitsStep *step,
+        uint32_t *count)
+{
+    const PeripheralRegisterAutoBits *rule;
+
+    *count = 0;
+    for (rule = rules; rule->mask; ++rule) {
+        if (rule->type != type || rule->shift == 0) {
+            continue;
+        }
+
+        step->src_mask = rule->mask;
+        if (rule->shift > 0) {
+            step->dest_mask = rule->mask << rule->shift;
+            step->rotate = rule->shift;
+        } else {
+            step->dest_mask = rule->mask >> -rule->shift;
+            step->rotate = 64 + rule->shift;
+        }
+
+        ++step;
+        ++(*count);
+    }
+
+    return step;
+}
+
+// ----------------------------------------------------------------------------
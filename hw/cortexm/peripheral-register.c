@@ -129,22 +129,10 @@ Object *peripheral_register_add_properties_and_children(Object *obj,
 }
 
 // Internal structure with temporary storage,
-// used to compute the auto_bits array.
+// used to compute the auto bits rules.
 typedef struct {
-    peripheral_register_t left_shift_follows_masks[sizeof(peripheral_register_t)
-            * 8];
-    peripheral_register_t right_shift_follows_masks[sizeof(peripheral_register_t)
-            * 8];
-
-    peripheral_register_t left_shift_cleared_by_masks[sizeof(peripheral_register_t)
-            * 8];
-    peripheral_register_t right_shift_cleared_by_masks[sizeof(peripheral_register_t)
-            * 8];
-
-    peripheral_register_t left_shift_set_by_masks[sizeof(peripheral_register_t)
-            * 8];
-    peripheral_register_t right_shift_set_by_masks[sizeof(peripheral_register_t)
-            * 8];
+    // Zero terminated array of rules, one per type and distance.
+    GArray *rules;
 
     const char *to_find_bifi;
     RegisterBitfieldState *found_bifi;
@@ -153,107 +141,42 @@ typedef struct {
     Error *local_err;
 } PeripheralRegisterAutoTmp;
 
+static gint peripheral_register_compare_auto_rules(gconstpointer a,
+        gconstpointer b);
+
 void peripheral_register_compute_auto_bits(Object *obj)
 {
     PeripheralRegisterState *state = PERIPHERAL_REGISTER_STATE(obj);
 
     // Scan children bitfields to identify those that follow other
     // bitfields. Compute the signed distance between bitfields
-    // and for each distance accumulate a bitmask.
+    // and for each distance and type accumulate a bitmask.
 
-    PeripheralRegisterAutoTmp *auto_tmp = g_malloc0(
-            sizeof(PeripheralRegisterAutoTmp));
-    auto_tmp->reg = state;
+    PeripheralRegisterAutoTmp auto_tmp;
+    memset(&auto_tmp, 0, sizeof(auto_tmp));
+    auto_tmp.reg = state;
+    auto_tmp.rules = g_array_new(TRUE, TRUE,
+            sizeof(PeripheralRegisterAutoBits));
 
+    g_free(state->auto_bits);
     state->auto_bits = NULL;
 
     int ret;
     ret = object_child_foreach(obj, peripheral_register_create_auto_array,
-            (void *) auto_tmp);
+            (void *) &auto_tmp);
 
     if (ret) {
-        if (auto_tmp->local_err) {
-            error_report_err(auto_tmp->local_err);
+        if (auto_tmp.local_err) {
+            error_report_err(auto_tmp.local_err);
             exit(1);
         }
-    } else {
-        int count = 0;
-        int i;
-        for (i = 0; i < sizeof(peripheral_register_t) * 8; ++i) {
-            if (auto_tmp->left_shift_follows_masks[i] != 0) {
-                count++;
-            }
-            if (auto_tmp->right_shift_follows_masks[i] != 0) {
-                count++;
-            }
-            if (auto_tmp->left_shift_cleared_by_masks[i] != 0) {
-                count++;
-            }
-            if (auto_tmp->right_shift_cleared_by_masks[i] != 0) {
-                count++;
-            }
-            if (auto_tmp->left_shift_set_by_masks[i] != 0) {
-                count++;
-            }
-            if (auto_tmp->right_shift_set_by_masks[i] != 0) {
-                count++;
-            }
-        }
-
-        if (count) {
-            count++; // One more for the terminator.
-            PeripheralRegisterAutoBits *auto_bits = g_malloc_n(count,
-                    sizeof(PeripheralRegisterAutoBits));
-
-            PeripheralRegisterAutoBits *p = auto_bits;
-
-            for (i = 0; i < sizeof(peripheral_register_t) * 8; ++i) {
-                if (auto_tmp->left_shift_follows_masks[i] != 0) {
-                    p->mask = auto_tmp->left_shift_follows_masks[i];
-                    p->shift = i;
-                    p->type = PERIPHERAL_REGISTER_AUTO_BITS_TYPE_FOLLOWS;
-                    ++p;
-                }
-                if (auto_tmp->right_shift_follows_masks[i] != 0) {
-                    p->mask = auto_tmp->right_shift_follows_masks[i];
-                    p->shift = -i;
-                    p->type = PERIPHERAL_REGISTER_AUTO_BITS_TYPE_FOLLOWS;
-                    ++p;
-                }
-                if (auto_tmp->left_shift_cleared_by_masks[i] != 0) {
-                    p->mask = auto_tmp->left_shift_cleared_by_masks[i];
-                    p->shift = i;
-                    p->type = PERIPHERAL_REGISTER_AUTO_BITS_TYPE_CLEARED_BY;
-                    ++p;
-                }
-                if (auto_tmp->right_shift_cleared_by_masks[i] != 0) {
-                    p->mask = auto_tmp->right_shift_cleared_by_masks[i];
-                    p->shift = -i;
-                    p->type = PERIPHERAL_REGISTER_AUTO_BITS_TYPE_CLEARED_BY;
-                    ++p;
-                }
-                if (auto_tmp->left_shift_set_by_masks[i] != 0) {
-                    p->mask = auto_tmp->left_shift_set_by_masks[i];
-                    p->shift = i;
-                    p->type = PERIPHERAL_REGISTER_AUTO_BITS_TYPE_SET_BY;
-                    ++p;
-                }
-                if (auto_tmp->right_shift_set_by_masks[i] != 0) {
-                    p->mask = auto_tmp->right_shift_set_by_masks[i];
-                    p->shift = -i;
-                    p->type = PERIPHERAL_REGISTER_AUTO_BITS_TYPE_SET_BY;
-                    ++p;
-                }
-            }
-
-            // End of array.
-            p->mask = 0;
-            p->shift = 0;
-
-            state->auto_bits = auto_bits;
-        }
+    } else if (auto_tmp.rules->len > 0) {
+        // Compile the rules into a program run on each write.
+        g_array_sort(auto_tmp.rules, peripheral_register_compare_auto_rules);
+        state->auto_bits = peripheral_auto_bits_compile(
+                (PeripheralRegisterAutoBits *) auto_tmp.rules->data);
     }
-    g_free(auto_tmp);
+    g_array_free(auto_tmp.rules, TRUE);
 }
 
 // ----------------------------------------------------------------------------
@@ -456,13 +379,36 @@ peripheral_register_t peripheral_register_widen(peripheral_register_t old_value,
     return new_value.ll;
 }
 
-// ----- Private --------------------------------------------------------------
+// ----- Public ---------------------------------------------------------------
 
-static peripheral_register_t peripheral_register_read_callback(Object *reg,
+// Default register read method; the actual work is done by
+// peripheral_register_direct_read(), also called by the peripheral
+// MMIO fast path.
+peripheral_register_t peripheral_register_read_callback(Object *reg,
         Object *periph, uint32_t addr, uint32_t offset, unsigned size)
 {
-    PeripheralRegisterState *state = PERIPHERAL_REGISTER_STATE(reg);
-    PeripheralState *periph_state = PERIPHERAL_STATE(periph);
+    return peripheral_register_direct_read(PERIPHERAL_REGISTER_STATE(reg),
+            PERIPHERAL_STATE(periph), addr, offset, size);
+}
+
+// Default register write method; the actual work is done by
+// peripheral_register_direct_write().
+void peripheral_register_write_callback(Object *reg, Object *periph,
+        uint32_t addr, uint32_t offset, unsigned size,
+        peripheral_register_t value)
+{
+    peripheral_register_direct_write(PERIPHERAL_REGISTER_STATE(reg),
+            PERIPHERAL_STATE(periph), addr, offset, size, value);
+}
+
+// Read the register, with no QOM casts; the register and peripheral
+// pointers are expected to be already validated.
+peripheral_register_t peripheral_register_direct_read(
+        PeripheralRegisterState *state, PeripheralState *periph_state,
+        uint32_t addr, uint32_t offset, unsigned size)
+{
+    Object *reg = OBJECT(state);
+    Object *periph = OBJECT(periph_state);
 
     // Validate alignment
     if (!peripheral_register_check_access(size, offset, state->access_flags)) {
@@ -506,12 +452,13 @@ static peripheral_register_t peripheral_register_read_callback(Object *reg,
     return ret;
 }
 
-static void peripheral_register_write_callback(Object *reg, Object *periph,
-        uint32_t addr, uint32_t offset, unsigned size,
-        peripheral_register_t value)
+// Write the register, with no QOM casts.
+void peripheral_register_direct_write(PeripheralRegisterState *state,
+        PeripheralState *periph_state, uint32_t addr, uint32_t offset,
+        unsigned size, peripheral_register_t value)
 {
-    PeripheralRegisterState *state = PERIPHERAL_REGISTER_STATE(reg);
-    PeripheralState *periph_state = PERIPHERAL_STATE(periph);
+    Object *reg = OBJECT(state);
+    Object *periph = OBJECT(periph_state);
 
     qemu_log_mask(LOG_FUNC, "%s('%s','%s',0x%04X,%u,%u,0x%"PRIX64")\n",
             __func__, state->name, periph_state->mmio_node_name, addr, offset,
@@ -534,41 +481,8 @@ static void peripheral_register_write_callback(Object *reg, Object *periph,
     // Set all writable bits with the new values.
     full_value |= (new_value & state->writable_bits);
 
-    PeripheralRegisterAutoBits *auto_bits;
-    for (auto_bits = state->auto_bits; auto_bits && auto_bits->mask;
-            auto_bits++) {
-        if (auto_bits->type == PERIPHERAL_REGISTER_AUTO_BITS_TYPE_FOLLOWS) {
-            // Clear the linked bits and copy those from the referred bits.
-            if (auto_bits->shift > 0) {
-                full_value &= ~(auto_bits->mask << auto_bits->shift);
-                full_value |= ((full_value & auto_bits->mask)
-                        << auto_bits->shift);
-            } else if (auto_bits->shift < 0) {
-                full_value &= ~(auto_bits->mask >> auto_bits->shift);
-                full_value |= ((full_value & auto_bits->mask)
-                        >> auto_bits->shift);
-            }
-        } else if (auto_bits->type
-                == PERIPHERAL_REGISTER_AUTO_BITS_TYPE_CLEARED_BY) {
-            // If the referred bits are set, clear the linked bits.
-            if (auto_bits->shift > 0) {
-                full_value &= ~((full_value & auto_bits->mask)
-                        << auto_bits->shift);
-            } else if (auto_bits->shift < 0) {
-                full_value &= ~((full_value & auto_bits->mask)
-                        >> auto_bits->shift);
-            }
-        } else if (auto_bits->type
-                == PERIPHERAL_REGISTER_AUTO_BITS_TYPE_SET_BY) {
-            // If the referred bits are set, set the linked bits.
-            if (auto_bits->shift > 0) {
-                full_value |= ((full_value & auto_bits->mask)
-                        << auto_bits->shift);
-            } else if (auto_bits->shift < 0) {
-                full_value |= ((full_value & auto_bits->mask)
-                        >> auto_bits->shift);
-            }
-        }
+    if (state->auto_bits) {
+        full_value = peripheral_auto_bits_run(state->auto_bits, full_value);
     }
 
     state->prev_value = state->value;
@@ -590,7 +504,7 @@ static void peripheral_register_write_callback(Object *reg, Object *periph,
     }
 }
 
-// ----------------------------------------------------------------------------
+// ----- Private --------------------------------------------------------------
 
 static void peripheral_register_instance_init_callback(Object *obj)
 {
@@ -733,8 +647,50 @@ static int peripheral_register_find_bifi(Object *obj, void *opaque)
     return 0; // Continue iterations.
 }
 
-// Create the auto_bits array, by concatenating masks of
-// followed bitfields and grouping based on shift steps.
+// Order the rules by distance, then by type, left shifts first.
+static gint peripheral_register_compare_auto_rules(gconstpointer a,
+        gconstpointer b)
+{
+    const PeripheralRegisterAutoBits *ra = a;
+    const PeripheralRegisterAutoBits *rb = b;
+
+    if (abs(ra->shift) != abs(rb->shift)) {
+        return abs(ra->shift) - abs(rb->shift);
+    }
+    if (ra->type != rb->type) {
+        return ra->type - rb->type;
+    }
+    return rb->shift - ra->shift;
+}
+
+// Accumulate the mask into the rule with the same type and distance.
+static void peripheral_register_add_auto_rule(PeripheralRegisterAutoTmp *auto_tmp,
+        peripheral_register_auto_bits_type_t type, int shift,
+        peripheral_register_t mask)
+{
+    if (shift == 0) {
+        return; // Nothing to do.
+    }
+
+    int i;
+    for (i = 0; i < auto_tmp->rules->len; ++i) {
+        PeripheralRegisterAutoBits *rule = &g_array_index(auto_tmp->rules,
+                PeripheralRegisterAutoBits, i);
+        if (rule->type == type && rule->shift == shift) {
+            rule->mask |= mask;
+            return;
+        }
+    }
+
+    PeripheralRegisterAutoBits rule;
+    rule.mask = mask;
+    rule.shift = shift;
+    rule.type = type;
+    g_array_append_val(auto_tmp->rules, rule);
+}
+
+// Create the auto bits rules, by concatenating masks of
+// referred bitfields and grouping based on type and shift steps.
 static int peripheral_register_create_auto_array(Object *obj, void *opaque)
 {
     PeripheralRegisterAutoTmp *auto_tmp = (PeripheralRegisterAutoTmp *) opaque;
@@ -744,85 +700,45 @@ static int peripheral_register_create_auto_array(Object *obj, void *opaque)
     if (cm_object_is_instance_of_typename(obj, TYPE_REGISTER_BITFIELD)) {
         RegisterBitfieldState *bifi = REGISTER_BITFIELD_STATE(obj);
 
+        const char *referred;
+        const char *relation;
+        peripheral_register_auto_bits_type_t type;
+
         if (bifi->follows) {
-            // Find the followed bitfield.
-            auto_tmp->to_find_bifi = bifi->follows;
-            auto_tmp->found_bifi = NULL;
-
-            // Try to find the followed bitfield among its siblings.
-            object_child_foreach(OBJECT(reg), peripheral_register_find_bifi,
-                    (void *) auto_tmp);
-
-            if (auto_tmp->found_bifi == NULL) {
-                error_setg(&auto_tmp->local_err,
-                        "Bitfield %s of register %s follows "
-                                "missing %s bitfield.\n", bifi->name, reg->name,
-                        auto_tmp->to_find_bifi);
-                return 1;
-            }
-
-            // Positive values means shift left, negative shift right.
-            int delta_shift = bifi->first_bit - auto_tmp->found_bifi->first_bit;
-            if (delta_shift > 0) {
-                auto_tmp->left_shift_follows_masks[delta_shift] |=
-                        auto_tmp->found_bifi->mask;
-            } else if (delta_shift < 0) {
-                auto_tmp->right_shift_follows_masks[-delta_shift] |=
-                        auto_tmp->found_bifi->mask;
-            }
+            referred = bifi->follows;
+            relation = "follows";
+            type = PERIPHERAL_REGISTER_AUTO_BITS_TYPE_FOLLOWS;
         } else if (bifi->cleared_by) {
-            // Find the .cleared_by bitfield.
-            auto_tmp->to_find_bifi = bifi->cleared_by;
-            auto_tmp->found_bifi = NULL;
-
-            // Try to find the followed bitfield among its siblings.
-            object_child_foreach(OBJECT(reg), peripheral_register_find_bifi,
-                    (void *) auto_tmp);
-
-            if (auto_tmp->found_bifi == NULL) {
-                error_setg(&auto_tmp->local_err,
-                        "Bitfield %s of register %s cleared by "
-                                "missing %s bitfield.\n", bifi->name, reg->name,
-                        auto_tmp->to_find_bifi);
-                return 1;
-            }
-
-            // Positive values means shift left, negative shift right.
-            int delta_shift = bifi->first_bit - auto_tmp->found_bifi->first_bit;
-            if (delta_shift > 0) {
-                auto_tmp->left_shift_cleared_by_masks[delta_shift] |=
-                        auto_tmp->found_bifi->mask;
-            } else if (delta_shift < 0) {
-                auto_tmp->right_shift_cleared_by_masks[-delta_shift] |=
-                        auto_tmp->found_bifi->mask;
-            }
+            referred = bifi->cleared_by;
+            relation = "cleared by";
+            type = PERIPHERAL_REGISTER_AUTO_BITS_TYPE_CLEARED_BY;
         } else if (bifi->set_by) {
-            // Find the .set_by bitfield.
-            auto_tmp->to_find_bifi = bifi->cleared_by;
-            auto_tmp->found_bifi = NULL;
-
-            // Try to find the followed bitfield among its siblings.
-            object_child_foreach(OBJECT(reg), peripheral_register_find_bifi,
-                    (void *) auto_tmp);
-
-            if (auto_tmp->found_bifi == NULL) {
-                error_setg(&auto_tmp->local_err,
-                        "Bitfield %s of register %s set by "
-                                "missing %s bitfield.\n", bifi->name, reg->name,
-                        auto_tmp->to_find_bifi);
-                return 1;
-            }
-
-            // Positive values means shift left, negative shift right.
-            int delta_shift = bifi->first_bit - auto_tmp->found_bifi->first_bit;
-            if (delta_shift > 0) {
-                auto_tmp->left_shift_set_by_masks[delta_shift] |=
-                        auto_tmp->found_bifi->mask;
-            } else if (delta_shift < 0) {
-                auto_tmp->right_shift_set_by_masks[-delta_shift] |=
-                        auto_tmp->found_bifi->mask;
-            }
+            referred = bifi->set_by;
+            relation = "set by";
+            type = PERIPHERAL_REGISTER_AUTO_BITS_TYPE_SET_BY;
+        } else {
+            return 0; // Continue iterations.
         }
+
+        // Find the referred bitfield.
+        auto_tmp->to_find_bifi = referred;
+        auto_tmp->found_bifi = NULL;
+
+        // Try to find the referred bitfield among its siblings.
+        object_child_foreach(OBJECT(reg), peripheral_register_find_bifi,
+                (void *) auto_tmp);
+
+        if (auto_tmp->found_bifi == NULL) {
+            error_setg(&auto_tmp->local_err,
+                    "Bitfield %s of register %s %s missing %s bitfield.\n",
+                    bifi->name, reg->name, relation, auto_tmp->to_find_bifi);
+            return 1;
+        }
+
+        // Positive values means shift left, negative shift right.
+        int delta_shift = bifi->first_bit - auto_tmp->found_bifi->first_bit;
+        peripheral_register_add_auto_rule(auto_tmp, type, delta_shift,
+                auto_tmp->found_bifi->mask);
     }
 
     return 0; // Continue iterations.
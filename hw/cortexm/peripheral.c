@@ -30,6 +30,37 @@
 #include "verbosity.h"
 #endif
 
+// Global generation of the cached is_enabled() results; incremented
+// each time the enabling conditions may have changed.
+static uint32_t peripheral_enabled_generation = 1;
+
+// Locate the register in the dense array or in the pages.
+static inline PeripheralRegisterDispatch *peripheral_lookup_register(
+        PeripheralState *state, uint32_t offset_bytes)
+{
+    uint32_t index = offset_bytes >> state->register_size_shift;
+
+    if (index >= state->registers_size_ptrs) {
+        return NULL;
+    }
+
+    PeripheralRegisterDispatch *entry;
+    if (likely(state->registers_layout == PERIPHERAL_REGISTERS_LAYOUT_DENSE)) {
+        entry = &state->registers[index];
+    } else if (state->registers_layout == PERIPHERAL_REGISTERS_LAYOUT_PAGED) {
+        PeripheralRegisterDispatch *page =
+                state->register_pages[index >> PERIPHERAL_REGISTERS_PAGE_BITS];
+        if (page == NULL) {
+            return NULL;
+        }
+        entry = &page[index & (PERIPHERAL_REGISTERS_PAGE_ENTRIES - 1)];
+    } else {
+        return NULL;
+    }
+
+    return (entry->obj != NULL) ? entry : NULL;
+}
+
 // ----- Public ---------------------------------------------------------------
 
 // Set the peripheral properties and add children registers from the
@@ -99,42 +130,263 @@ void peripheral_create_memory_region(Object *obj)
 
 }
 
-static int peripheral_compute_max_offset_foreach(Object *obj, void *opaque);
-static int peripheral_populate_registers_array_foreach(Object *obj,
-        void *opaque);
+static int peripheral_collect_registers_foreach(Object *obj, void *opaque);
+static gint peripheral_compare_registers(gconstpointer a, gconstpointer b);
+static void peripheral_add_register_entry(PeripheralState *state,
+        PeripheralRegisterState *reg);
 
-// For fast access, create an array of registers, indexed by
-// offset, aligned to register size (4 or 8).
+// For fast access, create the lookup tables of registers, indexed by
+// offset, aligned to register size (4 or 8). Each entry has the
+// register state and class methods already resolved, so MMIO
+// accesses do not need any QOM casts.
 //
-// Warning: for large, sparse, peripherals, this might use a lot
-// of memory.
+// For large, sparse, peripherals, a dense array would waste a lot
+// of memory, so the entries are grouped in pages and only the pages
+// that include registers are allocated. The paged layout is used
+// when it needs less than half the memory of the dense one.
 
 void peripheral_prepare_registers(Object *obj)
 {
     PeripheralState *state = PERIPHERAL_STATE(obj);
     DeviceState *dev = DEVICE(obj);
 
-    // Iterate children and determine the last register.
+    assert(is_power_of_2(state->register_size_bytes));
+    state->register_size_shift = ctz32(state->register_size_bytes);
+
+    // Release the tables of a previous call, if any.
+    int i;
+    if (state->register_pages != NULL) {
+        for (i = 0; i < state->num_register_pages; ++i) {
+            g_free(state->register_pages[i]);
+        }
+    }
+    g_free(state->register_pages);
+    state->register_pages = NULL;
+    g_free(state->registers);
+    state->registers = NULL;
+
+    // Iterate children and collect the registers.
+    GPtrArray *regs = g_ptr_array_new();
+    object_child_foreach(OBJECT(dev), peripheral_collect_registers_foreach,
+            (void *) regs);
+    g_ptr_array_sort(regs, peripheral_compare_registers);
+
+    state->num_registers = regs->len;
     state->max_offset_bytes = 0;
-    object_child_foreach(OBJECT(dev), peripheral_compute_max_offset_foreach,
-            (void *) dev);
+    if (regs->len > 0) {
+        PeripheralRegisterState *last = g_ptr_array_index(regs, regs->len - 1);
+        state->max_offset_bytes = last->offset_bytes;
+    }
 
     assert(state->max_offset_bytes < state->mmio_size_bytes);
 
-    // Compute the number of pointers the array should contain.
+    // Compute the number of entries the lookup tables should cover.
     state->registers_size_ptrs = (state->max_offset_bytes
-            / state->register_size_bytes) + 1;
+            >> state->register_size_shift) + 1;
+
+    // Count the pages with registers; the array is sorted.
+    state->num_register_pages = ((state->registers_size_ptrs - 1)
+            >> PERIPHERAL_REGISTERS_PAGE_BITS) + 1;
+    state->num_used_register_pages = 0;
+    uint32_t prev_page = UINT32_MAX;
+    for (i = 0; i < regs->len; ++i) {
+        PeripheralRegisterState *reg = g_ptr_array_index(regs, i);
+        uint32_t page = (reg->offset_bytes >> state->register_size_shift)
+                >> PERIPHERAL_REGISTERS_PAGE_BITS;
+        if (page != prev_page) {
+            state->num_used_register_pages++;
+            prev_page = page;
+        }
+    }
+
+    size_t dense_size = state->registers_size_ptrs
+            * sizeof(PeripheralRegisterDispatch);
+    size_t paged_size = state->num_register_pages
+            * sizeof(PeripheralRegisterDispatch *)
+            + state->num_used_register_pages * PERIPHERAL_REGISTERS_PAGE_ENTRIES
+                    * sizeof(PeripheralRegisterDispatch);
+
+    if (state->registers_size_ptrs >= PERIPHERAL_REGISTERS_DENSE_MIN_ENTRIES
+            && paged_size * 2 <= dense_size) {
+        state->registers_layout = PERIPHERAL_REGISTERS_LAYOUT_PAGED;
+        // Pages are allocated when the first register is added.
+        state->register_pages = g_malloc0_n(state->num_register_pages,
+                sizeof(PeripheralRegisterDispatch *));
+    } else {
+        state->registers_layout = PERIPHERAL_REGISTERS_LAYOUT_DENSE;
+        state->registers = g_malloc0_n(state->registers_size_ptrs,
+                sizeof(PeripheralRegisterDispatch));
+    }
+
+    // Fill in the tables with the pre-resolved registers.
+    for (i = 0; i < regs->len; ++i) {
+        peripheral_add_register_entry(state, g_ptr_array_index(regs, i));
+    }
+
+    g_free(state->register_list);
+    state->register_list = (PeripheralRegisterState **) g_ptr_array_free(regs,
+            FALSE);
+
+    qemu_log_mask(LOG_FUNC, "%s() '%s' %d registers, %s layout, %zu bytes\n",
+            __FUNCTION__, state->mmio_node_name, state->num_registers,
+            (state->registers_layout == PERIPHERAL_REGISTERS_LAYOUT_PAGED) ?
+                    "paged" : "dense", peripheral_registers_lookup_size(state));
+
+    // Resolve the class enable check once; the result is cached.
+    state->is_enabled = PERIPHERAL_GET_CLASS(obj)->is_enabled;
+    state->enabled_generation = 0;
+}
+
+// Return the dispatch entry of the register at the given offset,
+// or NULL if there is no register there.
+
+PeripheralRegisterDispatch *peripheral_find_register(PeripheralState *state,
+        uint32_t offset_bytes)
+{
+    return peripheral_lookup_register(state, offset_bytes);
+}
+
+// Return the memory used by the lookup tables, in bytes.
+
+size_t peripheral_registers_lookup_size(PeripheralState *state)
+{
+    switch (state->registers_layout) {
+    case PERIPHERAL_REGISTERS_LAYOUT_DENSE:
+        return state->registers_size_ptrs * sizeof(PeripheralRegisterDispatch);
+
+    case PERIPHERAL_REGISTERS_LAYOUT_PAGED:
+        return state->num_register_pages * sizeof(PeripheralRegisterDispatch *)
+                + state->num_used_register_pages
+                        * PERIPHERAL_REGISTERS_PAGE_ENTRIES
+                        * sizeof(PeripheralRegisterDispatch);
+
+    default:
+        return 0;
+    }
+}
+
+// Create the registers, either now or, for lazy peripherals, on the
+// first MMIO access (or explicit materialize), which saves the time
+// and memory to build the register/bitfield objects of peripherals
+// never used by the application.
+//
+// Until then, the MMIO region is mapped, reset does nothing and
+// the peripheral behaves as if in the reset state.
+
+void peripheral_populate_registers(Object *obj, peripheral_populate_t populate,
+        bool is_lazy)
+{
+    PeripheralState *state = PERIPHERAL_STATE(obj);
+
+    assert(populate != NULL);
+
+    if (!is_lazy) {
+        populate(obj);
+        return;
+    }
+
+    state->populate = populate;
+
+    // Needed before the registers exist, to filter accesses.
+    state->is_enabled = PERIPHERAL_GET_CLASS(obj)->is_enabled;
+    state->enabled_generation = 0;
+
+    qemu_log_mask(LOG_FUNC, "%s() '%s' deferred\n", __FUNCTION__,
+            state->mmio_node_name);
+}
+
+// Create the registers of a lazy peripheral, if not already created,
+// and bring them to the reset state. Must be called by all paths that
+// use the registers without going through MMIO (like incoming IRQs).
+
+void peripheral_materialize(Object *obj)
+{
+    PeripheralState *state = PERIPHERAL_STATE(obj);
+
+    if (state->populate == NULL) {
+        return;
+    }
+
+    peripheral_populate_t populate = state->populate;
+    // Clear it first, reset must see the registers.
+    state->populate = NULL;
+
+    qemu_log_mask(LOG_FUNC, "%s() '%s'\n", __FUNCTION__,
+            state->mmio_node_name);
+
+    populate(obj);
+    assert(state->registers_layout != PERIPHERAL_REGISTERS_LAYOUT_NONE);
+
+    // The peripheral was considered in the reset state so far.
+    device_reset(DEVICE(obj));
+
+#if defined(CONFIG_VERBOSE)
+    if (verbosity_level >= VERBOSITY_DETAILED) {
+        printf("'%s' materialized\n", object_get_canonical_path(obj));
+    }
+#endif /* defined(CONFIG_VERBOSE) */
+}
+
+bool peripheral_is_materialized(Object *obj)
+{
+    return (PERIPHERAL_STATE(obj)->populate == NULL);
+}
+
+// Invalidate the cached is_enabled() results of all peripherals.
+// Must be called when the enabling bits might have changed (usually
+// by the RCC).
+
+void peripheral_invalidate_enabled_cache(void)
+{
+    ++peripheral_enabled_generation;
+    if (peripheral_enabled_generation == 0) {
+        // Skip 0, it is used to mark never computed caches.
+        peripheral_enabled_generation = 1;
+    }
+}
+
+static int peripheral_info_foreach(Object *obj, void *opaque);
+
+typedef struct {
+    fprintf_function fprintf_func;
+    void *f;
+    size_t total_size;
+} PeripheralInfoContext;
 
-    // Allocate the array of pointers to registers.
-    state->registers = g_malloc0_n(state->registers_size_ptrs, sizeof(Object*));
+// Display the peripherals, with the layout of the registers lookup
+// tables; called by the 'info peripherals' monitor command.
 
-    // Fill in the array with pointers to registers.
-    object_child_foreach(OBJECT(dev),
-            peripheral_populate_registers_array_foreach, (void *) dev);
+void peripheral_info(fprintf_function fprintf_func, void *f)
+{
+    PeripheralInfoContext ctx = {
+        .fprintf_func = fprintf_func,
+        .f = f,
+        .total_size = 0, };
+
+    fprintf_func(f, "%-32s %-10s %-6s %5s %-6s %6s %s\n", "peripheral",
+            "address", "size", "regs", "layout", "bytes", "unimplemented");
+    object_child_foreach_recursive(object_get_root(), peripheral_info_foreach,
+            &ctx);
+    fprintf_func(f, "Total lookup tables size: %zu bytes\n", ctx.total_size);
 }
 
 // ----- Private --------------------------------------------------------------
 
+// Return the peripheral enabled status, recomputed only after the
+// cache was invalidated.
+static inline bool peripheral_is_enabled(PeripheralState *state)
+{
+    if (state->is_enabled == NULL) {
+        return true;
+    }
+
+    if (unlikely(state->enabled_generation != peripheral_enabled_generation)) {
+        state->is_enabled_cached = state->is_enabled(OBJECT(state));
+        state->enabled_generation = peripheral_enabled_generation;
+    }
+    return state->is_enabled_cached;
+}
+
 // Memory region read callback.
 //
 // Forward the read to the register. The basic register will do the
@@ -143,40 +395,32 @@ void peripheral_prepare_registers(Object *obj)
 // For special processing, create a new derived type with custom read()
 // and add the required actions.
 //
+// The register is identified via the lookup tables prepared by
+// peripheral_prepare_registers(), without any QOM casts.
+//
 static uint64_t peripheral_read_callback(void *opaque, hwaddr addr,
         unsigned size)
 {
     PeripheralState *state = (PeripheralState *) opaque;
-    PeripheralClass *per_class = PERIPHERAL_GET_CLASS(opaque);
-
-    if (per_class->is_enabled) {
-        if (!per_class->is_enabled(OBJECT(state))) {
-            // For all peripherals, when the peripheral is not active,
-            // the peripheral register values may not be readable by
-            // software and the returned value is always 0x0.
-            qemu_log_mask(LOG_GUEST_ERROR,
-                    "%s: Peripheral read of size %d at offset " "0x%"PRIX64 " on disabled peripheral, returns 0.\n",
-                    object_get_typename(OBJECT(state)), size, addr);
-            return 0;
-        }
-    }
-
-    uint32_t index = addr / state->register_size_bytes;
 
-#if 0
-    assert(index < state->registers_size_ptrs);
-#else
-    if (index >= state->registers_size_ptrs) {
-        qemu_log_mask(LOG_UNIMP,
-                "%s: Peripheral read of size %d at offset " "0x%"PRIX64" outside peripheral area.\n",
+    if (!peripheral_is_enabled(state)) {
+        // For all peripherals, when the peripheral is not active,
+        // the peripheral register values may not be readable by
+        // software and the returned value is always 0x0.
+        qemu_log_mask(LOG_GUEST_ERROR,
+                "%s: Peripheral read of size %d at offset " "0x%"PRIX64 " on disabled peripheral, returns 0.\n",
                 object_get_typename(OBJECT(state)), size, addr);
         return 0;
     }
-#endif
 
-    PeripheralRegisterState *reg = PERIPHERAL_REGISTER_STATE(
-            state->registers[index]);
-    if (reg == NULL) {
+    if (unlikely(state->populate != NULL)) {
+        peripheral_materialize(OBJECT(state));
+    }
+
+    PeripheralRegisterDispatch *entry = peripheral_lookup_register(state, addr);
+
+    if (entry == NULL) {
+        state->unimplemented_accesses++;
         qemu_log_mask(LOG_UNIMP,
                 "%s: Peripheral read of size %d at offset " "0x%"PRIX64" not implemented.\n",
                 object_get_typename(OBJECT(state)), size, addr);
@@ -187,16 +431,12 @@ static uint64_t peripheral_read_callback(void *opaque, hwaddr addr,
     uint32_t reg_addr = addr & ~(state->register_size_bytes - 1);
     uint32_t reg_offset = addr & (state->register_size_bytes - 1);
 
-    PeripheralRegisterClass *reg_class = PERIPHERAL_REGISTER_GET_CLASS(reg);
-
     // Read the register value.
-    uint64_t value = 0;
-    if (reg_class->read) {
-        value = reg_class->read(OBJECT(reg), OBJECT(state), reg_addr,
+    if (likely(entry->read == NULL)) {
+        return peripheral_register_direct_read(entry->state, state, reg_addr,
                 reg_offset, size);
     }
-
-    return value;
+    return entry->read(entry->obj, OBJECT(state), reg_addr, reg_offset, size);
 }
 
 // Memory region write callback.
@@ -212,36 +452,25 @@ static void peripheral_write_callback(void *opaque, hwaddr addr, uint64_t value,
 {
     PeripheralState *state = (PeripheralState *) opaque;
 
-    PeripheralClass *per_class = PERIPHERAL_GET_CLASS(opaque);
-
-    if (per_class->is_enabled) {
-        if (!per_class->is_enabled(OBJECT(state))) {
-            // For all peripherals, when the peripheral is not active,
-            // the peripheral register values may not be written by
-            // software.
-            qemu_log_mask(LOG_GUEST_ERROR,
-                    "%s: Write of size %d at offset 0x%"PRIX64 " on disabled peripheral, ignored.\n",
-                    object_get_typename(OBJECT(state)), size, addr);
-            return;
-        }
-    }
-
-    uint32_t index = addr / state->register_size_bytes;
-#if 0
-    assert(index < state->registers_size_ptrs);
-#else
-    if (index >= state->registers_size_ptrs) {
-        qemu_log_mask(LOG_UNIMP,
-                "%s: Peripheral write of size %d at offset " "0x%"PRIX64" outside peripheral area.\n",
+    if (!peripheral_is_enabled(state)) {
+        // For all peripherals, when the peripheral is not active,
+        // the peripheral register values may not be written by
+        // software.
+        qemu_log_mask(LOG_GUEST_ERROR,
+                "%s: Write of size %d at offset 0x%"PRIX64 " on disabled peripheral, ignored.\n",
                 object_get_typename(OBJECT(state)), size, addr);
         return;
     }
-#endif
+
+    if (unlikely(state->populate != NULL)) {
+        peripheral_materialize(OBJECT(state));
+    }
 
     // Identify the register inside the peripheral, by index.
-    PeripheralRegisterState *reg = PERIPHERAL_REGISTER_STATE(
-            state->registers[index]);
-    if (reg == NULL) {
+    PeripheralRegisterDispatch *entry = peripheral_lookup_register(state, addr);
+
+    if (entry == NULL) {
+        state->unimplemented_accesses++;
         qemu_log_mask(LOG_UNIMP,
                 "%s: Write of size %d at offset 0x%"PRIX64" not implemented.\n",
                 object_get_typename(OBJECT(state)), size, addr);
@@ -252,13 +481,14 @@ static void peripheral_write_callback(void *opaque, hwaddr addr, uint64_t value,
     uint32_t reg_addr = addr & ~(state->register_size_bytes - 1);
     uint32_t reg_offset = addr & (state->register_size_bytes - 1);
 
-    PeripheralRegisterClass *reg_class = PERIPHERAL_REGISTER_GET_CLASS(reg);
     // Write the value to the register.
-    if (reg_class->write) {
-        reg_class->write(OBJECT(reg), OBJECT(state), reg_addr, reg_offset, size,
+    if (likely(entry->write == NULL)) {
+        peripheral_register_direct_write(entry->state, state, reg_addr,
+                reg_offset, size, value);
+    } else {
+        entry->write(entry->obj, OBJECT(state), reg_addr, reg_offset, size,
                 value);
     }
-
 }
 
 static const MemoryRegionOps register_ops = {
@@ -301,6 +531,8 @@ static void peripheral_instance_init_callback(Object *obj)
             &state->is_little_endian);
     state->is_little_endian = true;
 
+    state->populate = NULL;
+
     cm_object_property_add_const_str(obj, "svd-size", &state->svd.size);
     state->svd.size = NULL;
 
@@ -320,46 +552,111 @@ static void peripheral_instance_init_callback(Object *obj)
     state->svd.reset_mask = NULL;
 }
 
-static int peripheral_compute_max_offset_foreach(Object *obj, void *opaque)
+static int peripheral_info_foreach(Object *obj, void *opaque)
+{
+    PeripheralInfoContext *ctx = (PeripheralInfoContext *) opaque;
+
+    if (!cm_object_is_instance_of_typename(obj, TYPE_PERIPHERAL)) {
+        return 0; // Continue iterations.
+    }
+
+    PeripheralState *state = PERIPHERAL_STATE(obj);
+
+    const char *layout;
+    switch (state->registers_layout) {
+    case PERIPHERAL_REGISTERS_LAYOUT_DENSE:
+        layout = "dense";
+        break;
+    case PERIPHERAL_REGISTERS_LAYOUT_PAGED:
+        layout = "paged";
+        break;
+    default:
+        layout = (state->populate != NULL) ? "lazy" : "none";
+        break;
+    }
+
+    size_t size = peripheral_registers_lookup_size(state);
+    ctx->total_size += size;
+
+    char *path = object_get_canonical_path(obj);
+    ctx->fprintf_func(ctx->f,
+            "%-32s 0x%08"PRIX64" 0x%04"PRIX32" %5"PRIu32" %-6s %6zu %"PRIu64"\n",
+            path, state->mmio_address, state->mmio_size_bytes,
+            state->num_registers, layout, size, state->unimplemented_accesses);
+    g_free(path);
+
+    if (state->registers_layout == PERIPHERAL_REGISTERS_LAYOUT_PAGED) {
+        ctx->fprintf_func(ctx->f, "%-32s %"PRIu32" of %"PRIu32" pages of %d\n",
+                "", state->num_used_register_pages, state->num_register_pages,
+                PERIPHERAL_REGISTERS_PAGE_ENTRIES);
+    }
+
+    return 0; // Continue iterations.
+}
+
+static int peripheral_collect_registers_foreach(Object *obj, void *opaque)
 {
-    PeripheralState *periph = PERIPHERAL_STATE(opaque);
+    GPtrArray *regs = (GPtrArray *) opaque;
 
-    int count = 0;
     // Process only children that descend from a register.
     if (cm_object_is_instance_of_typename(obj, TYPE_PERIPHERAL_REGISTER)) {
-        PeripheralRegisterState *reg = PERIPHERAL_REGISTER_STATE(obj);
-        if (reg->offset_bytes > periph->max_offset_bytes) {
-            periph->max_offset_bytes = reg->offset_bytes;
-        }
-        count++;
+        g_ptr_array_add(regs, PERIPHERAL_REGISTER_STATE(obj));
     }
-    periph->num_registers = count;
     return 0;
 }
 
-static int peripheral_populate_registers_array_foreach(Object *obj,
-        void *opaque)
+static gint peripheral_compare_registers(gconstpointer a, gconstpointer b)
 {
-    PeripheralState *periph = PERIPHERAL_STATE(opaque);
+    const PeripheralRegisterState *ra = *(PeripheralRegisterState * const *) a;
+    const PeripheralRegisterState *rb = *(PeripheralRegisterState * const *) b;
 
-    // Process only children that descend from a register.
-    if (cm_object_is_instance_of_typename(obj, TYPE_PERIPHERAL_REGISTER)) {
-        PeripheralRegisterState *reg = PERIPHERAL_REGISTER_STATE(obj);
-
-        uint32_t index = reg->offset_bytes / periph->register_size_bytes;
-        assert(index < periph->registers_size_ptrs);
-        if (periph->registers[index]) {
-            error_report("Register %s overlaps %s at 0x%X", reg->name,
-            PERIPHERAL_REGISTER_STATE(periph->registers[index])->name,
-                    reg->offset_bytes);
+    if (ra->offset_bytes < rb->offset_bytes) {
+        return -1;
+    }
+    return (ra->offset_bytes > rb->offset_bytes) ? 1 : 0;
+}
+
+static void peripheral_add_register_entry(PeripheralState *periph,
+        PeripheralRegisterState *reg)
+{
+    Object *obj = OBJECT(reg);
+
+    uint32_t index = reg->offset_bytes >> periph->register_size_shift;
+    assert(index < periph->registers_size_ptrs);
+
+    PeripheralRegisterDispatch *entry;
+    if (periph->registers_layout == PERIPHERAL_REGISTERS_LAYOUT_PAGED) {
+        PeripheralRegisterDispatch **page = &periph->register_pages[index
+                >> PERIPHERAL_REGISTERS_PAGE_BITS];
+        if (*page == NULL) {
+            *page = g_malloc0_n(PERIPHERAL_REGISTERS_PAGE_ENTRIES,
+                    sizeof(PeripheralRegisterDispatch));
         }
+        entry = &(*page)[index & (PERIPHERAL_REGISTERS_PAGE_ENTRIES - 1)];
+    } else {
+        entry = &periph->registers[index];
+    }
 
-        periph->registers[index] = obj;
+    if (entry->obj) {
+        error_report("Register %s overlaps %s at 0x%X", reg->name,
+                entry->state->name, reg->offset_bytes);
+    }
+
+    PeripheralRegisterClass *reg_class = PERIPHERAL_REGISTER_GET_CLASS(obj);
 
-        peripheral_register_compute_auto_bits(obj);
+    entry->obj = obj;
+    entry->state = reg;
+    // The default methods are called directly, without casts.
+    entry->read = NULL;
+    if (reg_class->read != peripheral_register_read_callback) {
+        entry->read = reg_class->read;
+    }
+    entry->write = NULL;
+    if (reg_class->write != peripheral_register_write_callback) {
+        entry->write = reg_class->write;
     }
 
-    return 0;
+    peripheral_register_compute_auto_bits(obj);
 }
 
 static void peripheral_realize_callback(DeviceState *dev, Error **errp)
@@ -386,14 +683,17 @@ static void peripheral_reset_callback(DeviceState *dev)
     // Call parent reset().
     cm_device_parent_reset(dev, TYPE_PERIPHERAL);
 
-    assert(state->registers != NULL);
+    if (state->populate != NULL) {
+        // Lazy peripheral, registers not yet created.
+        return;
+    }
+
+    assert(state->registers_layout != PERIPHERAL_REGISTERS_LAYOUT_NONE);
 
     // No bus used, explicitly reset all children registers.
     int i;
-    for (i = 0; i < state->registers_size_ptrs; ++i) {
-        if (state->registers[i] != NULL) {
-            device_reset(DEVICE(state->registers[i]));
-        }
+    for (i = 0; i < state->num_registers; ++i) {
+        device_reset(DEVICE(state->register_list[i]));
     }
 }
 
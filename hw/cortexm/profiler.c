@@ -0,0 +1,278 @@
+/*
+ * Cortex-M guest sampling profiler.
+ *
+ * Copyright (c) 2017 Liviu Ionescu.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <hw/cortexm/profiler.h>
+#include <hw/cortexm/nvic-prio.h>
+
+#include "qemu-common.h"
+#include "qapi/error.h"
+#include "qmp-commands.h"
+#include "qemu/error-report.h"
+#include "qemu/timer.h"
+#include "sysemu/sysemu.h"
+#include "disas/disas.h"
+#include "cpu.h"
+
+/*
+ * A QEMU_CLOCK_VIRTUAL timer records, `rate` times per second of guest
+ * time, the call stack of the core. The timer runs in the main loop,
+ * which holds the global lock, so the core is stopped between two
+ * translated blocks and its registers are up to date. Each sample
+ * costs one vCPU exit, a 1 KB stack read and a hash table update; the
+ * overhead at 1 kHz is expected to be small, but was not measured.
+ *
+ * The stack is the PC, the LR if it is a return address, then the
+ * return addresses found by scanning the stack upwards from SP. A word
+ * is a return address if it has the Thumb bit set, it is inside a
+ * function of the ELF symbol table (loaded with the application by
+ * load_elf()), and it follows a BL or BLX. GCC does not keep frame
+ * pointers usable for unwinding on Cortex-M, so this is a heuristic;
+ * return addresses left in uninitialised locals may add frames.
+ *
+ * Samples are aggregated by their symbolized stack, in the "folded"
+ * format used by flamegraph.pl, one "root;caller;...;function count"
+ * line per stack. The root is the thread mode, the exception being
+ * handled, or idle, when the core waits in WFI/WFE.
+ */
+
+// Bytes of stack scanned for return addresses.
+#define CORTEXM_PROFILER_SCAN_SIZE      (1024)
+
+typedef struct {
+    QEMUTimer *timer;
+    int64_t period_ns;
+    int depth;
+    char *file_name;
+
+    // Folded stack -> uint64_t count.
+    GHashTable *stacks;
+
+    Notifier exit_notifier;
+} CortexMProfiler;
+
+static CortexMProfiler profiler;
+
+static const char *cortexm_profiler_exception_names[16] = {
+    [NVIC_EXCEPTION_NMI] = "NMI",
+    [NVIC_EXCEPTION_HARD_FAULT] = "HardFault",
+    [NVIC_EXCEPTION_MEM_MANAGE] = "MemManage",
+    [NVIC_EXCEPTION_BUS_FAULT] = "BusFault",
+    [NVIC_EXCEPTION_USAGE_FAULT] = "UsageFault",
+    [NVIC_EXCEPTION_SVCALL] = "SVCall",
+    [NVIC_EXCEPTION_DEBUG_MONITOR] = "DebugMonitor",
+    [NVIC_EXCEPTION_PENDSV] = "PendSV",
+    [NVIC_EXCEPTION_SYSTICK] = "SysTick", };
+
+// ----- Private --------------------------------------------------------------
+
+// If value is the return address of a call (BL or BLX), return the
+// address of the call, otherwise 0.
+static uint32_t cortexm_profiler_call_address(CPUState *cs, uint32_t value)
+{
+    uint8_t code[4];
+    uint32_t addr;
+
+    // Thumb bit set, not an EXC_RETURN.
+    if ((value & 1) == 0 || value >= 0xF0000000) {
+        return 0;
+    }
+    addr = (value & ~1) - 2;
+    if (lookup_symbol(addr)[0] == '\0'
+            || cpu_memory_rw_debug(cs, addr - 2, code, 4, 0) != 0) {
+        return 0;
+    }
+
+    // BL
+    if ((lduw_le_p(code) & 0xF800) == 0xF000
+            && (lduw_le_p(code + 2) & 0xD000) == 0xD000) {
+        return addr;
+    }
+    // BLX Rm
+    if ((lduw_le_p(code + 2) & 0xFF87) == 0x4780) {
+        return addr;
+    }
+    return 0;
+}
+
+// Collect the PC and the call addresses, innermost first.
+static int cortexm_profiler_unwind(CPUState *cs, uint32_t *addrs)
+{
+    CPUARMState *env = &ARM_CPU(cs)->env;
+    uint8_t stack[CORTEXM_PROFILER_SCAN_SIZE];
+    uint32_t lr_call;
+    uint32_t call;
+    int count = 0;
+    int i;
+
+    addrs[count++] = env->regs[15];
+
+    lr_call = cortexm_profiler_call_address(cs, env->regs[14]);
+    if (lr_call != 0 && count <= profiler.depth) {
+        addrs[count++] = lr_call;
+    }
+
+    if (cpu_memory_rw_debug(cs, env->regs[13] & ~3, stack, sizeof(stack), 0)
+            != 0) {
+        return count;
+    }
+    for (i = 0; i < sizeof(stack) && count <= profiler.depth; i += 4) {
+        call = cortexm_profiler_call_address(cs, ldl_le_p(stack + i));
+        if (call == 0) {
+            continue;
+        }
+        // A non-leaf function saves its LR, already in the stack.
+        if (call == lr_call) {
+            lr_call = 0;
+            continue;
+        }
+        addrs[count++] = call;
+    }
+    return count;
+}
+
+static void cortexm_profiler_append_symbol(GString *str, uint32_t addr)
+{
+    const char *name = lookup_symbol(addr);
+
+    if (name[0] != '\0') {
+        g_string_append(str, name);
+    } else {
+        g_string_append_printf(str, "0x%08X", addr);
+    }
+}
+
+static void cortexm_profiler_sample(CPUState *cs)
+{
+    CPUARMState *env = &ARM_CPU(cs)->env;
+    uint32_t addrs[CORTEXM_PROFILER_MAX_DEPTH + 1];
+    GString *str = g_string_new("");
+    uint64_t *value;
+    int exception;
+    int count;
+    int i;
+
+    exception = env->v7m.exception;
+    if (cs->halted) {
+        g_string_append(str, "[idle]");
+        count = 0;
+    } else {
+        if (exception == 0) {
+            g_string_append(str, "[thread]");
+        } else if (exception < 16
+                && cortexm_profiler_exception_names[exception] != NULL) {
+            g_string_append_printf(str, "[%s]",
+                    cortexm_profiler_exception_names[exception]);
+        } else {
+            g_string_append_printf(str, "[IRQ %d]", exception - 16);
+        }
+        count = cortexm_profiler_unwind(cs, addrs);
+    }
+
+    // Outermost frame first.
+    for (i = count - 1; i >= 0; i--) {
+        g_string_append_c(str, ';');
+        cortexm_profiler_append_symbol(str, addrs[i]);
+    }
+
+    value = g_hash_table_lookup(profiler.stacks, str->str);
+    if (value == NULL) {
+        value = g_new0(uint64_t, 1);
+        g_hash_table_insert(profiler.stacks, g_string_free(str, FALSE),
+                value);
+    } else {
+        g_string_free(str, TRUE);
+    }
+    (*value)++;
+}
+
+static void cortexm_profiler_timer_callback(void *opaque)
+{
+    if (first_cpu != NULL && runstate_is_running()) {
+        cortexm_profiler_sample(first_cpu);
+    }
+
+    timer_mod(profiler.timer,
+            qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) + profiler.period_ns);
+}
+
+static void cortexm_profiler_exit_callback(Notifier *notifier, void *data)
+{
+    Error *err = NULL;
+
+    if (!cortexm_profiler_dump(profiler.file_name, &err)) {
+        error_report_err(err);
+    }
+}
+
+// ----- Public ---------------------------------------------------------------
+
+void cortexm_profiler_init(const char *file_name, int rate, int depth)
+{
+    profiler.file_name = g_strdup(file_name);
+    profiler.period_ns = NANOSECONDS_PER_SECOND / rate;
+    profiler.depth = MIN(depth, CORTEXM_PROFILER_MAX_DEPTH);
+    profiler.stacks = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+            g_free);
+
+    profiler.timer = timer_new_ns(QEMU_CLOCK_VIRTUAL,
+            cortexm_profiler_timer_callback, NULL);
+    timer_mod(profiler.timer,
+            qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) + profiler.period_ns);
+
+    profiler.exit_notifier.notify = cortexm_profiler_exit_callback;
+    qemu_add_exit_notifier(&profiler.exit_notifier);
+}
+
+bool cortexm_profiler_dump(const char *file_name, Error **errp)
+{
+    GString *out = g_string_new("");
+    GError *gerr = NULL;
+    GList *keys;
+    GList *l;
+    bool ret;
+
+    keys = g_list_sort(g_hash_table_get_keys(profiler.stacks),
+            (GCompareFunc) strcmp);
+    for (l = keys; l != NULL; l = l->next) {
+        g_string_append_printf(out, "%s %" PRIu64 "\n", (char *) l->data,
+                *(uint64_t *) g_hash_table_lookup(profiler.stacks, l->data));
+    }
+    g_list_free(keys);
+
+    ret = g_file_set_contents(file_name, out->str, out->len, &gerr);
+    if (!ret) {
+        error_setg(errp, "Cannot write profile '%s': %s", file_name,
+                gerr->message);
+        g_error_free(gerr);
+    }
+    g_string_free(out, TRUE);
+    return ret;
+}
+
+void qmp_profile_dump(bool has_filename, const char *filename, Error **errp)
+{
+    if (profiler.stacks == NULL) {
+        error_setg(errp, "The profiler is not enabled, use -profile");
+        return;
+    }
+    cortexm_profiler_dump(has_filename ? filename : profiler.file_name,
+            errp);
+}
+
+// ----------------------------------------------------------------------------
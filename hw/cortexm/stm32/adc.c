@@ -0,0 +1,558 @@
+/*
+ * STM32 MCU - ADC (analog to digital converter) emulation.
+ *
+ * Copyright (c) 2017 Liviu Ionescu.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <hw/cortexm/stm32/adc.h>
+#include <hw/cortexm/stm32/mcu.h>
+#include <hw/cortexm/helper.h>
+#include <hw/cortexm/svd.h>
+
+#include "qemu/host-utils.h"
+#include "qemu/bswap.h"
+
+/*
+ * This file implements the regular group of the F1/F4 ADCs.
+ *
+ * The analog inputs are read from a host file, mapped in memory, with
+ * the sample selected by the virtual time at the end of each
+ * conversion; there is no host I/O per sample, and very large
+ * recordings are paged in by the host as needed.
+ *
+ * Each conversion is a single timer event, after the sampling and
+ * conversion time computed from SMPRx and the ADC clock. Scan and
+ * continuous modes are supported; with CR2.DMA, a DMA request is
+ * raised after each conversion, and lowered when DR is read.
+ *
+ * TODO:
+ * - implement the injected group, the analog watchdog, the
+ *   external triggers and the F0 ADC
+ */
+
+#define ADC_SR_EOC          (1 << 1)
+#define ADC_SR_STRT         (1 << 4)
+
+#define ADC_CR1_EOCIE       (1 << 5)
+#define ADC_CR1_SCAN        (1 << 8)
+#define ADC_CR1_RES_SHIFT   (24)
+
+#define ADC_CR2_ADON        (1 << 0)
+#define ADC_CR2_CONT        (1 << 1)
+#define ADC_CR2_CAL         (1 << 2)
+#define ADC_CR2_RSTCAL      (1 << 3)
+#define ADC_CR2_DMA         (1 << 8)
+#define ADC_CR2_EOCS        (1 << 10)
+#define ADC_CR2_ALIGN       (1 << 11)
+#define ADC_CR2_SWSTART_F1  (1 << 22)
+#define ADC_CR2_SWSTART_F4  (1 << 30)
+
+// ----- Public ---------------------------------------------------------------
+
+// Create ADC%d and return it.
+Object* stm32_adc_create(Object *parent, stm32_adc_index_t index)
+{
+    if ((int) index >= STM32_ADC_UNDEFINED) {
+        hw_error("Cannot assign ADC %d: QEMU supports only %d ADCs\n",
+                1 + index - STM32_ADC_1, STM32_ADC_UNDEFINED);
+    }
+
+    char child_name[10];
+    snprintf(child_name, sizeof(child_name) - 1, "ADC%d",
+            1 + index - STM32_ADC_1);
+    // Passing a local string is ok.
+    Object *adc = cm_object_new(parent, child_name, TYPE_STM32_ADC);
+
+    object_property_set_int(adc, index, "adc-index", NULL);
+
+    cm_object_realize(adc);
+
+    return adc;
+}
+
+// ----- Private --------------------------------------------------------------
+
+static bool stm32_adc_is_enabled(Object *obj)
+{
+    STM32ADCState *state = STM32_ADC_STATE(obj);
+
+    if (register_bitfield_is_non_zero(state->enabling_bit)) {
+        return true; // Positive logic, bit == 1 means enabled.
+    }
+
+    // Not enabled
+    return false;
+}
+
+static bool stm32_adc_is_f4(STM32ADCState *state)
+{
+    return state->capabilities->family == STM32_FAMILY_F4;
+}
+
+// Return the input converted at position `index` of the regular
+// sequence (SQ1 is in SQR3).
+static int stm32_adc_get_sequence_input(STM32ADCState *state, int index)
+{
+    Object *sqr;
+
+    if (index < 6) {
+        sqr = state->reg.sqr3;
+    } else if (index < 12) {
+        sqr = state->reg.sqr2;
+        index -= 6;
+    } else {
+        sqr = state->reg.sqr1;
+        index -= 12;
+    }
+
+    return (peripheral_register_get_raw_value(sqr) >> (5 * index)) & 0x1F;
+}
+
+// Return the number of conversions in the regular sequence.
+static int stm32_adc_get_sequence_length(STM32ADCState *state)
+{
+    uint32_t cr1 = peripheral_register_get_raw_value(state->reg.cr1);
+
+    if (!(cr1 & ADC_CR1_SCAN)) {
+        return 1;
+    }
+    return 1 + ((peripheral_register_get_raw_value(state->reg.sqr1) >> 20)
+            & 0xF);
+}
+
+// Return the duration of one conversion, in ns.
+static int64_t stm32_adc_get_conversion_ns(STM32ADCState *state, int input)
+{
+    // Sampling time, in half ADC clock cycles.
+    static const uint16_t f1_sample_half_cycles[8] = {
+        3, 15, 27, 57, 83, 111, 143, 479 };
+    static const uint16_t f4_sample_half_cycles[8] = {
+        6, 30, 56, 112, 168, 224, 288, 960 };
+
+    Object *smpr = (input < 10) ? state->reg.smpr2 : state->reg.smpr1;
+    int smp = (peripheral_register_get_raw_value(smpr) >> (3 * (input % 10)))
+            & 0x7;
+
+    uint32_t half_cycles;
+    if (stm32_adc_is_f4(state)) {
+        // 12, 10, 8 or 6 bits, one cycle each.
+        int res = (peripheral_register_get_raw_value(state->reg.cr1)
+                >> ADC_CR1_RES_SHIFT) & 0x3;
+        half_cycles = f4_sample_half_cycles[smp] + 2 * (12 - 2 * res);
+    } else {
+        // 12.5 cycles.
+        half_cycles = f1_sample_half_cycles[smp] + 25;
+    }
+
+    STM32RCCState *rcc = STM32_RCC_STATE(stm32_mcu_get()->rcc);
+    uint32_t adc_hz = stm32_rcc_get_adc_freq_hz(rcc);
+    if (adc_hz == 0) {
+        return 0;
+    }
+
+    return muldiv64(half_cycles, NANOSECONDS_PER_SECOND, 2 * (uint64_t) adc_hz);
+}
+
+// Return the sample of the input at the given virtual time, as a 12-bit
+// right aligned value.
+static uint32_t stm32_adc_get_sample(STM32ADCState *state, int input,
+        int64_t now)
+{
+    if (state->samples == NULL || state->num_frames == 0) {
+        return 0;
+    }
+
+    uint64_t frame = muldiv64(now, state->sample_rate,
+            NANOSECONDS_PER_SECOND);
+    if (frame >= state->num_frames) {
+        frame = state->num_frames - 1;
+    }
+
+    uint64_t offset = (frame * state->sample_channels
+            + (input % state->sample_channels)) * 2;
+
+    return lduw_le_p(state->samples + offset) & 0xFFF;
+}
+
+// Raise or lower the DMA request, only when changed.
+static void stm32_adc_set_dma_request(STM32ADCState *state, bool level)
+{
+    if (state->dma.dma != NULL && level != state->dma.level) {
+        state->dma.level = level;
+        stm32_dma_set_request(state->dma.dma, state->dma.channel,
+                state->dma.request, state, level);
+    }
+}
+
+static void stm32_adc_schedule(STM32ADCState *state)
+{
+    int input = stm32_adc_get_sequence_input(state, state->sequence_index);
+
+    timer_mod(state->timer,
+            qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL)
+                    + stm32_adc_get_conversion_ns(state, input));
+}
+
+static void stm32_adc_start(STM32ADCState *state)
+{
+    if (state->is_converting) {
+        return;
+    }
+
+    state->is_converting = true;
+    state->sequence_index = 0;
+    peripheral_register_or_raw_value(state->reg.sr, ADC_SR_STRT);
+
+    stm32_adc_schedule(state);
+}
+
+static void stm32_adc_stop(STM32ADCState *state)
+{
+    state->is_converting = false;
+    timer_del(state->timer);
+}
+
+// End of one conversion: store the result, signal it and start the
+// next one, if any.
+static void stm32_adc_timer_callback(void *opaque)
+{
+    STM32ADCState *state = (STM32ADCState *) opaque;
+
+    if (!state->is_converting) {
+        return;
+    }
+
+    int64_t now = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+    uint32_t cr1 = peripheral_register_get_raw_value(state->reg.cr1);
+    uint32_t cr2 = peripheral_register_get_raw_value(state->reg.cr2);
+
+    int input = stm32_adc_get_sequence_input(state, state->sequence_index);
+    uint32_t value = stm32_adc_get_sample(state, input, now);
+
+    if (stm32_adc_is_f4(state)) {
+        // Lower resolutions drop the least significant bits.
+        value >>= 2 * ((cr1 >> ADC_CR1_RES_SHIFT) & 0x3);
+    }
+    if (cr2 & ADC_CR2_ALIGN) {
+        value <<= 4;
+    }
+    peripheral_register_set_raw_value(state->reg.dr, value);
+
+    state->sequence_index++;
+    bool is_sequence_end = (state->sequence_index
+            >= stm32_adc_get_sequence_length(state));
+
+    // On F4, with EOCS cleared, EOC is set only at the end of the
+    // sequence.
+    if (is_sequence_end || !stm32_adc_is_f4(state) || (cr2 & ADC_CR2_EOCS)) {
+        peripheral_register_or_raw_value(state->reg.sr, ADC_SR_EOC);
+        if ((cr1 & ADC_CR1_EOCIE) && state->irq >= 0) {
+            cortexm_nvic_set_pending_interrupt(state->nvic, state->irq);
+        }
+    }
+
+    if (is_sequence_end) {
+        state->sequence_index = 0;
+        if (!(cr2 & ADC_CR2_CONT)) {
+            state->is_converting = false;
+        }
+    }
+    if (state->is_converting) {
+        stm32_adc_schedule(state);
+    }
+
+    // Last, since the DMA reads DR right away.
+    if (cr2 & ADC_CR2_DMA) {
+        stm32_adc_set_dma_request(state, true);
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+// Status bits are cleared by writing 0.
+static peripheral_register_t stm32_adc_sr_pre_write_callback(Object *reg,
+        Object *periph, uint32_t addr, uint32_t offset, unsigned size,
+        peripheral_register_t value, peripheral_register_t full_value)
+{
+    return peripheral_register_get_raw_value(reg) & full_value;
+}
+
+// Reading DR clears EOC and the DMA request.
+static void stm32_adc_dr_post_read_callback(Object *reg, Object *periph,
+        uint32_t addr, uint32_t offset, unsigned size)
+{
+    STM32ADCState *state = STM32_ADC_STATE(periph);
+
+    peripheral_register_and_raw_value(state->reg.sr, ~ADC_SR_EOC);
+    stm32_adc_set_dma_request(state, false);
+}
+
+static void stm32_adc_cr2_post_write_callback(Object *reg, Object *periph,
+        uint32_t addr, uint32_t offset, unsigned size,
+        peripheral_register_t value, peripheral_register_t full_value)
+{
+    STM32ADCState *state = STM32_ADC_STATE(periph);
+
+    peripheral_register_t prev_value = peripheral_register_get_raw_prev_value(
+            reg);
+
+    uint32_t swstart;
+    if (stm32_adc_is_f4(state)) {
+        swstart = ADC_CR2_SWSTART_F4;
+    } else {
+        swstart = ADC_CR2_SWSTART_F1;
+        // The calibration completes immediately.
+        peripheral_register_and_raw_value(reg, ~(ADC_CR2_CAL | ADC_CR2_RSTCAL));
+    }
+
+    if (!(full_value & ADC_CR2_ADON)) {
+        stm32_adc_stop(state);
+        peripheral_register_and_raw_value(reg, ~swstart);
+        return;
+    }
+
+    // On F1, setting ADON again, with no other change, also starts
+    // a conversion.
+    bool start = (full_value & swstart) != 0;
+    if (!stm32_adc_is_f4(state) && (prev_value & ADC_CR2_ADON)
+            && full_value == prev_value) {
+        start = true;
+    }
+
+    if (start) {
+        // SWSTART is cleared when the conversion starts.
+        peripheral_register_and_raw_value(reg, ~swstart);
+        stm32_adc_start(state);
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+static void stm32_adc_instance_init_callback(Object *obj)
+{
+    qemu_log_function_name();
+
+    STM32ADCState *state = STM32_ADC_STATE(obj);
+
+    cm_object_property_add_int(obj, "adc-index",
+            (const int *) &state->adc_index);
+    state->adc_index = STM32_ADC_UNDEFINED;
+}
+
+// The DMA requests of the regular group: controller, channel (F1,
+// numbered from 0) or stream and CHSEL (F4); -1 if none.
+static void stm32_adc_set_dma_route(STM32ADCState *state)
+{
+    static const int f1_routes[STM32_ADC_UNDEFINED][3] = {
+        { 0, 0, 0 },
+        { -1, 0, 0 },
+        { 1, 4, 0 },
+    /**/
+    };
+    static const int f4_routes[STM32_ADC_UNDEFINED][3] = {
+        { 1, 0, 0 },
+        { 1, 2, 1 },
+        { 1, 1, 2 },
+    /**/
+    };
+
+    STM32MCUState *mcu = stm32_mcu_get();
+    const int *route = stm32_adc_is_f4(state) ?
+            f4_routes[state->adc_index] : f1_routes[state->adc_index];
+
+    state->dma.dma = NULL;
+    if (route[0] >= 0 && mcu->dma[route[0]] != NULL) {
+        state->dma.dma = OBJECT(mcu->dma[route[0]]);
+        state->dma.channel = route[1];
+        state->dma.request = route[2];
+    }
+}
+
+// Create the registers and bitfields; called at realize, or on first
+// access for lazy peripherals.
+static void stm32_adc_create_registers(Object *obj)
+{
+    STM32MCUState *mcu = stm32_mcu_get();
+    CortexMState *cm_state = CORTEXM_MCU_STATE(mcu);
+
+    STM32ADCState *state = STM32_ADC_STATE(obj);
+
+    char periph_name[10];
+    snprintf(periph_name, sizeof(periph_name) - 1, "ADC%d",
+            1 + state->adc_index - STM32_ADC_1);
+
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(
+            cm_state->svd_device, periph_name);
+    svd_add_peripheral_properties_and_children(obj, periph,
+            cm_state->svd_device);
+
+    // The register names are the same in F1 and F4.
+    state->reg.sr = cm_object_get_child_by_name(obj, "SR");
+    state->reg.cr1 = cm_object_get_child_by_name(obj, "CR1");
+    state->reg.cr2 = cm_object_get_child_by_name(obj, "CR2");
+    state->reg.smpr1 = cm_object_get_child_by_name(obj, "SMPR1");
+    state->reg.smpr2 = cm_object_get_child_by_name(obj, "SMPR2");
+    state->reg.sqr1 = cm_object_get_child_by_name(obj, "SQR1");
+    state->reg.sqr2 = cm_object_get_child_by_name(obj, "SQR2");
+    state->reg.sqr3 = cm_object_get_child_by_name(obj, "SQR3");
+    state->reg.dr = cm_object_get_child_by_name(obj, "DR");
+
+    peripheral_register_set_pre_write(state->reg.sr,
+            &stm32_adc_sr_pre_write_callback);
+    peripheral_register_set_post_read(state->reg.dr,
+            &stm32_adc_dr_post_read_callback);
+    peripheral_register_set_post_write(state->reg.cr2,
+            &stm32_adc_cr2_post_write_callback);
+
+    peripheral_prepare_registers(obj);
+}
+
+static void stm32_adc_realize_callback(DeviceState *dev, Error **errp)
+{
+    qemu_log_function_name();
+
+    // Call parent realize().
+    if (!cm_device_parent_realize(dev, errp, TYPE_STM32_ADC)) {
+        return;
+    }
+
+    STM32MCUState *mcu = stm32_mcu_get();
+    CortexMState *cm_state = CORTEXM_MCU_STATE(mcu);
+
+    STM32ADCState *state = STM32_ADC_STATE(dev);
+    // First thing first: get capabilities from MCU, needed everywhere.
+    state->capabilities = mcu->capabilities;
+
+    const STM32Capabilities *capabilities = state->capabilities;
+    assert(capabilities != NULL);
+
+    Object *obj = OBJECT(dev);
+
+    state->nvic = CORTEXM_NVIC_STATE(cm_state->nvic);
+
+    switch (capabilities->family) {
+    case STM32_FAMILY_F1:
+        // ADC3 (HD/XL devices) has a separate interrupt.
+        state->irq = (state->adc_index == STM32_ADC_3) ?
+                STM32F10X_HD_ADC3_IRQn : STM32F10X_CL_ADC1_2_IRQn;
+        break;
+    case STM32_FAMILY_F4:
+        state->irq = STM32F4_01_57_XX_ADC_IRQn;
+        break;
+    default:
+        state->irq = -1;
+        break;
+    }
+
+    char periph_name[10];
+    snprintf(periph_name, sizeof(periph_name) - 1, "ADC%d",
+            1 + state->adc_index - STM32_ADC_1);
+
+    svd_set_peripheral_address_block(cm_state->svd_device, periph_name, obj);
+    peripheral_create_memory_region(obj);
+
+    char enabling_bit_name[STM32_RCC_SIZEOF_ENABLING_BITFIELD];
+    snprintf(enabling_bit_name, sizeof(enabling_bit_name) - 1,
+            DEVICE_PATH_STM32_RCC "/APB2ENR/ADC%dEN",
+            1 + state->adc_index - STM32_ADC_1);
+
+    state->enabling_bit = OBJECT(cm_device_by_name(enabling_bit_name));
+
+    peripheral_populate_registers(obj, stm32_adc_create_registers,
+            mcu->lazy_peripherals);
+
+    stm32_adc_set_dma_route(state);
+
+    if (state->samples_file != NULL && *state->samples_file != '\0') {
+        GError *err = NULL;
+        state->mapped_file = g_mapped_file_new(state->samples_file, FALSE,
+                &err);
+        if (state->mapped_file == NULL) {
+            hw_error("%s: cannot map the samples file '%s'.\n", periph_name,
+                    state->samples_file);
+        }
+        if (state->sample_channels == 0) {
+            state->sample_channels = 1;
+        }
+        state->samples = (const uint8_t *) g_mapped_file_get_contents(
+                state->mapped_file);
+        state->num_frames = g_mapped_file_get_length(state->mapped_file)
+                / (2 * state->sample_channels);
+    }
+
+    state->timer = timer_new_ns(QEMU_CLOCK_VIRTUAL, stm32_adc_timer_callback,
+            state);
+}
+
+static void stm32_adc_reset_callback(DeviceState *dev)
+{
+    qemu_log_function_name();
+
+    STM32ADCState *state = STM32_ADC_STATE(dev);
+
+    // Call parent reset().
+    cm_device_parent_reset(dev, TYPE_STM32_ADC);
+
+    if (state->timer) {
+        stm32_adc_stop(state);
+    }
+    state->sequence_index = 0;
+    // Drop the DMA request, the DMA reset keeps the request lines.
+    if (state->dma.dma != NULL && state->dma.level) {
+        stm32_dma_set_request(state->dma.dma, state->dma.channel,
+                state->dma.request, state, false);
+    }
+    state->dma.level = false;
+}
+
+static Property stm32_adc_properties[] = {
+        DEFINE_PROP_STRING("samples-file", STM32ADCState, samples_file),
+        DEFINE_PROP_UINT32("sample-rate", STM32ADCState, sample_rate, 1000),
+        DEFINE_PROP_UINT32("sample-channels", STM32ADCState, sample_channels,
+                1),
+    DEFINE_PROP_END_OF_LIST(), };
+
+static void stm32_adc_class_init_callback(ObjectClass *klass, void *data)
+{
+    DeviceClass *dc = DEVICE_CLASS(klass);
+
+    dc->reset = stm32_adc_reset_callback;
+    dc->realize = stm32_adc_realize_callback;
+
+    dc->props = stm32_adc_properties;
+
+    PeripheralClass *per_class = PERIPHERAL_CLASS(klass);
+    per_class->is_enabled = stm32_adc_is_enabled;
+}
+
+static const TypeInfo stm32_adc_type_info = {
+    .name = TYPE_STM32_ADC,
+    .parent = TYPE_STM32_ADC_PARENT,
+    .instance_init = stm32_adc_instance_init_callback,
+    .instance_size = sizeof(STM32ADCState),
+    .class_init = stm32_adc_class_init_callback,
+    .class_size = sizeof(STM32ADCClass)
+/**/
+};
+
+static void stm32_adc_register_types(void)
+{
+    type_register_static(&stm32_adc_type_info);
+}
+
+type_init(stm32_adc_register_types);
+
+// ----------------------------------------------------------------------------
@@ -18,6 +18,7 @@
  */
 
 #include <hw/cortexm/stm32/afio.h>
+#include <hw/cortexm/stm32/exti.h>
 #include <hw/cortexm/stm32/mcu.h>
 #include <hw/cortexm/helper.h>
 #include <hw/cortexm/svd.h>
@@ -26,12 +27,12 @@
 //
 // STM32F103RB
 // DO NOT EDIT! Automatically generated!
-static void stm32f103xx_afio_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f103xx_afio_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32AFIOState *state = STM32_AFIO_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -146,12 +147,12 @@ static void stm32f103xx_afio_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F107VC
 // DO NOT EDIT! Automatically generated!
-static void stm32f107xx_afio_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f107xx_afio_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32AFIOState *state = STM32_AFIO_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -324,6 +325,18 @@ static void stm32_afio_xxx_post_read_callback(Object *reg, Object *periph,
 
 // ----------------------------------------------------------------------------
 
+// Publish the new routing to the GPIO ports.
+static void stm32_afio_exticr_post_write_callback(Object *reg, Object *periph,
+        uint32_t addr, uint32_t offset, unsigned size,
+        peripheral_register_t value, peripheral_register_t full_value)
+{
+    STM32AFIOState *state = STM32_AFIO_STATE(periph);
+
+    stm32_exti_compute_port_masks(state->exticr.reg, state->exticr.port_mask);
+}
+
+// ----------------------------------------------------------------------------
+
 static bool stm32_afio_is_enabled(Object *obj)
 {
     STM32AFIOState *state = STM32_AFIO_STATE(obj);
@@ -379,7 +392,7 @@ static void stm32_afio_realize_callback(DeviceState *dev, Error **errp)
 
     const char *periph_name = "AFIO";
 
-    svd_set_peripheral_address_block(cm_state->svd_json, periph_name, obj);
+    svd_set_peripheral_address_block(cm_state->svd_device, periph_name, obj);
     peripheral_create_memory_region(obj);
 
     char enabling_bit_name[STM32_RCC_SIZEOF_ENABLING_BITFIELD];
@@ -389,12 +402,12 @@ static void stm32_afio_realize_callback(DeviceState *dev, Error **errp)
 
         if (capabilities->f1.is_103xx) {
 
-            stm32f103xx_afio_create_objects(obj, cm_state->svd_json,
+            stm32f103xx_afio_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
         } else if (capabilities->f1.is_107xx) {
 
-            stm32f107xx_afio_create_objects(obj, cm_state->svd_json,
+            stm32f107xx_afio_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
         } else {
@@ -419,6 +432,11 @@ static void stm32_afio_realize_callback(DeviceState *dev, Error **errp)
         state->exticr.exti[14] = state->u.f1.fld.exticr4.exti14;
         state->exticr.exti[15] = state->u.f1.fld.exticr4.exti15;
 
+        state->exticr.reg[0] = state->u.f1.reg.exticr1;
+        state->exticr.reg[1] = state->u.f1.reg.exticr2;
+        state->exticr.reg[2] = state->u.f1.reg.exticr3;
+        state->exticr.reg[3] = state->u.f1.reg.exticr4;
+
         snprintf(enabling_bit_name, sizeof(enabling_bit_name) - 1,
                 DEVICE_PATH_STM32_RCC "/APB2ENR/AFIOEN");
 
@@ -439,6 +457,12 @@ static void stm32_afio_realize_callback(DeviceState *dev, Error **errp)
 
     state->enabling_bit = OBJECT(cm_device_by_name(enabling_bit_name));
 
+    int i;
+    for (i = 0; i < 4; ++i) {
+        peripheral_register_set_post_write(state->exticr.reg[i],
+                &stm32_afio_exticr_post_write_callback);
+    }
+
     peripheral_prepare_registers(obj);
 }
 
@@ -448,6 +472,10 @@ static void stm32_afio_reset_callback(DeviceState *dev)
 
     // Call parent reset(); this will reset all children registers.
     cm_device_parent_reset(dev, TYPE_STM32_AFIO);
+
+    STM32AFIOState *state = STM32_AFIO_STATE(dev);
+
+    stm32_exti_compute_port_masks(state->exticr.reg, state->exticr.port_mask);
 }
 
 static void stm32_afio_class_init_callback(ObjectClass *klass, void *data)
@@ -0,0 +1,935 @@
+/*
+ * STM32 MCU - DMA (direct memory access controller) emulation.
+ *
+ * Copyright (c) 2017 Liviu Ionescu.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <hw/cortexm/stm32/dma.h>
+#include <hw/cortexm/stm32/mcu.h>
+#include <hw/cortexm/helper.h>
+#include <hw/cortexm/svd.h>
+
+#include "exec/address-spaces.h"
+#include "exec/memory.h"
+
+/*
+ * This file implements the STM32 DMA controllers, both the F0/F1
+ * channels and the F4 streams.
+ *
+ * Transfers are not paced by the bus; memory to memory transfers
+ * are performed as soon as the channel is enabled, and, when both
+ * ends are RAM, as a single host copy via address_space_map().
+ * Peripheral ends are accessed with one MMIO access per item, for as
+ * long as the peripheral keeps its request active (see
+ * stm32_dma_set_request()), unless the peripheral registered a bulk
+ * handler, which moves whole blocks between the memory and its own
+ * buffers (see stm32_dma_transfer_block()).
+ *
+ * TODO:
+ * - implement the F4 FIFO packing, burst and double buffer modes
+ * - implement priorities between channels
+ */
+
+// F0/F1 CCRx
+#define DMA_CCR_EN          (1 << 0)
+#define DMA_CCR_TCIE        (1 << 1)
+#define DMA_CCR_HTIE        (1 << 2)
+#define DMA_CCR_TEIE        (1 << 3)
+#define DMA_CCR_DIR         (1 << 4)
+#define DMA_CCR_CIRC        (1 << 5)
+#define DMA_CCR_PINC        (1 << 6)
+#define DMA_CCR_MINC        (1 << 7)
+#define DMA_CCR_PSIZE_SHIFT (8)
+#define DMA_CCR_MSIZE_SHIFT (10)
+#define DMA_CCR_MEM2MEM     (1 << 14)
+
+// F4 SxCR
+#define DMA_SCR_EN          (1 << 0)
+#define DMA_SCR_TEIE        (1 << 2)
+#define DMA_SCR_HTIE        (1 << 3)
+#define DMA_SCR_TCIE        (1 << 4)
+#define DMA_SCR_DIR_SHIFT   (6)
+#define DMA_SCR_CIRC        (1 << 8)
+#define DMA_SCR_PINC        (1 << 9)
+#define DMA_SCR_MINC        (1 << 10)
+#define DMA_SCR_PSIZE_SHIFT (11)
+#define DMA_SCR_MSIZE_SHIFT (13)
+#define DMA_SCR_DBM         (1 << 18)
+#define DMA_SCR_CHSEL_SHIFT (25)
+
+// Channel events, mapped to the ISR bits of each family.
+#define DMA_FLAG_TC         (1 << 0)
+#define DMA_FLAG_HT         (1 << 1)
+#define DMA_FLAG_TE         (1 << 2)
+
+// The decoded channel configuration.
+typedef struct {
+    bool is_enabled;
+    bool is_mem2mem;
+    bool is_circular;
+    // The source is the memory address (M0AR/CMAR).
+    bool from_memory;
+    bool pinc;
+    bool minc;
+    unsigned psize;
+    unsigned msize;
+    // The request line selected (CHSEL) on F4.
+    int request;
+    // The enabled interrupts, as DMA_FLAG_xx.
+    uint32_t interrupts;
+} STM32DMAConfig;
+
+// ----- Public ---------------------------------------------------------------
+
+// Create DMA%d and return it.
+Object* stm32_dma_create(Object *parent, stm32_dma_index_t index)
+{
+    if ((int) index >= STM32_DMA_UNDEFINED) {
+        hw_error("Cannot assign DMA %d: QEMU supports only %d controllers\n",
+                1 + index - STM32_DMA_1, STM32_DMA_UNDEFINED);
+    }
+
+    char child_name[10];
+    snprintf(child_name, sizeof(child_name) - 1, "DMA%d",
+            1 + index - STM32_DMA_1);
+    // Passing a local string is ok.
+    Object *dma = cm_object_new(parent, child_name, TYPE_STM32_DMA);
+
+    object_property_set_int(dma, index, "dma-index", NULL);
+
+    cm_object_realize(dma);
+
+    return dma;
+}
+
+static void stm32_dma_run(STM32DMAState *state, int n);
+
+static void stm32_dma_get_config(STM32DMAState *state, int n,
+        STM32DMAConfig *config);
+
+static uint32_t stm32_dma_check_events(STM32DMAState *state, int n,
+        const STM32DMAConfig *config, uint32_t prev_remaining);
+
+static void stm32_dma_set_flags(STM32DMAState *state, int n,
+        const STM32DMAConfig *config, uint32_t flags);
+
+static void stm32_dma_disable(STM32DMAState *state, int n);
+
+// Return the requester of the channel with the given request line and
+// peripheral state, added on first use.
+static STM32DMARequester *stm32_dma_get_requester(STM32DMAChannel *ch,
+        int request, void *opaque)
+{
+    int i;
+    for (i = 0; i < ch->num_requesters; ++i) {
+        if (ch->requester[i].request == request
+                && ch->requester[i].opaque == opaque) {
+            return &ch->requester[i];
+        }
+    }
+
+    assert(ch->num_requesters < STM32_DMA_MAX_REQUESTERS);
+    STM32DMARequester *req = &ch->requester[ch->num_requesters++];
+    req->opaque = opaque;
+    req->request = request;
+    req->level = false;
+    req->handler = NULL;
+    return req;
+}
+
+// Called by the peripherals to set the level of their request;
+// `channel` is the channel (F0/F1) or the stream (F4), numbered
+// from 0, `request` is the CHSEL value on F4, 0 otherwise, and
+// `opaque` the peripheral state. On F0/F1 several peripherals share
+// the request line of a channel, which is active while any of them
+// is active.
+//
+// While the request is active and the channel is enabled, items
+// are transferred one by one; a request raised during a transfer
+// is served after it.
+void stm32_dma_set_request(Object *obj, int channel, int request,
+        void *opaque, bool level)
+{
+    STM32DMAState *state = STM32_DMA_STATE(obj);
+
+    peripheral_materialize(obj);
+
+    if (channel >= state->num_channels) {
+        return;
+    }
+
+    assert(request < STM32_DMA_MAX_REQUESTS);
+
+    STM32DMAChannel *ch = &state->ch[channel];
+    stm32_dma_get_requester(ch, request, opaque)->level = level;
+
+    bool line = false;
+    int i;
+    for (i = 0; i < ch->num_requesters; ++i) {
+        if (ch->requester[i].request == request && ch->requester[i].level) {
+            line = true;
+        }
+    }
+
+    if (line) {
+        ch->requests |= (1 << request);
+    } else {
+        ch->requests &= ~(1 << request);
+    }
+
+    if (level) {
+        if (state->is_busy) {
+            qemu_bh_schedule(state->bh);
+        } else {
+            stm32_dma_run(state, channel);
+        }
+    }
+}
+
+// Register the peripheral function that moves the data when its
+// request is active, with stm32_dma_transfer_block(); null to return
+// to the item by item transfers. `opaque` is the peripheral state,
+// the same passed to stm32_dma_set_request().
+void stm32_dma_set_bulk_handler(Object *obj, int channel, int request,
+        stm32_dma_bulk_handler_t handler, void *opaque)
+{
+    STM32DMAState *state = STM32_DMA_STATE(obj);
+
+    assert(channel < STM32_DMA_MAX_CHANNELS);
+    assert(request < STM32_DMA_MAX_REQUESTS);
+
+    stm32_dma_get_requester(&state->ch[channel], request, opaque)->handler =
+            handler;
+}
+
+// Return the number of items the channel still has to transfer for
+// the peripheral request, in the given direction; 0 if the channel
+// is not enabled, or configured for something else.
+uint32_t stm32_dma_get_pending(Object *obj, int channel, int request,
+        bool to_memory)
+{
+    STM32DMAState *state = STM32_DMA_STATE(obj);
+
+    peripheral_materialize(obj);
+
+    if (channel >= state->num_channels) {
+        return 0;
+    }
+
+    STM32DMAConfig config;
+    stm32_dma_get_config(state, channel, &config);
+    if (!config.is_enabled || config.is_mem2mem
+            || config.from_memory == to_memory
+            || config.request != request) {
+        return 0;
+    }
+
+    return state->ch[channel].remaining;
+}
+
+// Move up to `count` items between the channel memory and the
+// peripheral buffer, with `size` bytes per item (little endian);
+// the items are truncated or zero extended to the memory size.
+// Return the number of items moved; the channel counters, flags and
+// interrupts are updated as if the items were moved one by one.
+uint32_t stm32_dma_transfer_block(Object *obj, int channel, void *data,
+        unsigned size, uint32_t count, bool to_memory)
+{
+    STM32DMAState *state = STM32_DMA_STATE(obj);
+    STM32DMAChannel *ch = &state->ch[channel];
+    STM32DMAConfig config;
+
+    assert(size <= 4);
+
+    stm32_dma_get_config(state, channel, &config);
+    if (!config.is_enabled || config.is_mem2mem
+            || config.from_memory == to_memory || state->is_busy) {
+        return 0;
+    }
+
+    count = MIN(count, ch->remaining);
+    if (count == 0) {
+        return 0;
+    }
+
+    state->is_busy = true;
+
+    uint8_t *p = (uint8_t *) data;
+    MemTxResult res = MEMTX_OK;
+    if (config.minc && config.msize == size) {
+        // A single access, RAM is copied with memcpy().
+        res = address_space_rw(&address_space_memory, ch->cur_mar,
+                MEMTXATTRS_UNSPECIFIED, p, count * size, to_memory);
+        ch->cur_mar += count * size;
+    } else {
+        uint32_t i;
+        for (i = 0; i < count && res == MEMTX_OK; ++i, p += size) {
+            uint8_t buf[4] = { 0, 0, 0, 0 };
+            if (to_memory) {
+                memcpy(buf, p, size);
+            }
+            res = address_space_rw(&address_space_memory, ch->cur_mar,
+                    MEMTXATTRS_UNSPECIFIED, buf, config.msize, to_memory);
+            if (!to_memory) {
+                memcpy(p, buf, size);
+            }
+            ch->cur_mar += config.minc ? config.msize : 0;
+        }
+    }
+
+    uint32_t flags = 0;
+    if (res != MEMTX_OK) {
+        qemu_log_mask(LOG_GUEST_ERROR,
+                "DMA%d: transfer error on channel %d at 0x%08X\n",
+                1 + state->dma_index - STM32_DMA_1, channel, ch->cur_mar);
+        flags |= DMA_FLAG_TE;
+        stm32_dma_disable(state, channel);
+    } else {
+        uint32_t prev_remaining = ch->remaining;
+        ch->remaining -= count;
+        flags |= stm32_dma_check_events(state, channel, &config,
+                prev_remaining);
+    }
+
+    peripheral_register_set_raw_value(ch->ndtr, ch->remaining);
+
+    state->is_busy = false;
+
+    stm32_dma_set_flags(state, channel, &config, flags);
+
+    return (res == MEMTX_OK) ? count : 0;
+}
+
+// ----- Private --------------------------------------------------------------
+
+static bool stm32_dma_is_enabled(Object *obj)
+{
+    STM32DMAState *state = STM32_DMA_STATE(obj);
+
+    if (register_bitfield_is_non_zero(state->enabling_bit)) {
+        return true; // Positive logic, bit == 1 means enabled.
+    }
+
+    // Not enabled
+    return false;
+}
+
+static void stm32_dma_get_config(STM32DMAState *state, int n,
+        STM32DMAConfig *config)
+{
+    uint32_t cr = peripheral_register_get_raw_value(state->ch[n].cr);
+
+    memset(config, 0, sizeof(*config));
+
+    if (state->is_stream) {
+        unsigned dir = (cr >> DMA_SCR_DIR_SHIFT) & 0x3;
+
+        config->is_enabled = (cr & DMA_SCR_EN) != 0;
+        config->is_mem2mem = (dir == 2);
+        // Memory to memory copies from PAR to M0AR.
+        config->from_memory = (dir == 1);
+        config->is_circular = (cr & DMA_SCR_CIRC) != 0;
+        config->pinc = (cr & DMA_SCR_PINC) != 0;
+        config->minc = (cr & DMA_SCR_MINC) != 0;
+        config->psize = 1 << ((cr >> DMA_SCR_PSIZE_SHIFT) & 0x3);
+        config->msize = 1 << ((cr >> DMA_SCR_MSIZE_SHIFT) & 0x3);
+        config->request = (cr >> DMA_SCR_CHSEL_SHIFT) & 0x7;
+
+        config->interrupts |= (cr & DMA_SCR_TCIE) ? DMA_FLAG_TC : 0;
+        config->interrupts |= (cr & DMA_SCR_HTIE) ? DMA_FLAG_HT : 0;
+        config->interrupts |= (cr & DMA_SCR_TEIE) ? DMA_FLAG_TE : 0;
+    } else {
+        config->is_enabled = (cr & DMA_CCR_EN) != 0;
+        config->is_mem2mem = (cr & DMA_CCR_MEM2MEM) != 0;
+        config->from_memory = (cr & DMA_CCR_DIR) != 0;
+        config->is_circular = (cr & DMA_CCR_CIRC) != 0;
+        config->pinc = (cr & DMA_CCR_PINC) != 0;
+        config->minc = (cr & DMA_CCR_MINC) != 0;
+        config->psize = 1 << ((cr >> DMA_CCR_PSIZE_SHIFT) & 0x3);
+        config->msize = 1 << ((cr >> DMA_CCR_MSIZE_SHIFT) & 0x3);
+        config->request = 0;
+
+        config->interrupts |= (cr & DMA_CCR_TCIE) ? DMA_FLAG_TC : 0;
+        config->interrupts |= (cr & DMA_CCR_HTIE) ? DMA_FLAG_HT : 0;
+        config->interrupts |= (cr & DMA_CCR_TEIE) ? DMA_FLAG_TE : 0;
+    }
+
+    // 0b11 is reserved.
+    config->psize = MIN(config->psize, 4);
+    config->msize = MIN(config->msize, 4);
+}
+
+// Set the channel flags in ISR and raise the interrupt, if enabled.
+static void stm32_dma_set_flags(STM32DMAState *state, int n,
+        const STM32DMAConfig *config, uint32_t flags)
+{
+    if (flags == 0) {
+        return;
+    }
+
+    if (state->is_stream) {
+        // Flags offsets in LISR/HISR, for streams 0-3 and 4-7.
+        static const int offsets[4] = { 0, 6, 16, 22 };
+
+        uint32_t bits = ((flags & DMA_FLAG_TC) ? (1 << 5) : 0)
+                | ((flags & DMA_FLAG_HT) ? (1 << 4) : 0)
+                | ((flags & DMA_FLAG_TE) ? (1 << 3) : 0);
+        peripheral_register_or_raw_value(state->isr[n / 4],
+                bits << offsets[n % 4]);
+    } else {
+        // GIF, TCIF, HTIF, TEIF for each channel.
+        uint32_t bits = 1 | ((flags & DMA_FLAG_TC) ? (1 << 1) : 0)
+                | ((flags & DMA_FLAG_HT) ? (1 << 2) : 0)
+                | ((flags & DMA_FLAG_TE) ? (1 << 3) : 0);
+        peripheral_register_or_raw_value(state->isr[0], bits << (4 * n));
+    }
+
+    if ((flags & config->interrupts) && state->ch[n].irq >= 0) {
+        cortexm_nvic_set_pending_interrupt(state->nvic, state->ch[n].irq);
+    }
+}
+
+// Check if the range is entirely in a RAM region, writable if needed.
+static bool stm32_dma_is_ram(hwaddr addr, hwaddr len, bool is_write)
+{
+    MemoryRegionSection section = memory_region_find(get_system_memory(),
+            addr, len);
+    if (section.mr == NULL) {
+        return false;
+    }
+
+    bool ret = memory_region_is_ram(section.mr)
+            && int128_get64(section.size) == len
+            && !(is_write && section.readonly);
+
+    memory_region_unref(section.mr);
+    return ret;
+}
+
+// Copy a block between two RAM areas, directly between the host
+// buffers. Return false if not possible, to be done item by item.
+static bool stm32_dma_copy_block(hwaddr src, hwaddr dst, hwaddr len)
+{
+    if (!stm32_dma_is_ram(src, len, false) || !stm32_dma_is_ram(dst, len, true)) {
+        return false;
+    }
+
+    hwaddr src_len = len;
+    hwaddr dst_len = len;
+    void *src_ptr = address_space_map(&address_space_memory, src, &src_len,
+            false);
+    void *dst_ptr = address_space_map(&address_space_memory, dst, &dst_len,
+            true);
+
+    bool ok = (src_ptr != NULL && dst_ptr != NULL && src_len == len
+            && dst_len == len);
+    if (ok) {
+        memmove(dst_ptr, src_ptr, len);
+    }
+
+    // Unmapping the destination marks the pages dirty and invalidates
+    // the translated code in them.
+    if (dst_ptr != NULL) {
+        address_space_unmap(&address_space_memory, dst_ptr, dst_len, true,
+                ok ? len : 0);
+    }
+    if (src_ptr != NULL) {
+        address_space_unmap(&address_space_memory, src_ptr, src_len, false,
+                ok ? len : 0);
+    }
+    return ok;
+}
+
+// Move one item, zero extended or truncated to the destination size
+// (little endian).
+static bool stm32_dma_copy_item(hwaddr src, unsigned src_size, hwaddr dst,
+        unsigned dst_size)
+{
+    uint8_t buf[4] = { 0, 0, 0, 0 };
+    MemTxResult res;
+
+    res = address_space_rw(&address_space_memory, src,
+            MEMTXATTRS_UNSPECIFIED, buf, src_size, false);
+    res |= address_space_rw(&address_space_memory, dst,
+            MEMTXATTRS_UNSPECIFIED, buf, dst_size, true);
+
+    return (res == MEMTX_OK);
+}
+
+// Stop the channel at the end of the transfer or on error.
+static void stm32_dma_disable(STM32DMAState *state, int n)
+{
+    peripheral_register_and_raw_value(state->ch[n].cr,
+            state->is_stream ? ~DMA_SCR_EN : ~DMA_CCR_EN);
+}
+
+// After items were moved, check the half and full transfer events;
+// at the end, restart the circular transfers or stop the F4 streams.
+static uint32_t stm32_dma_check_events(STM32DMAState *state, int n,
+        const STM32DMAConfig *config, uint32_t prev_remaining)
+{
+    STM32DMAChannel *ch = &state->ch[n];
+    uint32_t half = ch->total / 2;
+    uint32_t flags = 0;
+
+    if (prev_remaining > half && ch->remaining <= half) {
+        flags |= DMA_FLAG_HT;
+    }
+
+    if (ch->remaining == 0) {
+        flags |= DMA_FLAG_TC;
+        if (config->is_circular && !config->is_mem2mem) {
+            // Reload and continue later, to let the main loop run.
+            ch->remaining = ch->total;
+            ch->cur_par = peripheral_register_get_raw_value(ch->par);
+            ch->cur_mar = peripheral_register_get_raw_value(ch->mar);
+            qemu_bh_schedule(state->bh);
+        } else if (state->is_stream) {
+            // The F4 streams are disabled at the end; F0/F1
+            // channels remain enabled, with nothing to do.
+            stm32_dma_disable(state, n);
+        }
+    }
+
+    return flags;
+}
+
+// Transfer as much as possible on the channel: the whole block for
+// memory to memory, otherwise as long as the request is active.
+static void stm32_dma_run(STM32DMAState *state, int n)
+{
+    STM32DMAChannel *ch = &state->ch[n];
+    STM32DMAConfig config;
+
+    stm32_dma_get_config(state, n, &config);
+    if (!config.is_enabled || ch->remaining == 0 || state->is_busy) {
+        return;
+    }
+
+    // An active peripheral moves the data itself, in blocks; the other
+    // peripherals are served item by item.
+    if (!config.is_mem2mem) {
+        int i;
+        for (i = 0; i < ch->num_requesters; ++i) {
+            STM32DMARequester *req = &ch->requester[i];
+            if (req->request == config.request && req->level
+                    && req->handler != NULL) {
+                req->handler(req->opaque);
+                return;
+            }
+        }
+    }
+
+    if (state->is_stream
+            && (peripheral_register_get_raw_value(ch->cr) & DMA_SCR_DBM)) {
+        qemu_log_mask(LOG_UNIMP, "DMA%d: double buffer mode not implemented.\n",
+                1 + state->dma_index - STM32_DMA_1);
+    }
+
+    state->is_busy = true;
+
+    unsigned src_size = config.from_memory ? config.msize : config.psize;
+    unsigned dst_size = config.from_memory ? config.psize : config.msize;
+    bool src_inc = config.from_memory ? config.minc : config.pinc;
+    bool dst_inc = config.from_memory ? config.pinc : config.minc;
+    uint32_t *src = config.from_memory ? &ch->cur_mar : &ch->cur_par;
+    uint32_t *dst = config.from_memory ? &ch->cur_par : &ch->cur_mar;
+
+    uint32_t flags = 0;
+
+    while (ch->remaining > 0) {
+
+        if (!config.is_mem2mem && !(ch->requests & (1 << config.request))) {
+            break;
+        }
+
+        uint32_t prev_remaining = ch->remaining;
+
+        // Memory to memory, the whole block at once.
+        if (config.is_mem2mem && src_inc && dst_inc && src_size == dst_size
+                && stm32_dma_copy_block(*src, *dst,
+                        (hwaddr) ch->remaining * src_size)) {
+            *src += ch->remaining * src_size;
+            *dst += ch->remaining * dst_size;
+            ch->remaining = 0;
+        } else {
+            if (!stm32_dma_copy_item(*src, src_size, *dst, dst_size)) {
+                qemu_log_mask(LOG_GUEST_ERROR,
+                        "DMA%d: transfer error on channel %d at 0x%08X->0x%08X\n",
+                        1 + state->dma_index - STM32_DMA_1, n, *src, *dst);
+                flags |= DMA_FLAG_TE;
+                stm32_dma_disable(state, n);
+                break;
+            }
+            *src += src_inc ? src_size : 0;
+            *dst += dst_inc ? dst_size : 0;
+            ch->remaining--;
+        }
+
+        uint32_t events = stm32_dma_check_events(state, n, &config,
+                prev_remaining);
+        flags |= events;
+        if ((events & DMA_FLAG_TC) && config.is_circular
+                && !config.is_mem2mem) {
+            break;
+        }
+    }
+
+    peripheral_register_set_raw_value(ch->ndtr, ch->remaining);
+
+    state->is_busy = false;
+
+    stm32_dma_set_flags(state, n, &config, flags);
+}
+
+// Serve the requests raised during other transfers and continue the
+// circular transfers.
+static void stm32_dma_bh_callback(void *opaque)
+{
+    STM32DMAState *state = (STM32DMAState *) opaque;
+
+    int n;
+    for (n = 0; n < state->num_channels; ++n) {
+        if (state->ch[n].requests) {
+            stm32_dma_run(state, n);
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+static void stm32_dma_cr_post_write_callback(Object *reg, Object *periph,
+        uint32_t addr, uint32_t offset, unsigned size,
+        peripheral_register_t value, peripheral_register_t full_value)
+{
+    STM32DMAState *state = STM32_DMA_STATE(periph);
+
+    int n;
+    for (n = 0; n < state->num_channels; ++n) {
+        if (state->ch[n].cr == reg) {
+            break;
+        }
+    }
+    assert(n < state->num_channels);
+
+    STM32DMAChannel *ch = &state->ch[n];
+    uint32_t en = state->is_stream ? DMA_SCR_EN : DMA_CCR_EN;
+    peripheral_register_t prev_value = peripheral_register_get_raw_prev_value(
+            reg);
+
+    if ((full_value & en) && !(prev_value & en)) {
+        // Enabled, load the internal pointers and the count.
+        ch->cur_par = peripheral_register_get_raw_value(ch->par);
+        ch->cur_mar = peripheral_register_get_raw_value(ch->mar);
+        ch->total = peripheral_register_get_raw_value(ch->ndtr) & 0xFFFF;
+        ch->remaining = ch->total;
+
+        stm32_dma_run(state, n);
+    }
+}
+
+// Writing 1 clears the corresponding ISR flags.
+static void stm32_dma_ifcr_post_write_callback(Object *reg, Object *periph,
+        uint32_t addr, uint32_t offset, unsigned size,
+        peripheral_register_t value, peripheral_register_t full_value)
+{
+    STM32DMAState *state = STM32_DMA_STATE(periph);
+
+    Object *isr = (reg == state->ifcr[1]) ? state->isr[1] : state->isr[0];
+    uint32_t clear = full_value;
+
+    if (!state->is_stream) {
+        // CGIFx clears all flags of the channel.
+        int n;
+        for (n = 0; n < state->num_channels; ++n) {
+            if (full_value & (1 << (4 * n))) {
+                clear |= 0xF << (4 * n);
+            }
+        }
+    }
+
+    uint32_t isr_value = peripheral_register_get_raw_value(isr) & ~clear;
+
+    if (!state->is_stream) {
+        // GIFx remains set only with other flags.
+        int n;
+        for (n = 0; n < state->num_channels; ++n) {
+            if ((isr_value & (0xE << (4 * n))) == 0) {
+                isr_value &= ~(1 << (4 * n));
+            }
+        }
+    }
+
+    peripheral_register_set_raw_value(isr, isr_value);
+    peripheral_register_set_raw_value(reg, 0);
+}
+
+// ----------------------------------------------------------------------------
+
+static void stm32_dma_instance_init_callback(Object *obj)
+{
+    qemu_log_function_name();
+
+    STM32DMAState *state = STM32_DMA_STATE(obj);
+
+    cm_object_property_add_int(obj, "dma-index",
+            (const int *) &state->dma_index);
+    state->dma_index = STM32_DMA_UNDEFINED;
+}
+
+// Set the interrupt numbers, one per channel, some shared.
+static void stm32_dma_set_irq_vectors(STM32DMAState *state)
+{
+    const STM32Capabilities *capabilities = state->capabilities;
+    bool is_dma2 = (state->dma_index == STM32_DMA_2);
+
+    int n;
+    for (n = 0; n < STM32_DMA_MAX_CHANNELS; ++n) {
+        int irq = -1;
+
+        switch (capabilities->family) {
+        case STM32_FAMILY_F0:
+            if (!is_dma2) {
+                if (n == 0) {
+                    irq = STM32F072XX_DMA1_Channel1_IRQn;
+                } else if (n <= 2) {
+                    irq = STM32F072XX_DMA1_Channel2_3_IRQn;
+                } else {
+                    irq = STM32F072XX_DMA1_Channel4_5_6_7_IRQn;
+                }
+            }
+            break;
+
+        case STM32_FAMILY_F1:
+            if (!is_dma2) {
+                irq = STM32F10X_CL_DMA1_Channel1_IRQn + n;
+            } else if (capabilities->f1.is_103xx && n >= 3) {
+                // Channels 4 and 5 share the interrupt.
+                irq = STM32F10X_CL_DMA2_Channel4_IRQn;
+            } else {
+                irq = STM32F10X_CL_DMA2_Channel1_IRQn + n;
+            }
+            break;
+
+        case STM32_FAMILY_F4:
+            if (!is_dma2) {
+                irq = (n < 7) ?
+                        STM32F4_01_57_XX_DMA1_Stream0_IRQn + n :
+                        STM32F4_01_57_XX_DMA1_Stream7_IRQn;
+            } else {
+                irq = (n < 5) ?
+                        STM32F4_01_57_XX_DMA2_Stream0_IRQn + n :
+                        STM32F4_01_57_XX_DMA2_Stream5_IRQn + (n - 5);
+            }
+            break;
+
+        default:
+            break;
+        }
+
+        state->ch[n].irq = irq;
+    }
+}
+
+// Create the registers and bitfields; called at realize, or on first
+// access for lazy peripherals.
+static void stm32_dma_create_registers(Object *obj)
+{
+    STM32MCUState *mcu = stm32_mcu_get();
+    CortexMState *cm_state = CORTEXM_MCU_STATE(mcu);
+
+    STM32DMAState *state = STM32_DMA_STATE(obj);
+
+    char periph_name[10];
+    snprintf(periph_name, sizeof(periph_name) - 1, "DMA%d",
+            1 + state->dma_index - STM32_DMA_1);
+
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(
+            cm_state->svd_device, periph_name);
+    svd_add_peripheral_properties_and_children(obj, periph,
+            cm_state->svd_device);
+
+    // The register names are the same in all devices of a family;
+    // the number of channels differs.
+    if (state->is_stream) {
+        state->isr[0] = cm_object_get_child_by_name(obj, "LISR");
+        state->isr[1] = cm_object_get_child_by_name(obj, "HISR");
+        state->ifcr[0] = cm_object_get_child_by_name(obj, "LIFCR");
+        state->ifcr[1] = cm_object_get_child_by_name(obj, "HIFCR");
+    } else {
+        state->isr[0] = cm_object_get_child_by_name(obj, "ISR");
+        state->ifcr[0] = cm_object_get_child_by_name(obj, "IFCR");
+    }
+
+    state->num_channels = 0;
+    int n;
+    for (n = 0; n < STM32_DMA_MAX_CHANNELS; ++n) {
+        STM32DMAChannel *ch = &state->ch[n];
+        char reg_name[10];
+
+        if (state->is_stream) {
+            snprintf(reg_name, sizeof(reg_name) - 1, "S%dCR", n);
+        } else {
+            snprintf(reg_name, sizeof(reg_name) - 1, "CCR%d", n + 1);
+        }
+        ch->cr = object_resolve_path_component(obj, reg_name);
+        if (ch->cr == NULL) {
+            break;
+        }
+
+        if (state->is_stream) {
+            snprintf(reg_name, sizeof(reg_name) - 1, "S%dNDTR", n);
+            ch->ndtr = cm_object_get_child_by_name(obj, reg_name);
+            snprintf(reg_name, sizeof(reg_name) - 1, "S%dPAR", n);
+            ch->par = cm_object_get_child_by_name(obj, reg_name);
+            snprintf(reg_name, sizeof(reg_name) - 1, "S%dM0AR", n);
+            ch->mar = cm_object_get_child_by_name(obj, reg_name);
+            snprintf(reg_name, sizeof(reg_name) - 1, "S%dM1AR", n);
+            ch->m1ar = cm_object_get_child_by_name(obj, reg_name);
+        } else {
+            snprintf(reg_name, sizeof(reg_name) - 1, "CNDTR%d", n + 1);
+            ch->ndtr = cm_object_get_child_by_name(obj, reg_name);
+            snprintf(reg_name, sizeof(reg_name) - 1, "CPAR%d", n + 1);
+            ch->par = cm_object_get_child_by_name(obj, reg_name);
+            snprintf(reg_name, sizeof(reg_name) - 1, "CMAR%d", n + 1);
+            ch->mar = cm_object_get_child_by_name(obj, reg_name);
+            ch->m1ar = NULL;
+        }
+
+        peripheral_register_set_post_write(ch->cr,
+                &stm32_dma_cr_post_write_callback);
+
+        state->num_channels = n + 1;
+    }
+
+    // The number of channels may be limited by capabilities.
+    const STM32Capabilities *capabilities = state->capabilities;
+    int max_channels = (state->dma_index == STM32_DMA_1) ?
+            capabilities->num_dma1 : capabilities->num_dma2;
+    if (capabilities->family == STM32_FAMILY_F0) {
+        max_channels = capabilities->num_dma;
+    }
+    if (max_channels > 0 && max_channels < state->num_channels) {
+        state->num_channels = max_channels;
+    }
+
+    peripheral_register_set_post_write(state->ifcr[0],
+            &stm32_dma_ifcr_post_write_callback);
+    if (state->ifcr[1] != NULL) {
+        peripheral_register_set_post_write(state->ifcr[1],
+                &stm32_dma_ifcr_post_write_callback);
+    }
+
+    peripheral_prepare_registers(obj);
+}
+
+static void stm32_dma_realize_callback(DeviceState *dev, Error **errp)
+{
+    qemu_log_function_name();
+
+    // Call parent realize().
+    if (!cm_device_parent_realize(dev, errp, TYPE_STM32_DMA)) {
+        return;
+    }
+
+    STM32MCUState *mcu = stm32_mcu_get();
+    CortexMState *cm_state = CORTEXM_MCU_STATE(mcu);
+
+    STM32DMAState *state = STM32_DMA_STATE(dev);
+    // First thing first: get capabilities from MCU, needed everywhere.
+    state->capabilities = mcu->capabilities;
+
+    const STM32Capabilities *capabilities = state->capabilities;
+    assert(capabilities != NULL);
+
+    Object *obj = OBJECT(dev);
+
+    state->nvic = CORTEXM_NVIC_STATE(cm_state->nvic);
+    state->is_stream = (capabilities->family == STM32_FAMILY_F4);
+    stm32_dma_set_irq_vectors(state);
+
+    char periph_name[10];
+    snprintf(periph_name, sizeof(periph_name) - 1, "DMA%d",
+            1 + state->dma_index - STM32_DMA_1);
+
+    svd_set_peripheral_address_block(cm_state->svd_device, periph_name, obj);
+    peripheral_create_memory_region(obj);
+
+    char enabling_bit_name[STM32_RCC_SIZEOF_ENABLING_BITFIELD];
+    snprintf(enabling_bit_name, sizeof(enabling_bit_name) - 1,
+            DEVICE_PATH_STM32_RCC "/%s/DMA%dEN",
+            (capabilities->family == STM32_FAMILY_F4) ? "AHB1ENR" : "AHBENR",
+            1 + state->dma_index - STM32_DMA_1);
+
+    state->enabling_bit = OBJECT(cm_device_by_name(enabling_bit_name));
+
+    state->bh = qemu_bh_new(stm32_dma_bh_callback, state);
+
+    peripheral_populate_registers(obj, stm32_dma_create_registers,
+            mcu->lazy_peripherals);
+}
+
+static void stm32_dma_reset_callback(DeviceState *dev)
+{
+    qemu_log_function_name();
+
+    STM32DMAState *state = STM32_DMA_STATE(dev);
+
+    // Call parent reset().
+    cm_device_parent_reset(dev, TYPE_STM32_DMA);
+
+    int n;
+    for (n = 0; n < STM32_DMA_MAX_CHANNELS; ++n) {
+        STM32DMAChannel *ch = &state->ch[n];
+
+        // The request lines belong to the peripherals.
+        ch->cur_par = 0;
+        ch->cur_mar = 0;
+        ch->total = 0;
+        ch->remaining = 0;
+    }
+    state->is_busy = false;
+}
+
+static void stm32_dma_class_init_callback(ObjectClass *klass, void *data)
+{
+    DeviceClass *dc = DEVICE_CLASS(klass);
+
+    dc->reset = stm32_dma_reset_callback;
+    dc->realize = stm32_dma_realize_callback;
+
+    PeripheralClass *per_class = PERIPHERAL_CLASS(klass);
+    per_class->is_enabled = stm32_dma_is_enabled;
+}
+
+static const TypeInfo stm32_dma_type_info = {
+    .name = TYPE_STM32_DMA,
+    .parent = TYPE_STM32_DMA_PARENT,
+    .instance_init = stm32_dma_instance_init_callback,
+    .instance_size = sizeof(STM32DMAState),
+    .class_init = stm32_dma_class_init_callback,
+    .class_size = sizeof(STM32DMAClass)
+/**/
+};
+
+static void stm32_dma_register_types(void)
+{
+    type_register_static(&stm32_dma_type_info);
+}
+
+type_init(stm32_dma_register_types);
+
+// ----------------------------------------------------------------------------
@@ -34,12 +34,12 @@
 //
 // STM32F051R8
 // DO NOT EDIT! Automatically generated!
-static void stm32f0x1_exti_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f0x1_exti_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32EXTIState *state = STM32_EXTI_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -331,12 +331,12 @@ static void stm32f0x1_exti_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F072CB
 // DO NOT EDIT! Automatically generated!
-static void stm32f0x2_exti_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f0x2_exti_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32EXTIState *state = STM32_EXTI_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -622,12 +622,12 @@ static void stm32f0x2_exti_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F103RB
 // DO NOT EDIT! Automatically generated!
-static void stm32f103xx_exti_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f103xx_exti_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32EXTIState *state = STM32_EXTI_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -883,12 +883,12 @@ static void stm32f103xx_exti_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F107VC
 // DO NOT EDIT! Automatically generated!
-static void stm32f107xx_exti_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f107xx_exti_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32EXTIState *state = STM32_EXTI_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -1156,12 +1156,12 @@ static void stm32f107xx_exti_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F407VG, STM32F407ZG, STM32F405RG
 // DO NOT EDIT! Automatically generated!
-static void stm32f40x_exti_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f40x_exti_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32EXTIState *state = STM32_EXTI_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -1465,12 +1465,12 @@ static void stm32f40x_exti_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F411RE
 // DO NOT EDIT! Automatically generated!
-static void stm32f411xx_exti_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f411xx_exti_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32EXTIState *state = STM32_EXTI_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -1774,12 +1774,12 @@ static void stm32f411xx_exti_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F429ZI
 // DO NOT EDIT! Automatically generated!
-static void stm32f429x_exti_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f429x_exti_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32EXTIState *state = STM32_EXTI_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -2079,6 +2079,29 @@ static void stm32f429x_exti_create_objects(Object *obj, JSON_Object *svd,
             "PR22");
 }
 
+// ----- Public ---------------------------------------------------------------
+
+// Convert the four EXTICR registers, common to AFIO and SYSCFG, into
+// one mask per GPIO port, with the pins routed to EXTI, so GPIO can
+// filter the changed pins with a single AND.
+
+void stm32_exti_compute_port_masks(Object *exticr[4], uint16_t *port_mask)
+{
+    int i;
+    for (i = 0; i < STM32_MAX_GPIO; ++i) {
+        port_mask[i] = 0;
+    }
+
+    int pin;
+    for (pin = 0; pin < 16; ++pin) {
+        uint32_t value = peripheral_register_get_raw_value(exticr[pin / 4]);
+        uint32_t port = (value >> ((pin % 4) * 4)) & 0xF;
+        if (port < STM32_MAX_GPIO) {
+            port_mask[port] |= (1 << pin);
+        }
+    }
+}
+
 // ----- Private --------------------------------------------------------------
 
 // Called for each pin changed in the board (like buttons)
@@ -2239,7 +2262,7 @@ static void stm32_exti_realize_callback(DeviceState *dev, Error **errp)
     Object *obj = OBJECT(dev);
 
     const char *periph_name = "EXTI";
-    svd_set_peripheral_address_block(cm_state->svd_json, periph_name, obj);
+    svd_set_peripheral_address_block(cm_state->svd_device, periph_name, obj);
     peripheral_create_memory_region(obj);
 
     assert(
@@ -2251,11 +2274,11 @@ static void stm32_exti_realize_callback(DeviceState *dev, Error **errp)
 
         if (capabilities->f0.is_0x1) {
 
-            stm32f0x1_exti_create_objects(obj, cm_state->svd_json, periph_name);
+            stm32f0x1_exti_create_objects(obj, cm_state->svd_device, periph_name);
 
         } else if (capabilities->f0.is_0x2) {
 
-            stm32f0x2_exti_create_objects(obj, cm_state->svd_json, periph_name);
+            stm32f0x2_exti_create_objects(obj, cm_state->svd_device, periph_name);
 
         } else {
             assert(false);
@@ -2274,12 +2297,12 @@ static void stm32_exti_realize_callback(DeviceState *dev, Error **errp)
 
         if (capabilities->f1.is_103xx) {
 
-            stm32f103xx_exti_create_objects(obj, cm_state->svd_json,
+            stm32f103xx_exti_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
         } else if (capabilities->f1.is_107xx) {
 
-            stm32f107xx_exti_create_objects(obj, cm_state->svd_json,
+            stm32f107xx_exti_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
         } else {
@@ -2299,16 +2322,16 @@ static void stm32_exti_realize_callback(DeviceState *dev, Error **errp)
 
         if (capabilities->f4.is_40x) {
 
-            stm32f40x_exti_create_objects(obj, cm_state->svd_json, periph_name);
+            stm32f40x_exti_create_objects(obj, cm_state->svd_device, periph_name);
 
         } else if (capabilities->f4.is_411xx) {
 
-            stm32f411xx_exti_create_objects(obj, cm_state->svd_json,
+            stm32f411xx_exti_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
         } else if (capabilities->f4.is_429x) {
 
-            stm32f429x_exti_create_objects(obj, cm_state->svd_json,
+            stm32f429x_exti_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
         } else {
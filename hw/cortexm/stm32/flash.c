@@ -22,23 +22,79 @@
 #include <hw/cortexm/helper.h>
 #include <hw/cortexm/svd.h>
 
+#include "exec/address-spaces.h"
+
 /*
  * This file implements the STM32 flash control.
  *
- * The initial implementation is intended only to pass CMSIS initialisations.
- * The written values can be read back, but no other actions are supported.
+ * The flash memory itself is a ROM device created by the Cortex-M MCU;
+ * reads are served directly from the host memory, and writes are passed
+ * here, to be programmed only while CR.PG is set. Page/sector and mass
+ * erase are done on CR.STRT. All operations complete immediately.
+ *
+ * With "-machine flash-image=<file>", the flash content is mapped from
+ * a file, so programmed data persists across runs.
+ *
+ * The ACR wait states, prefetch and cache settings are passed to the
+ * core, to be used by the cycle model (-cycle-model).
+ *
+ * TODO:
+ * - implement the option bytes and the write protection
  */
 
+#define FLASH_KEY1              (0x45670123)
+#define FLASH_KEY2              (0xCDEF89AB)
+
+// F0/F1 ACR
+#define FLASH_F1_ACR_LATENCY    (0x7)
+#define FLASH_F1_ACR_PRFTBE     (1 << 4)
+// The prefetch buffer is 2 x 64-bit.
+#define FLASH_F1_LINE_SIZE      (8)
+
+// F4 ACR
+#define FLASH_F4_ACR_LATENCY    (0xF)
+#define FLASH_F4_ACR_PRFTEN     (1 << 8)
+#define FLASH_F4_ACR_ICEN       (1 << 9)
+// The ART accelerator reads 128-bit lines.
+#define FLASH_F4_LINE_SIZE      (16)
+
+// F0/F1 SR & CR
+#define FLASH_F1_SR_PGERR       (1 << 2)
+#define FLASH_F1_SR_WRPRTERR    (1 << 4)
+#define FLASH_F1_SR_EOP         (1 << 5)
+
+#define FLASH_F1_CR_PG          (1 << 0)
+#define FLASH_F1_CR_PER         (1 << 1)
+#define FLASH_F1_CR_MER         (1 << 2)
+#define FLASH_F1_CR_STRT        (1 << 6)
+#define FLASH_F1_CR_LOCK        (1 << 7)
+#define FLASH_F1_CR_EOPIE       (1 << 12)
+
+// F4 SR & CR
+#define FLASH_F4_SR_EOP         (1 << 0)
+#define FLASH_F4_SR_W1C         (0xF3)
+
+#define FLASH_F4_CR_PG          (1 << 0)
+#define FLASH_F4_CR_SER         (1 << 1)
+#define FLASH_F4_CR_MER         (1 << 2)
+#define FLASH_F4_CR_SNB_SHIFT   (3)
+#define FLASH_F4_CR_MER1        (1 << 15)
+#define FLASH_F4_CR_STRT        (1 << 16)
+#define FLASH_F4_CR_EOPIE       (1 << 24)
+#define FLASH_F4_CR_LOCK        (1 << 31)
+
+#define FLASH_BASE_ADDRESS      (0x08000000)
+
 // ----- Generated code -------------------------------------------------------
 //
 // STM32F051R8
 // DO NOT EDIT! Automatically generated!
-static void stm32f0x1_flash_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f0x1_flash_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32FLASHState *state = STM32_FLASH_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -136,12 +192,12 @@ static void stm32f0x1_flash_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F072CB
 // DO NOT EDIT! Automatically generated!
-static void stm32f0x2_flash_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f0x2_flash_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32FLASHState *state = STM32_FLASH_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -231,12 +287,12 @@ static void stm32f0x2_flash_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F103RB
 // DO NOT EDIT! Automatically generated!
-static void stm32f103xx_flash_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f103xx_flash_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32FLASHState *state = STM32_FLASH_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -328,12 +384,12 @@ static void stm32f103xx_flash_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F107VC
 // DO NOT EDIT! Automatically generated!
-static void stm32f107xx_flash_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f107xx_flash_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32FLASHState *state = STM32_FLASH_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -425,12 +481,12 @@ static void stm32f107xx_flash_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F407VG, STM32F407ZG, STM32F405RG
 // DO NOT EDIT! Automatically generated!
-static void stm32f40x_flash_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f40x_flash_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32FLASHState *state = STM32_FLASH_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -522,12 +578,12 @@ static void stm32f40x_flash_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F411RE
 // DO NOT EDIT! Automatically generated!
-static void stm32f411xx_flash_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f411xx_flash_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32FLASHState *state = STM32_FLASH_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -619,12 +675,12 @@ static void stm32f411xx_flash_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F429ZI
 // DO NOT EDIT! Automatically generated!
-static void stm32f429x_flash_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f429x_flash_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32FLASHState *state = STM32_FLASH_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -721,70 +777,335 @@ static void stm32f429x_flash_create_objects(Object *obj, JSON_Object *svd,
 
 // ----- Private --------------------------------------------------------------
 
-static void stm32_flash_instance_init_callback(Object *obj)
+static bool stm32_flash_is_f4(STM32FLASHState *state)
 {
-    qemu_log_function_name();
+    return state->capabilities->family == STM32_FAMILY_F4;
 }
 
-static void stm32_flash_realize_callback(DeviceState *dev, Error **errp)
+static uint32_t stm32_flash_get_size(void)
 {
-    qemu_log_function_name();
+    return CORTEXM_MCU_STATE(stm32_mcu_get())->flash_size_kb * 1024;
+}
 
-    // Call parent realize().
-    if (!cm_device_parent_realize(dev, errp, TYPE_STM32_FLASH)) {
+// Program the flash content; the flash is mapped at 0, writing
+// there invalidates the translated code too.
+static void stm32_flash_store(hwaddr offset, const uint8_t *buf, int len)
+{
+    cpu_physical_memory_write_rom(&address_space_memory, offset, buf, len);
+}
+
+static void stm32_flash_erase(hwaddr offset, uint32_t len)
+{
+    uint8_t buf[1024];
+    memset(buf, 0xFF, sizeof(buf));
+
+    uint32_t flash_size = stm32_flash_get_size();
+    if (offset >= flash_size) {
         return;
     }
+    len = MIN(len, flash_size - offset);
 
+    while (len > 0) {
+        uint32_t n = MIN(len, sizeof(buf));
+        stm32_flash_store(offset, buf, n);
+        offset += n;
+        len -= n;
+    }
+}
+
+// Set EOP and raise the interrupt, if enabled.
+static void stm32_flash_end_of_operation(STM32FLASHState *state)
+{
+    uint32_t cr = peripheral_register_get_raw_value(state->reg.cr);
+
+    if (stm32_flash_is_f4(state)) {
+        // On F4, EOP is set only if the interrupt is enabled.
+        if (cr & FLASH_F4_CR_EOPIE) {
+            peripheral_register_or_raw_value(state->reg.sr, FLASH_F4_SR_EOP);
+            cortexm_nvic_set_pending_interrupt(state->nvic, state->irq);
+        }
+    } else {
+        peripheral_register_or_raw_value(state->reg.sr, FLASH_F1_SR_EOP);
+        if (cr & FLASH_F1_CR_EOPIE) {
+            cortexm_nvic_set_pending_interrupt(state->nvic, state->irq);
+        }
+    }
+}
+
+// Return the page size of the F0/F1 devices.
+static uint32_t stm32_flash_get_page_size(STM32FLASHState *state)
+{
+    const STM32Capabilities *capabilities = state->capabilities;
+
+    if (capabilities->family == STM32_FAMILY_F0) {
+        return capabilities->f0.is_0x2 ? 2048 : 1024;
+    }
+    // High density and connectivity line devices have 2 KB pages.
+    if (capabilities->f1.is_107xx || stm32_flash_get_size() > 128 * 1024) {
+        return 2048;
+    }
+    return 1024;
+}
+
+// Return the offset and size of a F4 sector; sectors 12-23, in the
+// second bank of the 2 MB devices, are numbered from 16.
+static bool stm32_flash_get_sector(unsigned snb, hwaddr *offset,
+        uint32_t *size)
+{
+    hwaddr base = 0;
+    if (snb & 0x10) {
+        base = 0x100000;
+        snb &= 0xF;
+    }
+
+    if (snb < 4) {
+        *offset = base + snb * 0x4000;
+        *size = 0x4000;
+    } else if (snb == 4) {
+        *offset = base + 0x10000;
+        *size = 0x10000;
+    } else if (snb < 12) {
+        *offset = base + (snb - 4) * 0x20000;
+        *size = 0x20000;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Called by the Cortex-M MCU for writes to the flash area.
+static void stm32_flash_write_callback(void *opaque, hwaddr addr,
+        uint64_t value, unsigned size)
+{
+    STM32FLASHState *state = STM32_FLASH_STATE(opaque);
+
+    peripheral_materialize(OBJECT(state));
+
+    uint32_t cr = peripheral_register_get_raw_value(state->reg.cr);
+    bool is_f4 = stm32_flash_is_f4(state);
+
+    if (!(cr & (is_f4 ? FLASH_F4_CR_PG : FLASH_F1_CR_PG))) {
+        qemu_log_mask(LOG_GUEST_ERROR,
+                "FLASH: write at 0x%08"PRIX64" without PG, ignored.\n",
+                FLASH_BASE_ADDRESS + addr);
+        return;
+    }
+
+    uint8_t buf[8];
+    cpu_physical_memory_read(addr, buf, size);
+
+    if (is_f4) {
+        // Programming can only clear bits.
+        uint8_t new_buf[8];
+        stq_le_p(new_buf, value);
+        int i;
+        for (i = 0; i < size; ++i) {
+            buf[i] &= new_buf[i];
+        }
+    } else {
+        // Half-words only, and only over erased locations (or to 0).
+        if (size != 2 || (lduw_le_p(buf) != 0xFFFF && value != 0)) {
+            qemu_log_mask(LOG_GUEST_ERROR,
+                    "FLASH: programming error at 0x%08"PRIX64".\n",
+                    FLASH_BASE_ADDRESS + addr);
+            peripheral_register_or_raw_value(state->reg.sr, FLASH_F1_SR_PGERR);
+            return;
+        }
+        stw_le_p(buf, value);
+    }
+
+    stm32_flash_store(addr, buf, size);
+    stm32_flash_end_of_operation(state);
+}
+
+// ----------------------------------------------------------------------------
+
+// Pass the flash access timing to the core.
+static void stm32_flash_update_timing(STM32FLASHState *state)
+{
+    CortexMState *cm_state = CORTEXM_MCU_STATE(stm32_mcu_get());
+
+    if (cm_state->cpu == NULL || state->reg.acr == NULL) {
+        return;
+    }
+
+    uint32_t acr = peripheral_register_get_raw_value(state->reg.acr);
+    if (stm32_flash_is_f4(state)) {
+        arm_cpu_set_flash_timing(cm_state->cpu, FLASH_BASE_ADDRESS,
+                stm32_flash_get_size(), acr & FLASH_F4_ACR_LATENCY,
+                FLASH_F4_LINE_SIZE, (acr & FLASH_F4_ACR_PRFTEN) != 0,
+                (acr & FLASH_F4_ACR_ICEN) != 0);
+    } else {
+        arm_cpu_set_flash_timing(cm_state->cpu, FLASH_BASE_ADDRESS,
+                stm32_flash_get_size(), acr & FLASH_F1_ACR_LATENCY,
+                FLASH_F1_LINE_SIZE, (acr & FLASH_F1_ACR_PRFTBE) != 0, false);
+    }
+}
+
+static void stm32_flash_acr_post_write_callback(Object *reg, Object *periph,
+        uint32_t addr, uint32_t offset, unsigned size,
+        peripheral_register_t value, peripheral_register_t full_value)
+{
+    stm32_flash_update_timing(STM32_FLASH_STATE(periph));
+}
+
+// KEY1 followed by KEY2 unlocks CR.
+static void stm32_flash_keyr_post_write_callback(Object *reg, Object *periph,
+        uint32_t addr, uint32_t offset, unsigned size,
+        peripheral_register_t value, peripheral_register_t full_value)
+{
+    STM32FLASHState *state = STM32_FLASH_STATE(periph);
+
+    if (full_value == FLASH_KEY1) {
+        state->key_index = 1;
+    } else if (full_value == FLASH_KEY2 && state->key_index == 1) {
+        uint32_t lock = stm32_flash_is_f4(state) ?
+                FLASH_F4_CR_LOCK : FLASH_F1_CR_LOCK;
+        peripheral_register_and_raw_value(state->reg.cr, ~lock);
+        state->key_index = 0;
+    } else {
+        qemu_log_mask(LOG_GUEST_ERROR, "FLASH: wrong key 0x%08X.\n",
+                (uint32_t) full_value);
+        state->key_index = 0;
+    }
+}
+
+// The error and EOP flags are cleared by writing 1.
+static peripheral_register_t stm32_flash_sr_pre_write_callback(Object *reg,
+        Object *periph, uint32_t addr, uint32_t offset, unsigned size,
+        peripheral_register_t value, peripheral_register_t full_value)
+{
+    STM32FLASHState *state = STM32_FLASH_STATE(periph);
+
+    uint32_t w1c = stm32_flash_is_f4(state) ?
+            FLASH_F4_SR_W1C :
+            (FLASH_F1_SR_PGERR | FLASH_F1_SR_WRPRTERR | FLASH_F1_SR_EOP);
+
+    return peripheral_register_get_raw_value(reg) & ~(full_value & w1c);
+}
+
+// While locked, CR cannot be written.
+static peripheral_register_t stm32_flash_cr_pre_write_callback(Object *reg,
+        Object *periph, uint32_t addr, uint32_t offset, unsigned size,
+        peripheral_register_t value, peripheral_register_t full_value)
+{
+    STM32FLASHState *state = STM32_FLASH_STATE(periph);
+
+    peripheral_register_t prev_value = peripheral_register_get_raw_value(reg);
+    uint32_t lock = stm32_flash_is_f4(state) ?
+            FLASH_F4_CR_LOCK : FLASH_F1_CR_LOCK;
+
+    if (prev_value & lock) {
+        qemu_log_mask(LOG_GUEST_ERROR, "FLASH: CR is locked.\n");
+        return prev_value;
+    }
+    return full_value;
+}
+
+static void stm32_flash_cr_post_write_callback(Object *reg, Object *periph,
+        uint32_t addr, uint32_t offset, unsigned size,
+        peripheral_register_t value, peripheral_register_t full_value)
+{
+    STM32FLASHState *state = STM32_FLASH_STATE(periph);
+
+    uint32_t cr = peripheral_register_get_raw_value(reg);
+
+    if (stm32_flash_is_f4(state)) {
+        if (!(cr & FLASH_F4_CR_STRT)) {
+            return;
+        }
+        if (cr & FLASH_F4_CR_SER) {
+            hwaddr sector_offset;
+            uint32_t sector_size;
+            if (stm32_flash_get_sector((cr >> FLASH_F4_CR_SNB_SHIFT) & 0x1F,
+                    &sector_offset, &sector_size)) {
+                stm32_flash_erase(sector_offset, sector_size);
+            }
+        } else {
+            if (cr & FLASH_F4_CR_MER) {
+                stm32_flash_erase(0, 0x100000);
+            }
+            if (cr & FLASH_F4_CR_MER1) {
+                stm32_flash_erase(0x100000, 0x100000);
+            }
+        }
+        peripheral_register_and_raw_value(reg, ~FLASH_F4_CR_STRT);
+    } else {
+        if (!(cr & FLASH_F1_CR_STRT)) {
+            return;
+        }
+        if (cr & FLASH_F1_CR_PER) {
+            uint32_t page_size = stm32_flash_get_page_size(state);
+            uint32_t ar = peripheral_register_get_raw_value(state->reg.ar);
+            if (ar >= FLASH_BASE_ADDRESS) {
+                ar -= FLASH_BASE_ADDRESS;
+            }
+            stm32_flash_erase(ar & ~(page_size - 1), page_size);
+        } else if (cr & FLASH_F1_CR_MER) {
+            stm32_flash_erase(0, stm32_flash_get_size());
+        }
+        peripheral_register_and_raw_value(reg, ~FLASH_F1_CR_STRT);
+    }
+
+    stm32_flash_end_of_operation(state);
+}
+
+// ----------------------------------------------------------------------------
+
+static void stm32_flash_instance_init_callback(Object *obj)
+{
+    qemu_log_function_name();
+}
+
+// Create the registers and bitfields; called at realize, or on first
+// access for lazy peripherals.
+static void stm32_flash_create_registers(Object *obj)
+{
     STM32MCUState *mcu = stm32_mcu_get();
     CortexMState *cm_state = CORTEXM_MCU_STATE(mcu);
 
-    STM32FLASHState *state = STM32_FLASH_STATE(dev);
-    // First thing first: get capabilities from MCU, needed everywhere.
-    state->capabilities = mcu->capabilities;
+    STM32FLASHState *state = STM32_FLASH_STATE(obj);
 
     const STM32Capabilities *capabilities = state->capabilities;
     assert(capabilities != NULL);
 
-    Object *obj = OBJECT(dev);
-
     const char *periph_name = "FLASH";
-    svd_set_peripheral_address_block(cm_state->svd_json, periph_name, obj);
-    peripheral_create_memory_region(obj);
-
-    // Must be defined before creating registers.
-    cm_object_property_set_int(obj, 4, "register-size-bytes");
-
-    // TODO: get it from MCU
-    cm_object_property_set_bool(obj, true, "is-little-endian");
 
     switch (capabilities->family) {
     case STM32_FAMILY_F0:
 
         if (capabilities->f0.is_0x1) {
 
-            stm32f0x1_flash_create_objects(obj, cm_state->svd_json,
+            stm32f0x1_flash_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
         } else if (capabilities->f0.is_0x2) {
 
-            stm32f0x2_flash_create_objects(obj, cm_state->svd_json,
+            stm32f0x2_flash_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
         } else {
             assert(false);
         }
+
+        state->reg.acr = state->u.f0.reg.acr;
+        state->reg.keyr = state->u.f0.reg.keyr;
+        state->reg.sr = state->u.f0.reg.sr;
+        state->reg.cr = state->u.f0.reg.cr;
+        state->reg.ar = state->u.f0.reg.ar;
+
         break;
 
     case STM32_FAMILY_F1:
 
         if (capabilities->f1.is_103xx) {
 
-            stm32f103xx_flash_create_objects(obj, cm_state->svd_json,
+            stm32f103xx_flash_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
         } else if (capabilities->f1.is_107xx) {
 
-            stm32f107xx_flash_create_objects(obj, cm_state->svd_json,
+            stm32f107xx_flash_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
         } else {
@@ -795,43 +1116,120 @@ static void stm32_flash_realize_callback(DeviceState *dev, Error **errp)
         cm_object_property_set_str(state->u.f1.fld.acr.prftbs, "PRFTBE",
                 "follows");
 
+        state->reg.acr = state->u.f1.reg.acr;
+        state->reg.keyr = state->u.f1.reg.keyr;
+        state->reg.sr = state->u.f1.reg.sr;
+        state->reg.cr = state->u.f1.reg.cr;
+        state->reg.ar = state->u.f1.reg.ar;
+
         break;
 
     case STM32_FAMILY_F4:
 
         if (capabilities->f4.is_40x) {
 
-            stm32f40x_flash_create_objects(obj, cm_state->svd_json,
+            stm32f40x_flash_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
         } else if (capabilities->f4.is_411xx) {
 
-            stm32f411xx_flash_create_objects(obj, cm_state->svd_json,
+            stm32f411xx_flash_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
         } else if (capabilities->f4.is_429x) {
 
-            stm32f429x_flash_create_objects(obj, cm_state->svd_json,
+            stm32f429x_flash_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
         } else {
             assert(false);
         }
+
+        state->reg.acr = state->u.f4.reg.acr;
+        state->reg.keyr = state->u.f4.reg.keyr;
+        state->reg.sr = state->u.f4.reg.sr;
+        state->reg.cr = state->u.f4.reg.cr;
+        state->reg.ar = NULL;
+
         break;
 
     default:
         break;
     }
 
+    if (state->reg.cr != NULL) {
+        peripheral_register_set_post_write(state->reg.keyr,
+                &stm32_flash_keyr_post_write_callback);
+        peripheral_register_set_pre_write(state->reg.sr,
+                &stm32_flash_sr_pre_write_callback);
+        peripheral_register_set_pre_write(state->reg.cr,
+                &stm32_flash_cr_pre_write_callback);
+        peripheral_register_set_post_write(state->reg.cr,
+                &stm32_flash_cr_post_write_callback);
+    }
+
+    if (state->reg.acr != NULL) {
+        peripheral_register_set_post_write(state->reg.acr,
+                &stm32_flash_acr_post_write_callback);
+    }
+
     peripheral_prepare_registers(obj);
 }
 
+static void stm32_flash_realize_callback(DeviceState *dev, Error **errp)
+{
+    qemu_log_function_name();
+
+    // Call parent realize().
+    if (!cm_device_parent_realize(dev, errp, TYPE_STM32_FLASH)) {
+        return;
+    }
+
+    STM32MCUState *mcu = stm32_mcu_get();
+    CortexMState *cm_state = CORTEXM_MCU_STATE(mcu);
+
+    STM32FLASHState *state = STM32_FLASH_STATE(dev);
+    // First thing first: get capabilities from MCU, needed everywhere.
+    state->capabilities = mcu->capabilities;
+
+    const STM32Capabilities *capabilities = state->capabilities;
+    assert(capabilities != NULL);
+
+    Object *obj = OBJECT(dev);
+
+    const char *periph_name = "FLASH";
+    svd_set_peripheral_address_block(cm_state->svd_device, periph_name, obj);
+    peripheral_create_memory_region(obj);
+
+    // Must be defined before creating registers.
+    cm_object_property_set_int(obj, 4, "register-size-bytes");
+
+    // TODO: get it from MCU
+    cm_object_property_set_bool(obj, true, "is-little-endian");
+
+    peripheral_populate_registers(obj, stm32_flash_create_registers,
+            mcu->lazy_peripherals);
+
+    state->nvic = CORTEXM_NVIC_STATE(cm_state->nvic);
+    state->irq = (capabilities->family == STM32_FAMILY_F0) ?
+            STM32F072XX_FLASH_IRQn : STM32F10X_CL_FLASH_IRQn;
+
+    // Flash writes are passed here.
+    cm_state->flash_write = stm32_flash_write_callback;
+    cm_state->flash_write_opaque = state;
+}
+
 static void stm32_flash_reset_callback(DeviceState *dev)
 {
     qemu_log_function_name();
 
     // Call parent reset().
     cm_device_parent_reset(dev, TYPE_STM32_FLASH);
+
+    STM32FLASHState *state = STM32_FLASH_STATE(dev);
+    state->key_index = 0;
+
+    stm32_flash_update_timing(state);
 }
 
 static void stm32_flash_class_init_callback(ObjectClass *klass, void *data)
@@ -0,0 +1,289 @@
+/*
+ * STM32 - GPIO link, a host side socket to drive and observe the pins.
+ *
+ * Copyright (c) 2017 Liviu Ionescu.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <hw/cortexm/stm32/gpio-link.h>
+#include <hw/cortexm/stm32/gpio.h>
+#include <hw/cortexm/helper.h>
+
+#include "qemu/timer.h"
+#include "qemu/bswap.h"
+#include "sysemu/sysemu.h"
+
+/*
+ * This file implements a link between the GPIO ports and an external
+ * program, for hardware-in-the-loop tests.
+ *
+ * The link is active only when the "chardev" property is set, for example
+ * to a UNIX socket:
+ *
+ *   -chardev socket,id=gpio,path=/tmp/gpio.sock,server,nowait
+ *   -global stm32:gpio-link.chardev=gpio
+ *
+ * The host sends fixed size commands, each able to change any number of
+ * pins of a port; the emulator sends an event for each ODR write that
+ * changed output pins, with the virtual time when it happened.
+ *
+ * Both directions are processed in the main loop, which owns the
+ * emulated peripherals; events are buffered and written when the
+ * main loop gets control back, to avoid a system call for each write.
+ */
+
+// ----- Private --------------------------------------------------------------
+
+// Write the buffered events.
+static void stm32_gpio_link_flush(STM32GPIOLinkState *state)
+{
+    if (state->out_count == 0) {
+        return;
+    }
+
+    qemu_chr_fe_write_all(&state->chr, state->out_buffer, state->out_count);
+
+    state->out_count = 0;
+}
+
+static void stm32_gpio_link_flush_bh_callback(void *opaque)
+{
+    stm32_gpio_link_flush((STM32GPIOLinkState *) opaque);
+}
+
+static void stm32_gpio_link_exit_notifier_callback(Notifier *notifier,
+        void *data)
+{
+    STM32GPIOLinkState *state = container_of(notifier, STM32GPIOLinkState,
+            exit_notifier);
+
+    stm32_gpio_link_flush(state);
+}
+
+static void stm32_gpio_link_send_odr(STM32GPIOLinkState *state, int port,
+        uint16_t odr, uint16_t changed)
+{
+    if (state->out_count + STM32_GPIO_LINK_EVENT_SIZE
+            > STM32_GPIO_LINK_BUFFER_SIZE) {
+        stm32_gpio_link_flush(state);
+    }
+
+    uint8_t *p = state->out_buffer + state->out_count;
+
+    p[0] = STM32_GPIO_LINK_EVENT_ODR;
+    p[1] = port;
+    stw_le_p(p + 2, odr);
+    stw_le_p(p + 4, changed);
+    stw_le_p(p + 6, 0);
+    stq_le_p(p + 8, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL));
+
+    if (state->out_count == 0) {
+        qemu_bh_schedule(state->out_bh);
+    }
+    state->out_count += STM32_GPIO_LINK_EVENT_SIZE;
+}
+
+static void stm32_gpio_link_process_command(STM32GPIOLinkState *state,
+        const uint8_t *cmd)
+{
+    int port = cmd[1];
+    uint16_t mask = lduw_le_p(cmd + 2);
+    uint16_t value = lduw_le_p(cmd + 4);
+
+    Object *gpio = NULL;
+    if (port < STM32_MAX_GPIO) {
+        gpio = stm32_gpio_get(STM32_PORT_GPIOA + port);
+    }
+    if (gpio == NULL) {
+        qemu_log_mask(LOG_GUEST_ERROR, "GPIO-LINK: no GPIO%c port.\n",
+                'A' + port);
+        return;
+    }
+
+    switch (cmd[0]) {
+    case STM32_GPIO_LINK_CMD_SET:
+
+        stm32_gpio_set_inputs(gpio, mask, value);
+        break;
+
+    case STM32_GPIO_LINK_CMD_WATCH:
+
+        state->watch_mask[port] = mask;
+        break;
+
+    case STM32_GPIO_LINK_CMD_READ:
+
+        stm32_gpio_link_send_odr(state, port, stm32_gpio_get_odr(gpio), 0);
+        break;
+
+    default:
+
+        qemu_log_mask(LOG_GUEST_ERROR, "GPIO-LINK: unknown command 0x%02X.\n",
+                cmd[0]);
+        break;
+    }
+}
+
+static int stm32_gpio_link_can_receive_callback(void *opaque)
+{
+    // Any amount; commands are processed as soon as they are complete.
+    return STM32_GPIO_LINK_BUFFER_SIZE;
+}
+
+static void stm32_gpio_link_receive_callback(void *opaque, const uint8_t *buf,
+        int size)
+{
+    STM32GPIOLinkState *state = STM32_GPIO_LINK_STATE(opaque);
+
+    int i;
+    for (i = 0; i < size; ++i) {
+        state->in_buffer[state->in_count++] = buf[i];
+        if (state->in_count == STM32_GPIO_LINK_CMD_SIZE) {
+            stm32_gpio_link_process_command(state, state->in_buffer);
+            state->in_count = 0;
+        }
+    }
+}
+
+static void stm32_gpio_link_event_callback(void *opaque, int event)
+{
+    STM32GPIOLinkState *state = STM32_GPIO_LINK_STATE(opaque);
+
+    // A new connection must not continue a partial command.
+    if (event == CHR_EVENT_OPENED || event == CHR_EVENT_CLOSED) {
+        state->in_count = 0;
+    }
+}
+
+// ----- Public ---------------------------------------------------------------
+
+// Create the GPIO link and return it; it remains inactive without
+// a "chardev".
+
+Object* stm32_gpio_link_create(Object *parent)
+{
+    Object *link = cm_object_new(parent, "GPIO-LINK", TYPE_STM32_GPIO_LINK);
+
+    cm_object_realize(link);
+
+    return link;
+}
+
+bool stm32_gpio_link_is_active(Object *obj)
+{
+    STM32GPIOLinkState *state = STM32_GPIO_LINK_STATE(obj);
+
+    return qemu_chr_fe_get_driver(&state->chr) != NULL;
+}
+
+// Called by GPIO when output pins change.
+void stm32_gpio_link_odr_changed(Object *obj, int port, uint16_t odr,
+        uint16_t changed)
+{
+    STM32GPIOLinkState *state = STM32_GPIO_LINK_STATE(obj);
+
+    assert(port < STM32_MAX_GPIO);
+
+    if ((changed & state->watch_mask[port]) == 0) {
+        return;
+    }
+
+    stm32_gpio_link_send_odr(state, port, odr, changed);
+}
+
+// ----------------------------------------------------------------------------
+
+static void stm32_gpio_link_instance_init_callback(Object *obj)
+{
+    qemu_log_function_name();
+
+    STM32GPIOLinkState *state = STM32_GPIO_LINK_STATE(obj);
+
+    int i;
+    for (i = 0; i < STM32_MAX_GPIO; ++i) {
+        state->watch_mask[i] = 0xFFFF;
+    }
+}
+
+static void stm32_gpio_link_realize_callback(DeviceState *dev, Error **errp)
+{
+    qemu_log_function_name();
+
+    // Call parent realize().
+    if (!cm_device_parent_realize(dev, errp, TYPE_STM32_GPIO_LINK)) {
+        return;
+    }
+
+    STM32GPIOLinkState *state = STM32_GPIO_LINK_STATE(dev);
+
+    if (!stm32_gpio_link_is_active(OBJECT(dev))) {
+        return;
+    }
+
+    state->in_count = 0;
+    state->out_count = 0;
+    state->out_bh = qemu_bh_new(stm32_gpio_link_flush_bh_callback, state);
+
+    qemu_chr_fe_set_handlers(&state->chr,
+            stm32_gpio_link_can_receive_callback,
+            stm32_gpio_link_receive_callback, stm32_gpio_link_event_callback,
+            state, NULL, true);
+
+    // Do not lose the last buffered events.
+    state->exit_notifier.notify = stm32_gpio_link_exit_notifier_callback;
+    qemu_add_exit_notifier(&state->exit_notifier);
+
+    // Register with the existing ports.
+    int i;
+    for (i = 0; i < STM32_MAX_GPIO; ++i) {
+        Object *gpio = stm32_gpio_get(STM32_PORT_GPIOA + i);
+        if (gpio != NULL) {
+            STM32_GPIO_STATE(gpio)->link = OBJECT(dev);
+        }
+    }
+}
+
+static Property stm32_gpio_link_properties[] = {
+        DEFINE_PROP_CHR("chardev", STM32GPIOLinkState, chr),
+    DEFINE_PROP_END_OF_LIST(), };
+
+static void stm32_gpio_link_class_init_callback(ObjectClass *klass,
+        void *data)
+{
+    DeviceClass *dc = DEVICE_CLASS(klass);
+
+    dc->props = stm32_gpio_link_properties;
+
+    dc->realize = stm32_gpio_link_realize_callback;
+}
+
+static const TypeInfo stm32_gpio_link_type_info = {
+    .name = TYPE_STM32_GPIO_LINK,
+    .parent = TYPE_STM32_GPIO_LINK_PARENT,
+    .instance_init = stm32_gpio_link_instance_init_callback,
+    .instance_size = sizeof(STM32GPIOLinkState),
+    .class_init = stm32_gpio_link_class_init_callback,
+    .class_size = sizeof(STM32GPIOLinkClass)
+/**/
+};
+
+static void stm32_gpio_link_register_types(void)
+{
+    type_register_static(&stm32_gpio_link_type_info);
+}
+
+type_init(stm32_gpio_link_register_types);
+
+// ----------------------------------------------------------------------------
@@ -22,6 +22,7 @@
 #include <hw/cortexm/stm32/exti.h>
 #include <hw/cortexm/stm32/syscfg.h>
 #include <hw/cortexm/stm32/mcu.h>
+#include <hw/cortexm/stm32/gpio-link.h>
 #include <hw/cortexm/helper.h>
 #include <hw/cortexm/svd.h>
 
@@ -45,12 +46,12 @@
 //
 // STM32F051R8
 // DO NOT EDIT! Automatically generated!
-static void stm32f0x1_gpio_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f0x1_gpio_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32GPIOState *state = STM32_GPIO_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -447,12 +448,12 @@ static void stm32f0x1_gpio_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F072CB
 // DO NOT EDIT! Automatically generated!
-static void stm32f0x2_gpio_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f0x2_gpio_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32GPIOState *state = STM32_GPIO_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -838,12 +839,12 @@ static void stm32f0x2_gpio_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F103RB
 // DO NOT EDIT! Automatically generated!
-static void stm32f103xx_gpio_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f103xx_gpio_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32GPIOState *state = STM32_GPIO_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -1132,12 +1133,12 @@ static void stm32f103xx_gpio_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F107VC
 // DO NOT EDIT! Automatically generated!
-static void stm32f107xx_gpio_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f107xx_gpio_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32GPIOState *state = STM32_GPIO_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -1426,12 +1427,12 @@ static void stm32f107xx_gpio_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F407VG, STM32F407ZG, STM32F405RG
 // DO NOT EDIT! Automatically generated!
-static void stm32f40x_gpio_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f40x_gpio_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32GPIOState *state = STM32_GPIO_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -1793,12 +1794,12 @@ static void stm32f40x_gpio_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F411RE
 // DO NOT EDIT! Automatically generated!
-static void stm32f411xx_gpio_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f411xx_gpio_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32GPIOState *state = STM32_GPIO_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -2160,12 +2161,12 @@ static void stm32f411xx_gpio_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F429ZI
 // DO NOT EDIT! Automatically generated!
-static void stm32f429x_gpio_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f429x_gpio_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32GPIOState *state = STM32_GPIO_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -2565,6 +2566,75 @@ Object* stm32_gpio_get(int index)
     return object_resolve_path(gpio_name, NULL);
 }
 
+static Object *stm32_gpio_get_idr(STM32GPIOState *state);
+
+static uint16_t stm32_gpio_get_exti_mask(STM32GPIOState *state);
+
+// Set several input pins at once; output pins in the mask are ignored.
+// Interrupts are triggered only for the pins that changed.
+// Must be called from the main loop.
+
+void stm32_gpio_set_inputs(Object *obj, uint16_t mask, uint16_t value)
+{
+    STM32GPIOState *state = STM32_GPIO_STATE(obj);
+
+    // Lazy peripherals need the registers to store the input.
+    peripheral_materialize(obj);
+
+    Object *idr = stm32_gpio_get_idr(state);
+
+    mask &= ~state->dir_mask;
+    uint16_t old_idr = peripheral_register_get_raw_value(idr);
+    uint16_t changed = (old_idr ^ value) & mask;
+    if (changed == 0) {
+        return;
+    }
+
+    peripheral_register_and_raw_value(idr, ~changed);
+    peripheral_register_or_raw_value(idr, value & changed);
+
+    uint16_t exti_changed = changed & stm32_gpio_get_exti_mask(state);
+    while (exti_changed != 0) {
+        int pin = ctz32(exti_changed);
+        exti_changed &= exti_changed - 1;
+
+        cm_irq_set(state->exti_irq[pin], (value >> pin) & 1);
+    }
+}
+
+// Return the current output value of the port.
+
+uint16_t stm32_gpio_get_odr(Object *obj)
+{
+    STM32GPIOState *state = STM32_GPIO_STATE(obj);
+
+    peripheral_materialize(obj);
+
+    Object *odr;
+    switch (state->capabilities->family) {
+    case STM32_FAMILY_F0:
+
+        odr = state->u.f0.reg.odr;
+        break;
+
+    case STM32_FAMILY_F1:
+
+        odr = state->u.f1.reg.odr;
+        break;
+
+    case STM32_FAMILY_F4:
+
+        odr = state->u.f4.reg.odr;
+        break;
+
+    default:
+        assert(false);
+        return 0;
+    }
+
+    return peripheral_register_get_raw_value(odr);
+}
+
 // ----- Private --------------------------------------------------------------
 
 static void stm32_gpio_update_idr(STM32GPIOState *state, Object *idr,
@@ -2869,24 +2939,20 @@ static void stm32_gpio_update_odr_and_idr(STM32GPIOState *state, Object *odr,
     stm32_gpio_update_idr(state, idr, new_value);
 }
 
-// If EXTI is sensitive to this GPIO pin, set interrupt.
-static void stm32_gpio_set_exti_irq(STM32GPIOState *state, int pin, int level)
+// Return the pins of this port routed to EXTI.
+//
+// The SYSCFG/AFIO multiplexers are implemented at origin, in GPIO,
+// instead of forwarding all interrupts to EXTI to be rejected there;
+// the routing is published by SYSCFG/AFIO when EXTICR are written.
+static uint16_t stm32_gpio_get_exti_mask(STM32GPIOState *state)
 {
-    assert(pin < 16);
-
-    const STM32Capabilities *capabilities = state->capabilities;
-
-    // Implement the SYSCFG/AFIO multiplexers at origin, in GPIO,
-    // instead of forwarding all interrupts to EXTI to be rejected there.
+    int port = state->port_index - STM32_PORT_GPIOA;
 
-    peripheral_register_t exti = 0;
-    if (capabilities->family == STM32_FAMILY_F1) {
-        exti = register_bitfield_read_value(state->afio->exticr.exti[pin]);
+    assert(port >= 0 && port < STM32_MAX_GPIO);
+    if (state->capabilities->family == STM32_FAMILY_F1) {
+        return state->afio->exticr.port_mask[port];
     } else {
-        exti = register_bitfield_read_value(state->syscfg->exticr.exti[pin]);
-    }
-    if (exti == (state->port_index - STM32_PORT_GPIOA)) {
-        cm_irq_set(state->exti_irq[pin], level);
+        return state->syscfg->exticr.port_mask[port];
     }
 }
 
@@ -2901,19 +2967,28 @@ static void stm32_gpio_set_odr_irqs(STM32GPIOState *state, uint16_t old_odr,
     // Filter changed pins that are outputs - do not touch input pins.
     uint16_t changed_out = changed & state->dir_mask;
 
-    uint16_t mask = 1;
     if (changed_out) {
-        int pin;
-        for (pin = 0; pin < STM32_GPIO_PIN_COUNT; pin++, mask <<= 1) {
-            // If the value of this pin has changed, then update
-            // the output IRQ.
-            if ((changed_out & mask) != 0) {
-                int level = (new_odr & mask) ? 1 : 0;
+        // Visit only the changed pins, lowest first.
+        uint16_t pending = changed_out;
+        while (pending != 0) {
+            int pin = ctz32(pending);
+            pending &= pending - 1;
+
+            cm_irq_set(state->odr_irq[pin], (new_odr >> pin) & 1);
+        }
 
-                cm_irq_set(state->odr_irq[pin], level);
+        uint16_t exti_changed = changed_out & stm32_gpio_get_exti_mask(state);
+        while (exti_changed != 0) {
+            int pin = ctz32(exti_changed);
+            exti_changed &= exti_changed - 1;
 
-                stm32_gpio_set_exti_irq(state, pin, level);
-            }
+            cm_irq_set(state->exti_irq[pin], (new_odr >> pin) & 1);
+        }
+
+        if (state->link != NULL) {
+            stm32_gpio_link_odr_changed(state->link,
+                    state->port_index - STM32_PORT_GPIOA, new_odr,
+                    changed_out);
         }
     }
 }
@@ -2933,44 +3008,49 @@ static void stm32_gpio_update_idr(STM32GPIOState *state, Object *idr,
     peripheral_register_or_raw_value(idr, (new_odr & state->dir_mask));
 }
 
-// Callback fired when a GPIO input pin changes state (based
-// on an external stimulus from the machine).
-static void stm32_gpio_in_irq_handler(void *opaque, int n, int level)
+// Return the family specific IDR register.
+static Object *stm32_gpio_get_idr(STM32GPIOState *state)
 {
-    qemu_log_mask(LOG_FUNC, "%s(%d,%d) \n", __FUNCTION__, n, level);
-
-    assert(n < 16);
-
-    STM32GPIOState *state = STM32_GPIO_STATE(opaque);
-    unsigned pin = n;
-
-    assert(pin < STM32_GPIO_PIN_COUNT);
-
     const STM32Capabilities *capabilities = state->capabilities;
     assert(capabilities != NULL);
 
-    Object *idr;
-    // Update internal pin state.
     switch (capabilities->family) {
     case STM32_FAMILY_F0:
 
-        idr = state->u.f0.reg.idr;
-        break;
+        return state->u.f0.reg.idr;
 
     case STM32_FAMILY_F1:
 
-        idr = state->u.f1.reg.idr;
-        break;
+        return state->u.f1.reg.idr;
 
     case STM32_FAMILY_F4:
 
-        idr = state->u.f4.reg.idr;
-        break;
+        return state->u.f4.reg.idr;
 
     default:
         assert(false);
-        return;
+        return NULL;
     }
+}
+
+// Callback fired when a GPIO input pin changes state (based
+// on an external stimulus from the machine).
+static void stm32_gpio_in_irq_handler(void *opaque, int n, int level)
+{
+    qemu_log_mask(LOG_FUNC, "%s(%d,%d) \n", __FUNCTION__, n, level);
+
+    assert(n < 16);
+
+    STM32GPIOState *state = STM32_GPIO_STATE(opaque);
+    unsigned pin = n;
+
+    // Lazy peripherals need the registers to store the input.
+    peripheral_materialize(OBJECT(state));
+
+    assert(pin < STM32_GPIO_PIN_COUNT);
+
+    // Update internal pin state.
+    Object *idr = stm32_gpio_get_idr(state);
 
     // TODO: check if a mutex is needed,
     // this can be called from the graphic thread.
@@ -2982,7 +3062,9 @@ static void stm32_gpio_in_irq_handler(void *opaque, int n, int level)
         peripheral_register_or_raw_value(idr, (1 << pin));
     }
 
-    stm32_gpio_set_exti_irq(state, pin, level);
+    if ((stm32_gpio_get_exti_mask(state) & (1 << pin)) != 0) {
+        cm_irq_set(state->exti_irq[pin], level);
+    }
 }
 
 // ----------------------------------------------------------------------------
@@ -3029,52 +3111,32 @@ static void stm32_gpio_instance_init_callback(Object *obj)
     state->reg.brr = NULL;
 }
 
-static void stm32_gpio_realize_callback(DeviceState *dev, Error **errp)
+// Create the registers and bitfields; called at realize, or on first
+// access for lazy peripherals.
+static void stm32_gpio_create_registers(Object *obj)
 {
-    qemu_log_function_name();
-
-    // Call parent realize().
-    if (!cm_device_parent_realize(dev, errp, TYPE_STM32_GPIO)) {
-        return;
-    }
-
     STM32MCUState *mcu = stm32_mcu_get();
     CortexMState *cm_state = CORTEXM_MCU_STATE(mcu);
 
-    STM32GPIOState *state = STM32_GPIO_STATE(dev);
-    // First thing first: get capabilities from MCU, needed everywhere.
-    state->capabilities = mcu->capabilities;
+    STM32GPIOState *state = STM32_GPIO_STATE(obj);
 
     const STM32Capabilities *capabilities = state->capabilities;
     assert(capabilities != NULL);
 
-    Object *obj = OBJECT(dev);
-
     char periph_name[10];
     snprintf(periph_name, sizeof(periph_name) - 1, "GPIO%c",
             'A' + state->port_index);
 
-    svd_set_peripheral_address_block(cm_state->svd_json, periph_name, obj);
-    peripheral_create_memory_region(obj);
-
-    // Must be defined before creating registers.
-    cm_object_property_set_int(obj, 4, "register-size-bytes");
-
-    // TODO: get it from MCU
-    cm_object_property_set_bool(obj, true, "is-little-endian");
-
-    char enabling_bit_name[STM32_RCC_SIZEOF_ENABLING_BITFIELD];
-
     switch (capabilities->family) {
     case STM32_FAMILY_F0:
 
         if (capabilities->f0.is_0x1) {
 
-            stm32f0x1_gpio_create_objects(obj, cm_state->svd_json, periph_name);
+            stm32f0x1_gpio_create_objects(obj, cm_state->svd_device, periph_name);
 
         } else if (capabilities->f0.is_0x2) {
 
-            stm32f0x2_gpio_create_objects(obj, cm_state->svd_json, periph_name);
+            stm32f0x2_gpio_create_objects(obj, cm_state->svd_device, periph_name);
 
         } else {
             assert(false);
@@ -3110,25 +3172,18 @@ static void stm32_gpio_realize_callback(DeviceState *dev, Error **errp)
         peripheral_register_set_post_write(state->reg.brr,
                 &stm32f0_gpio_brr_post_write_callback);
 
-        state->syscfg = STM32_SYSCFG_STATE(
-                cm_device_by_name(DEVICE_PATH_STM32_SYSCFG));
-
-        snprintf(enabling_bit_name, sizeof(enabling_bit_name) - 1,
-        DEVICE_PATH_STM32_RCC "/AHBENR/IOP%cEN",
-                'A' + state->port_index - STM32_PORT_GPIOA);
-
         break;
 
     case STM32_FAMILY_F1:
 
         if (capabilities->f1.is_103xx) {
 
-            stm32f103xx_gpio_create_objects(obj, cm_state->svd_json,
+            stm32f103xx_gpio_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
         } else if (capabilities->f1.is_107xx) {
 
-            stm32f107xx_gpio_create_objects(obj, cm_state->svd_json,
+            stm32f107xx_gpio_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
         } else {
@@ -3155,29 +3210,22 @@ static void stm32_gpio_realize_callback(DeviceState *dev, Error **errp)
         peripheral_register_set_post_write(state->u.f1.reg.brr,
                 &stm32f1_gpio_brr_post_write_callback);
 
-        state->afio = STM32_AFIO_STATE(
-                cm_device_by_name(DEVICE_PATH_STM32_AFIO));
-
-        snprintf(enabling_bit_name, sizeof(enabling_bit_name) - 1,
-        DEVICE_PATH_STM32_RCC "/APB2ENR/IOP%cEN",
-                'A' + state->port_index - STM32_PORT_GPIOA);
-
         break;
 
     case STM32_FAMILY_F4:
 
         if (capabilities->f4.is_40x) {
 
-            stm32f40x_gpio_create_objects(obj, cm_state->svd_json, periph_name);
+            stm32f40x_gpio_create_objects(obj, cm_state->svd_device, periph_name);
 
         } else if (capabilities->f4.is_411xx) {
 
-            stm32f411xx_gpio_create_objects(obj, cm_state->svd_json,
+            stm32f411xx_gpio_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
         } else if (capabilities->f4.is_429x) {
 
-            stm32f429x_gpio_create_objects(obj, cm_state->svd_json,
+            stm32f429x_gpio_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
         } else {
@@ -3208,6 +3256,77 @@ static void stm32_gpio_realize_callback(DeviceState *dev, Error **errp)
         peripheral_register_set_post_write(state->reg.bsrr,
                 &stm32f4_gpio_bsrr_post_write_callback);
 
+        break;
+
+    default:
+        assert(false);
+        break;
+    }
+
+    peripheral_prepare_registers(obj);
+}
+
+static void stm32_gpio_realize_callback(DeviceState *dev, Error **errp)
+{
+    qemu_log_function_name();
+
+    // Call parent realize().
+    if (!cm_device_parent_realize(dev, errp, TYPE_STM32_GPIO)) {
+        return;
+    }
+
+    STM32MCUState *mcu = stm32_mcu_get();
+    CortexMState *cm_state = CORTEXM_MCU_STATE(mcu);
+
+    STM32GPIOState *state = STM32_GPIO_STATE(dev);
+    // First thing first: get capabilities from MCU, needed everywhere.
+    state->capabilities = mcu->capabilities;
+
+    const STM32Capabilities *capabilities = state->capabilities;
+    assert(capabilities != NULL);
+
+    Object *obj = OBJECT(dev);
+
+    char periph_name[10];
+    snprintf(periph_name, sizeof(periph_name) - 1, "GPIO%c",
+            'A' + state->port_index);
+
+    svd_set_peripheral_address_block(cm_state->svd_device, periph_name, obj);
+    peripheral_create_memory_region(obj);
+
+    // Must be defined before creating registers.
+    cm_object_property_set_int(obj, 4, "register-size-bytes");
+
+    // TODO: get it from MCU
+    cm_object_property_set_bool(obj, true, "is-little-endian");
+
+    char enabling_bit_name[STM32_RCC_SIZEOF_ENABLING_BITFIELD];
+
+    switch (capabilities->family) {
+    case STM32_FAMILY_F0:
+
+        state->syscfg = STM32_SYSCFG_STATE(
+                cm_device_by_name(DEVICE_PATH_STM32_SYSCFG));
+
+        snprintf(enabling_bit_name, sizeof(enabling_bit_name) - 1,
+        DEVICE_PATH_STM32_RCC "/AHBENR/IOP%cEN",
+                'A' + state->port_index - STM32_PORT_GPIOA);
+
+        break;
+
+    case STM32_FAMILY_F1:
+
+        state->afio = STM32_AFIO_STATE(
+                cm_device_by_name(DEVICE_PATH_STM32_AFIO));
+
+        snprintf(enabling_bit_name, sizeof(enabling_bit_name) - 1,
+        DEVICE_PATH_STM32_RCC "/APB2ENR/IOP%cEN",
+                'A' + state->port_index - STM32_PORT_GPIOA);
+
+        break;
+
+    case STM32_FAMILY_F4:
+
         state->syscfg = STM32_SYSCFG_STATE(
                 cm_device_by_name(DEVICE_PATH_STM32_SYSCFG));
 
@@ -3224,13 +3343,20 @@ static void stm32_gpio_realize_callback(DeviceState *dev, Error **errp)
 
     state->enabling_bit = OBJECT(cm_device_by_name(enabling_bit_name));
 
-    peripheral_prepare_registers(obj);
+    peripheral_populate_registers(obj, stm32_gpio_create_registers,
+            mcu->lazy_peripherals);
 }
 
 static void stm32_gpio_reset_callback(DeviceState *dev)
 {
     qemu_log_function_name();
 
+    if (!peripheral_is_materialized(OBJECT(dev))) {
+        // Lazy peripheral, no registers yet, nothing to update.
+        cm_device_parent_reset(dev, TYPE_STM32_GPIO);
+        return;
+    }
+
     // Defer parent reset to read the previous value.
 
     STM32GPIOState *state = STM32_GPIO_STATE(dev);
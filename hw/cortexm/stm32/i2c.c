@@ -0,0 +1,766 @@
+/*
+ * STM32 MCU - I2C (inter-integrated circuit) emulation.
+ *
+ * Copyright (c) 2017 Liviu Ionescu.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <hw/cortexm/stm32/i2c.h>
+#include <hw/cortexm/stm32/mcu.h>
+#include <hw/cortexm/helper.h>
+#include <hw/cortexm/svd.h>
+
+/*
+ * This file implements the master mode of the F1/F4 I2Cs, with 7-bit
+ * addresses.
+ *
+ * The slaves are QEMU I2C devices, on a bus owned by each I2C; the
+ * bytes are exchanged with i2c_send()/i2c_recv() as soon as the
+ * firmware allows it, without the bus clock delay. When receiving,
+ * DR and the shift register are kept full while the bytes are
+ * acknowledged, like the hardware does, so the usual N=1/2/3 ACK/STOP
+ * sequences end with the expected number of bytes.
+ *
+ * With DMA, the I2C registers a bulk handler with the DMA channels,
+ * and whole buffers are moved in a loop, with one memory access per
+ * block.
+ *
+ * The slaves can be created at startup, for example a TMP105 on I2C1:
+ *
+ *   -global stm32:i2c-peripheral.devices="I2C1=tmp105@0x48"
+ *
+ * or by the board code, on the bus returned by stm32_i2c_get_bus().
+ *
+ * TODO:
+ * - implement slave mode, 10-bit addresses, SMBus/PEC and the F0 I2C
+ */
+
+#define I2C_CR1_PE          (1 << 0)
+#define I2C_CR1_START       (1 << 8)
+#define I2C_CR1_STOP        (1 << 9)
+#define I2C_CR1_ACK         (1 << 10)
+#define I2C_CR1_SWRST       (1 << 15)
+
+#define I2C_CR2_ITERREN     (1 << 8)
+#define I2C_CR2_ITEVTEN     (1 << 9)
+#define I2C_CR2_ITBUFEN     (1 << 10)
+#define I2C_CR2_DMAEN       (1 << 11)
+#define I2C_CR2_LAST        (1 << 12)
+
+#define I2C_SR1_SB          (1 << 0)
+#define I2C_SR1_ADDR        (1 << 1)
+#define I2C_SR1_BTF         (1 << 2)
+#define I2C_SR1_STOPF       (1 << 4)
+#define I2C_SR1_RXNE        (1 << 6)
+#define I2C_SR1_TXE         (1 << 7)
+#define I2C_SR1_AF          (1 << 10)
+// BERR, ARLO, AF, OVR, PECERR, TIMEOUT, SMBALERT; cleared by writing 0.
+#define I2C_SR1_ERRORS      (0xDF00)
+
+#define I2C_SR2_MSL         (1 << 0)
+#define I2C_SR2_BUSY        (1 << 1)
+#define I2C_SR2_TRA         (1 << 2)
+
+// ----- Public ---------------------------------------------------------------
+
+// Create I2C%d and return it.
+Object* stm32_i2c_create(Object *parent, stm32_i2c_index_t index)
+{
+    if ((int) index >= STM32_I2C_UNDEFINED) {
+        hw_error("Cannot assign I2C %d: QEMU supports only %d I2Cs\n",
+                1 + index - STM32_I2C_1, STM32_I2C_UNDEFINED);
+    }
+
+    char child_name[10];
+    snprintf(child_name, sizeof(child_name) - 1, "I2C%d",
+            1 + index - STM32_I2C_1);
+    // Passing a local string is ok.
+    Object *i2c = cm_object_new(parent, child_name, TYPE_STM32_I2C);
+
+    object_property_set_int(i2c, index, "i2c-index", NULL);
+
+    cm_object_realize(i2c);
+
+    return i2c;
+}
+
+// Return the bus where the slaves are connected.
+I2CBus *stm32_i2c_get_bus(Object *obj)
+{
+    return STM32_I2C_STATE(obj)->bus;
+}
+
+// ----- Private --------------------------------------------------------------
+
+static bool stm32_i2c_is_enabled(Object *obj)
+{
+    STM32I2CState *state = STM32_I2C_STATE(obj);
+
+    if (register_bitfield_is_non_zero(state->enabling_bit)) {
+        return true; // Positive logic, bit == 1 means enabled.
+    }
+
+    // Not enabled
+    return false;
+}
+
+static void stm32_i2c_update_irq(STM32I2CState *state)
+{
+    uint32_t cr2 = peripheral_register_get_raw_value(state->reg.cr2);
+    uint32_t sr1 = peripheral_register_get_raw_value(state->reg.sr1);
+
+    // With DMA, TXE and RXNE do not generate interrupts.
+    bool is_buf = (cr2 & I2C_CR2_ITBUFEN) && !(cr2 & I2C_CR2_DMAEN);
+
+    if ((cr2 & I2C_CR2_ITEVTEN)
+            && ((sr1 & (I2C_SR1_SB | I2C_SR1_ADDR | I2C_SR1_BTF | I2C_SR1_STOPF))
+                    || (is_buf && (sr1 & (I2C_SR1_TXE | I2C_SR1_RXNE))))
+            && state->irq_ev >= 0) {
+        cortexm_nvic_set_pending_interrupt(state->nvic, state->irq_ev);
+    }
+
+    if ((cr2 & I2C_CR2_ITERREN) && (sr1 & I2C_SR1_ERRORS)
+            && state->irq_er >= 0) {
+        cortexm_nvic_set_pending_interrupt(state->nvic, state->irq_er);
+    }
+}
+
+// Raise or lower the DMA requests, only when changed; active after
+// the address phase, in the direction of the transfer.
+static void stm32_i2c_update_dma_requests(STM32I2CState *state)
+{
+    uint32_t cr2 = peripheral_register_get_raw_value(state->reg.cr2);
+    uint32_t sr1 = peripheral_register_get_raw_value(state->reg.sr1);
+
+    bool is_data = (cr2 & I2C_CR2_DMAEN) && state->is_active
+            && !(sr1 & I2C_SR1_ADDR);
+    bool tx_level = is_data && !state->is_receiver;
+    bool rx_level = is_data && state->is_receiver;
+
+    if (state->dma_tx.dma != NULL && tx_level != state->dma_tx.level) {
+        state->dma_tx.level = tx_level;
+        stm32_dma_set_request(state->dma_tx.dma, state->dma_tx.channel,
+                state->dma_tx.request, state, tx_level);
+    }
+
+    if (state->dma_rx.dma != NULL && rx_level != state->dma_rx.level) {
+        state->dma_rx.level = rx_level;
+        stm32_dma_set_request(state->dma_rx.dma, state->dma_rx.channel,
+                state->dma_rx.request, state, rx_level);
+    }
+}
+
+// Send one byte; a NACK sets AF.
+static bool stm32_i2c_send_byte(STM32I2CState *state, uint8_t data)
+{
+    if (i2c_send(state->bus, data) != 0) {
+        peripheral_register_or_raw_value(state->reg.sr1, I2C_SR1_AF);
+        return false;
+    }
+
+    peripheral_register_or_raw_value(state->reg.sr1,
+            I2C_SR1_TXE | I2C_SR1_BTF);
+    return true;
+}
+
+// Receive one byte; without ACK, the slave stops sending.
+static uint8_t stm32_i2c_recv_byte(STM32I2CState *state, bool ack)
+{
+    uint8_t data = (uint8_t) i2c_recv(state->bus);
+
+    if (!ack) {
+        i2c_nack(state->bus);
+    }
+    state->rx_ack = ack;
+
+    return data;
+}
+
+// Keep DR and the shift register full while the slave sends; the ACK
+// bit is sampled as each byte is received.
+static void stm32_i2c_fill_rx(STM32I2CState *state)
+{
+    bool ack = (peripheral_register_get_raw_value(state->reg.cr1)
+            & I2C_CR1_ACK) != 0;
+    bool can_recv = state->is_active && state->rx_ack;
+
+    if (!(peripheral_register_get_raw_value(state->reg.sr1) & I2C_SR1_RXNE)) {
+        if (state->has_rx_shift) {
+            peripheral_register_set_raw_value(state->reg.dr, state->rx_shift);
+            state->has_rx_shift = false;
+        } else if (can_recv) {
+            peripheral_register_set_raw_value(state->reg.dr,
+                    stm32_i2c_recv_byte(state, ack));
+        } else {
+            return;
+        }
+        peripheral_register_or_raw_value(state->reg.sr1, I2C_SR1_RXNE);
+    }
+
+    if (!state->has_rx_shift && state->is_active && state->rx_ack) {
+        state->rx_shift = stm32_i2c_recv_byte(state, ack);
+        state->has_rx_shift = true;
+    }
+
+    if (state->has_rx_shift) {
+        peripheral_register_or_raw_value(state->reg.sr1, I2C_SR1_BTF);
+    } else {
+        peripheral_register_and_raw_value(state->reg.sr1, ~I2C_SR1_BTF);
+    }
+}
+
+// Keep received bytes that were not moved by the DMA in DR and the
+// shift register; the hardware cannot hold more.
+static void stm32_i2c_keep_rx(STM32I2CState *state, const uint8_t *data,
+        uint32_t count)
+{
+    uint32_t i;
+
+    for (i = 0; i < count; ++i) {
+        if (!(peripheral_register_get_raw_value(state->reg.sr1)
+                & I2C_SR1_RXNE)) {
+            peripheral_register_set_raw_value(state->reg.dr, data[i]);
+            peripheral_register_or_raw_value(state->reg.sr1, I2C_SR1_RXNE);
+        } else if (!state->has_rx_shift) {
+            state->rx_shift = data[i];
+            state->has_rx_shift = true;
+        } else {
+            qemu_log_mask(LOG_GUEST_ERROR,
+                    "I2C%d: %u received bytes lost, DMA transfer failed.\n",
+                    1 + state->i2c_index - STM32_I2C_1, count - i);
+            break;
+        }
+    }
+}
+
+static void stm32_i2c_stop(STM32I2CState *state)
+{
+    if (state->is_active) {
+        i2c_end_transfer(state->bus);
+    }
+    state->is_active = false;
+
+    peripheral_register_and_raw_value(state->reg.sr1,
+            ~(I2C_SR1_SB | I2C_SR1_ADDR | I2C_SR1_TXE | I2C_SR1_BTF));
+    peripheral_register_and_raw_value(state->reg.sr2,
+            ~(I2C_SR2_MSL | I2C_SR2_BUSY | I2C_SR2_TRA));
+}
+
+// Called by the DMA when a request is active and its channel enabled;
+// move all the bytes the channel has.
+static void stm32_i2c_dma_bulk_callback(void *opaque)
+{
+    STM32I2CState *state = STM32_I2C_STATE(opaque);
+
+    uint32_t cr2 = peripheral_register_get_raw_value(state->reg.cr2);
+    uint32_t sr1 = peripheral_register_get_raw_value(state->reg.sr1);
+
+    if (state->is_busy || !state->is_active || !(cr2 & I2C_CR2_DMAEN)
+            || (sr1 & I2C_SR1_ADDR)) {
+        return;
+    }
+
+    uint8_t buf[STM32_I2C_BLOCK_SIZE];
+    uint32_t count;
+    uint32_t i;
+
+    state->is_busy = true;
+
+    if (!state->is_receiver) {
+        count = stm32_dma_get_pending(state->dma_tx.dma, state->dma_tx.channel,
+                state->dma_tx.request, false);
+        while (count > 0) {
+            uint32_t n = stm32_dma_transfer_block(state->dma_tx.dma,
+                    state->dma_tx.channel, buf, 1,
+                    MIN(count, STM32_I2C_BLOCK_SIZE), false);
+            if (n == 0) {
+                break;
+            }
+            for (i = 0; i < n; ++i) {
+                if (!stm32_i2c_send_byte(state, buf[i])) {
+                    break;
+                }
+            }
+            if (i < n) {
+                break;
+            }
+            count -= n;
+        }
+    } else {
+        bool ack = (peripheral_register_get_raw_value(state->reg.cr1)
+                & I2C_CR1_ACK) != 0;
+        while (state->rx_ack) {
+            count = stm32_dma_get_pending(state->dma_rx.dma,
+                    state->dma_rx.channel, state->dma_rx.request, true);
+            if (count == 0) {
+                break;
+            }
+            uint32_t n = MIN(count, STM32_I2C_BLOCK_SIZE);
+            for (i = 0; i < n; ++i) {
+                // With LAST, the last byte of the DMA transfer is NACKed.
+                bool is_last = (count - i == 1) && (cr2 & I2C_CR2_LAST);
+                buf[i] = stm32_i2c_recv_byte(state, ack && !is_last);
+            }
+            uint32_t m = stm32_dma_transfer_block(state->dma_rx.dma,
+                    state->dma_rx.channel, buf, 1, n, true);
+            if (m < n) {
+                // The bytes already received stay in DR and the shift
+                // register, as when the DMA stops with the bus stretched.
+                stm32_i2c_keep_rx(state, buf + m, n - m);
+                break;
+            }
+        }
+        peripheral_register_or_raw_value(state->reg.sr1, I2C_SR1_BTF);
+    }
+
+    state->is_busy = false;
+
+    stm32_i2c_update_irq(state);
+}
+
+// ----------------------------------------------------------------------------
+
+// The error flags are cleared by writing 0, the others are read only.
+static peripheral_register_t stm32_i2c_sr1_pre_write_callback(Object *reg,
+        Object *periph, uint32_t addr, uint32_t offset, unsigned size,
+        peripheral_register_t value, peripheral_register_t full_value)
+{
+    return peripheral_register_get_raw_value(reg)
+            & (full_value | ~I2C_SR1_ERRORS);
+}
+
+// Reading SR2 after SR1 clears ADDR and starts the data phase.
+static void stm32_i2c_sr2_post_read_callback(Object *reg, Object *periph,
+        uint32_t addr, uint32_t offset, unsigned size)
+{
+    STM32I2CState *state = STM32_I2C_STATE(periph);
+
+    if (!(peripheral_register_get_raw_value(state->reg.sr1) & I2C_SR1_ADDR)) {
+        return;
+    }
+
+    peripheral_register_and_raw_value(state->reg.sr1, ~I2C_SR1_ADDR);
+
+    if (state->is_receiver) {
+        if (!(peripheral_register_get_raw_value(state->reg.cr2)
+                & I2C_CR2_DMAEN)) {
+            stm32_i2c_fill_rx(state);
+        }
+    } else {
+        peripheral_register_or_raw_value(state->reg.sr1, I2C_SR1_TXE);
+    }
+
+    stm32_i2c_update_irq(state);
+    stm32_i2c_update_dma_requests(state);
+}
+
+// Reading DR makes room for the next received byte.
+static void stm32_i2c_dr_post_read_callback(Object *reg, Object *periph,
+        uint32_t addr, uint32_t offset, unsigned size)
+{
+    STM32I2CState *state = STM32_I2C_STATE(periph);
+
+    if (!(peripheral_register_get_raw_value(state->reg.sr1) & I2C_SR1_RXNE)) {
+        return;
+    }
+
+    peripheral_register_and_raw_value(state->reg.sr1,
+            ~(I2C_SR1_RXNE | I2C_SR1_BTF));
+
+    if (state->is_receiver) {
+        stm32_i2c_fill_rx(state);
+    }
+
+    stm32_i2c_update_irq(state);
+}
+
+// Writing DR after START sends the address, otherwise a data byte.
+static void stm32_i2c_dr_post_write_callback(Object *reg, Object *periph,
+        uint32_t addr, uint32_t offset, unsigned size,
+        peripheral_register_t value, peripheral_register_t full_value)
+{
+    STM32I2CState *state = STM32_I2C_STATE(periph);
+
+    uint32_t sr1 = peripheral_register_get_raw_value(state->reg.sr1);
+
+    if (sr1 & I2C_SR1_SB) {
+        peripheral_register_and_raw_value(state->reg.sr1, ~I2C_SR1_SB);
+
+        bool recv = (full_value & 1) != 0;
+        if (i2c_start_transfer(state->bus, (full_value >> 1) & 0x7F, recv)
+                != 0) {
+            peripheral_register_or_raw_value(state->reg.sr1, I2C_SR1_AF);
+            state->is_active = false;
+        } else {
+            state->is_active = true;
+            state->is_receiver = recv;
+            state->rx_ack = true;
+            state->has_rx_shift = false;
+            peripheral_register_or_raw_value(state->reg.sr1, I2C_SR1_ADDR);
+            if (recv) {
+                peripheral_register_and_raw_value(state->reg.sr2,
+                        ~I2C_SR2_TRA);
+            } else {
+                peripheral_register_or_raw_value(state->reg.sr2, I2C_SR2_TRA);
+            }
+        }
+    } else if (state->is_active && !state->is_receiver
+            && !(sr1 & I2C_SR1_ADDR)) {
+        stm32_i2c_send_byte(state, full_value);
+    }
+
+    stm32_i2c_update_irq(state);
+    stm32_i2c_update_dma_requests(state);
+}
+
+// START and STOP are cleared by hardware once generated.
+static void stm32_i2c_cr1_post_write_callback(Object *reg, Object *periph,
+        uint32_t addr, uint32_t offset, unsigned size,
+        peripheral_register_t value, peripheral_register_t full_value)
+{
+    STM32I2CState *state = STM32_I2C_STATE(periph);
+
+    if (full_value & I2C_CR1_SWRST) {
+        stm32_i2c_stop(state);
+        peripheral_register_set_raw_value(state->reg.sr1, 0);
+        peripheral_register_set_raw_value(state->reg.sr2, 0);
+        state->has_rx_shift = false;
+        return;
+    }
+
+    if (!(full_value & I2C_CR1_PE)) {
+        return;
+    }
+
+    if (full_value & I2C_CR1_STOP) {
+        peripheral_register_and_raw_value(reg, ~I2C_CR1_STOP);
+        stm32_i2c_stop(state);
+    }
+
+    if (full_value & I2C_CR1_START) {
+        peripheral_register_and_raw_value(reg, ~I2C_CR1_START);
+        // A repeated start keeps the transfer active until the address.
+        peripheral_register_and_raw_value(state->reg.sr1,
+                ~(I2C_SR1_TXE | I2C_SR1_BTF));
+        peripheral_register_or_raw_value(state->reg.sr1, I2C_SR1_SB);
+        peripheral_register_or_raw_value(state->reg.sr2,
+                I2C_SR2_MSL | I2C_SR2_BUSY);
+        state->has_rx_shift = false;
+    }
+
+    stm32_i2c_update_irq(state);
+    stm32_i2c_update_dma_requests(state);
+}
+
+static void stm32_i2c_cr2_post_write_callback(Object *reg, Object *periph,
+        uint32_t addr, uint32_t offset, unsigned size,
+        peripheral_register_t value, peripheral_register_t full_value)
+{
+    STM32I2CState *state = STM32_I2C_STATE(periph);
+
+    stm32_i2c_update_irq(state);
+    stm32_i2c_update_dma_requests(state);
+}
+
+// ----------------------------------------------------------------------------
+
+static void stm32_i2c_instance_init_callback(Object *obj)
+{
+    qemu_log_function_name();
+
+    STM32I2CState *state = STM32_I2C_STATE(obj);
+
+    cm_object_property_add_int(obj, "i2c-index",
+            (const int *) &state->i2c_index);
+    state->i2c_index = STM32_I2C_UNDEFINED;
+}
+
+// The fixed DMA request mapping, per I2C.
+static const STM32DMARoute stm32f1_i2c_dma_tx[STM32_I2C_UNDEFINED] = {
+    { 0, 5, 0 },
+    { 0, 3, 0 },
+    { -1, 0, 0 },
+/**/
+};
+
+static const STM32DMARoute stm32f1_i2c_dma_rx[STM32_I2C_UNDEFINED] = {
+    { 0, 6, 0 },
+    { 0, 4, 0 },
+    { -1, 0, 0 },
+/**/
+};
+
+static const STM32DMARoute stm32f4_i2c_dma_tx[STM32_I2C_UNDEFINED] = {
+    { 0, 6, 1 },
+    { 0, 7, 7 },
+    { 0, 4, 3 },
+/**/
+};
+
+static const STM32DMARoute stm32f4_i2c_dma_rx[STM32_I2C_UNDEFINED] = {
+    { 0, 0, 1 },
+    { 0, 2, 7 },
+    { 0, 2, 3 },
+/**/
+};
+
+// Find the DMA channels for the I2C, if the controller exists, and
+// register the bulk handler with them.
+static void stm32_i2c_set_dma_routes(STM32I2CState *state)
+{
+    STM32MCUState *mcu = stm32_mcu_get();
+    const STM32DMARoute *tx;
+    const STM32DMARoute *rx;
+
+    state->dma_tx.dma = NULL;
+    state->dma_rx.dma = NULL;
+
+    if (state->capabilities->family == STM32_FAMILY_F4) {
+        tx = &stm32f4_i2c_dma_tx[state->i2c_index];
+        rx = &stm32f4_i2c_dma_rx[state->i2c_index];
+    } else {
+        tx = &stm32f1_i2c_dma_tx[state->i2c_index];
+        rx = &stm32f1_i2c_dma_rx[state->i2c_index];
+    }
+
+    if (tx->dma >= 0 && mcu->dma[tx->dma] != NULL) {
+        state->dma_tx.dma = OBJECT(mcu->dma[tx->dma]);
+        state->dma_tx.channel = tx->channel;
+        state->dma_tx.request = tx->request;
+        stm32_dma_set_bulk_handler(state->dma_tx.dma, tx->channel,
+                tx->request, stm32_i2c_dma_bulk_callback, state);
+    }
+    if (rx->dma >= 0 && mcu->dma[rx->dma] != NULL) {
+        state->dma_rx.dma = OBJECT(mcu->dma[rx->dma]);
+        state->dma_rx.channel = rx->channel;
+        state->dma_rx.request = rx->request;
+        stm32_dma_set_bulk_handler(state->dma_rx.dma, rx->channel,
+                rx->request, stm32_i2c_dma_bulk_callback, state);
+    }
+}
+
+// Create the slaves listed in the "devices" property for this I2C.
+static void stm32_i2c_create_devices(STM32I2CState *state,
+        const char *periph_name)
+{
+    if (state->devices == NULL || *state->devices == '\0') {
+        return;
+    }
+
+    gchar **entries = g_strsplit(state->devices, ";", 0);
+
+    int i;
+    for (i = 0; entries[i] != NULL; ++i) {
+        char *entry = g_strstrip(entries[i]);
+        if (*entry == '\0') {
+            continue;
+        }
+
+        char *type = strchr(entry, '=');
+        char *address_name = (type != NULL) ? strchr(type, '@') : NULL;
+        if (address_name == NULL) {
+            hw_error("I2C: invalid device '%s', expected "
+                    "I2Cn=<type>@<address>.\n", entry);
+        }
+        *type++ = '\0';
+        *address_name++ = '\0';
+        if (strcmp(entry, periph_name) != 0) {
+            continue;
+        }
+
+        char *end;
+        long address = strtol(address_name, &end, 0);
+        if (end == address_name || *end != '\0' || address < 0
+                || address > 0x7F) {
+            hw_error("%s: invalid address '%s'.\n", periph_name, address_name);
+        }
+
+        ObjectClass *oc = object_class_by_name(type);
+        if (oc == NULL || object_class_dynamic_cast(oc, TYPE_I2C_SLAVE) == NULL) {
+            hw_error("%s: '%s' is not an I2C device.\n", periph_name, type);
+        }
+
+        i2c_create_slave(state->bus, type, address);
+    }
+
+    g_strfreev(entries);
+}
+
+// Create the registers and bitfields; called at realize, or on first
+// access for lazy peripherals.
+static void stm32_i2c_create_registers(Object *obj)
+{
+    STM32MCUState *mcu = stm32_mcu_get();
+    CortexMState *cm_state = CORTEXM_MCU_STATE(mcu);
+
+    STM32I2CState *state = STM32_I2C_STATE(obj);
+
+    char periph_name[10];
+    snprintf(periph_name, sizeof(periph_name) - 1, "I2C%d",
+            1 + state->i2c_index - STM32_I2C_1);
+
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(
+            cm_state->svd_device, periph_name);
+    svd_add_peripheral_properties_and_children(obj, periph,
+            cm_state->svd_device);
+
+    // The register names are the same in F1 and F4.
+    state->reg.cr1 = cm_object_get_child_by_name(obj, "CR1");
+    state->reg.cr2 = cm_object_get_child_by_name(obj, "CR2");
+    state->reg.oar1 = cm_object_get_child_by_name(obj, "OAR1");
+    state->reg.oar2 = cm_object_get_child_by_name(obj, "OAR2");
+    state->reg.dr = cm_object_get_child_by_name(obj, "DR");
+    state->reg.sr1 = cm_object_get_child_by_name(obj, "SR1");
+    state->reg.sr2 = cm_object_get_child_by_name(obj, "SR2");
+    state->reg.ccr = cm_object_get_child_by_name(obj, "CCR");
+    state->reg.trise = cm_object_get_child_by_name(obj, "TRISE");
+
+    peripheral_register_set_pre_write(state->reg.sr1,
+            &stm32_i2c_sr1_pre_write_callback);
+    peripheral_register_set_post_read(state->reg.sr2,
+            &stm32_i2c_sr2_post_read_callback);
+    peripheral_register_set_post_read(state->reg.dr,
+            &stm32_i2c_dr_post_read_callback);
+    peripheral_register_set_post_write(state->reg.dr,
+            &stm32_i2c_dr_post_write_callback);
+    peripheral_register_set_post_write(state->reg.cr1,
+            &stm32_i2c_cr1_post_write_callback);
+    peripheral_register_set_post_write(state->reg.cr2,
+            &stm32_i2c_cr2_post_write_callback);
+
+    peripheral_prepare_registers(obj);
+}
+
+static void stm32_i2c_realize_callback(DeviceState *dev, Error **errp)
+{
+    qemu_log_function_name();
+
+    // Call parent realize().
+    if (!cm_device_parent_realize(dev, errp, TYPE_STM32_I2C)) {
+        return;
+    }
+
+    STM32MCUState *mcu = stm32_mcu_get();
+    CortexMState *cm_state = CORTEXM_MCU_STATE(mcu);
+
+    STM32I2CState *state = STM32_I2C_STATE(dev);
+    // First thing first: get capabilities from MCU, needed everywhere.
+    state->capabilities = mcu->capabilities;
+
+    const STM32Capabilities *capabilities = state->capabilities;
+    assert(capabilities != NULL);
+
+    Object *obj = OBJECT(dev);
+
+    state->nvic = CORTEXM_NVIC_STATE(cm_state->nvic);
+
+    // Event and error interrupts, the same on F1 and F4.
+    static const int irqs[STM32_I2C_UNDEFINED][2] = {
+        { STM32F10X_CL_I2C1_EV_IRQn, 32 },
+        { 33, 34 },
+        { STM32F4_01_57_XX_I2C3_EV_IRQn, 73 },
+    /**/
+    };
+
+    state->irq_ev = irqs[state->i2c_index][0];
+    state->irq_er = irqs[state->i2c_index][1];
+
+    char periph_name[10];
+    snprintf(periph_name, sizeof(periph_name) - 1, "I2C%d",
+            1 + state->i2c_index - STM32_I2C_1);
+
+    svd_set_peripheral_address_block(cm_state->svd_device, periph_name, obj);
+    peripheral_create_memory_region(obj);
+
+    char enabling_bit_name[STM32_RCC_SIZEOF_ENABLING_BITFIELD];
+    snprintf(enabling_bit_name, sizeof(enabling_bit_name) - 1,
+            DEVICE_PATH_STM32_RCC "/APB1ENR/I2C%dEN",
+            1 + state->i2c_index - STM32_I2C_1);
+
+    state->enabling_bit = OBJECT(cm_device_by_name(enabling_bit_name));
+
+    peripheral_populate_registers(obj, stm32_i2c_create_registers,
+            mcu->lazy_peripherals);
+
+    stm32_i2c_set_dma_routes(state);
+
+    state->bus = i2c_init_bus(dev, "i2c");
+    stm32_i2c_create_devices(state, periph_name);
+}
+
+static void stm32_i2c_reset_callback(DeviceState *dev)
+{
+    qemu_log_function_name();
+
+    STM32I2CState *state = STM32_I2C_STATE(dev);
+
+    // Call parent reset().
+    cm_device_parent_reset(dev, TYPE_STM32_I2C);
+
+    if (state->is_active) {
+        i2c_end_transfer(state->bus);
+    }
+    state->is_active = false;
+    state->is_receiver = false;
+    state->has_rx_shift = false;
+    state->is_busy = false;
+    // Drop the DMA requests, the DMA reset keeps the request lines.
+    if (state->dma_tx.dma != NULL && state->dma_tx.level) {
+        stm32_dma_set_request(state->dma_tx.dma, state->dma_tx.channel,
+                state->dma_tx.request, state, false);
+    }
+    if (state->dma_rx.dma != NULL && state->dma_rx.level) {
+        stm32_dma_set_request(state->dma_rx.dma, state->dma_rx.channel,
+                state->dma_rx.request, state, false);
+    }
+    state->dma_tx.level = false;
+    state->dma_rx.level = false;
+}
+
+static Property stm32_i2c_properties[] = {
+        DEFINE_PROP_STRING("devices", STM32I2CState, devices),
+    DEFINE_PROP_END_OF_LIST(), };
+
+static void stm32_i2c_class_init_callback(ObjectClass *klass, void *data)
+{
+    DeviceClass *dc = DEVICE_CLASS(klass);
+
+    dc->reset = stm32_i2c_reset_callback;
+    dc->realize = stm32_i2c_realize_callback;
+
+    dc->props = stm32_i2c_properties;
+
+    PeripheralClass *per_class = PERIPHERAL_CLASS(klass);
+    per_class->is_enabled = stm32_i2c_is_enabled;
+}
+
+static const TypeInfo stm32_i2c_type_info = {
+    .name = TYPE_STM32_I2C,
+    .parent = TYPE_STM32_I2C_PARENT,
+    .instance_init = stm32_i2c_instance_init_callback,
+    .instance_size = sizeof(STM32I2CState),
+    .class_init = stm32_i2c_class_init_callback,
+    .class_size = sizeof(STM32I2CClass)
+/**/
+};
+
+static void stm32_i2c_register_types(void)
+{
+    type_register_static(&stm32_i2c_type_info);
+}
+
+type_init(stm32_i2c_register_types);
+
+// ----------------------------------------------------------------------------
@@ -48,6 +48,41 @@ static void create_usart(STM32MCUState *state, stm32_usart_index_t index)
     state->usart[index] = DEVICE(stm32_usart_create(state->container, index));
 }
 
+// Create children DMA nodes.
+// Public names are "/machine/stm32/DMA%d".
+static void create_dma(STM32MCUState *state, stm32_dma_index_t index)
+{
+    state->dma[index] = DEVICE(stm32_dma_create(state->container, index));
+}
+
+// Create children ADC nodes.
+// Public names are "/machine/stm32/ADC%d".
+static void create_adc(STM32MCUState *state, stm32_adc_index_t index)
+{
+    state->adc[index] = DEVICE(stm32_adc_create(state->container, index));
+}
+
+// Create children SPI nodes.
+// Public names are "/machine/stm32/SPI%d".
+static void create_spi(STM32MCUState *state, stm32_spi_index_t index)
+{
+    state->spi[index] = DEVICE(stm32_spi_create(state->container, index));
+}
+
+// Create children I2C nodes.
+// Public names are "/machine/stm32/I2C%d".
+static void create_i2c(STM32MCUState *state, stm32_i2c_index_t index)
+{
+    state->i2c[index] = DEVICE(stm32_i2c_create(state->container, index));
+}
+
+// Create children TIM nodes.
+// Public names are "/machine/stm32/TIM%d".
+static void create_tim(STM32MCUState *state, stm32_tim_index_t index)
+{
+    state->tim[index] = DEVICE(stm32_tim_create(state->container, index));
+}
+
 // Constructor for all STM32 devices, based on capabilities.
 //
 // Alias the flash memory to 0x08000000.
@@ -114,6 +149,14 @@ static void stm32_mcu_realize_callback(DeviceState *dev, Error **errp)
     }
     qemu_log_mask(LOG_FUNC, "STM32 Family: %s\n", family);
 
+#if defined(CONFIG_VERBOSE)
+    if (verbosity_level >= VERBOSITY_COMMON) {
+        if (state->lazy_peripherals) {
+            printf("Lazy peripherals, registers created on first access.\n");
+        }
+    }
+#endif /* defined(CONFIG_VERBOSE) */
+
     // Devices will be addressed below "/machine/mcu/stm32".
     state->container = container_get(OBJECT(dev), "/stm32");
 
@@ -156,7 +199,7 @@ static void stm32_mcu_realize_callback(DeviceState *dev, Error **errp)
     }
 
     // RCC; assume the presence in SVD is enough.
-    if (svd_has_named_peripheral(cm_state->svd_json, "RCC")) {
+    if (svd_has_named_peripheral(cm_state->svd_device, "RCC")) {
         // RCC will be named "/machine/mcu/stm32/RCC"
         Object *rcc = cm_object_new(state->container, "RCC", TYPE_STM32_RCC);
 
@@ -176,7 +219,7 @@ static void stm32_mcu_realize_callback(DeviceState *dev, Error **errp)
     }
 
     // FLASH; assume the presence in SVD is enough.
-    if (svd_has_named_peripheral(cm_state->svd_json, "FLASH")) {
+    if (svd_has_named_peripheral(cm_state->svd_device, "FLASH")) {
         // FLASH will be named "/machine/mcu/stm32/FLASH"
         Object *flash = cm_object_new(state->container, "FLASH",
         TYPE_STM32_FLASH);
@@ -187,7 +230,7 @@ static void stm32_mcu_realize_callback(DeviceState *dev, Error **errp)
     }
 
     // PWR; assume the presence in SVD is enough.
-    if (svd_has_named_peripheral(cm_state->svd_json, "PWR")) {
+    if (svd_has_named_peripheral(cm_state->svd_device, "PWR")) {
         // PWRR will be named "/machine/mcu/stm32/PWR".
         Object *pwr = cm_object_new(state->container, "PWR",
         TYPE_STM32_PWR);
@@ -198,7 +241,7 @@ static void stm32_mcu_realize_callback(DeviceState *dev, Error **errp)
     }
 
     // SYSCFG; assume the presence in SVD is enough.
-    if (svd_has_named_peripheral(cm_state->svd_json, "SYSCFG")) {
+    if (svd_has_named_peripheral(cm_state->svd_device, "SYSCFG")) {
         // SYSCFG will be named "/machine/mcu/stm32/SYSCFG".
         // It controls, among other, which GPIO pins are
         // connected to EXTI.
@@ -211,7 +254,7 @@ static void stm32_mcu_realize_callback(DeviceState *dev, Error **errp)
     }
 
     // AFIO; assume the presence in SVD is enough.
-    if (svd_has_named_peripheral(cm_state->svd_json, "AFIO")) {
+    if (svd_has_named_peripheral(cm_state->svd_device, "AFIO")) {
         // SYSCFG will be named "/machine/mcu/stm32/AFIO".
         // It controls, among other, which GPIO pins are
         // connected to EXTI.
@@ -224,7 +267,7 @@ static void stm32_mcu_realize_callback(DeviceState *dev, Error **errp)
     }
 
     // EXTI; assume the presence in SVD is enough.
-    if (svd_has_named_peripheral(cm_state->svd_json, "EXTI")) {
+    if (svd_has_named_peripheral(cm_state->svd_device, "EXTI")) {
         // EXTI will be named "/machine/mcu/stm32/EXTI".
         // It is referred by the GPIOs, to forward interrupts, so
         // it must be constructed before the GPIOs.
@@ -241,132 +284,255 @@ static void stm32_mcu_realize_callback(DeviceState *dev, Error **errp)
     // The presence in SVD is maximal, must be validated by capabilities.
     // GPIOA
     if (capabilities->has_gpioa
-            && svd_has_named_peripheral(cm_state->svd_json, "GPIOA")) {
+            && svd_has_named_peripheral(cm_state->svd_device, "GPIOA")) {
         create_gpio(state, STM32_PORT_GPIOA);
         state->num_gpio = 1;
     }
 
     // GPIOB
     if (capabilities->has_gpiob
-            && svd_has_named_peripheral(cm_state->svd_json, "GPIOB")) {
+            && svd_has_named_peripheral(cm_state->svd_device, "GPIOB")) {
         create_gpio(state, STM32_PORT_GPIOB);
         state->num_gpio = 2;
     }
 
     // GPIOC
     if (capabilities->has_gpioc
-            && svd_has_named_peripheral(cm_state->svd_json, "GPIOC")) {
+            && svd_has_named_peripheral(cm_state->svd_device, "GPIOC")) {
         create_gpio(state, STM32_PORT_GPIOC);
         state->num_gpio = 3;
     }
 
     // GPIOD
     if (capabilities->has_gpiod
-            && svd_has_named_peripheral(cm_state->svd_json, "GPIOD")) {
+            && svd_has_named_peripheral(cm_state->svd_device, "GPIOD")) {
         create_gpio(state, STM32_PORT_GPIOD);
         state->num_gpio = 4;
     }
 
     // GPIOE
     if (capabilities->has_gpioe
-            && svd_has_named_peripheral(cm_state->svd_json, "GPIOE")) {
+            && svd_has_named_peripheral(cm_state->svd_device, "GPIOE")) {
         create_gpio(state, STM32_PORT_GPIOE);
         state->num_gpio = 5;
     }
 
     // GPIOF
     if (capabilities->has_gpiof
-            && svd_has_named_peripheral(cm_state->svd_json, "GPIOF")) {
+            && svd_has_named_peripheral(cm_state->svd_device, "GPIOF")) {
         create_gpio(state, STM32_PORT_GPIOF);
         state->num_gpio = 6;
     }
 
     // GPIOG
     if (capabilities->has_gpiog
-            && svd_has_named_peripheral(cm_state->svd_json, "GPIOG")) {
+            && svd_has_named_peripheral(cm_state->svd_device, "GPIOG")) {
         create_gpio(state, STM32_PORT_GPIOG);
         state->num_gpio = 7;
     }
 
     // GPIOH
     if (capabilities->has_gpioh
-            && svd_has_named_peripheral(cm_state->svd_json, "GPIOH")) {
+            && svd_has_named_peripheral(cm_state->svd_device, "GPIOH")) {
         create_gpio(state, STM32_PORT_GPIOH);
         state->num_gpio = 8;
     }
 
     // GPIOI
     if (capabilities->has_gpioi
-            && svd_has_named_peripheral(cm_state->svd_json, "GPIOI")) {
+            && svd_has_named_peripheral(cm_state->svd_device, "GPIOI")) {
         create_gpio(state, STM32_PORT_GPIOI);
         state->num_gpio = 9;
     }
 
     // GPIOJ
     if (capabilities->has_gpioj
-            && svd_has_named_peripheral(cm_state->svd_json, "GPIOJ")) {
+            && svd_has_named_peripheral(cm_state->svd_device, "GPIOJ")) {
         create_gpio(state, STM32_PORT_GPIOJ);
         state->num_gpio = 10;
     }
 
     // GPIOK
     if (capabilities->has_gpiok
-            && svd_has_named_peripheral(cm_state->svd_json, "GPIOK")) {
+            && svd_has_named_peripheral(cm_state->svd_device, "GPIOK")) {
         create_gpio(state, STM32_PORT_GPIOK);
         state->num_gpio = 11;
     }
 
+    // The host link to the GPIO pins, after the ports, which it
+    // registers with. Public name is "/machine/stm32/GPIO-LINK".
+    state->gpio_link = DEVICE(stm32_gpio_link_create(state->container));
+
+    // The DMA controllers are created before the peripherals that
+    // use them.
+    // F0 devices have a single controller, with has_dma.
+    if ((capabilities->has_dma || capabilities->has_dma1)
+            && svd_has_named_peripheral(cm_state->svd_device, "DMA1")) {
+        create_dma(state, STM32_DMA_1);
+    }
+
+    if (capabilities->has_dma2
+            && svd_has_named_peripheral(cm_state->svd_device, "DMA2")) {
+        create_dma(state, STM32_DMA_2);
+    }
+
     // The presence in SVD is maximal, must be validated by capabilities.
     // USART1
     if (capabilities->has_usart1
-            && svd_has_named_peripheral(cm_state->svd_json, "USART1")) {
+            && svd_has_named_peripheral(cm_state->svd_device, "USART1")) {
         create_usart(state, STM32_PORT_USART1);
     }
 
     // USART2
     if (capabilities->has_usart2
-            && svd_has_named_peripheral(cm_state->svd_json, "USART2")) {
+            && svd_has_named_peripheral(cm_state->svd_device, "USART2")) {
         create_usart(state, STM32_PORT_USART2);
     }
 
     // USART3
     if (capabilities->has_usart3
-            && svd_has_named_peripheral(cm_state->svd_json, "USART3")) {
+            && svd_has_named_peripheral(cm_state->svd_device, "USART3")) {
         create_usart(state, STM32_PORT_USART3);
     }
 
     // USART4
     if (capabilities->has_usart4
-            && svd_has_named_peripheral(cm_state->svd_json, "USART4")) {
+            && svd_has_named_peripheral(cm_state->svd_device, "USART4")) {
         create_usart(state, STM32_PORT_USART4);
     }
 
     // USART5
     if (capabilities->has_usart5
-            && svd_has_named_peripheral(cm_state->svd_json, "USART5")) {
+            && svd_has_named_peripheral(cm_state->svd_device, "USART5")) {
         create_usart(state, STM32_PORT_USART5);
     }
 
     // USART6
     if (capabilities->has_usart6
-            && svd_has_named_peripheral(cm_state->svd_json, "USART6")) {
+            && svd_has_named_peripheral(cm_state->svd_device, "USART6")) {
         create_usart(state, STM32_PORT_USART6);
     }
 
     // USART7
     if (capabilities->has_usart7
-            && svd_has_named_peripheral(cm_state->svd_json, "USART7")) {
+            && svd_has_named_peripheral(cm_state->svd_device, "USART7")) {
         create_usart(state, STM32_PORT_USART7);
     }
 
     // USART8
     if (capabilities->has_usart8
-            && svd_has_named_peripheral(cm_state->svd_json, "USART8")) {
+            && svd_has_named_peripheral(cm_state->svd_device, "USART8")) {
         create_usart(state, STM32_PORT_USART8);
     }
 
     // UARTS are separate from USARTS
 
+    // The presence in SVD is maximal, must be validated by capabilities.
+    // TIM1-TIM17
+    {
+        const bool has_tim[STM32_MAX_TIM] = {
+            capabilities->has_ac_tim1,
+            capabilities->has_gp_tim2,
+            capabilities->has_gp_tim3,
+            capabilities->has_gp_tim4,
+            capabilities->has_gp_tim5,
+            capabilities->has_bc_tim6,
+            capabilities->has_bc_tim7,
+            capabilities->has_ac_tim8,
+            capabilities->has_gp_tim9,
+            capabilities->has_gp_tim10,
+            capabilities->has_gp_tim11,
+            capabilities->has_gp_tim12,
+            capabilities->has_gp_tim13,
+            capabilities->has_gp_tim14,
+            capabilities->has_gp_tim15,
+            capabilities->has_gp_tim16,
+            capabilities->has_gp_tim17,
+        /**/
+        };
+
+        int i;
+        for (i = 0; i < STM32_MAX_TIM; ++i) {
+            char tim_name[10];
+            snprintf(tim_name, sizeof(tim_name) - 1, "TIM%d", i + 1);
+            if (has_tim[i]
+                    && svd_has_named_peripheral(cm_state->svd_device,
+                            tim_name)) {
+                create_tim(state, STM32_TIM_1 + i);
+            }
+        }
+    }
+
+    // The presence in SVD is maximal, must be validated by capabilities.
+    // ADC1-ADC3; the F0 ADC, with has_adc, has a different layout
+    // and is not yet implemented.
+    {
+        const bool has_adc[STM32_MAX_ADC] = {
+            capabilities->has_adc1,
+            capabilities->has_adc2,
+            capabilities->has_adc3,
+        /**/
+        };
+
+        int i;
+        for (i = 0; i < STM32_MAX_ADC; ++i) {
+            char adc_name[10];
+            snprintf(adc_name, sizeof(adc_name) - 1, "ADC%d", i + 1);
+            if (has_adc[i]
+                    && svd_has_named_peripheral(cm_state->svd_device,
+                            adc_name)) {
+                create_adc(state, STM32_ADC_1 + i);
+            }
+        }
+    }
+
+    // SPI1-SPI6.
+    {
+        const bool has_spi[STM32_MAX_SPI] = {
+            capabilities->has_spi1,
+            capabilities->has_spi2,
+            capabilities->has_spi3,
+            capabilities->has_spi4,
+            capabilities->has_spi5,
+            capabilities->has_spi6,
+        /**/
+        };
+
+        int i;
+        for (i = 0; i < STM32_MAX_SPI; ++i) {
+            char spi_name[10];
+            snprintf(spi_name, sizeof(spi_name) - 1, "SPI%d", i + 1);
+            if (has_spi[i]
+                    && svd_has_named_peripheral(cm_state->svd_device,
+                            spi_name)) {
+                create_spi(state, STM32_SPI_1 + i);
+            }
+        }
+    }
+
+    // I2C1-I2C3; the F0 I2C has a different layout and is not yet
+    // implemented.
+    if (capabilities->family == STM32_FAMILY_F1
+            || capabilities->family == STM32_FAMILY_F4) {
+        const bool has_i2c[STM32_MAX_I2C] = {
+            capabilities->has_i2c1,
+            capabilities->has_i2c2,
+            capabilities->has_i2c3,
+        /**/
+        };
+
+        int i;
+        for (i = 0; i < STM32_MAX_I2C; ++i) {
+            char i2c_name[10];
+            snprintf(i2c_name, sizeof(i2c_name) - 1, "I2C%d", i + 1);
+            if (has_i2c[i]
+                    && svd_has_named_peripheral(cm_state->svd_device,
+                            i2c_name)) {
+                create_i2c(state, STM32_I2C_1 + i);
+            }
+        }
+    }
+
     // TODO: add more devices.
 
 }
@@ -409,6 +575,8 @@ static void stm32_mcu_memory_regions_create_callback(DeviceState *dev)
 static Property stm32_mcu_properties[] = {
         DEFINE_PROP_STM32CAPABILITIES_PTR("stm32-capabilities",
                 STM32MCUState, param_capabilities),
+        DEFINE_PROP_BOOL("lazy-peripherals", STM32MCUState, lazy_peripherals,
+                false),
     DEFINE_PROP_END_OF_LIST(), /**/
 };
 
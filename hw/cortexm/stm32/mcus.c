@@ -789,6 +789,9 @@ static const STM32Capabilities stm32f429xx = {
     .has_spi1 = true,
     .has_spi2 = true,
     .has_spi3 = true,
+    .has_spi4 = true,
+    .has_spi5 = true,
+    .has_spi6 = true,
     .has_i2s1 = true,
     .has_i2s2 = true,
     .has_plli2s = true,
@@ -32,12 +32,12 @@
 //
 // STM32F051R8
 // DO NOT EDIT! Automatically generated!
-static void stm32f0x1_pwr_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f0x1_pwr_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32PWRState *state = STM32_PWR_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -91,12 +91,12 @@ static void stm32f0x1_pwr_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F072CB
 // DO NOT EDIT! Automatically generated!
-static void stm32f0x2_pwr_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f0x2_pwr_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32PWRState *state = STM32_PWR_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -148,12 +148,12 @@ static void stm32f0x2_pwr_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F103RB
 // DO NOT EDIT! Automatically generated!
-static void stm32f103xx_pwr_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f103xx_pwr_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32PWRState *state = STM32_PWR_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -191,12 +191,12 @@ static void stm32f103xx_pwr_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F107VC
 // DO NOT EDIT! Automatically generated!
-static void stm32f107xx_pwr_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f107xx_pwr_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32PWRState *state = STM32_PWR_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -234,12 +234,12 @@ static void stm32f107xx_pwr_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F407VG, STM32F407ZG, STM32F405RG
 // DO NOT EDIT! Automatically generated!
-static void stm32f40x_pwr_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f40x_pwr_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32PWRState *state = STM32_PWR_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -285,12 +285,12 @@ static void stm32f40x_pwr_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F411RE
 // DO NOT EDIT! Automatically generated!
-static void stm32f411xx_pwr_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f411xx_pwr_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32PWRState *state = STM32_PWR_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -340,12 +340,12 @@ static void stm32f411xx_pwr_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F429ZI
 // DO NOT EDIT! Automatically generated!
-static void stm32f429x_pwr_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f429x_pwr_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32PWRState *state = STM32_PWR_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -415,30 +415,19 @@ static void stm32_pwr_instance_init_callback(Object *obj)
 
 }
 
-static void stm32_pwr_realize_callback(DeviceState *dev, Error **errp)
+// Create the registers and bitfields; called at realize, or on first
+// access for lazy peripherals.
+static void stm32_pwr_create_registers(Object *obj)
 {
-    qemu_log_function_name();
-
-    // Call parent realize().
-    if (!cm_device_parent_realize(dev, errp, TYPE_STM32_PWR)) {
-        return;
-    }
-
     STM32MCUState *mcu = stm32_mcu_get();
     CortexMState *cm_state = CORTEXM_MCU_STATE(mcu);
 
-    STM32PWRState *state = STM32_PWR_STATE(dev);
-    // First thing first: get capabilities from MCU, needed everywhere.
-    state->capabilities = mcu->capabilities;
+    STM32PWRState *state = STM32_PWR_STATE(obj);
 
     const STM32Capabilities *capabilities = state->capabilities;
     assert(capabilities != NULL);
 
-    Object *obj = OBJECT(dev);
-
     const char *periph_name = "PWR";
-    svd_set_peripheral_address_block(cm_state->svd_json, periph_name, obj);
-    peripheral_create_memory_region(obj);
 
     switch (capabilities->family) {
 
@@ -446,11 +435,11 @@ static void stm32_pwr_realize_callback(DeviceState *dev, Error **errp)
 
         if (capabilities->f0.is_0x1) {
 
-            stm32f0x1_pwr_create_objects(obj, cm_state->svd_json, periph_name);
+            stm32f0x1_pwr_create_objects(obj, cm_state->svd_device, periph_name);
 
         } else if (capabilities->f0.is_0x2) {
 
-            stm32f0x2_pwr_create_objects(obj, cm_state->svd_json, periph_name);
+            stm32f0x2_pwr_create_objects(obj, cm_state->svd_device, periph_name);
 
         } else {
             assert(false);
@@ -462,12 +451,12 @@ static void stm32_pwr_realize_callback(DeviceState *dev, Error **errp)
 
         if (capabilities->f1.is_103xx) {
 
-            stm32f103xx_pwr_create_objects(obj, cm_state->svd_json,
+            stm32f103xx_pwr_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
         } else if (capabilities->f1.is_107xx) {
 
-            stm32f107xx_pwr_create_objects(obj, cm_state->svd_json,
+            stm32f107xx_pwr_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
         } else {
@@ -480,16 +469,16 @@ static void stm32_pwr_realize_callback(DeviceState *dev, Error **errp)
 
         if (capabilities->f4.is_40x) {
 
-            stm32f40x_pwr_create_objects(obj, cm_state->svd_json, periph_name);
+            stm32f40x_pwr_create_objects(obj, cm_state->svd_device, periph_name);
 
         } else if (capabilities->f4.is_411xx) {
 
-            stm32f411xx_pwr_create_objects(obj, cm_state->svd_json,
+            stm32f411xx_pwr_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
         } else if (capabilities->f4.is_429x) {
 
-            stm32f429x_pwr_create_objects(obj, cm_state->svd_json, periph_name);
+            stm32f429x_pwr_create_objects(obj, cm_state->svd_device, periph_name);
 
         } else {
             assert(false);
@@ -508,6 +497,35 @@ static void stm32_pwr_realize_callback(DeviceState *dev, Error **errp)
     peripheral_prepare_registers(obj);
 }
 
+static void stm32_pwr_realize_callback(DeviceState *dev, Error **errp)
+{
+    qemu_log_function_name();
+
+    // Call parent realize().
+    if (!cm_device_parent_realize(dev, errp, TYPE_STM32_PWR)) {
+        return;
+    }
+
+    STM32MCUState *mcu = stm32_mcu_get();
+    CortexMState *cm_state = CORTEXM_MCU_STATE(mcu);
+
+    STM32PWRState *state = STM32_PWR_STATE(dev);
+    // First thing first: get capabilities from MCU, needed everywhere.
+    state->capabilities = mcu->capabilities;
+
+    const STM32Capabilities *capabilities = state->capabilities;
+    assert(capabilities != NULL);
+
+    Object *obj = OBJECT(dev);
+
+    const char *periph_name = "PWR";
+    svd_set_peripheral_address_block(cm_state->svd_device, periph_name, obj);
+    peripheral_create_memory_region(obj);
+
+    peripheral_populate_registers(obj, stm32_pwr_create_registers,
+            mcu->lazy_peripherals);
+}
+
 static void stm32_pwr_reset_callback(DeviceState *dev)
 {
     qemu_log_function_name();
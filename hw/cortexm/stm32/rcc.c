@@ -43,12 +43,12 @@
 //
 // STM32F051R8
 // DO NOT EDIT! Automatically generated!
-static void stm32f0x1_rcc_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f0x1_rcc_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32RCCState *state = STM32_RCC_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -398,12 +398,12 @@ static void stm32f0x1_rcc_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F072CB
 // DO NOT EDIT! Automatically generated!
-static void stm32f0x2_rcc_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f0x2_rcc_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32RCCState *state = STM32_RCC_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -733,12 +733,12 @@ static void stm32f0x2_rcc_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F103RB
 // DO NOT EDIT! Automatically generated!
-static void stm32f103xx_rcc_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f103xx_rcc_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32RCCState *state = STM32_RCC_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -1062,12 +1062,12 @@ static void stm32f103xx_rcc_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F107VC
 // DO NOT EDIT! Automatically generated!
-static void stm32f107xx_rcc_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f107xx_rcc_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32RCCState *state = STM32_RCC_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -1399,12 +1399,12 @@ static void stm32f107xx_rcc_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F407VG, STM32F407ZG, STM32F405RG
 // DO NOT EDIT! Automatically generated!
-static void stm32f40x_rcc_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f40x_rcc_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32RCCState *state = STM32_RCC_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -1969,12 +1969,12 @@ static void stm32f40x_rcc_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F411RE
 // DO NOT EDIT! Automatically generated!
-static void stm32f411xx_rcc_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f411xx_rcc_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32RCCState *state = STM32_RCC_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -2384,12 +2384,12 @@ static void stm32f411xx_rcc_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F429ZI
 // DO NOT EDIT! Automatically generated!
-static void stm32f429x_rcc_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f429x_rcc_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32RCCState *state = STM32_RCC_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -3046,6 +3046,77 @@ static void stm32f429x_rcc_create_objects(Object *obj, JSON_Object *svd,
             state->u.f4.reg.dckcfgr, "TIMPRE");
 }
 
+// ----- Public ---------------------------------------------------------------
+
+static uint8_t APBPrescTable[8] = {
+    0,
+    0,
+    0,
+    0,
+    1,
+    2,
+    3,
+    4
+/**/
+};
+
+// Return the APB1 or APB2 prescaler, as a shift count. F0 devices
+// have a single APB bus, returned for both.
+static int stm32_rcc_get_apb_shift(STM32RCCState *state, int apb)
+{
+    Object *ppre;
+
+    switch (state->capabilities->family) {
+    case STM32_FAMILY_F0:
+        ppre = state->u.f0.fld.cfgr.ppre;
+        break;
+    case STM32_FAMILY_F1:
+        ppre = (apb == 2) ?
+                state->u.f1.fld.cfgr.ppre2 : state->u.f1.fld.cfgr.ppre1;
+        break;
+    case STM32_FAMILY_F4:
+        ppre = (apb == 2) ?
+                state->u.f4.fld.cfgr.ppre2 : state->u.f4.fld.cfgr.ppre1;
+        break;
+    default:
+        ppre = NULL;
+        break;
+    }
+
+    if (ppre == NULL) {
+        return 0;
+    }
+    return APBPrescTable[register_bitfield_read_value(ppre) & 0x7];
+}
+
+// The getters below return the clock tree cached by the last
+// recomputation, without reading any register.
+
+// Return the frequency of the APB1 or APB2 bus (PCLK1/PCLK2).
+uint32_t stm32_rcc_get_apb_freq_hz(STM32RCCState *state, int apb)
+{
+    return state->clocks.pclk_hz[(apb == 2) ? 1 : 0];
+}
+
+// Return the clock of the timers on the APB1 or APB2 bus.
+uint32_t stm32_rcc_get_apb_tim_freq_hz(STM32RCCState *state, int apb)
+{
+    return state->clocks.tim_hz[(apb == 2) ? 1 : 0];
+}
+
+// Return the ADC clock.
+uint32_t stm32_rcc_get_adc_freq_hz(STM32RCCState *state)
+{
+    return state->clocks.adc_hz;
+}
+
+// Register a callback, called with the RCC state after the clock
+// tree changes; not called for peripheral enable changes.
+void stm32_rcc_add_clock_notifier(STM32RCCState *state, Notifier *notifier)
+{
+    notifier_list_add(&state->clock_notifiers, notifier);
+}
+
 // ----- Private --------------------------------------------------------------
 
 // For all other peripherals,
@@ -3078,12 +3149,46 @@ extern int system_clock_scale;
 
 // ----------------------------------------------------------------------------
 
-// Recompute the system clock, after each change in the RCC registers.
+// Derive the bus clocks from SYSCLK and HCLK; if a bus is divided,
+// the timers on it get twice its frequency.
+static void stm32_rcc_compute_bus_clocks(STM32RCCState *state,
+        STM32RCCClocks *clocks)
+{
+    int apb;
+    for (apb = 0; apb < 2; ++apb) {
+        int shift = stm32_rcc_get_apb_shift(state, apb + 1);
+
+        clocks->pclk_hz[apb] = clocks->hclk_hz >> shift;
+        clocks->tim_hz[apb] =
+                (shift == 0) ? clocks->hclk_hz : clocks->hclk_hz >> (shift - 1);
+    }
+
+    // On F1 the ADC clock is PCLK2 divided by ADCPRE; on F4 the prescaler
+    // is in the common ADC registers, not emulated, and the reset value
+    // (/2) is used; F0 uses the dedicated 14 MHz HSI.
+    switch (state->capabilities->family) {
+    case STM32_FAMILY_F0:
+        clocks->adc_hz = 14000000;
+        break;
+    case STM32_FAMILY_F1:
+        clocks->adc_hz = clocks->pclk_hz[1]
+                / (2 * (1 + register_bitfield_read_value(
+                        state->u.f1.fld.cfgr.adcpre)));
+        break;
+    default:
+        clocks->adc_hz = clocks->pclk_hz[1] / 2;
+        break;
+    }
+}
+
+// Recompute the clock tree, after each change in the clock registers,
+// and notify the peripherals if anything changed.
 // The code is inspired by CMSIS init sequences.
 static void stm32_rcc_update_clocks(STM32RCCState *state)
 {
     const STM32Capabilities *capabilities = state->capabilities;
 
+    uint32_t sysclk_hz = 0;
     uint32_t cpu_freq_hz = 0;
     uint32_t pre_scaler;
 
@@ -3137,6 +3242,7 @@ static void stm32_rcc_update_clocks(STM32RCCState *state)
             }
         }
         }
+        sysclk_hz = cpu_freq_hz;
         pre_scaler = AHBPrescTable[register_bitfield_read_value(
                 state->u.f0.fld.cfgr.hpre)];
         // HCLK frequency
@@ -3248,6 +3354,8 @@ static void stm32_rcc_update_clocks(STM32RCCState *state)
             break;
         }
 
+        sysclk_hz = cpu_freq_hz;
+
         // Compute HCLK clock frequency. Get HCLK pre-scaler.
         pre_scaler = AHBPrescTable[register_bitfield_read_value(
                 state->u.f1.fld.cfgr.hpre)];
@@ -3303,6 +3411,8 @@ static void stm32_rcc_update_clocks(STM32RCCState *state)
             cpu_freq_hz = state->hsi_freq_hz;
             break;
         }
+        sysclk_hz = cpu_freq_hz;
+
         // Compute HCLK clock frequency. Get HCLK pre-scaler.
         pre_scaler = AHBPrescTable[register_bitfield_read_value(
                 state->u.f4.fld.cfgr.hpre)];
@@ -3318,6 +3428,7 @@ static void stm32_rcc_update_clocks(STM32RCCState *state)
 
     if (cpu_freq_hz == 0) {
         cpu_freq_hz = state->hsi_freq_hz; // Should be non-zero.
+        sysclk_hz = cpu_freq_hz;
     }
     state->cpu_freq_hz = cpu_freq_hz;
 
@@ -3327,6 +3438,20 @@ static void stm32_rcc_update_clocks(STM32RCCState *state)
     }
     qemu_log_mask(LOG_FUNC, "%s() %d, system_clock_scale=%d\n", __FUNCTION__,
             cpu_freq_hz, system_clock_scale);
+
+    // With -cycle-model, the virtual clock counts core cycles.
+    cpu_icount_set_cycle_hz(cpu_freq_hz);
+
+    STM32RCCClocks clocks;
+    memset(&clocks, 0, sizeof(clocks));
+    clocks.sysclk_hz = sysclk_hz;
+    clocks.hclk_hz = cpu_freq_hz;
+    stm32_rcc_compute_bus_clocks(state, &clocks);
+
+    if (memcmp(&clocks, &state->clocks, sizeof(clocks)) != 0) {
+        state->clocks = clocks;
+        notifier_list_notify(&state->clock_notifiers, state);
+    }
 }
 
 static void stm32_rcc_post_write_callback(Object *reg, Object *periph,
@@ -3334,7 +3459,25 @@ static void stm32_rcc_post_write_callback(Object *reg, Object *periph,
         peripheral_register_t value, peripheral_register_t full_value)
 {
     STM32RCCState *state = STM32_RCC_STATE(periph);
-    stm32_rcc_update_clocks(state);
+
+    // Rewriting the same value (like polling loops that set an
+    // already set bit) cannot change the clocks.
+    if (peripheral_register_get_raw_value(reg)
+            != peripheral_register_get_raw_prev_value(reg)) {
+        stm32_rcc_update_clocks(state);
+    }
+
+    peripheral_invalidate_enabled_cache();
+}
+
+// Writes to registers without specific actions may still change
+// the peripheral enabling bits (the xxxENR registers), so the
+// cached enabled status must be recomputed.
+static void stm32_rcc_enable_post_write_callback(Object *reg, Object *periph,
+        uint32_t addr, uint32_t offset, unsigned size,
+        peripheral_register_t value, peripheral_register_t full_value)
+{
+    peripheral_invalidate_enabled_cache();
 }
 
 // ----------------------------------------------------------------------------
@@ -3356,6 +3499,8 @@ static void stm32_rcc_instance_init_callback(Object *obj)
 
     cm_object_property_add_uint32(obj, "lsi-freq-hz", &state->lsi_freq_hz);
     state->lsi_freq_hz = 0;
+
+    notifier_list_init(&state->clock_notifiers);
 }
 
 static void stm32_rcc_realize_callback(DeviceState *dev, Error **errp)
@@ -3380,7 +3525,7 @@ static void stm32_rcc_realize_callback(DeviceState *dev, Error **errp)
     Object *obj = OBJECT(dev);
 
     const char *periph_name = "RCC";
-    svd_set_peripheral_address_block(cm_state->svd_json, periph_name, obj);
+    svd_set_peripheral_address_block(cm_state->svd_device, periph_name, obj);
     peripheral_create_memory_region(obj);
 
     // Must be defined before creating registers.
@@ -3406,11 +3551,11 @@ static void stm32_rcc_realize_callback(DeviceState *dev, Error **errp)
 
         if (capabilities->f0.is_0x1) {
 
-            stm32f0x1_rcc_create_objects(obj, cm_state->svd_json, periph_name);
+            stm32f0x1_rcc_create_objects(obj, cm_state->svd_device, periph_name);
 
         } else if (capabilities->f0.is_0x2) {
 
-            stm32f0x2_rcc_create_objects(obj, cm_state->svd_json, periph_name);
+            stm32f0x2_rcc_create_objects(obj, cm_state->svd_device, periph_name);
 
         } else {
             assert(false);
@@ -3486,12 +3631,12 @@ static void stm32_rcc_realize_callback(DeviceState *dev, Error **errp)
 
         if (capabilities->f1.is_103xx) {
 
-            stm32f103xx_rcc_create_objects(obj, cm_state->svd_json,
+            stm32f103xx_rcc_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
         } else if (capabilities->f1.is_107xx) {
 
-            stm32f107xx_rcc_create_objects(obj, cm_state->svd_json,
+            stm32f107xx_rcc_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
             // Add callbacks.
@@ -3572,16 +3717,16 @@ static void stm32_rcc_realize_callback(DeviceState *dev, Error **errp)
 
         if (capabilities->f4.is_40x) {
 
-            stm32f40x_rcc_create_objects(obj, cm_state->svd_json, periph_name);
+            stm32f40x_rcc_create_objects(obj, cm_state->svd_device, periph_name);
 
         } else if (capabilities->f4.is_411xx) {
 
-            stm32f411xx_rcc_create_objects(obj, cm_state->svd_json,
+            stm32f411xx_rcc_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
         } else if (capabilities->f4.is_429x) {
 
-            stm32f429x_rcc_create_objects(obj, cm_state->svd_json, periph_name);
+            stm32f429x_rcc_create_objects(obj, cm_state->svd_device, periph_name);
 
             // Auto bits.
             cm_object_property_set_str(state->u.f4.fld.cir.pllsairdyf,
@@ -3655,6 +3800,16 @@ static void stm32_rcc_realize_callback(DeviceState *dev, Error **errp)
     }
 
     peripheral_prepare_registers(obj);
+
+    PeripheralState *periph_state = PERIPHERAL_STATE(obj);
+    int i;
+    for (i = 0; i < periph_state->num_registers; ++i) {
+        PeripheralRegisterState *reg = periph_state->register_list[i];
+        if (reg->post_write == NULL) {
+            peripheral_register_set_post_write(OBJECT(reg),
+                    &stm32_rcc_enable_post_write_callback);
+        }
+    }
 }
 
 static void stm32_rcc_reset_callback(DeviceState *dev)
@@ -3667,6 +3822,9 @@ static void stm32_rcc_reset_callback(DeviceState *dev)
     STM32RCCState *state = STM32_RCC_STATE(dev);
 
     stm32_rcc_update_clocks(state);
+
+    // Reset values of the enabling bits may differ from the current ones.
+    peripheral_invalidate_enabled_cache();
 }
 
 static void stm32_rcc_class_init_callback(ObjectClass *klass, void *data)
@@ -0,0 +1,754 @@
+/*
+ * STM32 MCU - SPI (serial peripheral interface) emulation.
+ *
+ * Copyright (c) 2017 Liviu Ionescu.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <hw/cortexm/stm32/spi.h>
+#include <hw/cortexm/stm32/mcu.h>
+#include <hw/cortexm/stm32/gpio.h>
+#include <hw/cortexm/helper.h>
+#include <hw/cortexm/svd.h>
+
+#include "qemu/host-utils.h"
+#include "qemu/bswap.h"
+
+/*
+ * This file implements the master mode of the F0/F1/F4 SPIs.
+ *
+ * The slaves are QEMU SSI devices, on a bus owned by each SPI; each
+ * frame is exchanged with a single ssi_transfer(), when DR is written,
+ * without the baud rate delay.
+ *
+ * With DMA, the SPI registers a bulk handler with the DMA channels,
+ * and whole buffers are moved in a loop, with one memory access per
+ * block instead of two register accesses per frame.
+ *
+ * The slaves can be created at startup, for example an N25Q128 flash
+ * on SPI1, selected by PA4:
+ *
+ *   -global stm32:spi-peripheral.devices="SPI1=n25q128@PA4"
+ *   -drive if=none,id=flash,file=flash.bin,format=raw
+ *   -global n25q128.drive=flash
+ *
+ * or by the board code, on the bus returned by stm32_spi_get_bus().
+ *
+ * TODO:
+ * - implement slave mode, CRC, the F0 FIFO thresholds and I2S
+ */
+
+#define SPI_CR1_MSTR        (1 << 2)
+#define SPI_CR1_SPE         (1 << 6)
+#define SPI_CR1_LSBFIRST    (1 << 7)
+#define SPI_CR1_RXONLY      (1 << 10)
+#define SPI_CR1_DFF         (1 << 11)
+#define SPI_CR1_BIDIOE      (1 << 14)
+#define SPI_CR1_BIDIMODE    (1 << 15)
+
+#define SPI_CR2_RXDMAEN     (1 << 0)
+#define SPI_CR2_TXDMAEN     (1 << 1)
+#define SPI_CR2_ERRIE       (1 << 5)
+#define SPI_CR2_RXNEIE      (1 << 6)
+#define SPI_CR2_TXEIE       (1 << 7)
+#define SPI_CR2_DS_SHIFT    (8)
+
+#define SPI_SR_RXNE         (1 << 0)
+#define SPI_SR_TXE          (1 << 1)
+#define SPI_SR_CRCERR       (1 << 4)
+#define SPI_SR_MODF         (1 << 5)
+#define SPI_SR_OVR          (1 << 6)
+
+// ----- Public ---------------------------------------------------------------
+
+// Create SPI%d and return it.
+Object* stm32_spi_create(Object *parent, stm32_spi_index_t index)
+{
+    if ((int) index >= STM32_SPI_UNDEFINED) {
+        hw_error("Cannot assign SPI %d: QEMU supports only %d SPIs\n",
+                1 + index - STM32_SPI_1, STM32_SPI_UNDEFINED);
+    }
+
+    char child_name[10];
+    snprintf(child_name, sizeof(child_name) - 1, "SPI%d",
+            1 + index - STM32_SPI_1);
+    // Passing a local string is ok.
+    Object *spi = cm_object_new(parent, child_name, TYPE_STM32_SPI);
+
+    object_property_set_int(spi, index, "spi-index", NULL);
+
+    cm_object_realize(spi);
+
+    return spi;
+}
+
+// Return the bus where the slaves are connected.
+SSIBus *stm32_spi_get_bus(Object *obj)
+{
+    return STM32_SPI_STATE(obj)->bus;
+}
+
+// ----- Private --------------------------------------------------------------
+
+static bool stm32_spi_is_enabled(Object *obj)
+{
+    STM32SPIState *state = STM32_SPI_STATE(obj);
+
+    if (register_bitfield_is_non_zero(state->enabling_bit)) {
+        return true; // Positive logic, bit == 1 means enabled.
+    }
+
+    // Not enabled
+    return false;
+}
+
+static bool stm32_spi_is_f0(STM32SPIState *state)
+{
+    return state->capabilities->family == STM32_FAMILY_F0;
+}
+
+// Return the frame size, in bits; DS on F0, DFF on F1/F4.
+static unsigned stm32_spi_get_frame_bits(STM32SPIState *state)
+{
+    if (stm32_spi_is_f0(state)) {
+        unsigned ds = (peripheral_register_get_raw_value(state->reg.cr2)
+                >> SPI_CR2_DS_SHIFT) & 0xF;
+        // The reserved values are 8-bit.
+        return (ds < 3) ? 8 : ds + 1;
+    }
+
+    return (peripheral_register_get_raw_value(state->reg.cr1) & SPI_CR1_DFF) ?
+            16 : 8;
+}
+
+static void stm32_spi_update_irq(STM32SPIState *state)
+{
+    uint32_t cr2 = peripheral_register_get_raw_value(state->reg.cr2);
+    uint32_t sr = peripheral_register_get_raw_value(state->reg.sr);
+
+    bool pending = ((cr2 & SPI_CR2_TXEIE) && (sr & SPI_SR_TXE))
+            || ((cr2 & SPI_CR2_RXNEIE) && (sr & SPI_SR_RXNE))
+            || ((cr2 & SPI_CR2_ERRIE)
+                    && (sr & (SPI_SR_OVR | SPI_SR_MODF | SPI_SR_CRCERR)));
+
+    if (pending && state->irq >= 0) {
+        cortexm_nvic_set_pending_interrupt(state->nvic, state->irq);
+    }
+}
+
+// Raise or lower the DMA requests, only when changed. Since the
+// frames are transferred instantly, the requests are active as long
+// as the SPI is enabled and the DMA is enabled in CR2.
+static void stm32_spi_update_dma_requests(STM32SPIState *state)
+{
+    uint32_t cr1 = peripheral_register_get_raw_value(state->reg.cr1);
+    uint32_t cr2 = peripheral_register_get_raw_value(state->reg.cr2);
+
+    bool is_active = (cr1 & SPI_CR1_SPE) && (cr1 & SPI_CR1_MSTR);
+    bool tx_level = is_active && (cr2 & SPI_CR2_TXDMAEN);
+    bool rx_level = is_active && (cr2 & SPI_CR2_RXDMAEN);
+
+    if (state->dma_tx.dma != NULL && tx_level != state->dma_tx.level) {
+        state->dma_tx.level = tx_level;
+        stm32_dma_set_request(state->dma_tx.dma, state->dma_tx.channel,
+                state->dma_tx.request, state, tx_level);
+    }
+
+    if (state->dma_rx.dma != NULL && rx_level != state->dma_rx.level) {
+        state->dma_rx.level = rx_level;
+        stm32_dma_set_request(state->dma_rx.dma, state->dma_rx.channel,
+                state->dma_rx.request, state, rx_level);
+    }
+}
+
+// Exchange one frame with the slaves, LSB first if so configured.
+static uint32_t stm32_spi_transfer_frame(STM32SPIState *state, uint32_t cr1,
+        unsigned bits, uint32_t tx)
+{
+    uint32_t mask = (1 << bits) - 1;
+
+    tx &= mask;
+    if (cr1 & SPI_CR1_LSBFIRST) {
+        tx = revbit32(tx) >> (32 - bits);
+    }
+
+    uint32_t rx = ssi_transfer(state->bus, tx) & mask;
+
+    if (cr1 & SPI_CR1_LSBFIRST) {
+        rx = revbit32(rx) >> (32 - bits);
+    }
+    return rx;
+}
+
+// Store a received frame in DR; a frame not read yet is lost.
+static void stm32_spi_store_rx(STM32SPIState *state, uint32_t rx)
+{
+    if (peripheral_register_get_raw_value(state->reg.sr) & SPI_SR_RXNE) {
+        peripheral_register_or_raw_value(state->reg.sr, SPI_SR_OVR);
+    }
+
+    state->rx_data = rx;
+    peripheral_register_or_raw_value(state->reg.sr, SPI_SR_RXNE);
+}
+
+// Pass received frames to the RX DMA channel; return the number
+// of frames taken.
+static uint32_t stm32_spi_dma_rx(STM32SPIState *state, void *data,
+        unsigned size, uint32_t count)
+{
+    uint32_t cr2 = peripheral_register_get_raw_value(state->reg.cr2);
+
+    if (!(cr2 & SPI_CR2_RXDMAEN) || state->dma_rx.dma == NULL) {
+        return 0;
+    }
+    if (stm32_dma_get_pending(state->dma_rx.dma, state->dma_rx.channel,
+            state->dma_rx.request, true) == 0) {
+        return 0;
+    }
+
+    return stm32_dma_transfer_block(state->dma_rx.dma, state->dma_rx.channel,
+            data, size, count, true);
+}
+
+// Called by the DMA when a request is active and its channel enabled;
+// move as many frames as both channels allow.
+static void stm32_spi_dma_bulk_callback(void *opaque)
+{
+    STM32SPIState *state = STM32_SPI_STATE(opaque);
+
+    if (state->is_busy) {
+        return;
+    }
+
+    uint32_t cr1 = peripheral_register_get_raw_value(state->reg.cr1);
+    uint32_t cr2 = peripheral_register_get_raw_value(state->reg.cr2);
+
+    if (!(cr1 & SPI_CR1_SPE) || !(cr1 & SPI_CR1_MSTR)) {
+        return;
+    }
+
+    bool tx_dma = (cr2 & SPI_CR2_TXDMAEN) && state->dma_tx.dma != NULL;
+    bool rx_dma = (cr2 & SPI_CR2_RXDMAEN) && state->dma_rx.dma != NULL;
+    // Without a transmitter, the master clocks continuously.
+    bool rx_only = (cr1 & SPI_CR1_RXONLY)
+            || ((cr1 & SPI_CR1_BIDIMODE) && !(cr1 & SPI_CR1_BIDIOE));
+
+    uint32_t count;
+    if (tx_dma && !rx_only) {
+        count = stm32_dma_get_pending(state->dma_tx.dma, state->dma_tx.channel,
+                state->dma_tx.request, false);
+        if (rx_dma) {
+            // Wait for the RX channel, the frames must not be lost.
+            count = MIN(count,
+                    stm32_dma_get_pending(state->dma_rx.dma,
+                            state->dma_rx.channel, state->dma_rx.request,
+                            true));
+        }
+    } else if (rx_dma && rx_only) {
+        count = stm32_dma_get_pending(state->dma_rx.dma, state->dma_rx.channel,
+                state->dma_rx.request, true);
+    } else {
+        return;
+    }
+
+    unsigned bits = stm32_spi_get_frame_bits(state);
+    unsigned size = (bits > 8) ? 2 : 1;
+    uint8_t buf[STM32_SPI_BLOCK_FRAMES * 2];
+
+    state->is_busy = true;
+
+    while (count > 0) {
+        uint32_t n = MIN(count, STM32_SPI_BLOCK_FRAMES);
+
+        if (rx_only) {
+            memset(buf, 0xFF, n * size);
+        } else {
+            n = stm32_dma_transfer_block(state->dma_tx.dma,
+                    state->dma_tx.channel, buf, size, n, false);
+            if (n == 0) {
+                break;
+            }
+        }
+
+        uint32_t i;
+        for (i = 0; i < n; ++i) {
+            if (size == 2) {
+                stw_le_p(buf + 2 * i,
+                        stm32_spi_transfer_frame(state, cr1, bits,
+                                lduw_le_p(buf + 2 * i)));
+            } else {
+                buf[i] = stm32_spi_transfer_frame(state, cr1, bits, buf[i]);
+            }
+        }
+
+        if (rx_dma) {
+            stm32_spi_dma_rx(state, buf, size, n);
+        } else {
+            // Only the last frame remains in DR, the others overrun it.
+            if (n > 1) {
+                peripheral_register_or_raw_value(state->reg.sr, SPI_SR_RXNE);
+            }
+            stm32_spi_store_rx(state,
+                    (size == 2) ? lduw_le_p(buf + 2 * (n - 1)) : buf[n - 1]);
+        }
+
+        count -= n;
+    }
+
+    state->is_busy = false;
+
+    stm32_spi_update_irq(state);
+}
+
+// ----------------------------------------------------------------------------
+
+// CRCERR is cleared by writing 0, the other bits are read only.
+static peripheral_register_t stm32_spi_sr_pre_write_callback(Object *reg,
+        Object *periph, uint32_t addr, uint32_t offset, unsigned size,
+        peripheral_register_t value, peripheral_register_t full_value)
+{
+    return peripheral_register_get_raw_value(reg)
+            & (full_value | ~SPI_SR_CRCERR);
+}
+
+static peripheral_register_t stm32_spi_dr_pre_read_callback(Object *reg,
+        Object *periph, uint32_t addr, uint32_t offset, unsigned size)
+{
+    STM32SPIState *state = STM32_SPI_STATE(periph);
+
+    return state->rx_data;
+}
+
+// Reading DR clears RXNE; the overrun flag is also cleared, since
+// the SR read that follows is not tracked.
+static void stm32_spi_dr_post_read_callback(Object *reg, Object *periph,
+        uint32_t addr, uint32_t offset, unsigned size)
+{
+    STM32SPIState *state = STM32_SPI_STATE(periph);
+
+    peripheral_register_and_raw_value(state->reg.sr,
+            ~(SPI_SR_RXNE | SPI_SR_OVR));
+}
+
+// Writing DR sends the frame and receives one from the slaves.
+static void stm32_spi_dr_post_write_callback(Object *reg, Object *periph,
+        uint32_t addr, uint32_t offset, unsigned size,
+        peripheral_register_t value, peripheral_register_t full_value)
+{
+    STM32SPIState *state = STM32_SPI_STATE(periph);
+
+    uint32_t cr1 = peripheral_register_get_raw_value(state->reg.cr1);
+
+    if (!(cr1 & SPI_CR1_SPE)) {
+        return;
+    }
+    if (!(cr1 & SPI_CR1_MSTR)) {
+        qemu_log_mask(LOG_UNIMP, "SPI%d: slave mode not implemented.\n",
+                1 + state->spi_index - STM32_SPI_1);
+        return;
+    }
+
+    unsigned bits = stm32_spi_get_frame_bits(state);
+    uint8_t buf[2];
+
+    if (stm32_spi_is_f0(state) && bits <= 8 && size == 2) {
+        // F0 data packing, two frames per 16-bit access.
+        buf[0] = stm32_spi_transfer_frame(state, cr1, bits, full_value);
+        buf[1] = stm32_spi_transfer_frame(state, cr1, bits, full_value >> 8);
+        if (stm32_spi_dma_rx(state, buf, 1, 2) == 0) {
+            stm32_spi_store_rx(state, lduw_le_p(buf));
+        }
+    } else {
+        uint32_t rx = stm32_spi_transfer_frame(state, cr1, bits, full_value);
+        stw_le_p(buf, rx);
+        if (stm32_spi_dma_rx(state, buf, (bits > 8) ? 2 : 1, 1) == 0) {
+            stm32_spi_store_rx(state, rx);
+        }
+    }
+
+    stm32_spi_update_irq(state);
+}
+
+static void stm32_spi_cr1_post_write_callback(Object *reg, Object *periph,
+        uint32_t addr, uint32_t offset, unsigned size,
+        peripheral_register_t value, peripheral_register_t full_value)
+{
+    STM32SPIState *state = STM32_SPI_STATE(periph);
+
+    if ((full_value & SPI_CR1_SPE) && !(full_value & SPI_CR1_MSTR)) {
+        qemu_log_mask(LOG_UNIMP, "SPI%d: slave mode not implemented.\n",
+                1 + state->spi_index - STM32_SPI_1);
+    }
+
+    stm32_spi_update_dma_requests(state);
+}
+
+static void stm32_spi_cr2_post_write_callback(Object *reg, Object *periph,
+        uint32_t addr, uint32_t offset, unsigned size,
+        peripheral_register_t value, peripheral_register_t full_value)
+{
+    STM32SPIState *state = STM32_SPI_STATE(periph);
+
+    stm32_spi_update_irq(state);
+    stm32_spi_update_dma_requests(state);
+}
+
+// ----------------------------------------------------------------------------
+
+static void stm32_spi_instance_init_callback(Object *obj)
+{
+    qemu_log_function_name();
+
+    STM32SPIState *state = STM32_SPI_STATE(obj);
+
+    cm_object_property_add_int(obj, "spi-index",
+            (const int *) &state->spi_index);
+    state->spi_index = STM32_SPI_UNDEFINED;
+}
+
+// The fixed DMA request mapping, per SPI; F0 is the same as F1.
+static const STM32DMARoute stm32f1_spi_dma_tx[STM32_SPI_UNDEFINED] = {
+    { 0, 2, 0 },
+    { 0, 4, 0 },
+    { 1, 1, 0 },
+    { -1, 0, 0 },
+    { -1, 0, 0 },
+    { -1, 0, 0 },
+/**/
+};
+
+static const STM32DMARoute stm32f1_spi_dma_rx[STM32_SPI_UNDEFINED] = {
+    { 0, 1, 0 },
+    { 0, 3, 0 },
+    { 1, 0, 0 },
+    { -1, 0, 0 },
+    { -1, 0, 0 },
+    { -1, 0, 0 },
+/**/
+};
+
+static const STM32DMARoute stm32f4_spi_dma_tx[STM32_SPI_UNDEFINED] = {
+    { 1, 3, 3 },
+    { 0, 4, 0 },
+    { 0, 5, 0 },
+    { 1, 1, 4 },
+    { 1, 4, 2 },
+    { 1, 5, 1 },
+/**/
+};
+
+static const STM32DMARoute stm32f4_spi_dma_rx[STM32_SPI_UNDEFINED] = {
+    { 1, 0, 3 },
+    { 0, 3, 0 },
+    { 0, 0, 0 },
+    { 1, 0, 4 },
+    { 1, 3, 2 },
+    { 1, 6, 1 },
+/**/
+};
+
+// Find the DMA channels for the SPI, if the controller exists, and
+// register the bulk handler with them.
+static void stm32_spi_set_dma_routes(STM32SPIState *state)
+{
+    STM32MCUState *mcu = stm32_mcu_get();
+    const STM32DMARoute *tx;
+    const STM32DMARoute *rx;
+
+    state->dma_tx.dma = NULL;
+    state->dma_rx.dma = NULL;
+
+    if (state->capabilities->family == STM32_FAMILY_F4) {
+        tx = &stm32f4_spi_dma_tx[state->spi_index];
+        rx = &stm32f4_spi_dma_rx[state->spi_index];
+    } else {
+        tx = &stm32f1_spi_dma_tx[state->spi_index];
+        rx = &stm32f1_spi_dma_rx[state->spi_index];
+    }
+
+    if (tx->dma >= 0 && mcu->dma[tx->dma] != NULL) {
+        state->dma_tx.dma = OBJECT(mcu->dma[tx->dma]);
+        state->dma_tx.channel = tx->channel;
+        state->dma_tx.request = tx->request;
+        stm32_dma_set_bulk_handler(state->dma_tx.dma, tx->channel,
+                tx->request, stm32_spi_dma_bulk_callback, state);
+    }
+    if (rx->dma >= 0 && mcu->dma[rx->dma] != NULL) {
+        state->dma_rx.dma = OBJECT(mcu->dma[rx->dma]);
+        state->dma_rx.channel = rx->channel;
+        state->dma_rx.request = rx->request;
+        stm32_dma_set_bulk_handler(state->dma_rx.dma, rx->channel,
+                rx->request, stm32_spi_dma_bulk_callback, state);
+    }
+}
+
+// Create the slaves listed in the "devices" property for this SPI.
+static void stm32_spi_create_devices(STM32SPIState *state,
+        const char *periph_name)
+{
+    if (state->devices == NULL || *state->devices == '\0') {
+        return;
+    }
+
+    gchar **entries = g_strsplit(state->devices, ";", 0);
+
+    int i;
+    for (i = 0; entries[i] != NULL; ++i) {
+        char *entry = g_strstrip(entries[i]);
+        if (*entry == '\0') {
+            continue;
+        }
+
+        char *type = strchr(entry, '=');
+        if (type == NULL) {
+            hw_error("SPI: invalid device '%s', expected "
+                    "SPIn=<type>[@<CS pin>].\n", entry);
+        }
+        *type++ = '\0';
+        if (strcmp(entry, periph_name) != 0) {
+            continue;
+        }
+
+        char *pin_name = strchr(type, '@');
+        if (pin_name != NULL) {
+            *pin_name++ = '\0';
+        }
+
+        ObjectClass *oc = object_class_by_name(type);
+        if (oc == NULL || object_class_dynamic_cast(oc, TYPE_SSI_SLAVE) == NULL) {
+            hw_error("%s: '%s' is not an SPI device.\n", periph_name, type);
+        }
+
+        DeviceState *slave = ssi_create_slave(state->bus, type);
+
+        if (pin_name != NULL) {
+            // Like "PA4".
+            int port = toupper(pin_name[1]) - 'A';
+            char *end;
+            long pin = strtol(pin_name + 2, &end, 10);
+
+            Object *gpio = NULL;
+            if (toupper(pin_name[0]) == 'P' && port >= 0
+                    && port < STM32_MAX_GPIO && pin >= 0 && pin < 16
+                    && end != pin_name + 2 && *end == '\0') {
+                gpio = stm32_gpio_get(STM32_PORT_GPIOA + port);
+            }
+            if (gpio == NULL) {
+                hw_error("%s: invalid CS pin '%s'.\n", periph_name, pin_name);
+            }
+
+            cm_irq_connect(DEVICE(gpio), STM32_IRQ_GPIO_ODR_OUT, pin, slave,
+                    SSI_GPIO_CS, 0);
+        }
+    }
+
+    g_strfreev(entries);
+}
+
+// Create the registers and bitfields; called at realize, or on first
+// access for lazy peripherals.
+static void stm32_spi_create_registers(Object *obj)
+{
+    STM32MCUState *mcu = stm32_mcu_get();
+    CortexMState *cm_state = CORTEXM_MCU_STATE(mcu);
+
+    STM32SPIState *state = STM32_SPI_STATE(obj);
+
+    char periph_name[10];
+    snprintf(periph_name, sizeof(periph_name) - 1, "SPI%d",
+            1 + state->spi_index - STM32_SPI_1);
+
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(
+            cm_state->svd_device, periph_name);
+    svd_add_peripheral_properties_and_children(obj, periph,
+            cm_state->svd_device);
+
+    // The register names are the same in F0, F1 and F4.
+    state->reg.cr1 = cm_object_get_child_by_name(obj, "CR1");
+    state->reg.cr2 = cm_object_get_child_by_name(obj, "CR2");
+    state->reg.sr = cm_object_get_child_by_name(obj, "SR");
+    state->reg.dr = cm_object_get_child_by_name(obj, "DR");
+
+    peripheral_register_set_pre_write(state->reg.sr,
+            &stm32_spi_sr_pre_write_callback);
+    peripheral_register_set_pre_read(state->reg.dr,
+            &stm32_spi_dr_pre_read_callback);
+    peripheral_register_set_post_read(state->reg.dr,
+            &stm32_spi_dr_post_read_callback);
+    peripheral_register_set_post_write(state->reg.dr,
+            &stm32_spi_dr_post_write_callback);
+    peripheral_register_set_post_write(state->reg.cr1,
+            &stm32_spi_cr1_post_write_callback);
+    peripheral_register_set_post_write(state->reg.cr2,
+            &stm32_spi_cr2_post_write_callback);
+
+    peripheral_prepare_registers(obj);
+}
+
+static void stm32_spi_realize_callback(DeviceState *dev, Error **errp)
+{
+    qemu_log_function_name();
+
+    // Call parent realize().
+    if (!cm_device_parent_realize(dev, errp, TYPE_STM32_SPI)) {
+        return;
+    }
+
+    STM32MCUState *mcu = stm32_mcu_get();
+    CortexMState *cm_state = CORTEXM_MCU_STATE(mcu);
+
+    STM32SPIState *state = STM32_SPI_STATE(dev);
+    // First thing first: get capabilities from MCU, needed everywhere.
+    state->capabilities = mcu->capabilities;
+
+    const STM32Capabilities *capabilities = state->capabilities;
+    assert(capabilities != NULL);
+
+    Object *obj = OBJECT(dev);
+
+    state->nvic = CORTEXM_NVIC_STATE(cm_state->nvic);
+
+    static const int f0_irqs[STM32_SPI_UNDEFINED] = {
+        STM32F051XX_SPI1_IRQn,
+        STM32F051XX_SPI2_IRQn,
+        -1,
+        -1,
+        -1,
+        -1,
+    /**/
+    };
+    static const int f1_irqs[STM32_SPI_UNDEFINED] = {
+        STM32F10X_CL_SPI1_IRQn,
+        STM32F10X_CL_SPI2_IRQn,
+        STM32F10X_CL_SPI3_IRQn,
+        -1,
+        -1,
+        -1,
+    /**/
+    };
+    static const int f4_irqs[STM32_SPI_UNDEFINED] = {
+        STM32F4_01_57_XX_SPI1_IRQn,
+        STM32F4_01_57_XX_SPI2_IRQn,
+        STM32F4_23_XX_SPI3_IRQn,
+        STM32F4_23_XX_SPI4_IRQn,
+        STM32F4_23_XX_SPI5_IRQn,
+        STM32F4_23_XX_SPI6_IRQn,
+    /**/
+    };
+
+    switch (capabilities->family) {
+    case STM32_FAMILY_F0:
+        state->irq = f0_irqs[state->spi_index];
+        break;
+    case STM32_FAMILY_F1:
+        state->irq = f1_irqs[state->spi_index];
+        break;
+    case STM32_FAMILY_F4:
+        state->irq = f4_irqs[state->spi_index];
+        break;
+    default:
+        state->irq = -1;
+        break;
+    }
+
+    char periph_name[10];
+    snprintf(periph_name, sizeof(periph_name) - 1, "SPI%d",
+            1 + state->spi_index - STM32_SPI_1);
+
+    svd_set_peripheral_address_block(cm_state->svd_device, periph_name, obj);
+    peripheral_create_memory_region(obj);
+
+    // SPI2 and SPI3 are on APB1, the others on APB2.
+    char enabling_bit_name[STM32_RCC_SIZEOF_ENABLING_BITFIELD];
+    if (state->spi_index == STM32_SPI_2 || state->spi_index == STM32_SPI_3) {
+        snprintf(enabling_bit_name, sizeof(enabling_bit_name) - 1,
+                DEVICE_PATH_STM32_RCC "/APB1ENR/SPI%dEN",
+                1 + state->spi_index - STM32_SPI_1);
+    } else {
+        snprintf(enabling_bit_name, sizeof(enabling_bit_name) - 1,
+                DEVICE_PATH_STM32_RCC "/APB2ENR/SPI%dEN",
+                1 + state->spi_index - STM32_SPI_1);
+    }
+
+    state->enabling_bit = OBJECT(cm_device_by_name(enabling_bit_name));
+
+    peripheral_populate_registers(obj, stm32_spi_create_registers,
+            mcu->lazy_peripherals);
+
+    stm32_spi_set_dma_routes(state);
+
+    state->bus = ssi_create_bus(dev, "ssi");
+    stm32_spi_create_devices(state, periph_name);
+}
+
+static void stm32_spi_reset_callback(DeviceState *dev)
+{
+    qemu_log_function_name();
+
+    STM32SPIState *state = STM32_SPI_STATE(dev);
+
+    // Call parent reset().
+    cm_device_parent_reset(dev, TYPE_STM32_SPI);
+
+    state->rx_data = 0;
+    state->is_busy = false;
+    // Drop the DMA requests, the DMA reset keeps the request lines.
+    if (state->dma_tx.dma != NULL && state->dma_tx.level) {
+        stm32_dma_set_request(state->dma_tx.dma, state->dma_tx.channel,
+                state->dma_tx.request, state, false);
+    }
+    if (state->dma_rx.dma != NULL && state->dma_rx.level) {
+        stm32_dma_set_request(state->dma_rx.dma, state->dma_rx.channel,
+                state->dma_rx.request, state, false);
+    }
+    state->dma_tx.level = false;
+    state->dma_rx.level = false;
+}
+
+static Property stm32_spi_properties[] = {
+        DEFINE_PROP_STRING("devices", STM32SPIState, devices),
+    DEFINE_PROP_END_OF_LIST(), };
+
+static void stm32_spi_class_init_callback(ObjectClass *klass, void *data)
+{
+    DeviceClass *dc = DEVICE_CLASS(klass);
+
+    dc->reset = stm32_spi_reset_callback;
+    dc->realize = stm32_spi_realize_callback;
+
+    dc->props = stm32_spi_properties;
+
+    PeripheralClass *per_class = PERIPHERAL_CLASS(klass);
+    per_class->is_enabled = stm32_spi_is_enabled;
+}
+
+static const TypeInfo stm32_spi_type_info = {
+    .name = TYPE_STM32_SPI,
+    .parent = TYPE_STM32_SPI_PARENT,
+    .instance_init = stm32_spi_instance_init_callback,
+    .instance_size = sizeof(STM32SPIState),
+    .class_init = stm32_spi_class_init_callback,
+    .class_size = sizeof(STM32SPIClass)
+/**/
+};
+
+static void stm32_spi_register_types(void)
+{
+    type_register_static(&stm32_spi_type_info);
+}
+
+type_init(stm32_spi_register_types);
+
+// ----------------------------------------------------------------------------
@@ -18,6 +18,7 @@
  */
 
 #include <hw/cortexm/stm32/syscfg.h>
+#include <hw/cortexm/stm32/exti.h>
 #include <hw/cortexm/stm32/mcu.h>
 #include <hw/cortexm/helper.h>
 #include <hw/cortexm/svd.h>
@@ -30,12 +31,12 @@
 //
 // STM32F051R8
 // DO NOT EDIT! Automatically generated!
-static void stm32f0x1_syscfg_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f0x1_syscfg_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32SYSCFGState *state = STM32_SYSCFG_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -141,12 +142,12 @@ static void stm32f0x1_syscfg_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F051R8
 // DO NOT EDIT! Automatically generated!
-static void stm32f0x2_syscfg_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f0x2_syscfg_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32SYSCFGState *state = STM32_SYSCFG_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -246,12 +247,12 @@ static void stm32f0x2_syscfg_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F407VG, STM32F407ZG, STM32F405RG
 // DO NOT EDIT! Automatically generated!
-static void stm32f40x_syscfg_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f40x_syscfg_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32SYSCFGState *state = STM32_SYSCFG_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -322,12 +323,12 @@ static void stm32f40x_syscfg_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F411RE
 // DO NOT EDIT! Automatically generated!
-static void stm32f411xx_syscfg_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f411xx_syscfg_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32SYSCFGState *state = STM32_SYSCFG_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -398,12 +399,12 @@ static void stm32f411xx_syscfg_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F429ZI
 // DO NOT EDIT! Automatically generated!
-static void stm32f429x_syscfg_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f429x_syscfg_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32SYSCFGState *state = STM32_SYSCFG_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -482,6 +483,18 @@ static void stm32f429x_syscfg_create_objects(Object *obj, JSON_Object *svd,
 
 // ----- Private --------------------------------------------------------------
 
+// Publish the new routing to the GPIO ports.
+static void stm32_syscfg_exticr_post_write_callback(Object *reg, Object *periph,
+        uint32_t addr, uint32_t offset, unsigned size,
+        peripheral_register_t value, peripheral_register_t full_value)
+{
+    STM32SYSCFGState *state = STM32_SYSCFG_STATE(periph);
+
+    stm32_exti_compute_port_masks(state->exticr.reg, state->exticr.port_mask);
+}
+
+// ----------------------------------------------------------------------------
+
 static bool stm32_syscfg_is_enabled(Object *obj)
 {
     STM32SYSCFGState *state = STM32_SYSCFG_STATE(obj);
@@ -536,7 +549,7 @@ static void stm32_syscfg_realize_callback(DeviceState *dev, Error **errp)
     Object *obj = OBJECT(dev);
 
     const char *periph_name = "SYSCFG";
-    svd_set_peripheral_address_block(cm_state->svd_json, periph_name, obj);
+    svd_set_peripheral_address_block(cm_state->svd_device, periph_name, obj);
     peripheral_create_memory_region(obj);
 
     char enabling_bit_name[STM32_RCC_SIZEOF_ENABLING_BITFIELD];
@@ -546,12 +559,12 @@ static void stm32_syscfg_realize_callback(DeviceState *dev, Error **errp)
 
         if (capabilities->f0.is_0x1) {
 
-            stm32f0x1_syscfg_create_objects(obj, cm_state->svd_json,
+            stm32f0x1_syscfg_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
         } else if (capabilities->f0.is_0x2) {
 
-            stm32f0x2_syscfg_create_objects(obj, cm_state->svd_json,
+            stm32f0x2_syscfg_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
         } else {
@@ -576,6 +589,11 @@ static void stm32_syscfg_realize_callback(DeviceState *dev, Error **errp)
         state->exticr.exti[14] = state->u.f0.fld.exticr4.exti14;
         state->exticr.exti[15] = state->u.f0.fld.exticr4.exti15;
 
+        state->exticr.reg[0] = state->u.f0.reg.exticr1;
+        state->exticr.reg[1] = state->u.f0.reg.exticr2;
+        state->exticr.reg[2] = state->u.f0.reg.exticr3;
+        state->exticr.reg[3] = state->u.f0.reg.exticr4;
+
         snprintf(enabling_bit_name, sizeof(enabling_bit_name) - 1,
         DEVICE_PATH_STM32_RCC "/APB2ENR/SYSCFGEN");
 
@@ -585,17 +603,17 @@ static void stm32_syscfg_realize_callback(DeviceState *dev, Error **errp)
 
         if (capabilities->f4.is_40x) {
 
-            stm32f40x_syscfg_create_objects(obj, cm_state->svd_json,
+            stm32f40x_syscfg_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
         } else if (capabilities->f4.is_411xx) {
 
-            stm32f411xx_syscfg_create_objects(obj, cm_state->svd_json,
+            stm32f411xx_syscfg_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
         } else if (capabilities->f4.is_429x) {
 
-            stm32f429x_syscfg_create_objects(obj, cm_state->svd_json,
+            stm32f429x_syscfg_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
         } else {
@@ -620,6 +638,11 @@ static void stm32_syscfg_realize_callback(DeviceState *dev, Error **errp)
         state->exticr.exti[14] = state->u.f4.fld.exticr4.exti14;
         state->exticr.exti[15] = state->u.f4.fld.exticr4.exti15;
 
+        state->exticr.reg[0] = state->u.f4.reg.exticr1;
+        state->exticr.reg[1] = state->u.f4.reg.exticr2;
+        state->exticr.reg[2] = state->u.f4.reg.exticr3;
+        state->exticr.reg[3] = state->u.f4.reg.exticr4;
+
         // Actions.
         cm_object_property_set_str(state->u.f4.fld.cmpcr.ready, "CMP_PD",
                 "follows");
@@ -636,6 +659,12 @@ static void stm32_syscfg_realize_callback(DeviceState *dev, Error **errp)
 
     state->enabling_bit = OBJECT(cm_device_by_name(enabling_bit_name));
 
+    int i;
+    for (i = 0; i < 4; ++i) {
+        peripheral_register_set_post_write(state->exticr.reg[i],
+                &stm32_syscfg_exticr_post_write_callback);
+    }
+
     peripheral_prepare_registers(obj);
 }
 
@@ -645,6 +674,10 @@ static void stm32_syscfg_reset_callback(DeviceState *dev)
 
     // Call parent reset().
     cm_device_parent_reset(dev, TYPE_STM32_SYSCFG);
+
+    STM32SYSCFGState *state = STM32_SYSCFG_STATE(dev);
+
+    stm32_exti_compute_port_masks(state->exticr.reg, state->exticr.port_mask);
 }
 
 static void stm32_syscfg_class_init_callback(ObjectClass *klass, void *data)
@@ -0,0 +1,936 @@
+/*
+ * STM32 MCU - TIM (timers) emulation.
+ *
+ * Copyright (c) 2017 Liviu Ionescu.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <hw/cortexm/stm32/tim.h>
+#include <hw/cortexm/stm32/mcu.h>
+#include <hw/cortexm/helper.h>
+#include <hw/cortexm/svd.h>
+
+#include "qemu/host-utils.h"
+
+/*
+ * This file implements the time base and the output compare flags of the
+ * STM32 advanced, general purpose and basic timers (TIM1-TIM17), in up
+ * and down counting modes, with one pulse mode.
+ *
+ * The counter does not tick; its value is computed from the virtual
+ * time elapsed since a base moment, the timer clock and the prescaler,
+ * only when CNT or SR are read. A single QEMU timer is armed for the
+ * next update or compare event with an enabled interrupt, so a running
+ * timer costs nothing between events.
+ *
+ * TODO:
+ * - implement center-aligned modes, input capture and the slave modes
+ * - implement DMA requests
+ */
+
+#define TIM_CR1_CEN         (1 << 0)
+#define TIM_CR1_UDIS        (1 << 1)
+#define TIM_CR1_URS         (1 << 2)
+#define TIM_CR1_OPM         (1 << 3)
+#define TIM_CR1_DIR         (1 << 4)
+#define TIM_CR1_CMS         (3 << 5)
+#define TIM_CR1_ARPE        (1 << 7)
+
+#define TIM_DIER_UIE        (1 << 0)
+#define TIM_DIER_CCIE(ch)   (1 << (1 + (ch)))
+
+#define TIM_SR_UIF          (1 << 0)
+#define TIM_SR_CCIF(ch)     (1 << (1 + (ch)))
+#define TIM_SR_CCIF_ALL     (0xF << 1)
+
+#define TIM_EGR_UG          (1 << 0)
+#define TIM_EGR_CCG(ch)     (1 << (1 + (ch)))
+
+// ----- Public ---------------------------------------------------------------
+
+// Create TIM%d and return it.
+Object* stm32_tim_create(Object *parent, stm32_tim_index_t index)
+{
+    if ((int) index >= STM32_TIM_UNDEFINED) {
+        hw_error("Cannot assign TIM %d: QEMU supports only %d timers\n",
+                1 + index - STM32_TIM_1, STM32_TIM_UNDEFINED);
+    }
+
+    char child_name[10];
+    snprintf(child_name, sizeof(child_name) - 1, "TIM%d",
+            1 + index - STM32_TIM_1);
+    // Passing a local string is ok.
+    Object *tim = cm_object_new(parent, child_name, TYPE_STM32_TIM);
+
+    object_property_set_int(tim, index, "tim-index", NULL);
+
+    cm_object_realize(tim);
+
+    return tim;
+}
+
+// ----- Private --------------------------------------------------------------
+
+static bool stm32_tim_is_enabled(Object *obj)
+{
+    STM32TIMState *state = STM32_TIM_STATE(obj);
+
+    if (register_bitfield_is_non_zero(state->enabling_bit)) {
+        return true; // Positive logic, bit == 1 means enabled.
+    }
+
+    // Not enabled
+    return false;
+}
+
+// The advanced timers, and the timers sharing their interrupts,
+// are on APB2, all others on APB1.
+static bool stm32_tim_is_on_apb2(STM32TIMState *state)
+{
+    switch (state->tim_index) {
+    case STM32_TIM_1:
+    case STM32_TIM_8:
+    case STM32_TIM_9:
+    case STM32_TIM_10:
+    case STM32_TIM_11:
+    case STM32_TIM_15:
+    case STM32_TIM_16:
+    case STM32_TIM_17:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Set the update and capture/compare interrupt numbers.
+static void stm32_tim_set_irq_vectors(STM32TIMState *state)
+{
+    const STM32Capabilities *capabilities = state->capabilities;
+
+    int update = -1;
+    int cc = -1;
+
+    if (capabilities->family == STM32_FAMILY_F0) {
+        switch (state->tim_index) {
+        case STM32_TIM_1:
+            update = STM32F072XX_TIM1_BRK_UP_TRG_COM_IRQn;
+            cc = STM32F072XX_TIM1_CC_IRQn;
+            break;
+        case STM32_TIM_2:
+            update = STM32F072XX_TIM2_IRQn;
+            break;
+        case STM32_TIM_3:
+            update = STM32F072XX_TIM3_IRQn;
+            break;
+        case STM32_TIM_6:
+            update = STM32F072XX_TIM6_DAC_IRQn;
+            break;
+        case STM32_TIM_7:
+            update = STM32F072XX_TIM7_IRQn;
+            break;
+        case STM32_TIM_14:
+            update = STM32F072XX_TIM14_IRQn;
+            break;
+        case STM32_TIM_15:
+            update = STM32F072XX_TIM15_IRQn;
+            break;
+        case STM32_TIM_16:
+            update = STM32F072XX_TIM16_IRQn;
+            break;
+        case STM32_TIM_17:
+            update = STM32F072XX_TIM17_IRQn;
+            break;
+        default:
+            break;
+        }
+    } else {
+        // F1 devices use the same numbers as F4.
+        switch (state->tim_index) {
+        case STM32_TIM_1:
+            update = STM32F4_01_57_XX_TIM1_UP_TIM10_IRQn;
+            cc = STM32F4_01_57_XX_TIM1_CC_IRQn;
+            break;
+        case STM32_TIM_2:
+            update = STM32F4_01_57_XX_TIM2_IRQn;
+            break;
+        case STM32_TIM_3:
+            update = STM32F4_01_57_XX_TIM3_IRQn;
+            break;
+        case STM32_TIM_4:
+            update = STM32F4_01_57_XX_TIM4_IRQn;
+            break;
+        case STM32_TIM_5:
+            update = STM32F4_01_57_XX_TIM5_IRQn;
+            break;
+        case STM32_TIM_6:
+            update = STM32F4_01_57_XX_TIM6_DAC_IRQn;
+            break;
+        case STM32_TIM_7:
+            update = STM32F4_01_57_XX_TIM7_IRQn;
+            break;
+        case STM32_TIM_8:
+            update = STM32F4_01_57_XX_TIM8_UP_TIM13_IRQn;
+            cc = STM32F4_01_57_XX_TIM8_CC_IRQn;
+            break;
+        case STM32_TIM_9:
+            update = STM32F4_01_57_XX_TIM1_BRK_TIM9_IRQn;
+            break;
+        case STM32_TIM_10:
+            update = STM32F4_01_57_XX_TIM1_UP_TIM10_IRQn;
+            break;
+        case STM32_TIM_11:
+            update = STM32F4_01_57_XX_TIM1_TRG_COM_TIM11_IRQn;
+            break;
+        case STM32_TIM_12:
+            update = STM32F4_01_57_XX_TIM8_BRK_TIM12_IRQn;
+            break;
+        case STM32_TIM_13:
+            update = STM32F4_01_57_XX_TIM8_UP_TIM13_IRQn;
+            break;
+        case STM32_TIM_14:
+            update = STM32F4_01_57_XX_TIM8_TRG_COM_TIM14_IRQn;
+            break;
+        default:
+            break;
+        }
+    }
+
+    state->irq_update = update;
+    state->irq_cc = (cc >= 0) ? cc : update;
+}
+
+// ----------------------------------------------------------------------------
+
+static uint32_t stm32_tim_get_clock_hz(STM32TIMState *state)
+{
+    return state->clock_hz;
+}
+
+static inline uint32_t stm32_tim_get_cr1(STM32TIMState *state)
+{
+    return peripheral_register_get_raw_value(state->reg.cr1);
+}
+
+// Center-aligned modes are counted up.
+static inline bool stm32_tim_is_down(STM32TIMState *state)
+{
+    uint32_t cr1 = stm32_tim_get_cr1(state);
+
+    return (cr1 & TIM_CR1_DIR) && !(cr1 & TIM_CR1_CMS);
+}
+
+// Convert counter ticks to ns, rounded up, so that the counter did
+// reach the value at the returned time.
+static int64_t stm32_tim_ticks_to_ns(STM32TIMState *state, uint64_t ticks)
+{
+    uint32_t clock_hz = stm32_tim_get_clock_hz(state);
+    uint64_t clocks = ticks * ((uint64_t) state->active_psc + 1);
+
+    uint64_t ns = muldiv64(clocks, NANOSECONDS_PER_SECOND, clock_hz);
+    if (muldiv64(ns, clock_hz, NANOSECONDS_PER_SECOND) < clocks) {
+        ++ns;
+    }
+    return ns;
+}
+
+static uint64_t stm32_tim_ns_to_ticks(STM32TIMState *state, int64_t ns)
+{
+    uint32_t clock_hz = stm32_tim_get_clock_hz(state);
+
+    return muldiv64(ns, clock_hz, NANOSECONDS_PER_SECOND)
+            / ((uint64_t) state->active_psc + 1);
+}
+
+// Return the number of ticks from the given counter value to the
+// update event (overflow or underflow).
+static uint64_t stm32_tim_ticks_to_update(STM32TIMState *state,
+        uint32_t count)
+{
+    uint32_t arr = state->active_arr;
+
+    if (stm32_tim_is_down(state)) {
+        return (uint64_t) count + 1;
+    }
+    if (count <= arr) {
+        return (uint64_t) arr - count + 1;
+    }
+    // Above ARR, the counter goes to the maximum and wraps to 0 first.
+    return (uint64_t) state->counter_mask - count + arr + 2;
+}
+
+// Return the number of ticks from the given counter value to the match
+// with the compare value, or 0 if there is no match before the update
+// event; a match with the value loaded at the update event is counted.
+static uint64_t stm32_tim_ticks_to_compare(STM32TIMState *state,
+        uint32_t count, uint32_t ccr)
+{
+    if (stm32_tim_is_down(state)) {
+        if (ccr < count) {
+            return count - ccr;
+        }
+        if (ccr == state->active_arr) {
+            return (uint64_t) count + 1;
+        }
+    } else {
+        if (ccr > count && ccr <= state->active_arr) {
+            return ccr - count;
+        }
+        if (ccr == 0) {
+            return stm32_tim_ticks_to_update(state, count);
+        }
+    }
+    return 0;
+}
+
+// Only the channels configured as outputs compare; input capture
+// is not implemented.
+static bool stm32_tim_is_output_compare(STM32TIMState *state, int ch)
+{
+    if (ch >= state->num_channels || state->reg.ccr[ch] == NULL) {
+        return false;
+    }
+
+    Object *ccmr = (ch < 2) ? state->reg.ccmr1 : state->reg.ccmr2;
+    if (ccmr == NULL) {
+        return true;
+    }
+
+    // CCxS is [1:0] for the odd channels, [9:8] for the even ones.
+    uint32_t ccs = peripheral_register_get_raw_value(ccmr) >> ((ch & 1) * 8);
+    return (ccs & 0x3) == 0;
+}
+
+// Set status flags, and raise the interrupts for the new ones.
+static void stm32_tim_set_flags(STM32TIMState *state, uint32_t flags)
+{
+    uint32_t sr = peripheral_register_get_raw_value(state->reg.sr);
+    uint32_t raised = flags & ~sr;
+
+    if (raised == 0) {
+        return;
+    }
+
+    peripheral_register_set_raw_value(state->reg.sr, sr | flags);
+
+    uint32_t dier = peripheral_register_get_raw_value(state->reg.dier);
+    if ((raised & TIM_SR_UIF) && (dier & TIM_DIER_UIE)) {
+        cortexm_nvic_set_pending_interrupt(state->nvic, state->irq_update);
+    }
+    if (raised & dier & TIM_SR_CCIF_ALL) {
+        cortexm_nvic_set_pending_interrupt(state->nvic, state->irq_cc);
+    }
+}
+
+// Account for the compare matches in the (from, to] ticks interval,
+// counted from the base.
+static uint32_t stm32_tim_get_compare_flags(STM32TIMState *state,
+        uint64_t from, uint64_t to)
+{
+    uint32_t flags = 0;
+    int ch;
+
+    for (ch = 0; ch < state->num_channels; ++ch) {
+        if (!stm32_tim_is_output_compare(state, ch)) {
+            continue;
+        }
+        uint64_t ticks = stm32_tim_ticks_to_compare(state, state->base_count,
+                peripheral_register_get_raw_value(state->reg.ccr[ch]));
+        if (ticks > from && ticks <= to) {
+            flags |= TIM_SR_CCIF(ch);
+        }
+    }
+    return flags;
+}
+
+// Bring the counter base and the status flags up to the given time.
+static void stm32_tim_sync(STM32TIMState *state, int64_t now)
+{
+    if (!state->is_running || now <= state->base_ns) {
+        return;
+    }
+
+    uint32_t flags = 0;
+    uint64_t ticks = stm32_tim_ns_to_ticks(state, now - state->base_ns);
+
+    while (ticks > state->done_ticks) {
+
+        uint64_t to_update = stm32_tim_ticks_to_update(state,
+                state->base_count);
+        uint32_t cr1 = stm32_tim_get_cr1(state);
+
+        flags |= stm32_tim_get_compare_flags(state, state->done_ticks,
+                MIN(ticks, to_update));
+
+        if (ticks < to_update) {
+            state->done_ticks = ticks;
+            break;
+        }
+
+        // Update event; the new period starts with the preloaded values.
+        state->base_ns += stm32_tim_ticks_to_ns(state, to_update);
+        state->done_ticks = 0;
+
+        if (!(cr1 & TIM_CR1_UDIS)) {
+            flags |= TIM_SR_UIF;
+            state->active_psc = peripheral_register_get_raw_value(
+                    state->reg.psc);
+            state->active_arr = peripheral_register_get_raw_value(
+                    state->reg.arr) & state->counter_mask;
+        }
+        state->base_count = stm32_tim_is_down(state) ? state->active_arr : 0;
+
+        if (cr1 & TIM_CR1_OPM) {
+            // Stop at the update event.
+            peripheral_register_set_raw_value(state->reg.cr1,
+                    cr1 & ~TIM_CR1_CEN);
+            peripheral_register_set_raw_value(state->reg.cnt,
+                    state->base_count);
+            state->is_running = false;
+            break;
+        }
+
+        ticks = stm32_tim_ns_to_ticks(state, now - state->base_ns);
+
+        // Skip the whole periods at once, the flags are the same.
+        uint64_t period = (uint64_t) state->active_arr + 1;
+        if (ticks >= period) {
+            flags |= stm32_tim_get_compare_flags(state, 0, period);
+            uint64_t skipped = (ticks / period) * period;
+            state->base_ns += stm32_tim_ticks_to_ns(state, skipped);
+            ticks = stm32_tim_ns_to_ticks(state, now - state->base_ns);
+        }
+    }
+
+    stm32_tim_set_flags(state, flags);
+}
+
+// Return the current counter value; the state must be synchronised.
+static uint32_t stm32_tim_get_count(STM32TIMState *state)
+{
+    if (!state->is_running) {
+        return peripheral_register_get_raw_value(state->reg.cnt);
+    }
+
+    if (stm32_tim_is_down(state)) {
+        return (state->base_count - state->done_ticks) & state->counter_mask;
+    }
+    return (state->base_count + state->done_ticks) & state->counter_mask;
+}
+
+// Bring the counter up to date and move the base to it, before changing
+// the configuration.
+static void stm32_tim_freeze(STM32TIMState *state)
+{
+    stm32_tim_sync(state, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL));
+
+    if (!state->is_running) {
+        return;
+    }
+
+    uint32_t count = stm32_tim_get_count(state);
+    state->base_ns += stm32_tim_ticks_to_ns(state, state->done_ticks);
+    state->base_count = count;
+    state->done_ticks = 0;
+
+    peripheral_register_set_raw_value(state->reg.cnt, count);
+}
+
+// Arm the timer for the first event with an enabled interrupt.
+static void stm32_tim_schedule(STM32TIMState *state)
+{
+    if (!state->is_running) {
+        timer_del(state->timer);
+        return;
+    }
+
+    uint32_t cr1 = stm32_tim_get_cr1(state);
+    uint32_t dier = peripheral_register_get_raw_value(state->reg.dier);
+
+    uint64_t to_update = stm32_tim_ticks_to_update(state, state->base_count);
+    uint64_t next = UINT64_MAX;
+
+    if ((dier & TIM_DIER_UIE) && !(cr1 & TIM_CR1_UDIS)) {
+        next = to_update;
+    }
+
+    int ch;
+    for (ch = 0; ch < state->num_channels; ++ch) {
+        if (!(dier & TIM_DIER_CCIE(ch))
+                || !stm32_tim_is_output_compare(state, ch)) {
+            continue;
+        }
+        uint64_t ticks = stm32_tim_ticks_to_compare(state, state->base_count,
+                peripheral_register_get_raw_value(state->reg.ccr[ch]));
+        if (ticks <= state->done_ticks) {
+            // Already passed, check again in the next period.
+            ticks = to_update;
+        }
+        next = MIN(next, ticks);
+    }
+
+    // One pulse mode must stop the counter even with no interrupts.
+    if (cr1 & TIM_CR1_OPM) {
+        next = MIN(next, to_update);
+    }
+
+    if (next == UINT64_MAX) {
+        timer_del(state->timer);
+        return;
+    }
+
+    timer_mod(state->timer,
+            state->base_ns + stm32_tim_ticks_to_ns(state, next));
+}
+
+static void stm32_tim_timer_callback(void *opaque)
+{
+    STM32TIMState *state = (STM32TIMState *) opaque;
+
+    stm32_tim_sync(state, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL));
+    stm32_tim_schedule(state);
+}
+
+// Start or stop the counter, after a write to CR1.
+static void stm32_tim_restart(STM32TIMState *state)
+{
+    uint32_t cr1 = stm32_tim_get_cr1(state);
+
+    bool is_running = (cr1 & TIM_CR1_CEN) && stm32_tim_get_clock_hz(state);
+    if (is_running && !state->is_running) {
+        state->base_ns = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+        state->base_count = peripheral_register_get_raw_value(state->reg.cnt)
+                & state->counter_mask;
+        state->done_ticks = 0;
+    }
+    state->is_running = is_running;
+
+    if (!(cr1 & TIM_CR1_ARPE)) {
+        state->active_arr = peripheral_register_get_raw_value(state->reg.arr)
+                & state->counter_mask;
+    }
+
+    stm32_tim_schedule(state);
+}
+
+// The bus clock changed; the elapsed time is converted with the old
+// clock, then the counter continues with the new one.
+static void stm32_tim_clock_notifier_callback(Notifier *notifier, void *data)
+{
+    STM32TIMState *state = container_of(notifier, STM32TIMState,
+            clock_notifier);
+    STM32RCCState *rcc = STM32_RCC_STATE(data);
+
+    uint32_t clock_hz = stm32_rcc_get_apb_tim_freq_hz(rcc,
+            stm32_tim_is_on_apb2(state) ? 2 : 1);
+    if (clock_hz == state->clock_hz) {
+        return;
+    }
+
+    stm32_tim_freeze(state);
+    state->clock_hz = clock_hz;
+
+    // Lazy peripherals have no registers until first accessed.
+    if (state->reg.cr1 != NULL) {
+        stm32_tim_restart(state);
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+static peripheral_register_t stm32_tim_sync_pre_read_callback(Object *reg,
+        Object *periph, uint32_t addr, uint32_t offset, unsigned size)
+{
+    STM32TIMState *state = STM32_TIM_STATE(periph);
+
+    stm32_tim_sync(state, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL));
+
+    return peripheral_register_get_raw_value(reg);
+}
+
+static peripheral_register_t stm32_tim_freeze_pre_write_callback(Object *reg,
+        Object *periph, uint32_t addr, uint32_t offset, unsigned size,
+        peripheral_register_t value, peripheral_register_t full_value)
+{
+    STM32TIMState *state = STM32_TIM_STATE(periph);
+
+    stm32_tim_freeze(state);
+
+    return full_value;
+}
+
+static void stm32_tim_cr1_post_write_callback(Object *reg, Object *periph,
+        uint32_t addr, uint32_t offset, unsigned size,
+        peripheral_register_t value, peripheral_register_t full_value)
+{
+    STM32TIMState *state = STM32_TIM_STATE(periph);
+
+    if (!(full_value & TIM_CR1_CEN) && state->is_running) {
+        state->is_running = false;
+    }
+
+    if (full_value & TIM_CR1_CMS) {
+        qemu_log_mask(LOG_UNIMP, "TIM%d: center-aligned mode not implemented, "
+                "counting up.\n", 1 + state->tim_index - STM32_TIM_1);
+    }
+
+    stm32_tim_restart(state);
+}
+
+static peripheral_register_t stm32_tim_cnt_pre_read_callback(Object *reg,
+        Object *periph, uint32_t addr, uint32_t offset, unsigned size)
+{
+    STM32TIMState *state = STM32_TIM_STATE(periph);
+
+    stm32_tim_sync(state, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL));
+
+    return stm32_tim_get_count(state);
+}
+
+static void stm32_tim_cnt_post_write_callback(Object *reg, Object *periph,
+        uint32_t addr, uint32_t offset, unsigned size,
+        peripheral_register_t value, peripheral_register_t full_value)
+{
+    STM32TIMState *state = STM32_TIM_STATE(periph);
+
+    if (state->is_running) {
+        state->base_ns = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+        state->base_count = full_value & state->counter_mask;
+        state->done_ticks = 0;
+    }
+
+    stm32_tim_schedule(state);
+}
+
+static void stm32_tim_arr_post_write_callback(Object *reg, Object *periph,
+        uint32_t addr, uint32_t offset, unsigned size,
+        peripheral_register_t value, peripheral_register_t full_value)
+{
+    STM32TIMState *state = STM32_TIM_STATE(periph);
+
+    // Without ARPE the new value is used immediately.
+    if (!(stm32_tim_get_cr1(state) & TIM_CR1_ARPE)) {
+        state->active_arr = full_value & state->counter_mask;
+    }
+
+    stm32_tim_schedule(state);
+}
+
+// Flags already set raise the interrupt when enabled.
+static void stm32_tim_dier_post_write_callback(Object *reg, Object *periph,
+        uint32_t addr, uint32_t offset, unsigned size,
+        peripheral_register_t value, peripheral_register_t full_value)
+{
+    STM32TIMState *state = STM32_TIM_STATE(periph);
+
+    peripheral_register_t prev_value = peripheral_register_get_raw_prev_value(
+            reg);
+    uint32_t sr = peripheral_register_get_raw_value(state->reg.sr);
+    uint32_t enabled = full_value & ~prev_value;
+
+    // The DIER interrupt enable bits match the SR flags.
+    if ((enabled & sr & TIM_SR_UIF)) {
+        cortexm_nvic_set_pending_interrupt(state->nvic, state->irq_update);
+    }
+    if ((enabled & sr & TIM_SR_CCIF_ALL)) {
+        cortexm_nvic_set_pending_interrupt(state->nvic, state->irq_cc);
+    }
+
+    stm32_tim_schedule(state);
+}
+
+// The flags are cleared by writing 0, writing 1 has no effect.
+static peripheral_register_t stm32_tim_sr_pre_write_callback(Object *reg,
+        Object *periph, uint32_t addr, uint32_t offset, unsigned size,
+        peripheral_register_t value, peripheral_register_t full_value)
+{
+    STM32TIMState *state = STM32_TIM_STATE(periph);
+
+    stm32_tim_sync(state, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL));
+
+    return peripheral_register_get_raw_value(reg) & full_value;
+}
+
+static void stm32_tim_ccr_post_write_callback(Object *reg, Object *periph,
+        uint32_t addr, uint32_t offset, unsigned size,
+        peripheral_register_t value, peripheral_register_t full_value)
+{
+    STM32TIMState *state = STM32_TIM_STATE(periph);
+
+    stm32_tim_schedule(state);
+}
+
+// Software generated events; EGR always reads as 0.
+static void stm32_tim_egr_post_write_callback(Object *reg, Object *periph,
+        uint32_t addr, uint32_t offset, unsigned size,
+        peripheral_register_t value, peripheral_register_t full_value)
+{
+    STM32TIMState *state = STM32_TIM_STATE(periph);
+
+    peripheral_register_set_raw_value(reg, 0);
+
+    uint32_t flags = 0;
+
+    if (full_value & TIM_EGR_UG) {
+        stm32_tim_freeze(state);
+
+        // Re-initialise the counter and load the preloaded values.
+        state->active_psc = peripheral_register_get_raw_value(state->reg.psc);
+        state->active_arr = peripheral_register_get_raw_value(state->reg.arr)
+                & state->counter_mask;
+
+        uint32_t count = stm32_tim_is_down(state) ? state->active_arr : 0;
+        state->base_ns = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+        state->base_count = count;
+        state->done_ticks = 0;
+        peripheral_register_set_raw_value(state->reg.cnt, count);
+
+        if (!(stm32_tim_get_cr1(state) & TIM_CR1_URS)) {
+            flags |= TIM_SR_UIF;
+        }
+    }
+
+    int ch;
+    for (ch = 0; ch < state->num_channels; ++ch) {
+        if (full_value & TIM_EGR_CCG(ch)) {
+            flags |= TIM_SR_CCIF(ch);
+        }
+    }
+
+    stm32_tim_set_flags(state, flags);
+    stm32_tim_schedule(state);
+}
+
+// ----------------------------------------------------------------------------
+
+static void stm32_tim_instance_init_callback(Object *obj)
+{
+    qemu_log_function_name();
+
+    STM32TIMState *state = STM32_TIM_STATE(obj);
+
+    cm_object_property_add_int(obj, "tim-index",
+            (const int *) &state->tim_index);
+    state->tim_index = STM32_TIM_UNDEFINED;
+}
+
+// The register names are the same in all families; some registers
+// are present only in the larger timers.
+static Object *stm32_tim_get_register(Object *obj, const char *name)
+{
+    return object_resolve_path_component(obj, name);
+}
+
+// Create the registers and bitfields; called at realize, or on first
+// access for lazy peripherals.
+static void stm32_tim_create_registers(Object *obj)
+{
+    STM32MCUState *mcu = stm32_mcu_get();
+    CortexMState *cm_state = CORTEXM_MCU_STATE(mcu);
+
+    STM32TIMState *state = STM32_TIM_STATE(obj);
+
+    char periph_name[10];
+    snprintf(periph_name, sizeof(periph_name) - 1, "TIM%d",
+            1 + state->tim_index - STM32_TIM_1);
+
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(
+            cm_state->svd_device, periph_name);
+    svd_add_peripheral_properties_and_children(obj, periph,
+            cm_state->svd_device);
+
+    state->reg.cr1 = cm_object_get_child_by_name(obj, "CR1");
+    state->reg.dier = cm_object_get_child_by_name(obj, "DIER");
+    state->reg.sr = cm_object_get_child_by_name(obj, "SR");
+    state->reg.egr = cm_object_get_child_by_name(obj, "EGR");
+    state->reg.cnt = cm_object_get_child_by_name(obj, "CNT");
+    state->reg.psc = cm_object_get_child_by_name(obj, "PSC");
+    state->reg.arr = cm_object_get_child_by_name(obj, "ARR");
+
+    state->reg.ccmr1 = stm32_tim_get_register(obj, "CCMR1_Output");
+    state->reg.ccmr2 = stm32_tim_get_register(obj, "CCMR2_Output");
+
+    state->num_channels = 0;
+    int ch;
+    for (ch = 0; ch < STM32_TIM_MAX_CHANNELS; ++ch) {
+        char reg_name[8];
+        snprintf(reg_name, sizeof(reg_name) - 1, "CCR%d", ch + 1);
+        state->reg.ccr[ch] = stm32_tim_get_register(obj, reg_name);
+        if (state->reg.ccr[ch] != NULL) {
+            state->num_channels = ch + 1;
+        }
+    }
+
+    // Register callbacks.
+    peripheral_register_set_pre_read(state->reg.cr1,
+            &stm32_tim_sync_pre_read_callback);
+    peripheral_register_set_pre_write(state->reg.cr1,
+            &stm32_tim_freeze_pre_write_callback);
+    peripheral_register_set_post_write(state->reg.cr1,
+            &stm32_tim_cr1_post_write_callback);
+
+    peripheral_register_set_pre_read(state->reg.cnt,
+            &stm32_tim_cnt_pre_read_callback);
+    peripheral_register_set_pre_write(state->reg.cnt,
+            &stm32_tim_freeze_pre_write_callback);
+    peripheral_register_set_post_write(state->reg.cnt,
+            &stm32_tim_cnt_post_write_callback);
+
+    peripheral_register_set_pre_write(state->reg.arr,
+            &stm32_tim_freeze_pre_write_callback);
+    peripheral_register_set_post_write(state->reg.arr,
+            &stm32_tim_arr_post_write_callback);
+
+    peripheral_register_set_pre_write(state->reg.dier,
+            &stm32_tim_freeze_pre_write_callback);
+    peripheral_register_set_post_write(state->reg.dier,
+            &stm32_tim_dier_post_write_callback);
+
+    peripheral_register_set_pre_read(state->reg.sr,
+            &stm32_tim_sync_pre_read_callback);
+    peripheral_register_set_pre_write(state->reg.sr,
+            &stm32_tim_sr_pre_write_callback);
+
+    peripheral_register_set_post_write(state->reg.egr,
+            &stm32_tim_egr_post_write_callback);
+
+    for (ch = 0; ch < state->num_channels; ++ch) {
+        if (state->reg.ccr[ch] != NULL) {
+            peripheral_register_set_pre_write(state->reg.ccr[ch],
+                    &stm32_tim_freeze_pre_write_callback);
+            peripheral_register_set_post_write(state->reg.ccr[ch],
+                    &stm32_tim_ccr_post_write_callback);
+        }
+    }
+
+    peripheral_prepare_registers(obj);
+}
+
+static void stm32_tim_realize_callback(DeviceState *dev, Error **errp)
+{
+    qemu_log_function_name();
+
+    // Call parent realize().
+    if (!cm_device_parent_realize(dev, errp, TYPE_STM32_TIM)) {
+        return;
+    }
+
+    STM32MCUState *mcu = stm32_mcu_get();
+    CortexMState *cm_state = CORTEXM_MCU_STATE(mcu);
+
+    STM32TIMState *state = STM32_TIM_STATE(dev);
+    // First thing first: get capabilities from MCU, needed everywhere.
+    state->capabilities = mcu->capabilities;
+
+    const STM32Capabilities *capabilities = state->capabilities;
+    assert(capabilities != NULL);
+
+    Object *obj = OBJECT(dev);
+
+    state->nvic = CORTEXM_NVIC_STATE(cm_state->nvic);
+    stm32_tim_set_irq_vectors(state);
+
+    // TIM2 and TIM5 are 32-bit on F4, TIM2 is 32-bit on F0.
+    state->counter_mask = 0xFFFF;
+    if ((capabilities->family == STM32_FAMILY_F4
+            && (state->tim_index == STM32_TIM_2
+                    || state->tim_index == STM32_TIM_5))
+            || (capabilities->family == STM32_FAMILY_F0
+                    && state->tim_index == STM32_TIM_2)) {
+        state->counter_mask = 0xFFFFFFFF;
+    }
+
+    char periph_name[10];
+    snprintf(periph_name, sizeof(periph_name) - 1, "TIM%d",
+            1 + state->tim_index - STM32_TIM_1);
+
+    svd_set_peripheral_address_block(cm_state->svd_device, periph_name, obj);
+    peripheral_create_memory_region(obj);
+
+    char enabling_bit_name[STM32_RCC_SIZEOF_ENABLING_BITFIELD];
+    snprintf(enabling_bit_name, sizeof(enabling_bit_name) - 1,
+            DEVICE_PATH_STM32_RCC "/%s/TIM%dEN",
+            stm32_tim_is_on_apb2(state) ? "APB2ENR" : "APB1ENR",
+            1 + state->tim_index - STM32_TIM_1);
+
+    state->enabling_bit = OBJECT(cm_device_by_name(enabling_bit_name));
+
+    state->timer = timer_new_ns(QEMU_CLOCK_VIRTUAL, stm32_tim_timer_callback,
+            state);
+
+    STM32RCCState *rcc = STM32_RCC_STATE(mcu->rcc);
+    state->clock_hz = stm32_rcc_get_apb_tim_freq_hz(rcc,
+            stm32_tim_is_on_apb2(state) ? 2 : 1);
+    state->clock_notifier.notify = stm32_tim_clock_notifier_callback;
+    stm32_rcc_add_clock_notifier(rcc, &state->clock_notifier);
+
+    peripheral_populate_registers(obj, stm32_tim_create_registers,
+            mcu->lazy_peripherals);
+}
+
+static void stm32_tim_reset_callback(DeviceState *dev)
+{
+    qemu_log_function_name();
+
+    STM32TIMState *state = STM32_TIM_STATE(dev);
+
+    // Call parent reset().
+    cm_device_parent_reset(dev, TYPE_STM32_TIM);
+
+    state->is_running = false;
+    state->base_ns = 0;
+    state->base_count = 0;
+    state->done_ticks = 0;
+
+    state->active_psc = 0;
+    state->active_arr = state->counter_mask;
+    if (state->reg.arr != NULL) {
+        state->active_arr = peripheral_register_get_raw_value(state->reg.arr)
+                & state->counter_mask;
+    }
+
+    if (state->timer) {
+        timer_del(state->timer);
+    }
+}
+
+static void stm32_tim_class_init_callback(ObjectClass *klass, void *data)
+{
+    DeviceClass *dc = DEVICE_CLASS(klass);
+
+    dc->reset = stm32_tim_reset_callback;
+    dc->realize = stm32_tim_realize_callback;
+
+    PeripheralClass *per_class = PERIPHERAL_CLASS(klass);
+    per_class->is_enabled = stm32_tim_is_enabled;
+}
+
+static const TypeInfo stm32_tim_type_info = {
+    .name = TYPE_STM32_TIM,
+    .parent = TYPE_STM32_TIM_PARENT,
+    .instance_init = stm32_tim_instance_init_callback,
+    .instance_size = sizeof(STM32TIMState),
+    .class_init = stm32_tim_class_init_callback,
+    .class_size = sizeof(STM32TIMClass)
+/**/
+};
+
+static void stm32_tim_register_types(void)
+{
+    type_register_static(&stm32_tim_type_info);
+}
+
+type_init(stm32_tim_register_types);
+
+// ----------------------------------------------------------------------------
@@ -31,28 +31,34 @@
 #include <hw/cortexm/svd.h>
 
 #include "sysemu/sysemu.h"
+#include "qemu/host-utils.h"
 
 #define USART_SR_TXE        (1 << 7)
 #define USART_SR_TC         (1 << 6)
 #define USART_SR_RXNE       (1 << 5)
 
+#define USART_CR1_OVER8     (1 << 15)
 #define USART_CR1_UE        (1 << 13)
+#define USART_CR1_M         (1 << 12)
 #define USART_CR1_TXEIE     (1 << 7)
 #define USART_CR1_TCIE      (1 << 6)
 #define USART_CR1_RXNEIE    (1 << 5)
 #define USART_CR1_TE        (1 << 3)
 #define USART_CR1_RE        (1 << 2)
 
+#define USART_CR3_DMAT      (1 << 7)
+#define USART_CR3_DMAR      (1 << 6)
+
 // ----- Generated code -------------------------------------------------------
 
 // STM32F051R8
 // DO NOT EDIT! Automatically generated!
-static void stm32f0x1_usart_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f0x1_usart_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32USARTState *state = STM32_USART_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -307,12 +313,12 @@ static void stm32f0x1_usart_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F072CB
 // DO NOT EDIT! Automatically generated!
-static void stm32f0x2_usart_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f0x2_usart_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32USARTState *state = STM32_USART_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -556,12 +562,12 @@ static void stm32f0x2_usart_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F103RB
 // DO NOT EDIT! Automatically generated!
-static void stm32f103xx_usart_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f103xx_usart_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32USARTState *state = STM32_USART_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -690,12 +696,12 @@ static void stm32f103xx_usart_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F107VC
 // DO NOT EDIT! Automatically generated!
-static void stm32f107xx_usart_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f107xx_usart_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32USARTState *state = STM32_USART_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -824,12 +830,12 @@ static void stm32f107xx_usart_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F407VG, STM32F407ZG, STM32F405RG
 // DO NOT EDIT! Automatically generated!
-static void stm32f40x_usart_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f40x_usart_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32USARTState *state = STM32_USART_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -962,12 +968,12 @@ static void stm32f40x_usart_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F411RE
 // DO NOT EDIT! Automatically generated!
-static void stm32f411xx_usart_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f411xx_usart_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32USARTState *state = STM32_USART_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -1100,12 +1106,12 @@ static void stm32f411xx_usart_create_objects(Object *obj, JSON_Object *svd,
 
 // STM32F429ZI
 // DO NOT EDIT! Automatically generated!
-static void stm32f429x_usart_create_objects(Object *obj, JSON_Object *svd,
+static void stm32f429x_usart_create_objects(Object *obj, SVDDevice *svd,
         const char *name)
 {
     STM32USARTState *state = STM32_USART_STATE(obj);
 
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
     svd_add_peripheral_properties_and_children(obj, periph, svd);
 
     // Registers.
@@ -1297,22 +1303,198 @@ static int stm32f4_usart_get_irq_vector(STM32USARTState *state)
     }
 }
 
-#if 0
-static int stm32f4_usart_can_receive(void *obj)
+// The transmitter and the receiver are modelled with a few virtual time
+// stamps, not with per-character events: a write to DR only computes
+// when the character leaves the data register (TXE) and when the line
+// becomes idle (TC), and received characters wait in a FIFO, one every
+// character time. The status bits are brought up to date when SR is
+// read and by a single timer, armed only for the next change with an
+// enabled interrupt.
+//
+// With pacing disabled the character time is zero, so all status
+// changes are immediate, as before.
+
+// Return the time to transfer one character, in ns, or 0 if not paced.
+static int64_t stm32_usart_get_char_ns(STM32USARTState *state)
 {
-    STM32USARTState *state = STM32_USART_STATE((Object * )obj);
+    if (!state->baud_pacing) {
+        return 0;
+    }
 
-    int32_t sr = peripheral_register_get_raw_value(state->reg.sr);
-    if (!(sr & USART_SR_RXNE)) {
-        return 1;
+    uint32_t brr = peripheral_register_get_raw_value(state->reg.brr) & 0xFFFF;
+    uint32_t cr1 = peripheral_register_get_raw_value(state->reg.cr1);
+    uint32_t cr2 = peripheral_register_get_raw_value(state->reg.cr2);
+
+    // With OVER8 (CR1[15], F4 only) the fraction has 3 bits.
+    uint32_t divider = brr;
+    if (cr1 & USART_CR1_OVER8) {
+        divider = (brr >> 4) * 8 + (brr & 0x7);
     }
+    if (divider == 0) {
+        return 0;
+    }
+
+    // USART1 and USART6 are on APB2, all others on APB1.
+    int apb = (state->port_index == STM32_PORT_USART1
+            || state->port_index == STM32_PORT_USART6) ? 2 : 1;
+    STM32RCCState *rcc = STM32_RCC_STATE(stm32_mcu_get()->rcc);
+    uint32_t fck = stm32_rcc_get_apb_freq_hz(rcc, apb);
+    if (fck == 0) {
+        return 0;
+    }
+
+    // Count half bits: start, 8 or 9 data bits, 1, 0.5, 2 or 1.5 stop.
+    static const uint8_t stop_half_bits[4] = { 2, 1, 4, 3 };
+    uint32_t half_bits = 2 * (1 + ((cr1 & USART_CR1_M) ? 9 : 8))
+            + stop_half_bits[(cr2 >> 12) & 0x3];
 
-    return 0;
+    return muldiv64((uint64_t) half_bits * divider, NANOSECONDS_PER_SECOND,
+            2 * (uint64_t) fck);
+}
+
+// Pass the transmitted characters to the chardev, in one write.
+static void stm32_usart_tx_flush(STM32USARTState *state)
+{
+    if (state->tx_count == 0) {
+        return;
+    }
+
+    if (qemu_chr_fe_get_driver(&state->chr) != NULL) {
+        qemu_chr_fe_write_all(&state->chr, state->tx_buffer, state->tx_count);
+    }
+    state->tx_count = 0;
 }
 
-static void stm32f4_usart_receive(void *obj, const uint8_t *buf, int size)
+static void stm32_usart_tx_bh_callback(void *opaque)
 {
-    STM32USARTState *state = STM32_USART_STATE((Object * )obj);
+    stm32_usart_tx_flush((STM32USARTState *) opaque);
+}
+
+static void stm32_usart_exit_notifier_callback(Notifier *notifier, void *data)
+{
+    STM32USARTState *state = container_of(notifier, STM32USARTState,
+            exit_notifier);
+
+    stm32_usart_tx_flush(state);
+}
+
+// Pass the TX/RX request levels to the DMA, only when changed; the
+// levels are stored first, since the DMA may access DR right away.
+static void stm32_usart_update_dma_requests(STM32USARTState *state)
+{
+    uint32_t sr = peripheral_register_get_raw_value(state->reg.sr);
+    uint32_t cr1 = peripheral_register_get_raw_value(state->reg.cr1);
+    uint32_t cr3 = peripheral_register_get_raw_value(state->reg.cr3);
+
+    bool tx_level = (cr3 & USART_CR3_DMAT) && (sr & USART_SR_TXE)
+            && (cr1 & USART_CR1_UE) && (cr1 & USART_CR1_TE);
+    if (state->dma_tx.dma != NULL && tx_level != state->dma_tx.level) {
+        state->dma_tx.level = tx_level;
+        stm32_dma_set_request(state->dma_tx.dma, state->dma_tx.channel,
+                state->dma_tx.request, state, tx_level);
+    }
+
+    bool rx_level = (cr3 & USART_CR3_DMAR) && (sr & USART_SR_RXNE);
+    if (state->dma_rx.dma != NULL && rx_level != state->dma_rx.level) {
+        state->dma_rx.level = rx_level;
+        stm32_dma_set_request(state->dma_rx.dma, state->dma_rx.channel,
+                state->dma_rx.request, state, rx_level);
+    }
+}
+
+// Bring SR up to date with the current virtual time, raise the interrupt
+// for the newly set flags and arm the timer for the next change.
+static void stm32_usart_update(STM32USARTState *state)
+{
+    int64_t now = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+
+    uint32_t sr = peripheral_register_get_raw_value(state->reg.sr);
+    uint32_t cr1 = peripheral_register_get_raw_value(state->reg.cr1);
+    uint32_t cr3 = peripheral_register_get_raw_value(state->reg.cr3);
+    uint32_t new_sr = sr;
+    bool fifo_freed = false;
+
+    if (state->txe_pending && now >= state->tx_txe_ns) {
+        new_sr |= USART_SR_TXE;
+        state->txe_pending = false;
+    }
+    if (state->tc_pending && now >= state->tx_idle_ns) {
+        new_sr |= USART_SR_TC;
+        state->tc_pending = false;
+    }
+
+    if (state->rx_count > 0 && !(new_sr & USART_SR_RXNE)
+            && now >= state->rx_next_ns) {
+        peripheral_register_set_raw_value(state->reg.dr,
+                state->rx_fifo[state->rx_head]);
+        state->rx_head = (state->rx_head + 1) % STM32_USART_RX_FIFO_SIZE;
+        state->rx_count--;
+        state->rx_next_ns = now + stm32_usart_get_char_ns(state);
+
+        new_sr |= USART_SR_RXNE;
+        fifo_freed = true;
+    }
+
+    if (new_sr != sr) {
+        peripheral_register_set_raw_value(state->reg.sr, new_sr);
+
+        uint32_t raised = new_sr & ~sr;
+        if (((raised & USART_SR_RXNE) && (cr1 & USART_CR1_RXNEIE))
+                || ((raised & USART_SR_TXE) && (cr1 & USART_CR1_TXEIE))
+                || ((raised & USART_SR_TC) && (cr1 & USART_CR1_TCIE))) {
+            cortexm_nvic_set_pending_interrupt(state->nvic,
+                    stm32f4_usart_get_irq_vector(state));
+        }
+    }
+
+    // Without interrupts or DMA, the application polls SR, which calls
+    // this function anyway.
+    int64_t next_ns = INT64_MAX;
+    if (state->txe_pending
+            && ((cr1 & USART_CR1_TXEIE) || (cr3 & USART_CR3_DMAT))) {
+        next_ns = MIN(next_ns, state->tx_txe_ns);
+    }
+    if (state->tc_pending && (cr1 & USART_CR1_TCIE)) {
+        next_ns = MIN(next_ns, state->tx_idle_ns);
+    }
+    if (state->rx_count > 0 && !(new_sr & USART_SR_RXNE)
+            && ((cr1 & USART_CR1_RXNEIE) || (cr3 & USART_CR3_DMAR))) {
+        next_ns = MIN(next_ns, state->rx_next_ns);
+    }
+
+    if (next_ns != INT64_MAX) {
+        timer_mod(state->timer, next_ns);
+    } else {
+        timer_del(state->timer);
+    }
+
+    stm32_usart_update_dma_requests(state);
+
+    // Last, once SR is written: the chardev may deliver the next bytes
+    // right away, which calls this function again.
+    if (fifo_freed) {
+        qemu_chr_fe_accept_input(&state->chr);
+    }
+}
+
+static void stm32_usart_timer_callback(void *opaque)
+{
+    stm32_usart_update((STM32USARTState *) opaque);
+}
+
+static int stm32_usart_can_receive(void *opaque)
+{
+    STM32USARTState *state = (STM32USARTState *) opaque;
+
+    return STM32_USART_RX_FIFO_SIZE - state->rx_count;
+}
+
+static void stm32_usart_receive(void *opaque, const uint8_t *buf, int size)
+{
+    STM32USARTState *state = (STM32USARTState *) opaque;
+    Object *obj = OBJECT(state);
+
+    peripheral_materialize(obj);
 
     int32_t cr1 = peripheral_register_get_raw_value(state->reg.cr1);
 
@@ -1322,62 +1504,93 @@ static void stm32f4_usart_receive(void *obj, const uint8_t *buf, int size)
         return;
     }
 
-    peripheral_register_set_raw_value(state->reg.dr, *buf);
-    peripheral_register_or_raw_value(state->reg.sr, USART_SR_RXNE);
+    if (state->rx_count == 0) {
+        // The first character needs a full character time to arrive.
+        int64_t now = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+        state->rx_next_ns = MAX(state->rx_next_ns,
+                now + stm32_usart_get_char_ns(state));
+    }
 
-    if (cr1 & USART_CR1_RXNEIE) {
-        cortexm_nvic_set_pending_interrupt(state->nvic,
-                stm32f4_usart_get_irq_vector(state));
+    int i;
+    for (i = 0; i < size && state->rx_count < STM32_USART_RX_FIFO_SIZE; ++i) {
+        state->rx_fifo[(state->rx_head + state->rx_count)
+                % STM32_USART_RX_FIFO_SIZE] = buf[i];
+        state->rx_count++;
     }
+
+    stm32_usart_update(state);
+}
+
+static peripheral_register_t stm32_usart_sr_pre_read_callback(Object *reg,
+        Object *periph, uint32_t addr, uint32_t offset, unsigned size)
+{
+    STM32USARTState *state = STM32_USART_STATE(periph);
+
+    stm32_usart_update(state);
+
+    return peripheral_register_get_raw_value(state->reg.sr);
 }
-#endif
 
-static void stm32f4_usart_dr_post_read_callback(Object *reg, Object *periph,
+// Clearing RXNE by writing 0 may let the next character in.
+static void stm32_usart_sr_post_write_callback(Object *reg, Object *periph,
+        uint32_t addr, uint32_t offset, unsigned size,
+        peripheral_register_t value, peripheral_register_t full_value)
+{
+    STM32USARTState *state = STM32_USART_STATE(periph);
+
+    stm32_usart_update(state);
+}
+
+static void stm32_usart_dr_post_read_callback(Object *reg, Object *periph,
         uint32_t addr, uint32_t offset, unsigned size)
 {
     STM32USARTState *state = STM32_USART_STATE(periph);
 
     peripheral_register_and_raw_value(state->reg.sr, ~USART_SR_RXNE);
-    if (state->chr) {
-#if 0
-        qemu_chr_accept_input(state->chr);
-#endif
-    }
+    stm32_usart_update(state);
 }
 
-static void stm32f4_usart_dr_post_write_callback(Object *reg, Object *periph,
+static void stm32_usart_dr_post_write_callback(Object *reg, Object *periph,
         uint32_t addr, uint32_t offset, unsigned size,
         peripheral_register_t value, peripheral_register_t full_value)
 {
     STM32USARTState *state = STM32_USART_STATE(periph);
-    unsigned char ch;
 
     int32_t cr1 = peripheral_register_get_raw_value(state->reg.cr1);
 
     // 'value' may be half-word, use full_word.
     if ((cr1 & USART_CR1_UE) && (cr1 & USART_CR1_TE)) {
-        if (state->chr) {
-            ch = full_value; /* Use only the lower 8 bits */
-#if 0
-            qemu_chr_fe_write_all(state->chr, &ch, 1);
-#endif
-        }
-        // transmission is immediately complete
-        peripheral_register_or_raw_value(state->reg.sr,
-        USART_SR_TC | USART_SR_TXE);
-        if ((cr1 & USART_CR1_TXEIE) || (cr1 & USART_CR1_TCIE)) {
-            cortexm_nvic_set_pending_interrupt(state->nvic,
-                    stm32f4_usart_get_irq_vector(state));
+        if (state->tx_count >= STM32_USART_TX_BUFFER_SIZE) {
+            stm32_usart_tx_flush(state);
         }
+        // Use only the lower 8 bits.
+        state->tx_buffer[state->tx_count++] = full_value;
+        qemu_bh_schedule(state->tx_bh);
+
+        // The character moves to the shift register when the previous
+        // one was sent.
+        int64_t now = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+        state->tx_txe_ns = MAX(now, state->tx_idle_ns);
+        state->tx_idle_ns = state->tx_txe_ns + stm32_usart_get_char_ns(state);
+        state->txe_pending = true;
+        state->tc_pending = true;
+
+        peripheral_register_and_raw_value(state->reg.sr,
+                ~(USART_SR_TC | USART_SR_TXE));
+        stm32_usart_update(state);
     }
 }
 
-static void stm32f4_usart_cr1_post_write_callback(Object *reg, Object *periph,
+static void stm32_usart_cr1_post_write_callback(Object *reg, Object *periph,
         uint32_t addr, uint32_t offset, unsigned size,
         peripheral_register_t value, peripheral_register_t full_value)
 {
     STM32USARTState *state = STM32_USART_STATE(periph);
 
+    // Deliver what became due and re-arm the timer for the new
+    // interrupt enables.
+    stm32_usart_update(state);
+
     int32_t sr = peripheral_register_get_raw_value(state->reg.sr);
 
     // 'value' may be half-word, use full_word.
@@ -1389,6 +1602,16 @@ static void stm32f4_usart_cr1_post_write_callback(Object *reg, Object *periph,
     }
 }
 
+// DMAT/DMAR may raise the requests for the current status.
+static void stm32_usart_cr3_post_write_callback(Object *reg, Object *periph,
+        uint32_t addr, uint32_t offset, unsigned size,
+        peripheral_register_t value, peripheral_register_t full_value)
+{
+    STM32USARTState *state = STM32_USART_STATE(periph);
+
+    stm32_usart_update(state);
+}
+
 // ----------------------------------------------------------------------------
 
 static void stm32_usart_instance_init_callback(Object *obj)
@@ -1397,53 +1620,128 @@ static void stm32_usart_instance_init_callback(Object *obj)
 
     STM32USARTState *state = STM32_USART_STATE(obj);
 
-    // FIXME use a qdev char-device prop instead of qemu_char_get_next_serial()
-    // state->chr = qemu_char_get_next_serial();
-
     cm_object_property_add_int(obj, "port-index",
             (const int *) &state->port_index);
     state->port_index = STM32_PORT_USART_UNDEFINED;
 
 }
 
-static void stm32_usart_realize_callback(DeviceState *dev, Error **errp)
+// F1 and F4 have the same SR/DR/BRR/CR1-3 layout.
+static void stm32_usart_register_callbacks(STM32USARTState *state)
 {
-    qemu_log_function_name();
+    peripheral_register_set_pre_read(state->reg.sr,
+            &stm32_usart_sr_pre_read_callback);
+    peripheral_register_set_post_write(state->reg.sr,
+            &stm32_usart_sr_post_write_callback);
+    peripheral_register_set_post_read(state->reg.dr,
+            &stm32_usart_dr_post_read_callback);
+    peripheral_register_set_post_write(state->reg.dr,
+            &stm32_usart_dr_post_write_callback);
+    peripheral_register_set_post_write(state->reg.cr1,
+            &stm32_usart_cr1_post_write_callback);
+    peripheral_register_set_post_write(state->reg.cr3,
+            &stm32_usart_cr3_post_write_callback);
+}
 
-    // Call parent realize().
-    if (!cm_device_parent_realize(dev, errp, TYPE_STM32_USART)) {
-        return;
-    }
+// The fixed DMA request mapping, per USART.
+// USART1, USART2, USART3, UART4, UART5, USART6.
+static const STM32DMARoute stm32f1_usart_dma_tx[STM32_MAX_USART] = {
+    { 0, 3, 0 },
+    { 0, 6, 0 },
+    { 0, 1, 0 },
+    { 1, 4, 0 },
+    { -1, 0, 0 },
+    { -1, 0, 0 },
+/**/
+};
+
+static const STM32DMARoute stm32f1_usart_dma_rx[STM32_MAX_USART] = {
+    { 0, 4, 0 },
+    { 0, 5, 0 },
+    { 0, 2, 0 },
+    { 1, 2, 0 },
+    { -1, 0, 0 },
+    { -1, 0, 0 },
+/**/
+};
+
+static const STM32DMARoute stm32f4_usart_dma_tx[STM32_MAX_USART] = {
+    { 1, 7, 4 },
+    { 0, 6, 4 },
+    { 0, 3, 4 },
+    { 0, 4, 4 },
+    { 0, 7, 4 },
+    { 1, 6, 5 },
+/**/
+};
 
+static const STM32DMARoute stm32f4_usart_dma_rx[STM32_MAX_USART] = {
+    { 1, 2, 4 },
+    { 0, 5, 4 },
+    { 0, 1, 4 },
+    { 0, 2, 4 },
+    { 0, 0, 4 },
+    { 1, 1, 5 },
+/**/
+};
+
+// Find the DMA channels for the USART, if the controller exists.
+static void stm32_usart_set_dma_routes(STM32USARTState *state)
+{
     STM32MCUState *mcu = stm32_mcu_get();
-    CortexMState *cm_state = CORTEXM_MCU_STATE(mcu);
+    const STM32DMARoute *tx;
+    const STM32DMARoute *rx;
 
-    STM32USARTState *state = STM32_USART_STATE(dev);
-    // First thing first: get capabilities from MCU, needed everywhere.
-    state->capabilities = mcu->capabilities;
+    state->dma_tx.dma = NULL;
+    state->dma_rx.dma = NULL;
 
-    Object *obj = OBJECT(dev);
+    if (state->port_index >= STM32_MAX_USART) {
+        return;
+    }
 
-    state->nvic = CORTEXM_NVIC_STATE(cm_state->nvic);
+    switch (state->capabilities->family) {
+    case STM32_FAMILY_F1:
+        tx = &stm32f1_usart_dma_tx[state->port_index];
+        rx = &stm32f1_usart_dma_rx[state->port_index];
+        break;
 
-    char periph_name[10];
-    snprintf(periph_name, sizeof(periph_name) - 1, "USART%d",
-            1 + state->port_index - STM32_PORT_USART1);
+    case STM32_FAMILY_F4:
+        tx = &stm32f4_usart_dma_tx[state->port_index];
+        rx = &stm32f4_usart_dma_rx[state->port_index];
+        break;
 
-    svd_set_peripheral_address_block(cm_state->svd_json, periph_name, obj);
-    peripheral_create_memory_region(obj);
+    default:
+        // TODO: add F0 routes (remappable via SYSCFG).
+        return;
+    }
 
-    // Must be defined before creating registers.
-    cm_object_property_set_int(obj, 4, "register-size-bytes");
+    if (tx->dma >= 0 && mcu->dma[tx->dma] != NULL) {
+        state->dma_tx.dma = OBJECT(mcu->dma[tx->dma]);
+        state->dma_tx.channel = tx->channel;
+        state->dma_tx.request = tx->request;
+    }
+    if (rx->dma >= 0 && mcu->dma[rx->dma] != NULL) {
+        state->dma_rx.dma = OBJECT(mcu->dma[rx->dma]);
+        state->dma_rx.channel = rx->channel;
+        state->dma_rx.request = rx->request;
+    }
+}
 
-    // TODO: get it from MCU
-    cm_object_property_set_bool(obj, true, "is-little-endian");
+// Create the registers and bitfields; called at realize, or on first
+// access for lazy peripherals.
+static void stm32_usart_create_registers(Object *obj)
+{
+    STM32MCUState *mcu = stm32_mcu_get();
+    CortexMState *cm_state = CORTEXM_MCU_STATE(mcu);
 
-    const STM32Capabilities *capabilities =
-    STM32_USART_STATE(state)->capabilities;
+    STM32USARTState *state = STM32_USART_STATE(obj);
+
+    const STM32Capabilities *capabilities = state->capabilities;
     assert(capabilities != NULL);
 
-    char enabling_bit_name[STM32_RCC_SIZEOF_ENABLING_BITFIELD];
+    char periph_name[10];
+    snprintf(periph_name, sizeof(periph_name) - 1, "USART%d",
+            1 + state->port_index - STM32_PORT_USART1);
 
     switch (capabilities->family) {
 
@@ -1451,14 +1749,14 @@ static void stm32_usart_realize_callback(DeviceState *dev, Error **errp)
 
         if (capabilities->f0.is_0x1) {
 
-            stm32f0x1_usart_create_objects(obj, cm_state->svd_json,
+            stm32f0x1_usart_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
             // TODO: add callbacks
 
         } else if (capabilities->f0.is_0x2) {
 
-            stm32f0x2_usart_create_objects(obj, cm_state->svd_json,
+            stm32f0x2_usart_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
             // TODO: add callbacks
@@ -1467,48 +1765,24 @@ static void stm32_usart_realize_callback(DeviceState *dev, Error **errp)
             assert(false);
         }
 
-        switch (state->port_index) {
-
-        case STM32_PORT_USART1:
-            snprintf(enabling_bit_name, sizeof(enabling_bit_name) - 1,
-            DEVICE_PATH_STM32_RCC "/APB2ENR/USART%dEN",
-                    1 + state->port_index - STM32_PORT_USART1);
-            break;
-
-        case STM32_PORT_USART2:
-        case STM32_PORT_USART3:
-        case STM32_PORT_USART4:
-        case STM32_PORT_USART5:
-            snprintf(enabling_bit_name, sizeof(enabling_bit_name) - 1,
-            DEVICE_PATH_STM32_RCC "/APB1ENR/USART%dEN",
-                    1 + state->port_index - STM32_PORT_USART1);
-            break;
-
-        default:
-            assert(false);
-            break;
-        }
-
         break;
 
     case STM32_FAMILY_F1:
 
         if (capabilities->f1.is_103xx) {
 
-            stm32f103xx_usart_create_objects(obj, cm_state->svd_json,
+            stm32f103xx_usart_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
         } else if (capabilities->f1.is_107xx) {
 
-            stm32f107xx_usart_create_objects(obj, cm_state->svd_json,
+            stm32f107xx_usart_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
         } else {
             assert(false);
         }
 
-        // TODO: add callbacks
-
         state->reg.sr = state->u.f1.reg.sr;
         state->reg.dr = state->u.f1.reg.dr;
         state->reg.brr = state->u.f1.reg.brr;
@@ -1517,26 +1791,7 @@ static void stm32_usart_realize_callback(DeviceState *dev, Error **errp)
         state->reg.cr3 = state->u.f1.reg.cr3;
         state->reg.gtpr = state->u.f1.reg.gtpr;
 
-        switch (state->port_index) {
-
-        case STM32_PORT_USART1:
-            snprintf(enabling_bit_name, sizeof(enabling_bit_name) - 1,
-            DEVICE_PATH_STM32_RCC "/APB2ENR/USART%dEN",
-                    1 + state->port_index - STM32_PORT_USART1);
-            break;
-
-        case STM32_PORT_USART2:
-        case STM32_PORT_USART3:
-            // UART_4, UART_5:
-            snprintf(enabling_bit_name, sizeof(enabling_bit_name) - 1,
-            DEVICE_PATH_STM32_RCC "/APB1ENR/USART%dEN",
-                    1 + state->port_index - STM32_PORT_USART1);
-            break;
-
-        default:
-            assert(false);
-            break;
-        }
+        stm32_usart_register_callbacks(state);
 
         break;
 
@@ -1544,17 +1799,17 @@ static void stm32_usart_realize_callback(DeviceState *dev, Error **errp)
 
         if (capabilities->f4.is_40x) {
 
-            stm32f40x_usart_create_objects(obj, cm_state->svd_json,
+            stm32f40x_usart_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
         } else if (capabilities->f4.is_411xx) {
 
-            stm32f411xx_usart_create_objects(obj, cm_state->svd_json,
+            stm32f411xx_usart_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
         } else if (capabilities->f4.is_429x) {
 
-            stm32f429x_usart_create_objects(obj, cm_state->svd_json,
+            stm32f429x_usart_create_objects(obj, cm_state->svd_device,
                     periph_name);
 
         } else {
@@ -1569,71 +1824,115 @@ static void stm32_usart_realize_callback(DeviceState *dev, Error **errp)
         state->reg.cr3 = state->u.f4.reg.cr3;
         state->reg.gtpr = state->u.f4.reg.gtpr;
 
-        // Register callbacks.
-        peripheral_register_set_post_read(state->reg.dr,
-                &stm32f4_usart_dr_post_read_callback);
-        peripheral_register_set_post_write(state->reg.dr,
-                &stm32f4_usart_dr_post_write_callback);
-        peripheral_register_set_post_write(state->reg.cr1,
-                &stm32f4_usart_cr1_post_write_callback);
-
-        // char-device callbacks.
-        if (state->chr) {
-#if 0
-            qemu_chr_add_handlers(state->chr, stm32f4_usart_can_receive,
-                    stm32f4_usart_receive, NULL, obj);
-#endif
-        }
+        stm32_usart_register_callbacks(state);
+
+        break;
+
+    default:
+        assert(false);
+        break;
+    }
+
+    peripheral_prepare_registers(obj);
+}
 
-        switch (state->port_index) {
+static void stm32_usart_realize_callback(DeviceState *dev, Error **errp)
+{
+    qemu_log_function_name();
 
-        case STM32_PORT_USART1:
-        case STM32_PORT_USART6:
-            snprintf(enabling_bit_name, sizeof(enabling_bit_name) - 1,
-            DEVICE_PATH_STM32_RCC "/APB2ENR/USART%dEN",
-                    1 + state->port_index - STM32_PORT_USART1);
-            break;
+    // Call parent realize().
+    if (!cm_device_parent_realize(dev, errp, TYPE_STM32_USART)) {
+        return;
+    }
 
-        case STM32_PORT_USART2:
-        case STM32_PORT_USART3:
+    STM32MCUState *mcu = stm32_mcu_get();
+    CortexMState *cm_state = CORTEXM_MCU_STATE(mcu);
 
-            // UART_4, UART_5:
-            // F429 UART_7, UART_8
-            snprintf(enabling_bit_name, sizeof(enabling_bit_name) - 1,
-            DEVICE_PATH_STM32_RCC "/APB1ENR/USART%dEN",
-                    1 + state->port_index - STM32_PORT_USART1);
-            break;
+    STM32USARTState *state = STM32_USART_STATE(dev);
+    // First thing first: get capabilities from MCU, needed everywhere.
+    state->capabilities = mcu->capabilities;
 
-        default:
-            assert(false);
-            break;
-        }
+    Object *obj = OBJECT(dev);
+
+    state->nvic = CORTEXM_NVIC_STATE(cm_state->nvic);
+
+    char periph_name[10];
+    snprintf(periph_name, sizeof(periph_name) - 1, "USART%d",
+            1 + state->port_index - STM32_PORT_USART1);
+
+    svd_set_peripheral_address_block(cm_state->svd_device, periph_name, obj);
+    peripheral_create_memory_region(obj);
+
+    // Must be defined before creating registers.
+    cm_object_property_set_int(obj, 4, "register-size-bytes");
+
+    // TODO: get it from MCU
+    cm_object_property_set_bool(obj, true, "is-little-endian");
+
+    const STM32Capabilities *capabilities =
+    STM32_USART_STATE(state)->capabilities;
+    assert(capabilities != NULL);
+
+    char enabling_bit_name[STM32_RCC_SIZEOF_ENABLING_BITFIELD];
+
+    // USART1 and USART6 are on APB2, all others on APB1.
+    switch (state->port_index) {
 
+    case STM32_PORT_USART1:
+    case STM32_PORT_USART6:
+        snprintf(enabling_bit_name, sizeof(enabling_bit_name) - 1,
+        DEVICE_PATH_STM32_RCC "/APB2ENR/USART%dEN",
+                1 + state->port_index - STM32_PORT_USART1);
         break;
 
     default:
-        assert(false);
+        snprintf(enabling_bit_name, sizeof(enabling_bit_name) - 1,
+        DEVICE_PATH_STM32_RCC "/APB1ENR/USART%dEN",
+                1 + state->port_index - STM32_PORT_USART1);
         break;
     }
 
     state->enabling_bit = OBJECT(cm_device_by_name(enabling_bit_name));
 
-    peripheral_prepare_registers(obj);
+    peripheral_populate_registers(obj, stm32_usart_create_registers,
+            mcu->lazy_peripherals);
 
-    // ------------------------------------------------------------------------
+    stm32_usart_set_dma_routes(state);
 
-    CharDriverState *chr = serial_hds[state->port_index];
-    if (!chr) {
-        char chardev_name[10];
+    // ------------------------------------------------------------------------
 
-        snprintf(chardev_name, ARRAY_SIZE(chardev_name) - 1, "serial%d",
-                0 + state->port_index - STM32_PORT_USART1);
-        chr = qemu_chr_new(chardev_name, "null");
-        if (!(chr)) {
-            hw_error("Can't assign serial port to %s.\n", periph_name);
+    // Without an explicit "chardev" property, use the -serial ports,
+    // in order.
+    if (qemu_chr_fe_get_driver(&state->chr) == NULL) {
+        CharDriverState *chr = NULL;
+        if (state->port_index < MAX_SERIAL_PORTS) {
+            chr = serial_hds[state->port_index];
+        }
+        if (!chr) {
+            char chardev_name[10];
+
+            snprintf(chardev_name, ARRAY_SIZE(chardev_name) - 1, "serial%d",
+                    0 + state->port_index - STM32_PORT_USART1);
+            chr = qemu_chr_new(chardev_name, "null");
+            if (!(chr)) {
+                hw_error("Can't assign serial port to %s.\n", periph_name);
+            }
+        }
+        if (!qemu_chr_fe_init(&state->chr, chr, errp)) {
+            return;
         }
     }
-    state->chr = chr;
+
+    qemu_chr_fe_set_handlers(&state->chr, stm32_usart_can_receive,
+            stm32_usart_receive, NULL, state, NULL, true);
+
+    state->tx_bh = qemu_bh_new(stm32_usart_tx_bh_callback, state);
+    state->timer = timer_new_ns(QEMU_CLOCK_VIRTUAL, stm32_usart_timer_callback,
+            state);
+
+    // Do not lose the last buffered characters.
+    state->exit_notifier.notify = stm32_usart_exit_notifier_callback;
+    qemu_add_exit_notifier(&state->exit_notifier);
 }
 
 static void stm32_usart_reset_callback(DeviceState *dev)
@@ -1645,11 +1944,34 @@ static void stm32_usart_reset_callback(DeviceState *dev)
     // Call parent reset().
     cm_device_parent_reset(dev, TYPE_STM32_USART);
 
-    if (state->chr) {
-#if 0
-        qemu_chr_accept_input(state->chr);
-#endif
+    // Output from before the reset is still valid.
+    stm32_usart_tx_flush(state);
+
+    state->txe_pending = false;
+    state->tc_pending = false;
+    state->tx_txe_ns = 0;
+    state->tx_idle_ns = 0;
+
+    state->rx_head = 0;
+    state->rx_count = 0;
+    state->rx_next_ns = 0;
+
+    // Drop the DMA requests, the DMA reset keeps the request lines.
+    if (state->dma_tx.dma != NULL && state->dma_tx.level) {
+        stm32_dma_set_request(state->dma_tx.dma, state->dma_tx.channel,
+                state->dma_tx.request, state, false);
+    }
+    if (state->dma_rx.dma != NULL && state->dma_rx.level) {
+        stm32_dma_set_request(state->dma_rx.dma, state->dma_rx.channel,
+                state->dma_rx.request, state, false);
     }
+    state->dma_tx.level = false;
+    state->dma_rx.level = false;
+
+    if (state->timer) {
+        timer_del(state->timer);
+    }
+    qemu_chr_fe_accept_input(&state->chr);
 
     const STM32Capabilities *capabilities =
     STM32_USART_STATE(state)->capabilities;
@@ -1669,11 +1991,10 @@ static void stm32_usart_reset_callback(DeviceState *dev)
 
 }
 
-#if 0
 static Property stm32_usart_properties[] = {
-    DEFINE_PROP_CHR("chardev", STM32USARTState, chr),
-    DEFINE_PROP_END_OF_LIST()};
-#endif
+        DEFINE_PROP_CHR("chardev", STM32USARTState, chr),
+        DEFINE_PROP_BOOL("baud-pacing", STM32USARTState, baud_pacing, false),
+    DEFINE_PROP_END_OF_LIST(), };
 
 static void stm32_usart_class_init_callback(ObjectClass *klass, void *data)
 {
@@ -1682,10 +2003,7 @@ static void stm32_usart_class_init_callback(ObjectClass *klass, void *data)
     dc->reset = stm32_usart_reset_callback;
     dc->realize = stm32_usart_realize_callback;
 
-    // dc->props = stm32_usart_properties;
-
-    // Reason: instance_init() method uses qemu_char_get_next_serial()
-    // dc->cannot_instantiate_with_device_add_yet = true;
+    dc->props = stm32_usart_properties;
 
     PeripheralClass *per_class = PERIPHERAL_CLASS(klass);
     per_class->is_enabled = stm32_usart_is_enabled;
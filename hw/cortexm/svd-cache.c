@@ -0,0 +1,712 @@
+/*
+ * Cortex-M SVD device binary cache.
+ *
+ * Copyright (c) 2017 Liviu Ionescu.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <hw/cortexm/svd-cache.h>
+#include <hw/cortexm/svd.h>
+#include <hw/cortexm/parson.h>
+
+#include "qemu/error-report.h"
+#include "qemu/cutils.h"
+
+#if defined(CONFIG_VERBOSE)
+#include "verbosity.h"
+#endif
+
+/*
+ * The JSON SVD files are large (more than 1 MB for the STM32F4 devices)
+ * and parsing them, then walking the tree with string lookups, is
+ * a visible fraction of the startup time.
+ *
+ * On first use, the JSON is processed into a compact binary image,
+ * which is written in the user cache folder; subsequent runs map this
+ * file and use it as is. The JSON file is still read, to compute its
+ * hash, but it is no longer parsed.
+ */
+
+// Temporary storage used while compiling the JSON.
+typedef struct {
+    GArray *peripherals;
+    GArray *registers;
+    GArray *fields;
+
+    GString *strings;
+    GHashTable *strings_map;
+
+    // Peripheral name -> JSON object.
+    GHashTable *json_peripherals;
+    // Peripheral name -> index + 1 in the peripherals array.
+    GHashTable *indices;
+} SVDCacheBuilder;
+
+static void *svd_cache_compile(JSON_Object *root, const char *hash,
+        size_t *size_bytes);
+static bool svd_cache_validate(const void *data, size_t size_bytes,
+        const char *hash);
+static void svd_cache_set_pointers(SVDDevice *svd, const void *data);
+static bool svd_cache_map_file(SVDDevice *svd, const char *file_name,
+        const char *hash);
+static gchar *svd_cache_get_file_name(const char *json_file_name,
+        const char *hash);
+
+// ----- Public ---------------------------------------------------------------
+
+// Return the processed device, either from the cache or, if not
+// available or not matching the JSON file, compiled from the JSON
+// file and also stored in the cache for next time.
+SVDDevice *svd_cache_load(const char *json_file_name)
+{
+    gchar *contents = NULL;
+    gsize length = 0;
+    GError *err = NULL;
+
+    if (!g_file_get_contents(json_file_name, &contents, &length, &err)) {
+        error_printf("Cannot read JSON SVD file '%s': %s.\n", json_file_name,
+                err->message);
+        exit(1);
+    }
+
+    gchar *hash = g_compute_checksum_for_data(G_CHECKSUM_SHA256,
+            (const guchar *) contents, length);
+    gchar *cache_file_name = svd_cache_get_file_name(json_file_name, hash);
+
+    SVDDevice *svd = g_new0(SVDDevice, 1);
+
+    if (cache_file_name != NULL
+            && svd_cache_map_file(svd, cache_file_name, hash)) {
+
+#if defined(CONFIG_VERBOSE)
+        if (verbosity_level >= VERBOSITY_DETAILED) {
+            printf("Device cache: '%s'.\n", cache_file_name);
+        }
+#endif
+
+    } else {
+
+        JSON_Value *value = json_parse_string(contents);
+        if (value == NULL || json_value_get_object(value) == NULL) {
+            error_printf("JSON SVD file '%s' cannot be parsed.\n",
+                    json_file_name);
+            exit(1);
+        }
+
+        size_t size_bytes = 0;
+        svd->buffer = svd_cache_compile(json_value_get_object(value), hash,
+                &size_bytes);
+        json_value_free(value);
+
+        svd_cache_set_pointers(svd, svd->buffer);
+
+        // The cache is only an optimisation; failing to write it
+        // is not an error. g_file_set_contents() writes to a temporary
+        // file and renames it, so concurrent instances are safe.
+        if (cache_file_name != NULL
+                && !g_file_set_contents(cache_file_name, svd->buffer,
+                        size_bytes, &err)) {
+            qemu_log_mask(LOG_UNIMP, "Cannot write device cache '%s': %s.\n",
+                    cache_file_name, err->message);
+            g_error_free(err);
+            err = NULL;
+        }
+
+#if defined(CONFIG_VERBOSE)
+        if (verbosity_level >= VERBOSITY_DETAILED && cache_file_name) {
+            printf("Device cache: '%s' (created).\n", cache_file_name);
+        }
+#endif
+    }
+
+    g_free(cache_file_name);
+    g_free(hash);
+    g_free(contents);
+
+    return svd;
+}
+
+// ----- Private --------------------------------------------------------------
+
+static svd_string_t svd_cache_add_string(SVDCacheBuilder *builder,
+        const char *str)
+{
+    if (str == NULL) {
+        return 0;
+    }
+
+    gpointer offset;
+    if (g_hash_table_lookup_extended(builder->strings_map, str, NULL,
+            &offset)) {
+        return GPOINTER_TO_UINT(offset);
+    }
+
+    svd_string_t ret = builder->strings->len;
+    // Include the terminator.
+    g_string_append_len(builder->strings, str, strlen(str) + 1);
+    g_hash_table_insert(builder->strings_map, g_strdup(str),
+            GUINT_TO_POINTER(ret));
+
+    return ret;
+}
+
+static svd_string_t GCC_FMT_ATTR(2, 3) svd_cache_add_error(
+        SVDCacheBuilder *builder, const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    gchar *str = g_strdup_vprintf(fmt, ap);
+    va_end(ap);
+
+    svd_string_t ret = svd_cache_add_string(builder, str);
+    g_free(str);
+
+    return ret;
+}
+
+static void svd_cache_add_group(SVDCacheBuilder *builder, JSON_Object *json,
+        SVDGroup *group)
+{
+    group->size = svd_cache_add_string(builder,
+            json_object_get_string(json, "size"));
+    group->access = svd_cache_add_string(builder,
+            json_object_get_string(json, "access"));
+    group->protection = svd_cache_add_string(builder,
+            json_object_get_string(json, "protection"));
+    group->reset_value = svd_cache_add_string(builder,
+            json_object_get_string(json, "resetValue"));
+    group->reset_mask = svd_cache_add_string(builder,
+            json_object_get_string(json, "resetMask"));
+}
+
+static void svd_cache_add_fields(SVDCacheBuilder *builder,
+        JSON_Array *bitfields, SVDRegister *reg)
+{
+    size_t count = json_array_get_count(bitfields);
+    int i;
+
+    reg->first_field = builder->fields->len;
+    reg->num_fields = count;
+
+    for (i = 0; i < count; ++i) {
+        JSON_Object *bitfield = json_array_get_object(bitfields, i);
+        SVDField field;
+        const char *str;
+
+        memset(&field, 0, sizeof(field));
+
+        field.name = svd_cache_add_string(builder,
+                json_object_get_string(bitfield, "name"));
+        field.access = svd_cache_add_string(builder,
+                json_object_get_string(bitfield, "access"));
+
+        str = json_object_get_string(bitfield, "bitOffset");
+        if (str != NULL) {
+            field.bit_offset = svd_parse_uint(str);
+            field.flags |= SVD_FIELD_HAS_BIT_OFFSET;
+        }
+
+        str = json_object_get_string(bitfield, "bitWidth");
+        if (str != NULL) {
+            field.bit_width = svd_parse_uint(str);
+            field.flags |= SVD_FIELD_HAS_BIT_WIDTH;
+        }
+
+        g_array_append_val(builder->fields, field);
+    }
+}
+
+static void svd_cache_add_registers(SVDCacheBuilder *builder,
+        JSON_Array *registers, SVDPeripheral *periph)
+{
+    size_t count = json_array_get_count(registers);
+    int i;
+
+    periph->first_register = builder->registers->len;
+    periph->num_registers = count;
+
+    for (i = 0; i < count; ++i) {
+        JSON_Object *regi = json_array_get_object(registers, i);
+        SVDRegister reg;
+        const char *str;
+
+        memset(&reg, 0, sizeof(reg));
+
+        reg.name = svd_cache_add_string(builder,
+                json_object_get_string(regi, "name"));
+        svd_cache_add_group(builder, regi, &reg.group);
+
+        str = json_object_get_string(regi, "addressOffset");
+        if (str != NULL) {
+            reg.offset_bytes = svd_parse_uint(str);
+            reg.flags |= SVD_REGISTER_HAS_OFFSET;
+        }
+
+        JSON_Array *bitfields = json_object_get_array(regi, "fields");
+        if (bitfields != NULL) {
+            reg.flags |= SVD_REGISTER_HAS_FIELDS;
+            svd_cache_add_fields(builder, bitfields, &reg);
+        }
+
+        g_array_append_val(builder->registers, reg);
+    }
+}
+
+// Same rules as the original JSON processing: the base address
+// is always local, the address blocks may be inherited.
+static void svd_cache_add_address_block(SVDCacheBuilder *builder,
+        JSON_Object *json, SVDPeripheral *periph)
+{
+    const char *str;
+
+    str = json_object_get_string(json, "baseAddress");
+    if (str == NULL) {
+        periph->block_error = svd_cache_add_error(builder,
+                "Missing baseAddress array.");
+        return;
+    }
+    uint64_t addr = svd_parse_uint(str);
+
+    JSON_Array *address_blocks = json_object_get_array(json, "addressBlocks");
+    if (address_blocks == NULL) {
+        str = json_object_get_string(json, "derivedFrom");
+        if (str == NULL) {
+            periph->block_error = svd_cache_add_error(builder,
+                    "Missing derivedFrom for addressBlocks.");
+            return;
+        }
+        JSON_Object *base = g_hash_table_lookup(builder->json_peripherals,
+                str);
+        if (base == NULL) {
+            periph->block_error = svd_cache_add_error(builder,
+                    "Peripheral '%s' not found in JSON.", str);
+            return;
+        }
+        address_blocks = json_object_get_array(base, "addressBlocks");
+        if (address_blocks == NULL) {
+            periph->block_error = svd_cache_add_error(builder,
+                    "Missing addressBlocks array.");
+            return;
+        }
+    }
+
+    size_t count = json_array_get_count(address_blocks);
+    int i;
+
+    for (i = 0; i < count; ++i) {
+        JSON_Object *address_block = json_array_get_object(address_blocks, i);
+
+        str = json_object_get_string(address_block, "usage");
+        if (str != NULL && strcmp(str, "registers") == 0) {
+            str = json_object_get_string(address_block, "offset");
+            if (str == NULL) {
+                periph->block_error = svd_cache_add_error(builder,
+                        "Missing addressBlock.offset.");
+                return;
+            }
+            addr += svd_parse_uint(str);
+
+            str = json_object_get_string(address_block, "size");
+            if (str == NULL) {
+                periph->block_error = svd_cache_add_error(builder,
+                        "Missing addressBlock.size.");
+                return;
+            }
+
+            periph->mmio_address = addr;
+            periph->mmio_size_bytes = svd_parse_uint(str);
+            return;
+        }
+    }
+
+    periph->block_error = svd_cache_add_error(builder,
+            "Missing addressBlock.usage=registers.");
+}
+
+// Peripherals without registers refer the registers of the
+// peripheral they derive from; must be called after all
+// local registers were added.
+static void svd_cache_add_derived_registers(SVDCacheBuilder *builder,
+        JSON_Object *json, SVDPeripheral *periph)
+{
+    const char *str = json_object_get_string(json, "derivedFrom");
+    if (str == NULL) {
+        periph->registers_error = svd_cache_add_error(builder,
+                "Missing registers array.");
+        return;
+    }
+
+    JSON_Object *base = g_hash_table_lookup(builder->json_peripherals, str);
+    if (base == NULL) {
+        periph->registers_error = svd_cache_add_error(builder,
+                "Peripheral '%s' not found in JSON.", str);
+        return;
+    }
+
+    if (json_object_get_array(base, "registers") == NULL) {
+        periph->registers_error = svd_cache_add_error(builder,
+                "Missing registers array.");
+        return;
+    }
+
+    guint index = GPOINTER_TO_UINT(g_hash_table_lookup(builder->indices, str));
+    assert(index > 0);
+
+    SVDPeripheral *base_periph = &g_array_index(builder->peripherals,
+            SVDPeripheral, index - 1);
+    periph->registers_error = base_periph->registers_error;
+    periph->first_register = base_periph->first_register;
+    periph->num_registers = base_periph->num_registers;
+}
+
+static gint svd_cache_compare_peripherals(gconstpointer a, gconstpointer b,
+        gpointer user_data)
+{
+    const char *strings = (const char *) user_data;
+
+    return strcmp(strings + ((const SVDPeripheral *) a)->name,
+            strings + ((const SVDPeripheral *) b)->name);
+}
+
+static void *svd_cache_compile(JSON_Object *root, const char *hash,
+        size_t *size_bytes)
+{
+    SVDCacheBuilder builder;
+    SVDCacheHeader header;
+    int i;
+
+    memset(&header, 0, sizeof(header));
+
+    builder.peripherals = g_array_new(FALSE, TRUE, sizeof(SVDPeripheral));
+    builder.registers = g_array_new(FALSE, TRUE, sizeof(SVDRegister));
+    builder.fields = g_array_new(FALSE, TRUE, sizeof(SVDField));
+    // Offset 0 is reserved for missing strings.
+    builder.strings = g_string_new(NULL);
+    g_string_append_c(builder.strings, '\0');
+    builder.strings_map = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, NULL);
+    builder.json_peripherals = g_hash_table_new(g_str_hash, g_str_equal);
+    builder.indices = g_hash_table_new(g_str_hash, g_str_equal);
+
+    JSON_Object *device = json_object_get_object(root, "device");
+    if (device != NULL) {
+        header.device.flags |= SVD_DEVICE_HAS_DEVICE;
+        header.device.name = svd_cache_add_string(&builder,
+                json_object_get_string(device, "name"));
+        svd_cache_add_group(&builder, device, &header.device.group);
+
+        JSON_Object *cpu = json_object_get_object(device, "cpu");
+        if (cpu != NULL) {
+            SVDCpu *c = &header.device.cpu;
+
+            header.device.flags |= SVD_DEVICE_HAS_CPU;
+            c->name = svd_cache_add_string(&builder,
+                    json_object_get_string(cpu, "name"));
+            c->revision = svd_cache_add_string(&builder,
+                    json_object_get_string(cpu, "revision"));
+            c->mpu_present = svd_cache_add_string(&builder,
+                    json_object_get_string(cpu, "mpuPresent"));
+            c->fpu_present = svd_cache_add_string(&builder,
+                    json_object_get_string(cpu, "fpuPresent"));
+            c->itm_present = svd_cache_add_string(&builder,
+                    json_object_get_string(cpu, "qemuItmPresent"));
+            c->etm_present = svd_cache_add_string(&builder,
+                    json_object_get_string(cpu, "qemuEtmPresent"));
+            c->num_interrupts = svd_cache_add_string(&builder,
+                    json_object_get_string(cpu, "deviceNumInterrupts"));
+            c->nvic_prio_bits = svd_cache_add_string(&builder,
+                    json_object_get_string(cpu, "nvicPrioBits"));
+        }
+
+        JSON_Array *peripherals = json_object_get_array(device, "peripherals");
+        size_t count = json_array_get_count(peripherals);
+
+        for (i = 0; i < count; ++i) {
+            JSON_Object *json = json_array_get_object(peripherals, i);
+            const char *name = json_object_get_string(json, "name");
+            if (name != NULL) {
+                g_hash_table_insert(builder.json_peripherals, (gpointer) name,
+                        json);
+                g_hash_table_insert(builder.indices, (gpointer) name,
+                        GUINT_TO_POINTER(i + 1));
+            }
+        }
+
+        // First pass, local registers and address blocks.
+        for (i = 0; i < count; ++i) {
+            JSON_Object *json = json_array_get_object(peripherals, i);
+            SVDPeripheral periph;
+
+            memset(&periph, 0, sizeof(periph));
+
+            periph.name = svd_cache_add_string(&builder,
+                    json_object_get_string(json, "name"));
+            svd_cache_add_group(&builder, json, &periph.group);
+
+            if (json_object_get_array(json, "clusters") != NULL) {
+                periph.registers_error = svd_cache_add_error(&builder,
+                        "clusters are not yet implemented.");
+            } else {
+                JSON_Array *registers = json_object_get_array(json,
+                        "registers");
+                if (registers != NULL) {
+                    svd_cache_add_registers(&builder, registers, &periph);
+                }
+            }
+
+            svd_cache_add_address_block(&builder, json, &periph);
+
+            g_array_append_val(builder.peripherals, periph);
+        }
+
+        // Second pass, derived registers.
+        for (i = 0; i < count; ++i) {
+            JSON_Object *json = json_array_get_object(peripherals, i);
+
+            if (json_object_get_array(json, "clusters") == NULL
+                    && json_object_get_array(json, "registers") == NULL) {
+                svd_cache_add_derived_registers(&builder, json,
+                        &g_array_index(builder.peripherals, SVDPeripheral, i));
+            }
+        }
+
+        // Sort by name, to allow binary search.
+        g_array_sort_with_data(builder.peripherals,
+                svd_cache_compare_peripherals, builder.strings->str);
+    }
+
+    // Layout: header, peripherals, registers, fields, strings.
+    memcpy(header.magic, SVD_CACHE_MAGIC, sizeof(header.magic));
+    header.version = SVD_CACHE_VERSION;
+    header.byte_order = SVD_CACHE_BYTE_ORDER;
+    pstrcpy(header.hash, sizeof(header.hash), hash);
+
+    size_t offset = QEMU_ALIGN_UP(sizeof(header), 8);
+
+    header.num_peripherals = builder.peripherals->len;
+    header.peripherals_offset = offset;
+    offset = QEMU_ALIGN_UP(offset +
+            builder.peripherals->len * sizeof(SVDPeripheral), 8);
+
+    header.num_registers = builder.registers->len;
+    header.registers_offset = offset;
+    offset = QEMU_ALIGN_UP(offset + builder.registers->len * sizeof(SVDRegister),
+            8);
+
+    header.num_fields = builder.fields->len;
+    header.fields_offset = offset;
+    offset = QEMU_ALIGN_UP(offset + builder.fields->len * sizeof(SVDField), 8);
+
+    header.strings_size_bytes = builder.strings->len;
+    header.strings_offset = offset;
+    offset = QEMU_ALIGN_UP(offset + builder.strings->len, 8);
+
+    header.total_size_bytes = offset;
+
+    uint8_t *buffer = g_malloc0(offset);
+    memcpy(buffer, &header, sizeof(header));
+    memcpy(buffer + header.peripherals_offset, builder.peripherals->data,
+            builder.peripherals->len * sizeof(SVDPeripheral));
+    memcpy(buffer + header.registers_offset, builder.registers->data,
+            builder.registers->len * sizeof(SVDRegister));
+    memcpy(buffer + header.fields_offset, builder.fields->data,
+            builder.fields->len * sizeof(SVDField));
+    memcpy(buffer + header.strings_offset, builder.strings->str,
+            builder.strings->len);
+
+    g_array_free(builder.peripherals, TRUE);
+    g_array_free(builder.registers, TRUE);
+    g_array_free(builder.fields, TRUE);
+    g_string_free(builder.strings, TRUE);
+    g_hash_table_destroy(builder.strings_map);
+    g_hash_table_destroy(builder.json_peripherals);
+    g_hash_table_destroy(builder.indices);
+
+    *size_bytes = offset;
+    return buffer;
+}
+
+static bool svd_cache_check_table(const SVDCacheHeader *header,
+        uint32_t offset, uint32_t count, size_t size_of)
+{
+    return (offset % 8) == 0
+            && (uint64_t) offset + (uint64_t) count * size_of
+                    <= header->total_size_bytes;
+}
+
+static bool svd_cache_check_group(const SVDCacheHeader *header,
+        const SVDGroup *group)
+{
+    uint32_t size = header->strings_size_bytes;
+
+    return group->size < size && group->access < size
+            && group->protection < size && group->reset_value < size
+            && group->reset_mask < size;
+}
+
+// A cache file may be truncated, corrupted or created by another
+// version; validate everything once, so accesses need no checks.
+static bool svd_cache_validate(const void *data, size_t size_bytes,
+        const char *hash)
+{
+    const SVDCacheHeader *header = (const SVDCacheHeader *) data;
+    int i;
+
+    if (size_bytes < sizeof(SVDCacheHeader)
+            || memcmp(header->magic, SVD_CACHE_MAGIC, sizeof(header->magic))
+                    != 0 || header->version != SVD_CACHE_VERSION
+            || header->byte_order != SVD_CACHE_BYTE_ORDER
+            || header->total_size_bytes != size_bytes
+            || strncmp(header->hash, hash, sizeof(header->hash)) != 0) {
+        return false;
+    }
+
+    if (!svd_cache_check_table(header, header->peripherals_offset,
+            header->num_peripherals, sizeof(SVDPeripheral))
+            || !svd_cache_check_table(header, header->registers_offset,
+                    header->num_registers, sizeof(SVDRegister))
+            || !svd_cache_check_table(header, header->fields_offset,
+                    header->num_fields, sizeof(SVDField))
+            || !svd_cache_check_table(header, header->strings_offset,
+                    header->strings_size_bytes, 1)) {
+        return false;
+    }
+
+    const char *strings = (const char *) data + header->strings_offset;
+    uint32_t strings_size = header->strings_size_bytes;
+
+    if (strings_size == 0 || strings[0] != '\0'
+            || strings[strings_size - 1] != '\0') {
+        return false;
+    }
+
+    const SVDCpu *cpu = &header->device.cpu;
+    if (header->device.name >= strings_size
+            || !svd_cache_check_group(header, &header->device.group)
+            || cpu->name >= strings_size || cpu->revision >= strings_size
+            || cpu->mpu_present >= strings_size
+            || cpu->fpu_present >= strings_size
+            || cpu->itm_present >= strings_size
+            || cpu->etm_present >= strings_size
+            || cpu->num_interrupts >= strings_size
+            || cpu->nvic_prio_bits >= strings_size) {
+        return false;
+    }
+
+    const SVDPeripheral *peripherals = (const SVDPeripheral *) ((const char *)
+            data + header->peripherals_offset);
+    for (i = 0; i < header->num_peripherals; ++i) {
+        const SVDPeripheral *p = &peripherals[i];
+        if (p->name >= strings_size
+                || !svd_cache_check_group(header, &p->group)
+                || p->registers_error >= strings_size
+                || p->block_error >= strings_size
+                || (uint64_t) p->first_register + p->num_registers
+                        > header->num_registers) {
+            return false;
+        }
+    }
+
+    const SVDRegister *registers = (const SVDRegister *) ((const char *) data
+            + header->registers_offset);
+    for (i = 0; i < header->num_registers; ++i) {
+        const SVDRegister *r = &registers[i];
+        if (r->name >= strings_size || !svd_cache_check_group(header, &r->group)
+                || (uint64_t) r->first_field + r->num_fields
+                        > header->num_fields) {
+            return false;
+        }
+    }
+
+    const SVDField *fields = (const SVDField *) ((const char *) data
+            + header->fields_offset);
+    for (i = 0; i < header->num_fields; ++i) {
+        if (fields[i].name >= strings_size
+                || fields[i].access >= strings_size) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void svd_cache_set_pointers(SVDDevice *svd, const void *data)
+{
+    const char *base = (const char *) data;
+
+    svd->header = (const SVDCacheHeader *) data;
+    svd->peripherals = (const SVDPeripheral *) (base
+            + svd->header->peripherals_offset);
+    svd->registers = (const SVDRegister *) (base
+            + svd->header->registers_offset);
+    svd->fields = (const SVDField *) (base + svd->header->fields_offset);
+    svd->strings = base + svd->header->strings_offset;
+}
+
+static bool svd_cache_map_file(SVDDevice *svd, const char *file_name,
+        const char *hash)
+{
+    GMappedFile *mapped_file = g_mapped_file_new(file_name, FALSE, NULL);
+    if (mapped_file == NULL) {
+        return false;
+    }
+
+    const char *data = g_mapped_file_get_contents(mapped_file);
+    size_t size_bytes = g_mapped_file_get_length(mapped_file);
+
+    if (data == NULL || !svd_cache_validate(data, size_bytes, hash)) {
+        g_mapped_file_unref(mapped_file);
+        return false;
+    }
+
+    // Keep it mapped, the strings are referred by the objects.
+    svd->mapped_file = mapped_file;
+    svd_cache_set_pointers(svd, data);
+
+    return true;
+}
+
+// The cache file name includes the JSON file name, the beginning
+// of the hash and the format version, to allow several devices
+// and versions to coexist.
+static gchar *svd_cache_get_file_name(const char *json_file_name,
+        const char *hash)
+{
+    gchar *folder = g_build_filename(g_get_user_cache_dir(), "gnu-mcu-eclipse",
+            "qemu", "devices", NULL);
+    if (g_mkdir_with_parents(folder, 0755) != 0) {
+        g_free(folder);
+        return NULL;
+    }
+
+    gchar *base_name = g_path_get_basename(json_file_name);
+    char *dot = strrchr(base_name, '.');
+    if (dot != NULL) {
+        *dot = '\0';
+    }
+
+    gchar *name = g_strdup_printf("%s-%.16s.v%d.bin", base_name, hash,
+            SVD_CACHE_VERSION);
+    gchar *file_name = g_build_filename(folder, name, NULL);
+
+    g_free(name);
+    g_free(base_name);
+    g_free(folder);
+
+    return file_name;
+}
+
+// ----------------------------------------------------------------------------
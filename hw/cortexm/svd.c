@@ -23,18 +23,17 @@
 
 #include "qemu/error-report.h"
 
-void svd_validate_device_name(JSON_Object *svd, const char *name)
+void svd_validate_device_name(SVDDevice *svd, const char *name)
 {
     assert(svd != NULL);
     assert(name != NULL);
 
-    JSON_Object *device = json_object_get_object(svd, "device");
-    if (device == NULL) {
+    if ((svd->header->device.flags & SVD_DEVICE_HAS_DEVICE) == 0) {
         error_printf("SVD has no mandatory \"device\".\n");
         exit(1);
     }
 
-    const char *svd_name = json_object_get_string(device, "name");
+    const char *svd_name = svd_cache_string(svd, svd->header->device.name);
     if (svd_name == NULL) {
         error_printf("SVD device has no \"name\".\n");
         exit(1);
@@ -45,43 +44,47 @@ void svd_validate_device_name(JSON_Object *svd, const char *name)
     }
 }
 
-JSON_Object *svd_get_peripheral_by_name(JSON_Object *svd, const char *name)
-{
-    JSON_Object *device = json_object_get_object(svd, "device");
-    assert(device != NULL);
+typedef struct {
+    const SVDDevice *svd;
+    const char *name;
+} SVDPeripheralKey;
 
-    JSON_Array *peripherals = json_object_get_array(device, "peripherals");
-    size_t count = json_array_get_count(peripherals);
-    int i;
+static int svd_compare_peripheral_name(const void *key, const void *elem)
+{
+    const SVDPeripheralKey *k = (const SVDPeripheralKey *) key;
 
-    for (i = 0; i < count; ++i) {
-        JSON_Object *peripheral = json_array_get_object(peripherals, i);
-        const char *periph_name = json_object_get_string(peripheral, "name");
-        if (strcmp(periph_name, name) == 0) {
-            return peripheral;
-        }
-    }
-    error_printf("Peripheral '%s' not found in JSON.\n", name);
-    exit(1);
+    return strcmp(k->name,
+            k->svd->strings + ((const SVDPeripheral *) elem)->name);
 }
 
-bool svd_has_named_peripheral(JSON_Object *svd, const char *name)
+// Peripherals are sorted by name, use binary search.
+static const SVDPeripheral *svd_find_peripheral(SVDDevice *svd,
+        const char *name)
 {
-    JSON_Object *device = json_object_get_object(svd, "device");
-    assert(device != NULL);
+    assert((svd->header->device.flags & SVD_DEVICE_HAS_DEVICE) != 0);
 
-    JSON_Array *peripherals = json_object_get_array(device, "peripherals");
-    size_t count = json_array_get_count(peripherals);
-    int i;
+    SVDPeripheralKey key = {
+        .svd = svd,
+        .name = name };
 
-    for (i = 0; i < count; ++i) {
-        JSON_Object *peripheral = json_array_get_object(peripherals, i);
-        const char *periph_name = json_object_get_string(peripheral, "name");
-        if (strcmp(periph_name, name) == 0) {
-            return true;
-        }
+    return bsearch(&key, svd->peripherals, svd->header->num_peripherals,
+            sizeof(SVDPeripheral), svd_compare_peripheral_name);
+}
+
+const SVDPeripheral *svd_get_peripheral_by_name(SVDDevice *svd,
+        const char *name)
+{
+    const SVDPeripheral *peripheral = svd_find_peripheral(svd, name);
+    if (peripheral == NULL) {
+        error_printf("Peripheral '%s' not found in JSON.\n", name);
+        exit(1);
     }
-    return false;
+    return peripheral;
+}
+
+bool svd_has_named_peripheral(SVDDevice *svd, const char *name)
+{
+    return svd_find_peripheral(svd, name) != NULL;
 }
 
 void svd_set_rw_mode(Object *obj, const char *str)
@@ -108,92 +111,53 @@ void svd_set_rw_mode(Object *obj, const char *str)
     }
 }
 
-void svd_set_register_properties_group(JSON_Object *svd, Object *obj)
+void svd_set_register_properties_group(SVDDevice *svd, const SVDGroup *group,
+        Object *obj)
 {
     assert(svd != NULL);
+    assert(group != NULL);
     assert(obj != NULL);
 
-    const char *str;
-
     // If NULL, the *_set_str() does nothing.
-    str = json_object_get_string(svd, "size");
-    cm_object_property_set_str(obj, str, "svd-size");
-
-    str = json_object_get_string(svd, "access");
-    cm_object_property_set_str(obj, str, "svd-access");
-
-    str = json_object_get_string(svd, "protection");
-    cm_object_property_set_str(obj, str, "svd-protection");
-
-    str = json_object_get_string(svd, "resetValue");
-    cm_object_property_set_str(obj, str, "svd-reset-value");
+    cm_object_property_set_str(obj, svd_cache_string(svd, group->size),
+            "svd-size");
+    cm_object_property_set_str(obj, svd_cache_string(svd, group->access),
+            "svd-access");
+    cm_object_property_set_str(obj, svd_cache_string(svd, group->protection),
+            "svd-protection");
+    cm_object_property_set_str(obj, svd_cache_string(svd, group->reset_value),
+            "svd-reset-value");
+    cm_object_property_set_str(obj, svd_cache_string(svd, group->reset_mask),
+            "svd-reset-mask");
+}
 
-    str = json_object_get_string(svd, "resetMask");
-    cm_object_property_set_str(obj, str, "svd-reset-mask");
+void svd_set_device_properties_group(SVDDevice *svd, Object *obj)
+{
+    svd_set_register_properties_group(svd, &svd->header->device.group, obj);
 }
 
 Object *svd_add_peripheral_properties_and_children(Object *obj,
-        JSON_Object *svd, JSON_Object *root)
+        const SVDPeripheral *periph, SVDDevice *svd)
 {
-    const char *str;
-
-    str = json_object_get_string(svd, "name");
     // Store a local copy of the node name, for easier access.
-    // Passing a parsed string is ok, it is copied.
-    cm_object_property_set_str(obj, str, "name");
-
-#if 0
-    if (json_object_has_value_of_type(info, "default_access_flags",
-                    JSONString)) {
-        str = json_object_get_string(info, "default_access_flags");
-        uint64_t access_flags = cm_json_parser_parse_access_flags(str);
-        cm_object_property_set_int(obj, access_flags, "default-access-flags");
-    }
-#endif
-
-#if 0
-    if (json_object_has_value_of_type(info, "register_size_bytes",
-                    JSONNumber)) {
-        number = json_object_get_number(info, "register_size_bytes");
-        cm_object_property_set_int(obj, (uint32_t) number,
-                "register-size-bytes");
-    }
-#endif
+    // Passing a cached string is ok, it is copied.
+    cm_object_property_set_str(obj, svd_cache_string(svd, periph->name),
+            "name");
 
-    svd_set_register_properties_group(svd, obj);
+    svd_set_register_properties_group(svd, &periph->group, obj);
 
-    JSON_Array *clusters = json_object_get_array(svd, "clusters");
-    if (clusters != NULL) {
-        error_printf("clusters are not yet implemented.\n");
+    // Errors found while processing the JSON are reported only now,
+    // when the peripheral is actually used.
+    if (periph->registers_error != 0) {
+        error_printf("%s\n", svd_cache_string(svd, periph->registers_error));
         exit(1);
     }
 
-    JSON_Array *registers = json_object_get_array(svd, "registers");
-    if (registers == NULL) {
-        str = json_object_get_string(svd, "derivedFrom");
-        if (str == NULL) {
-            error_printf("Missing registers array.\n");
-            exit(1);
-        }
-        JSON_Object *peripheral = svd_get_peripheral_by_name(root, str);
-        if (peripheral == NULL) {
-            error_printf("Missing derivedFrom %s.\n", str);
-            exit(1);
-        }
-        registers = json_object_get_array(peripheral, "registers");
-        if (registers == NULL) {
-            error_printf("Missing registers array.\n");
-            exit(1);
-        }
-    }
-
-    size_t count = json_array_get_count(registers);
     int i;
+    for (i = 0; i < periph->num_registers; ++i) {
+        const SVDRegister *regi = &svd->registers[periph->first_register + i];
 
-    for (i = 0; i < count; ++i) {
-        JSON_Object *regi = json_array_get_object(registers, i);
-
-        const char *regi_name = json_object_get_string(regi, "name");
+        const char *regi_name = svd_cache_string(svd, regi->name);
 
         // Create the register with exactly the SVD name
         // (usually uppercase).
@@ -201,10 +165,10 @@ Object *svd_add_peripheral_properties_and_children(Object *obj,
         TYPE_PERIPHERAL_REGISTER);
 
         // Store a local copy of the node name, for easier access.
-        // Passing a parsed string is ok, it is copied.
+        // Passing a cached string is ok, it is copied.
         cm_object_property_set_str(reg, regi_name, "name");
 
-        svd_add_peripheral_register_properties_and_children(reg, regi);
+        svd_add_peripheral_register_properties_and_children(reg, regi, svd);
 
         cm_object_realize(reg);
     }
@@ -213,21 +177,19 @@ Object *svd_add_peripheral_properties_and_children(Object *obj,
 }
 
 Object *svd_add_peripheral_register_properties_and_children(Object *obj,
-        JSON_Object *svd)
+        const SVDRegister *regi, SVDDevice *svd)
 {
     const char *str;
     uint32_t val32;
 
-    str = json_object_get_string(svd, "addressOffset");
-    if (str != NULL) {
-        val32 = svd_parse_uint(str);
-        cm_object_property_set_int(obj, val32, "offset-bytes");
+    if (regi->flags & SVD_REGISTER_HAS_OFFSET) {
+        cm_object_property_set_int(obj, regi->offset_bytes, "offset-bytes");
     } else {
         error_printf("Missing register offset_bytes.\n");
         exit(1);
     }
 
-    svd_set_register_properties_group(svd, obj);
+    svd_set_register_properties_group(svd, &regi->group, obj);
 
     str = cm_object_property_get_str_with_parent(obj, "svd-reset-value", NULL);
     if (str != NULL) {
@@ -253,87 +215,51 @@ Object *svd_add_peripheral_register_properties_and_children(Object *obj,
         svd_set_rw_mode(obj, str);
     }
 
-    JSON_Array *bitfields = json_object_get_array(svd, "fields");
-    if (bitfields != NULL) {
-        size_t count = json_array_get_count(bitfields);
+    if (regi->flags & SVD_REGISTER_HAS_FIELDS) {
         int i;
 
-        for (i = 0; i < count; ++i) {
-            JSON_Object *bitfield = json_array_get_object(bitfields, i);
+        for (i = 0; i < regi->num_fields; ++i) {
+            const SVDField *bitfield = &svd->fields[regi->first_field + i];
 
-            const char *bifi_name = json_object_get_string(bitfield, "name");
+            const char *bifi_name = svd_cache_string(svd, bitfield->name);
 
-            // Passing a parsed string is ok, it is used to as an
+            // Passing a cached string is ok, it is used to as an
             // index in a table.
             Object *obifi = cm_object_new(obj, bifi_name,
             TYPE_REGISTER_BITFIELD);
 
-            // Passing a parsed string is ok, it is copied.
+            // Passing a cached string is ok, it is copied.
             cm_object_property_set_str(obifi, bifi_name, "name");
 
-            svd_add_register_bitfield_properties_and_children(obifi, bitfield);
+            svd_add_register_bitfield_properties_and_children(obifi, bitfield,
+                    svd);
 
             // Should we delay until the register is realized()?
             cm_object_realize(obifi);
         }
-    } else {
-#if 0
-        if (json_object_has_value_of_type(svd, "readable_bits", JSONString)) {
-            str = json_object_get_string(svd, "readable_bits");
-            val32 = cm_json_parser_parse_hex(str);
-            cm_object_property_set_int(obj, val32, "readable-bits");
-        }
-
-        if (json_object_has_value_of_type(svd, "writable_bits", JSONString)) {
-            str = json_object_get_string(svd, "writable_bits");
-            val32 = cm_json_parser_parse_hex(str);
-            cm_object_property_set_int(obj, val32, "writable-bits");
-        }
-#endif
-
-#if 0
-        uint64_t access_flags = 0;
-        if (json_object_has_value_of_type(svd, "access_flags", JSONString)) {
-            str = json_object_get_string(svd, "access_flags");
-            access_flags = cm_json_parser_parse_access_flags(str);
-        } else {
-            if (parent->default_access_flags != 0) {
-                access_flags = parent->default_access_flags;
-            } else {
-                access_flags = PERIPHERAL_REGISTER_DEFAULT_ACCESS_FLAGS;
-            }
-        }
-        cm_object_property_set_int(obj, access_flags, "access-flags");
-#endif
-
     }
 
     return obj;
 }
 
 Object *svd_add_register_bitfield_properties_and_children(Object *obj,
-        JSON_Object *svd)
+        const SVDField *bitfield, SVDDevice *svd)
 {
     const char *str;
-    uint32_t val32;
 
-    str = json_object_get_string(svd, "bitOffset");
-    if (str != NULL) {
-        val32 = svd_parse_uint(str);
-        assert(val32 < PERIPHERAL_REGISTER_MAX_SIZE_BITS);
-        cm_object_property_set_int(obj, val32, "first-bit");
+    if (bitfield->flags & SVD_FIELD_HAS_BIT_OFFSET) {
+        assert(bitfield->bit_offset < PERIPHERAL_REGISTER_MAX_SIZE_BITS);
+        cm_object_property_set_int(obj, bitfield->bit_offset, "first-bit");
     }
 
-    str = json_object_get_string(svd, "bitWidth");
-    if (str != NULL) {
-        val32 = svd_parse_uint(str);
-        assert(val32 < PERIPHERAL_REGISTER_MAX_SIZE_BITS);
-        cm_object_property_set_int(obj, val32, "width-bits");
+    if (bitfield->flags & SVD_FIELD_HAS_BIT_WIDTH) {
+        assert(bitfield->bit_width < PERIPHERAL_REGISTER_MAX_SIZE_BITS);
+        cm_object_property_set_int(obj, bitfield->bit_width, "width-bits");
     }
 
-    str = json_object_get_string(svd, "access");
-    // Passing a parsed string is ok, it is copied.
-    cm_object_property_set_str(obj, str, "svd-access");
+    // Passing a cached string is ok, it is copied.
+    cm_object_property_set_str(obj, svd_cache_string(svd, bitfield->access),
+            "svd-access");
 
     str = cm_object_property_get_str_with_parent(obj, "svd-access", NULL);
     if (str != NULL) {
@@ -350,76 +276,21 @@ Object *svd_add_register_bitfield_properties_and_children(Object *obj,
     return obj;
 }
 
-void svd_set_peripheral_address_block(JSON_Object *svd, const char* name,
+void svd_set_peripheral_address_block(SVDDevice *svd, const char* name,
         Object *obj)
 {
-    const char *str;
+    const SVDPeripheral *periph = svd_get_peripheral_by_name(svd, name);
 
-    uint32_t size = 0;
-    hwaddr addr = 0;
-
-    JSON_Object *periph = svd_get_peripheral_by_name(svd, name);
-
-    str = json_object_get_string(periph, "baseAddress");
-    if (str == NULL) {
-        error_printf("Missing baseAddress array.\n");
+    if (periph->block_error != 0) {
+        error_printf("%s\n", svd_cache_string(svd, periph->block_error));
         exit(1);
     }
-    addr = svd_parse_uint(str);
 
-    JSON_Array *address_blocks = json_object_get_array(periph, "addressBlocks");
-    if (address_blocks == NULL) {
-        str = json_object_get_string(periph, "derivedFrom");
-        if (str == NULL) {
-            error_printf("Missing derivedFrom for addressBlocks.\n");
-            exit(1);
-        }
-        JSON_Object *peripheral = svd_get_peripheral_by_name(svd, str);
-        if (peripheral == NULL) {
-            error_printf("Missing derivedFrom %s.\n", str);
-            exit(1);
-        }
-        address_blocks = json_object_get_array(peripheral, "addressBlocks");
-        if (address_blocks == NULL) {
-            error_printf("Missing addressBlocks array.\n");
-            exit(1);
-        }
-    }
-
-    size_t count = json_array_get_count(address_blocks);
-    int i;
-
-    for (i = 0; i < count; ++i) {
-        JSON_Object *address_block = json_array_get_object(address_blocks, i);
+    assert(periph->mmio_address != 0);
+    assert(periph->mmio_size_bytes != 0);
 
-        str = json_object_get_string(address_block, "usage");
-        if (strcmp(str, "registers") == 0) {
-            str = json_object_get_string(address_block, "offset");
-            if (str == NULL) {
-                error_printf("Missing addressBlock.offset.\n");
-                exit(1);
-            }
-            addr += svd_parse_uint(str);
-
-            str = json_object_get_string(address_block, "size");
-            if (str == NULL) {
-                error_printf("Missing addressBlock.size.\n");
-                exit(1);
-            }
-            size = svd_parse_uint(str);
-
-            assert(addr != 0);
-            assert(size != 0);
-
-            cm_object_property_set_int(obj, addr, "mmio-address");
-            cm_object_property_set_int(obj, size, "mmio-size-bytes");
-
-            return;
-        }
-    }
-
-    error_printf("Missing addressBlock.usage=registers.\n");
-    exit(1);
+    cm_object_property_set_int(obj, periph->mmio_address, "mmio-address");
+    cm_object_property_set_int(obj, periph->mmio_size_bytes, "mmio-size-bytes");
 }
 
 uint64_t svd_parse_uint(const char *str)
@@ -461,23 +332,22 @@ bool svd_parse_bool(const char *str)
     }
 }
 
-void svd_process_cpu(JSON_Object *svd, CortexMCoreCapabilities *core)
+void svd_process_cpu(SVDDevice *svd, CortexMCoreCapabilities *core)
 {
     assert(svd != NULL);
     assert(core != NULL);
 
-    JSON_Object *device = json_object_get_object(svd, "device");
-    assert(device != NULL);
+    assert((svd->header->device.flags & SVD_DEVICE_HAS_DEVICE) != 0);
 
-    JSON_Object *cpu = json_object_get_object(device, "cpu");
-    if (cpu == NULL) {
+    if ((svd->header->device.flags & SVD_DEVICE_HAS_CPU) == 0) {
         error_printf("SVD device has no mandatory \"cpu\".\n");
         exit(1);
     }
 
+    const SVDCpu *cpu = &svd->header->device.cpu;
     const char *str;
 
-    str = json_object_get_string(cpu, "name");
+    str = svd_cache_string(svd, cpu->name);
     if (str == NULL) {
         error_printf("SVD device.cpu has no mandatory \"name\".\n");
         exit(1);
@@ -500,7 +370,7 @@ void svd_process_cpu(JSON_Object *svd, CortexMCoreCapabilities *core)
         exit(1);
     }
 
-    str = json_object_get_string(cpu, "revision");
+    str = svd_cache_string(svd, cpu->revision);
     if (str != NULL) {
         int major = 0;
         int minor = 0;
@@ -517,28 +387,28 @@ void svd_process_cpu(JSON_Object *svd, CortexMCoreCapabilities *core)
 
     // TODO: process endian
 
-    str = json_object_get_string(cpu, "mpuPresent");
+    str = svd_cache_string(svd, cpu->mpu_present);
     if (str != NULL) {
         core->has_mpu = svd_parse_bool(str);
     } else {
         core->has_mpu = false;
     }
 
-    str = json_object_get_string(cpu, "fpuPresent");
+    str = svd_cache_string(svd, cpu->fpu_present);
     if (str != NULL) {
         core->has_fpu = svd_parse_bool(str);
     } else {
         core->has_fpu = false;
     }
 
-    str = json_object_get_string(cpu, "qemuItmPresent");
+    str = svd_cache_string(svd, cpu->itm_present);
     if (str != NULL) {
         core->has_etm = svd_parse_bool(str);
     } else {
         core->has_etm = false;
     }
 
-    str = json_object_get_string(cpu, "qemuEtmPresent");
+    str = svd_cache_string(svd, cpu->etm_present);
     if (str != NULL) {
         core->has_itm = svd_parse_bool(str);
     } else {
@@ -547,7 +417,7 @@ void svd_process_cpu(JSON_Object *svd, CortexMCoreCapabilities *core)
 
     // TODO parse fpuDP
 
-    str = json_object_get_string(cpu, "deviceNumInterrupts");
+    str = svd_cache_string(svd, cpu->num_interrupts);
     if (str != NULL) {
         core->num_irq = svd_parse_uint(str);
     } else {
@@ -556,7 +426,7 @@ void svd_process_cpu(JSON_Object *svd, CortexMCoreCapabilities *core)
         exit(1);
     }
 
-    str = json_object_get_string(cpu, "nvicPrioBits");
+    str = svd_cache_string(svd, cpu->nvic_prio_bits);
     if (str != NULL) {
         core->nvic_bits = svd_parse_uint(str);
     } else {
@@ -568,4 +438,3 @@ void svd_process_cpu(JSON_Object *svd, CortexMCoreCapabilities *core)
 }
 
 // ----------------------------------------------------------------------------
-
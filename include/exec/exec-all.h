@@ -207,6 +207,11 @@ struct TranslationBlock {
     uint16_t size;      /* size of target code for this block (1 <=
                            size <= TARGET_PAGE_SIZE) */
     uint16_t icount;
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+    /* Units charged to the icount budget at block start; equal to icount,
+       unless the target computes a cycle cost.  */
+    uint16_t icount_cost;
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
     uint32_t cflags;    /* compile flags */
 #define CF_COUNT_MASK  0x7fff
 #define CF_LAST_IO     0x8000 /* Last insn may be an IO access.  */
@@ -258,6 +263,10 @@ struct TranslationBlock {
 void tb_free(TranslationBlock *tb);
 void tb_flush(CPUState *cpu);
 void tb_phys_invalidate(TranslationBlock *tb, tb_page_addr_t page_addr);
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+TranslationBlock *tb_htable_lookup(CPUState *cpu, target_ulong pc,
+                                   target_ulong cs_base, uint32_t flags);
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
 
 #if defined(USE_DIRECT_JUMP)
 
@@ -45,8 +45,14 @@ static inline void gen_tb_start(TranslationBlock *tb)
     tcg_temp_free_i32(count);
 }
 
+/* With the cycle model, num_insns is the number of cycles charged for the
+   block; tb->icount must still be set to the number of instructions.  */
 static void gen_tb_end(TranslationBlock *tb, int num_insns)
 {
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+    tb->icount_cost = num_insns;
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
+
     gen_set_label(exitreq_label);
     tcg_gen_exit_tb((uintptr_t)tb + TB_EXIT_REQUESTED);
 
@@ -529,6 +529,28 @@ void memory_region_init_rom_device(MemoryRegion *mr,
                                    uint64_t size,
                                    Error **errp);
 
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+/**
+ * memory_region_init_rom_device_ptr:  Initialize a ROM memory region from
+ *                                     a user-provided pointer.  Writes are
+ *                                     handled via callbacks.
+ *
+ * @mr: the #MemoryRegion to be initialized.
+ * @owner: the object that tracks the region's reference count
+ * @ops: callbacks for write access handling (must not be NULL).
+ * @name: the name of the region.
+ * @size: size of the region.
+ * @ptr: memory to be mapped; must contain at least @size bytes.
+ */
+void memory_region_init_rom_device_ptr(MemoryRegion *mr,
+                                       struct Object *owner,
+                                       const MemoryRegionOps *ops,
+                                       void *opaque,
+                                       const char *name,
+                                       uint64_t size,
+                                       void *ptr);
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
+
 /**
  * memory_region_init_reservation: Initialize a memory region that reserves
  *                                 I/O space.
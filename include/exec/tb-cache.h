@@ -0,0 +1,55 @@
+/*
+ * Persistent translation cache.
+ *
+ * Copyright (c) 2017 Liviu Ionescu.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EXEC_TB_CACHE_H
+#define EXEC_TB_CACHE_H
+
+#include "exec/exec-all.h"
+
+/*
+ * The host code generated for each block is saved in a file at exit
+ * and reused by the next runs, skipping the translation of blocks whose
+ * guest code did not change.
+ *
+ * Blocks are keyed by the guest pc, cs_base, flags and cflags, the CPU
+ * type, and the hash of the guest page(s) containing the code; the file
+ * itself is valid only for the same QEMU executable and host CPU
+ * features. The host addresses in the generated code (helpers, the
+ * epilogue and the TranslationBlock) are relocated when loaded.
+ */
+
+/* Set by tb_cache_init() (see sysemu/cpus.h).  */
+extern bool tb_cache_enabled;
+
+/* Called by tb_gen_code() for a new block, with pc, cs_base, flags and
+   cflags set. Returns 1 if the code was loaded from the cache, with the
+   block filled in, 0 if the block must be translated, or -1 if the code
+   buffer is full.  */
+int tb_cache_lookup(CPUState *cpu, TranslationBlock *tb,
+                    tb_page_addr_t phys_pc, int *gen_code_size,
+                    int *search_size);
+
+/* Called by tb_gen_code() after a block was translated.  */
+void tb_cache_store(CPUState *cpu, TranslationBlock *tb,
+                    tb_page_addr_t phys_pc, tb_page_addr_t phys_page2,
+                    int gen_code_size, int search_size);
+
+void tb_cache_dump_info(FILE *f, fprintf_function cpu_fprintf);
+
+#endif
@@ -40,6 +40,12 @@ struct TBContext {
     /* statistics */
     unsigned tb_flush_count;
     int tb_phys_invalidate_count;
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+    /* helper_lookup_tb_ptr() results */
+    unsigned tb_lookup_jmp_cache_count;
+    unsigned tb_lookup_htable_count;
+    unsigned tb_lookup_miss_count;
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
 };
 
 #endif
@@ -179,6 +179,7 @@ struct MachineState {
 
 #if defined(CONFIG_GNU_MCU_ECLIPSE)
     const char *image_filename;
+    const char *flash_image_filename;
     const char *mcu_device;
 #endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
 
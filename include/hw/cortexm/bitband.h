@@ -25,11 +25,19 @@
 #include <hw/cortexm/helper.h>
 
 #include "hw/sysbus.h"
+#include "exec/memory.h"
 
 // ----------------------------------------------------------------------------
 
 #define CORTEXM_BITBAND_OFFSET (0x02000000)
 
+// The bit-band region covers the first 1 MB of the 32 MB area.
+#define CORTEXM_BITBAND_SOURCE_SIZE (0x00100000)
+
+// Number of target regions remembered; the peripheral bit-band
+// accesses usually alternate between a few peripherals.
+#define CORTEXM_BITBAND_CACHE_SIZE (4)
+
 // ----------------------------------------------------------------------------
 
 #define TYPE_CORTEXM_BITBAND TYPE_CORTEXM_PREFIX "bitband-memory"
@@ -61,6 +69,23 @@ typedef struct {
 #define CORTEXM_BITBAND_STATE(obj) \
     OBJECT_CHECK(CortexMBitBandState, (obj), TYPE_CORTEXM_BITBAND)
 
+// A contiguous range of the bit-band source area, resolved to
+// the memory region that implements it.
+typedef struct {
+    // NULL if the entry is not used; holds a reference.
+    MemoryRegion *mr;
+    // The range, as system addresses.
+    hwaddr start;
+    hwaddr size;
+    // Offset of start inside the region.
+    hwaddr offset_within_region;
+    // For RAM, the host address of start, otherwise NULL.
+    uint8_t *host;
+    // RAM address of start, for dirty tracking.
+    ram_addr_t ram_addr;
+    bool readonly;
+} CortexMBitBandTarget;
+
 typedef struct {
     // private:
     CortexMBitBandParentState parent_obj;
@@ -68,6 +93,12 @@ typedef struct {
 
     MemoryRegion iomem;
     uint32_t base;
+
+    // Invalidates the cache when the memory map changes.
+    MemoryListener listener;
+
+    CortexMBitBandTarget cache[CORTEXM_BITBAND_CACHE_SIZE];
+    int cache_next;
 } CortexMBitBandState;
 
 // ----------------------------------------------------------------------------
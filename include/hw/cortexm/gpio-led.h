@@ -32,6 +32,10 @@
 
 #define IRQ_GPIO_LED_IN     "led-in"
 
+// Above this rate, the on/off messages are no longer displayed
+// individually, only their number, once per second.
+#define GPIO_LED_MESSAGES_PER_SECOND    (20)
+
 // ----------------------------------------------------------------------------
 
 #define DEFINE_PROP_GPIO_LED_PTR(_n, _s, _f) \
@@ -118,6 +122,11 @@ typedef struct {
     const char *on_message;
     const char *off_message;
 
+    // Messages rate limiting, in host real time.
+    int64_t messages_window_start_ms;
+    uint32_t messages_in_window;
+    uint32_t messages_suppressed;
+
 #if defined(CONFIG_SDL)
     struct {
         uint8_t red;
@@ -133,6 +142,8 @@ typedef struct {
 Object **gpio_led_create_from_info(Object *parent, GPIOLEDInfo *info_array,
         BoardGraphicContext *graphic_context);
 
+uint64_t gpio_led_get_suppressed_messages(void);
+
 // ----------------------------------------------------------------------------
 
 #endif /* GPIO_LED_H_ */
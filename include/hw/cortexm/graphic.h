@@ -21,6 +21,7 @@
 #define CORTEXM_GRAPHIC_H_
 
 #include "qemu/osdep.h"
+#include "qemu/fprintf-fn.h"
 
 #if defined(CONFIG_SDL)
 #if defined(CONFIG_SDLABI_2_0)
@@ -97,8 +98,35 @@ typedef struct {
     SDL_Rect rectangle;
     SDL_Surface *crop_off;
     SDL_Surface *crop_on;
+
+    // Last state requested by the emulated device; written by the
+    // producer, read by the graphic thread when the ring is drained.
+    bool pending_is_on;
+    // True while the LED is in the ring; further changes only
+    // update pending_is_on.
+    bool is_queued;
+    // The state currently drawn, used only by the graphic thread.
+    bool is_drawn_on;
 } LEDGraphicContext;
 
+// LED changes are passed to the graphic thread via a lock-free ring,
+// with a single producer (the devices are accessed only with the
+// iothread lock taken) and a single consumer (the graphic event loop).
+// Each LED is at most once in the ring, so the size only limits the
+// number of LEDs that can change during a frame.
+#define GRAPHIC_LED_RING_SIZE (64) // Must be a power of 2.
+
+typedef struct {
+    // Number of LED changes that required a new ring entry.
+    uint64_t led_queued;
+    // Number of LED changes merged into an entry still in the ring.
+    uint64_t led_coalesced;
+    // Number of LED changes lost because the ring was full.
+    uint64_t led_dropped;
+    // Number of frames with at least one LED redrawn.
+    uint64_t frames;
+} GraphicStatistics;
+
 // ----------------------------------------------------------------------------
 
 enum {
@@ -107,7 +135,7 @@ enum {
     GRAPHIC_EVENT_EXIT,
     GRAPHIC_EVENT_BOARD_INIT,
     GRAPHIC_EVENT_LED_INIT,
-    GRAPHIC_EVENT_LED_TURN,
+    GRAPHIC_EVENT_LED_FLUSH,
 };
 
 // ----------------------------------------------------------------------------
@@ -124,6 +152,8 @@ int cortexm_graphic_enqueue_event(int code, void *data1, void *data2);
 
 void cortexm_graphic_event_loop(void);
 
+void cortexm_graphic_info(fprintf_function fprintf_func, void *f);
+
 //void cortexm_graphic_init_timer(void);
 
 // ----- Board graphic functions -----
@@ -140,6 +170,9 @@ void cortexm_graphic_board_add_button(
 void cortexm_graphic_led_clear_graphic_context(
         LEDGraphicContext *led_graphic_context);
 
+void cortexm_graphic_led_enqueue_turn(LEDGraphicContext *led_graphic_context,
+        bool is_on);
+
 bool cortexm_graphic_led_is_graphic_context_initialised(
         LEDGraphicContext *led_graphic_context);
 
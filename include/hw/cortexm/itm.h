@@ -24,6 +24,9 @@
 
 #include "hw/sysbus.h"
 #include "exec/address-spaces.h"
+#include "sysemu/char.h"
+#include "qemu/timer.h"
+#include "qemu/notify.h"
 #include <hw/cortexm/peripheral.h>
 #include <hw/cortexm/helper.h>
 
@@ -34,6 +37,14 @@
 #define CORTEXM_ITM_DEFAULT_NUM_PORTS	32
 #define CORTEXM_ITM_MAX_NUM_PORTS		256
 
+// The SWO packet header has only 5 bits for the port number.
+#define CORTEXM_ITM_SWO_MAX_NUM_PORTS   32
+
+// The output is accumulated and written when the buffer is full,
+// at the end of a line (when not framed), or after a short delay.
+#define CORTEXM_ITM_OUT_BUFFER_SIZE     (4096)
+#define CORTEXM_ITM_FLUSH_DELAY_MS      (10)
+
 // ----------------------------------------------------------------------------
 
 #define TYPE_CORTEXM_ITM TYPE_CORTEXM_PREFIX "itm" TYPE_PERIPHERAL_SUFFIX
@@ -74,6 +85,24 @@ typedef struct {
     // Must be a multiple of 8
     int num_ports;
 
+    // Where the stimulus writes go; if not set, to stderr.
+    CharBackend chr;
+
+    // If true, the output is framed as ITM software source packets
+    // (SWO protocol), so host tools can demultiplex the ports;
+    // otherwise only the payload bytes are written.
+    bool swo_framing;
+
+    // Set on reset, a synchronisation packet precedes the first
+    // framed packet.
+    bool needs_sync;
+
+    uint8_t out_buffer[CORTEXM_ITM_OUT_BUFFER_SIZE];
+    uint32_t out_count;
+
+    QEMUTimer *flush_timer;
+    Notifier exit_notifier;
+
     // The memory area 0xE0000000-0xE0000FFF.
     MemoryRegion mmio;
 
@@ -30,6 +30,7 @@
 
 #include <hw/cortexm/itm.h>
 #include <hw/cortexm/json-parser.h>
+#include <hw/cortexm/svd-cache.h>
 
 // ----------------------------------------------------------------------------
 
@@ -128,6 +129,10 @@ typedef struct {
 
 // ----------------------------------------------------------------------------
 
+// Guest write to flash; `addr` is the offset in the flash area.
+typedef void (*cortexm_flash_write_callback_t)(void *opaque, hwaddr addr,
+        uint64_t value, unsigned size);
+
 // Instance definitions.
 #define CORTEXM_MCU_STATE(obj) \
     OBJECT_CHECK(CortexMState, (obj), TYPE_CORTEXM_MCU)
@@ -143,10 +148,20 @@ typedef struct {
     // R/W copy of core capabilities, set by *_instance_init().
     const CortexMCapabilities *capabilities;
 
-    JSON_Object *svd_json;
+    // The processed SVD device, mapped from the cache.
+    SVDDevice *svd_device;
 
     const char *image_filename;
 
+    // If set, the flash content is mapped from this file, and the
+    // changes are preserved across runs.
+    const char *flash_image_filename;
+
+    // Called for guest writes to flash, to implement the vendor
+    // programming logic; writes are ignored if not set.
+    cortexm_flash_write_callback_t flash_write;
+    void *flash_write_opaque;
+
     // The following are the actual values used to initialise the object.
     // May be different from capabilities, if explicitly overwritten.
     const char *cpu_model;
@@ -0,0 +1,188 @@
+/*
+ * Cortex-M NVIC priority engine.
+ *
+ * Copyright (c) 2017 Liviu Ionescu.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CORTEXM_NVIC_PRIO_H_
+#define CORTEXM_NVIC_PRIO_H_
+
+#include "qemu/osdep.h"
+#include "qemu/bitops.h"
+#include "qemu/bitmap.h"
+
+// ----------------------------------------------------------------------------
+
+/*
+ * The state of the exceptions (pending, enabled, active) and the
+ * logic to select the exception to be taken, without any QOM
+ * dependencies, to allow it to be used by the benchmarks in tests/.
+ *
+ * Exceptions are identified by the vector number (1-15 for the system
+ * exceptions, 16 and up for the interrupts), with 0 meaning none.
+ *
+ * Priorities are signed, the lower the value, the higher the priority;
+ * Reset, NMI and HardFault have fixed negative priorities, the others
+ * use the 8-bit values from the registers (with the unimplemented
+ * low bits cleared).
+ *
+ * Exceptions that are both pending and enabled are kept in per-priority
+ * bitmaps, and the non-empty priorities in another bitmap, so the
+ * highest priority pending exception is found with two find-first-set
+ * searches; for the same priority, the lowest vector number wins.
+ * Active exceptions are counted per priority in a similar way, to
+ * compute the execution priority.
+ */
+
+/*
+ * System exceptions numbers.
+ */
+#define NVIC_EXCEPTION_RESET            1
+#define NVIC_EXCEPTION_NMI              2
+#define NVIC_EXCEPTION_HARD_FAULT       3
+#define NVIC_EXCEPTION_MEM_MANAGE       4
+#define NVIC_EXCEPTION_BUS_FAULT        5
+#define NVIC_EXCEPTION_USAGE_FAULT      6
+#define NVIC_EXCEPTION_SVCALL           11
+#define NVIC_EXCEPTION_DEBUG_MONITOR    12
+#define NVIC_EXCEPTION_PENDSV           14
+#define NVIC_EXCEPTION_SYSTICK          15
+
+// In addition to these 16 exceptions, each device also has a vendor specific
+// number of peripheral interrupts (`num_irq`).
+
+#define NVIC_PRIO_MAX_IRQ               (512)
+#define NVIC_PRIO_MAX_VECTORS           (16 + NVIC_PRIO_MAX_IRQ)
+
+#define NVIC_PRIO_RESET                 (-3)
+#define NVIC_PRIO_NMI                   (-2)
+#define NVIC_PRIO_HARD_FAULT            (-1)
+
+// Execution priority when no exception is active.
+#define NVIC_PRIO_THREAD                (256)
+
+// One level for each priority, from -3 to 255.
+#define NVIC_PRIO_LEVEL_OFFSET          (3)
+#define NVIC_PRIO_NUM_LEVELS            (256 + NVIC_PRIO_LEVEL_OFFSET)
+
+typedef struct {
+    uint32_t num_vectors;
+
+    // Implemented priority bits, from the left.
+    uint8_t priority_mask;
+    // AIRCR.PRIGROUP, the bits at and below bit (prigroup) are
+    // the subpriority.
+    uint8_t prigroup;
+
+    // Raw values, as written in the registers, masked.
+    uint8_t raw_priority[NVIC_PRIO_MAX_VECTORS];
+    // Effective priority, including the fixed ones.
+    int16_t priority[NVIC_PRIO_MAX_VECTORS];
+
+    unsigned long enabled[BITS_TO_LONGS(NVIC_PRIO_MAX_VECTORS)];
+    unsigned long pending[BITS_TO_LONGS(NVIC_PRIO_MAX_VECTORS)];
+    unsigned long active[BITS_TO_LONGS(NVIC_PRIO_MAX_VECTORS)];
+
+    // Pending and enabled, grouped by priority.
+    unsigned long ready[NVIC_PRIO_NUM_LEVELS][BITS_TO_LONGS(
+            NVIC_PRIO_MAX_VECTORS)];
+    uint16_t ready_count[NVIC_PRIO_NUM_LEVELS];
+    unsigned long ready_levels[BITS_TO_LONGS(NVIC_PRIO_NUM_LEVELS)];
+
+    // Active, counted by priority.
+    uint16_t active_count[NVIC_PRIO_NUM_LEVELS];
+    unsigned long active_levels[BITS_TO_LONGS(NVIC_PRIO_NUM_LEVELS)];
+    uint32_t num_active;
+} NVICPrio;
+
+// ----- Public ---------------------------------------------------------------
+
+void nvic_prio_init(NVICPrio *p, uint32_t num_vectors, int priority_bits);
+void nvic_prio_reset(NVICPrio *p);
+
+void nvic_prio_set_priority(NVICPrio *p, int vector, uint8_t raw);
+void nvic_prio_set_prigroup(NVICPrio *p, int prigroup);
+
+void nvic_prio_set_enabled(NVICPrio *p, int vector, bool enabled);
+void nvic_prio_set_pending(NVICPrio *p, int vector, bool pending);
+void nvic_prio_set_active(NVICPrio *p, int vector, bool active);
+
+int nvic_prio_execution_priority(NVICPrio *p, uint32_t basepri);
+
+static inline bool nvic_prio_is_enabled(NVICPrio *p, int vector)
+{
+    return test_bit(vector, p->enabled);
+}
+
+static inline bool nvic_prio_is_pending(NVICPrio *p, int vector)
+{
+    return test_bit(vector, p->pending);
+}
+
+static inline bool nvic_prio_is_active(NVICPrio *p, int vector)
+{
+    return test_bit(vector, p->active);
+}
+
+// Clear the subpriority bits.
+static inline int nvic_prio_group_priority(NVICPrio *p, int priority)
+{
+    if (priority < 0) {
+        return priority;
+    }
+    return priority & ~((2 << p->prigroup) - 1);
+}
+
+// Return the highest priority pending and enabled exception, or 0.
+static inline int nvic_prio_highest_pending(NVICPrio *p)
+{
+    unsigned long level = find_first_bit(p->ready_levels,
+            NVIC_PRIO_NUM_LEVELS);
+    if (level >= NVIC_PRIO_NUM_LEVELS) {
+        return 0;
+    }
+    return find_first_bit(p->ready[level], p->num_vectors);
+}
+
+// Return the exception that should preempt the current execution,
+// or 0 if none.
+static inline int nvic_prio_preempting(NVICPrio *p, uint32_t basepri)
+{
+    int vector = nvic_prio_highest_pending(p);
+    if (vector == 0) {
+        return 0;
+    }
+    if (nvic_prio_group_priority(p, p->priority[vector])
+            >= nvic_prio_execution_priority(p, basepri)) {
+        return 0;
+    }
+    return vector;
+}
+
+// Make the exception active; return it, or 0 if none.
+static inline int nvic_prio_acknowledge(NVICPrio *p)
+{
+    int vector = nvic_prio_highest_pending(p);
+    if (vector != 0) {
+        nvic_prio_set_pending(p, vector, false);
+        nvic_prio_set_active(p, vector, true);
+    }
+    return vector;
+}
+
+// ----------------------------------------------------------------------------
+
+#endif /* CORTEXM_NVIC_PRIO_H_ */
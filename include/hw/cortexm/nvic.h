@@ -24,32 +24,24 @@
 
 #include "qemu/osdep.h"
 
-#include "hw/intc/gic_internal.h"
+#include "hw/sysbus.h"
+#include "qemu/timer.h"
 #include <hw/cortexm/peripheral.h>
+#include <hw/cortexm/nvic-prio.h>
 
 // ----------------------------------------------------------------------------
 
 #define DEVICE_PATH_CORTEXM_NVIC "/machine/mcu/cortexm/nvic"
 
-/* The GIC incoming interrupts are currently unnamed. */
+/* The incoming interrupts are unnamed, one per peripheral interrupt. */
 #define IRQ_NVIC_IN     NULL
 
-/*
- * System exceptions numbers.
- */
-#define NVIC_EXCEPTION_RESET            1
-#define NVIC_EXCEPTION_NMI              2
-#define NVIC_EXCEPTION_HARD_FAULT       3
-#define NVIC_EXCEPTION_MEM_MANAGE       4
-#define NVIC_EXCEPTION_BUS_FAULT        5
-#define NVIC_EXCEPTION_USAGE_FAULT      6
-#define NVIC_EXCEPTION_SVCALL           11
-#define NVIC_EXCEPTION_DEBUG_MONITOR    12
-#define NVIC_EXCEPTION_PENDSV           14
-#define NVIC_EXCEPTION_SYSTICK          15
-
-// In addition to these 16 exceptions, each device also has a vendor specific
-// number of peripheral interrupts (`num_irq`).
+// The system exceptions numbers are defined in nvic-prio.h.
+
+#define CORTEXM_NVIC_DEFAULT_NUM_IRQ    (64)
+
+// For migration, the bitmaps are saved as NVIC register words.
+#define CORTEXM_NVIC_VMSTATE_WORDS      DIV_ROUND_UP(NVIC_PRIO_MAX_VECTORS, 32)
 
 // ----------------------------------------------------------------------------
 
@@ -58,9 +50,9 @@
 // ----------------------------------------------------------------------------
 
 // Parent definitions.
-#define TYPE_CORTEXM_NVIC_PARENT TYPE_ARM_GIC_COMMON
-typedef ARMGICClass CortexMNVICParentClass;
-typedef GICState CortexMNVICParentState;
+#define TYPE_CORTEXM_NVIC_PARENT TYPE_SYS_BUS_DEVICE
+typedef SysBusDeviceClass CortexMNVICParentClass;
+typedef SysBusDevice CortexMNVICParentState;
 
 // ----------------------------------------------------------------------------
 
@@ -87,10 +79,11 @@ typedef struct {
 #define CORTEXM_NVIC_STATE(obj) \
     OBJECT_CHECK(CortexMNVICState, (obj), TYPE_CORTEXM_NVIC)
 
-// Inspired by the nvic_state defined in hw/intc/armv7m_nvic.c
+// Inspired by the nvic_state defined in hw/intc/armv7m_nvic.c, but
+// with a native priority engine, instead of the ARM GIC.
 typedef struct {
     // private:
-    CortexMNVICParentState gic;
+    CortexMNVICParentState parent_obj;
     // public:
 
     struct {
@@ -100,14 +93,38 @@ typedef struct {
         QEMUTimer *timer;
     } systick;
     MemoryRegion sysregmem;
-    MemoryRegion gic_iomem_alias;
     MemoryRegion container;
 
     // Number of vendor specific interrupts, multiple of 32.
     uint32_t num_irq;
+    // Number of implemented priority bits.
+    uint8_t priority_bits;
+
+    // The pending/enabled/active state and priorities.
+    NVICPrio prio;
+
+    // Points to the CPU BASEPRI register.
+    uint32_t *basepri_ptr;
+
+    // Raised when an exception should preempt the current execution.
+    qemu_irq cpu_irq;
+
+    // The level of the incoming interrupt lines; a line still high when
+    // the handler returns makes the interrupt pending again.
+    unsigned long level[BITS_TO_LONGS(NVIC_PRIO_MAX_IRQ)];
 
     qemu_irq sysresetreq;
 
+    // For migration, see CORTEXM_NVIC_VMSTATE_WORDS.
+    struct {
+        uint32_t enabled[CORTEXM_NVIC_VMSTATE_WORDS];
+        uint32_t pending[CORTEXM_NVIC_VMSTATE_WORDS];
+        uint32_t active[CORTEXM_NVIC_VMSTATE_WORDS];
+        uint32_t level[CORTEXM_NVIC_VMSTATE_WORDS];
+        uint8_t priority[NVIC_PRIO_MAX_VECTORS];
+        uint8_t prigroup;
+    } saved;
+
     // System Control Block 0xE000ED00 - 0xE000ED8C
     struct {
         uint32_t scr; // 0xE000ED10, RW, 0x00000000, System Control Block
@@ -141,6 +158,9 @@ void cortexm_nvic_set_pending_interrupt(void *opaque, int irq);
 int cortexm_nvic_acknowledge_irq(void *opaque);
 void cortexm_nvic_complete_irq(void *opaque, int irq);
 
+bool cortexm_nvic_can_tail_chain(void *opaque);
+void cortexm_nvic_update(void *opaque);
+
 // ----------------------------------------------------------------------------
 
 #endif /* CORTEXM_NVIC_H */
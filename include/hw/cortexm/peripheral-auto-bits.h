@@ -0,0 +1,116 @@
+/*
+ * Peripheral register auto bits.
+ *
+ * Copyright (c) 2017 Liviu Ionescu.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PERIPHERAL_AUTO_BITS_H_
+#define PERIPHERAL_AUTO_BITS_H_
+
+#include "qemu/osdep.h"
+#include "qemu/bitops.h"
+
+// ----------------------------------------------------------------------------
+
+/*
+ * Automatically reflected bits (like ENABLE) into status bits
+ * (like READY).
+ *
+ * This file has no QOM dependencies, to allow it to be used by
+ * the benchmarks in tests/.
+ */
+
+typedef enum {
+    PERIPHERAL_REGISTER_AUTO_BITS_TYPE_FOLLOWS = 1,
+    PERIPHERAL_REGISTER_AUTO_BITS_TYPE_CLEARED_BY,
+    PERIPHERAL_REGISTER_AUTO_BITS_TYPE_SET_BY,
+} peripheral_register_auto_bits_type_t;
+
+/*
+ * A rule, as collected from the register bitfields. The mask defines
+ * which bits should be reflected and the shift how many positions
+ * should be shifted (+ <<, - >>).
+ *
+ * The operations are:
+ * - follows:       value &= ~(mask << shift);
+ *                  value |= ((value & mask) << shift);
+ * - cleared by:    value &= ~((value & mask) << shift);
+ * - set by:        value |= ((value & mask) << shift);
+ *
+ * Arrays of rules are terminated by a zero mask.
+ */
+typedef struct {
+    uint64_t mask;
+    int shift;
+    // follows, cleared by, set by
+    peripheral_register_auto_bits_type_t type;
+} PeripheralRegisterAutoBits;
+
+/*
+ * A step of the compiled program. Since both bitfields are inside the
+ * register, shifts are implemented as rotations (right shifts are
+ * left rotations by 64 - shift), so all steps of a type execute the
+ * same code, with no branches:
+ *
+ * - follows:       value &= ~dest_mask;
+ *                  value |= rol64(value & src_mask, rotate);
+ * - cleared by:    value &= ~rol64(value & src_mask, rotate);
+ * - set by:        value |= rol64(value & src_mask, rotate);
+ */
+typedef struct {
+    uint64_t src_mask;
+    uint64_t dest_mask;
+    uint32_t rotate;
+} PeripheralAutoBitsStep;
+
+// The steps are grouped by type: first all follows, then all
+// cleared by, then all set by.
+typedef struct {
+    uint32_t num_follows;
+    uint32_t num_cleared_by;
+    uint32_t num_set_by;
+    PeripheralAutoBitsStep steps[];
+} PeripheralAutoBitsProgram;
+
+// ----- Public ---------------------------------------------------------------
+
+PeripheralAutoBitsProgram *peripheral_auto_bits_compile(
+        const PeripheralRegisterAutoBits *rules);
+
+// Apply the auto bits rules to the value about to be written.
+static inline uint64_t peripheral_auto_bits_run(
+        const PeripheralAutoBitsProgram *program, uint64_t value)
+{
+    const PeripheralAutoBitsStep *step = program->steps;
+    const PeripheralAutoBitsStep *end;
+
+    for (end = step + program->num_follows; step < end; ++step) {
+        value &= ~step->dest_mask;
+        value |= rol64(value & step->src_mask, step->rotate);
+    }
+    for (end = step + program->num_cleared_by; step < end; ++step) {
+        value &= ~rol64(value & step->src_mask, step->rotate);
+    }
+    for (end = step + program->num_set_by; step < end; ++step) {
+        value |= rol64(value & step->src_mask, step->rotate);
+    }
+
+    return value;
+}
+
+// ----------------------------------------------------------------------------
+
+#endif /* PERIPHERAL_AUTO_BITS_H_ */
@@ -26,6 +26,7 @@
 #include "qapi/error.h"
 
 #include <hw/cortexm/register-bitfield.h>
+#include <hw/cortexm/peripheral-auto-bits.h>
 #include <hw/cortexm/json-parser.h>
 
 /*
@@ -143,30 +144,6 @@ typedef struct {
     //register_write_callback_t post_write;
 } PeripheralRegisterInfo;
 
-typedef enum {
-    PERIPHERAL_REGISTER_AUTO_BITS_TYPE_FOLLOWS = 1,
-    PERIPHERAL_REGISTER_AUTO_BITS_TYPE_CLEARED_BY,
-    PERIPHERAL_REGISTER_AUTO_BITS_TYPE_SET_BY,
-} peripheral_register_auto_bits_type_t;
-
-/*
- * Automatically reflected bits (like ENABLE) into status bits
- * (like READY). The mask defines which bits should be reflected and
- * the shift how many positions should be shifted (+ <<, - >>).
- *
- * The operations are:
- *      value &= ~(mask << shift);
- *      value |= ((value & mask) << shift);
- *
- * The array is terminated by a zero mask.
- */
-typedef struct {
-    peripheral_register_t mask;
-    int shift;
-    // follows, cleared by, set by
-    peripheral_register_auto_bits_type_t type;
-} PeripheralRegisterAutoBits;
-
 // ----------------------------------------------------------------------------
 
 #define TYPE_PERIPHERAL_REGISTER "peripheral-register"
@@ -225,7 +202,8 @@ typedef struct {
     bool is_readable; /**/
     bool is_writable;
 
-    PeripheralRegisterAutoBits *auto_bits;
+    // Compiled auto bits rules, or NULL if none.
+    PeripheralAutoBitsProgram *auto_bits;
 
     // Current register value; returned (masked) by reads.
     peripheral_register_t value;
@@ -305,6 +283,14 @@ void peripheral_register_set_pre_read(Object* obj,
 void peripheral_register_set_post_read(Object* obj,
         register_post_read_callback_t ptr);
 
+// The default class methods; derived types may redefine them.
+peripheral_register_t peripheral_register_read_callback(Object *reg,
+        Object *periph, uint32_t addr, uint32_t offset, unsigned size);
+
+void peripheral_register_write_callback(Object *reg, Object *periph,
+        uint32_t addr, uint32_t offset, unsigned size,
+        peripheral_register_t value);
+
 // ----------------------------------------------------------------------------
 
 #endif /* PERIPHERAL_REGISTER_H_ */
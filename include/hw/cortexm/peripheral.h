@@ -21,6 +21,7 @@
 #define PERIPHERAL_H_
 
 #include "qemu/osdep.h"
+#include "qemu/fprintf-fn.h"
 
 #include <hw/cortexm/peripheral-register.h>
 #include <hw/cortexm/json-parser.h>
@@ -64,6 +65,45 @@ typedef SysBusDevice PeripheralParentState;
 
 typedef bool (*peripheral_is_enabled_t)(Object *obj);
 
+// Create the registers and bitfields children, then call
+// peripheral_prepare_registers().
+typedef void (*peripheral_populate_t)(Object *obj);
+
+/*
+ * Pre-resolved register access entry, used by the MMIO callbacks to
+ * reach the register without QOM casts or class lookups.
+ *
+ * The read/write pointers are the register class methods, or NULL
+ * when the class uses the default peripheral register methods, which
+ * are then called directly.
+ */
+typedef struct {
+    Object *obj;
+    PeripheralRegisterState *state;
+
+    register_read_callback_t read;
+    register_write_callback_t write;
+} PeripheralRegisterDispatch;
+
+/*
+ * Registers are located by index (offset / register size). Compact
+ * peripherals use a dense array of entries; for large, sparse,
+ * peripherals (like USB OTG or Ethernet MAC, with registers spread
+ * over several KB), the entries are grouped in pages, and only pages
+ * with registers are allocated. The layout is selected automatically.
+ */
+typedef enum {
+    PERIPHERAL_REGISTERS_LAYOUT_NONE = 0,
+    PERIPHERAL_REGISTERS_LAYOUT_DENSE,
+    PERIPHERAL_REGISTERS_LAYOUT_PAGED,
+} peripheral_registers_layout_t;
+
+#define PERIPHERAL_REGISTERS_PAGE_BITS      (4)
+#define PERIPHERAL_REGISTERS_PAGE_ENTRIES   (1 << PERIPHERAL_REGISTERS_PAGE_BITS)
+
+// Below this number of entries, always use the dense array.
+#define PERIPHERAL_REGISTERS_DENSE_MIN_ENTRIES  (64)
+
 /* Class definitions. */
 #define PERIPHERAL_GET_CLASS(obj) \
     OBJECT_GET_CLASS(PeripheralClass, (obj), TYPE_PERIPHERAL)
@@ -109,11 +149,41 @@ typedef struct {
     uint32_t max_offset_bytes;
     uint32_t num_registers;
 
+    // log2(register_size_bytes), to compute the index.
+    uint32_t register_size_shift;
+
+    // Number of indices covered by the lookup tables (not all used).
     uint32_t registers_size_ptrs;
-    Object **registers;
+    peripheral_registers_layout_t registers_layout;
+    // Dense layout: array of dispatch entries, indexed by offset /
+    // register size; unused entries have a NULL obj.
+    PeripheralRegisterDispatch *registers;
+    // Paged layout: array of pointers to pages of dispatch entries,
+    // indexed by index >> PERIPHERAL_REGISTERS_PAGE_BITS; pages
+    // without registers are NULL.
+    PeripheralRegisterDispatch **register_pages;
+    uint32_t num_register_pages;
+    uint32_t num_used_register_pages;
+
+    // All registers, in offset order, for iterations.
+    PeripheralRegisterState **register_list;
+
+    // Accesses to offsets with no registers.
+    uint64_t unimplemented_accesses;
 
     bool is_little_endian;
 
+    // Class is_enabled(), resolved when the registers are prepared.
+    peripheral_is_enabled_t is_enabled;
+    // Cached is_enabled() result, valid while enabled_generation
+    // matches the global generation.
+    bool is_enabled_cached;
+    uint32_t enabled_generation;
+
+    // For lazy peripherals, the function that creates the registers,
+    // called on the first access; NULL once the registers exist.
+    peripheral_populate_t populate;
+
     struct {
         const char *size;
         const char *access;
@@ -135,6 +205,28 @@ void peripheral_serialize_info(const char* file_name, const char* periph_name,
 void peripheral_create_memory_region(Object *obj);
 void peripheral_prepare_registers(Object *obj);
 
+void peripheral_populate_registers(Object *obj, peripheral_populate_t populate,
+        bool is_lazy);
+void peripheral_materialize(Object *obj);
+bool peripheral_is_materialized(Object *obj);
+
+void peripheral_invalidate_enabled_cache(void);
+
+PeripheralRegisterDispatch *peripheral_find_register(PeripheralState *state,
+        uint32_t offset_bytes);
+
+size_t peripheral_registers_lookup_size(PeripheralState *state);
+
+void peripheral_info(fprintf_function fprintf_func, void *f);
+
+peripheral_register_t peripheral_register_direct_read(
+        PeripheralRegisterState *state, PeripheralState *periph_state,
+        uint32_t addr, uint32_t offset, unsigned size);
+
+void peripheral_register_direct_write(PeripheralRegisterState *state,
+        PeripheralState *periph_state, uint32_t addr, uint32_t offset,
+        unsigned size, peripheral_register_t value);
+
 // ----------------------------------------------------------------------------
 
 #endif /* PERIPHERAL_H_ */
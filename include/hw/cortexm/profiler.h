@@ -0,0 +1,45 @@
+/*
+ * Cortex-M guest sampling profiler.
+ *
+ * Copyright (c) 2017 Liviu Ionescu.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CORTEXM_PROFILER_H_
+#define CORTEXM_PROFILER_H_
+
+#include "qemu/osdep.h"
+
+// ----------------------------------------------------------------------------
+
+// Samples per second of virtual time.
+#define CORTEXM_PROFILER_DEFAULT_RATE   (1000)
+
+// Frames above the sampled function.
+#define CORTEXM_PROFILER_DEFAULT_DEPTH  (16)
+#define CORTEXM_PROFILER_MAX_DEPTH      (64)
+
+// ----- Public ---------------------------------------------------------------
+
+// Start sampling the call stack of the core; the folded stacks are
+// written to file_name at exit.
+void cortexm_profiler_init(const char *file_name, int rate, int depth);
+
+// Write the folded stacks collected so far.
+bool cortexm_profiler_dump(const char *file_name, Error **errp);
+
+// ----------------------------------------------------------------------------
+
+#endif /* CORTEXM_PROFILER_H_ */
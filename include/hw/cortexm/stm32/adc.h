@@ -0,0 +1,141 @@
+/*
+ * STM32 MCU - ADC (analog to digital converter) emulation.
+ *
+ * Copyright (c) 2017 Liviu Ionescu.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STM32_ADC_H_
+#define STM32_ADC_H_
+
+#include "qemu/osdep.h"
+
+#include <hw/cortexm/peripheral.h>
+#include <hw/cortexm/stm32/capabilities.h>
+#include <hw/cortexm/nvic.h>
+
+#include "qemu/timer.h"
+
+// ----------------------------------------------------------------------------
+
+#define DEVICE_PATH_STM32_ADC DEVICE_PATH_STM32 "ADC"
+
+typedef enum {
+    STM32_ADC_1 = 0,
+    STM32_ADC_2,
+    STM32_ADC_3,
+    STM32_ADC_UNDEFINED,
+} stm32_adc_index_t;
+
+// Up to 16 external inputs, plus the internal ones.
+#define STM32_ADC_MAX_INPUTS    (19)
+#define STM32_ADC_MAX_SEQUENCE  (16)
+
+// ----------------------------------------------------------------------------
+
+#define TYPE_STM32_ADC TYPE_STM32_PREFIX "adc" TYPE_PERIPHERAL_SUFFIX
+
+// ----------------------------------------------------------------------------
+
+// Parent definitions.
+#define TYPE_STM32_ADC_PARENT TYPE_PERIPHERAL
+typedef PeripheralClass STM32ADCParentClass;
+typedef PeripheralState STM32ADCParentState;
+
+// ----------------------------------------------------------------------------
+
+// Class definitions.
+#define STM32_ADC_GET_CLASS(obj) \
+    OBJECT_GET_CLASS(STM32ADCClass, (obj), TYPE_STM32_ADC)
+#define STM32_ADC_CLASS(klass) \
+    OBJECT_CLASS_CHECK(STM32ADCClass, (klass), TYPE_STM32_ADC)
+
+typedef struct {
+    // private:
+    STM32ADCParentClass parent_class;
+    // public:
+
+    // None, so far.
+} STM32ADCClass;
+
+// ----------------------------------------------------------------------------
+
+// Instance definitions.
+#define STM32_ADC_STATE(obj) \
+    OBJECT_CHECK(STM32ADCState, (obj), TYPE_STM32_ADC)
+
+typedef struct {
+    // private:
+    STM32ADCParentState parent_obj;
+    // public:
+
+    const STM32Capabilities *capabilities;
+
+    stm32_adc_index_t adc_index;
+
+    // Points to one RCC bitfield that enables the peripheral.
+    Object *enabling_bit;
+
+    CortexMNVICState *nvic;
+    int irq;
+
+    // The regular group registers, common to F1 and F4.
+    struct {
+        Object *sr;
+        Object *cr1;
+        Object *cr2;
+        Object *smpr1;
+        Object *smpr2;
+        Object *sqr1;
+        Object *sqr2;
+        Object *sqr3;
+        Object *dr;
+    } reg;
+
+    // The input samples, a file of little endian 16-bit values,
+    // in frames of `sample_channels` values, one frame every
+    // 1/`sample_rate` seconds of virtual time. The file is mapped,
+    // not read, so it can be larger than the host memory. After the
+    // last frame, the last values are kept.
+    char *samples_file;
+    uint32_t sample_rate;
+    uint32_t sample_channels;
+    GMappedFile *mapped_file;
+    const uint8_t *samples;
+    uint64_t num_frames;
+
+    // The conversion in progress, as index in the sequence.
+    bool is_converting;
+    int sequence_index;
+    QEMUTimer *timer;
+
+    // The DMA channel serving the requests, if any, and the current
+    // request level.
+    struct {
+        Object *dma;
+        int channel;
+        int request;
+        bool level;
+    } dma;
+
+} STM32ADCState;
+
+// ----- Public ---------------------------------------------------------------
+
+Object* stm32_adc_create(Object *parent, stm32_adc_index_t index);
+
+// ----------------------------------------------------------------------------
+
+#endif /* STM32_ADC_H_ */
@@ -75,6 +75,11 @@ typedef struct {
     // Used in GPIOs, it is easier to make it common to all families.
     struct {
         Object *exti[16];
+        Object *reg[4];
+
+        // The pins routed to EXTI, one mask per GPIO port, updated
+        // when EXTICR registers are written.
+        uint16_t port_mask[STM32_MAX_GPIO];
     } exticr;
 
     union {
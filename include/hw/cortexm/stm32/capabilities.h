@@ -52,8 +52,13 @@ typedef enum {
     STM32_FAMILY_L4,
 } stm32_family_t;
 
-#define STM32_MAX_GPIO  (8)
+#define STM32_MAX_GPIO  (11)
 #define STM32_MAX_USART (6)
+#define STM32_MAX_TIM   (17)
+#define STM32_MAX_DMA   (2)
+#define STM32_MAX_ADC   (3)
+#define STM32_MAX_SPI   (6)
+#define STM32_MAX_I2C   (3)
 
 typedef enum {
     STM32F051XX_WWDG_IRQn = 0, /*!< Window WatchDog Interrupt                               */
@@ -168,6 +173,69 @@ typedef enum {
     STM32F10X_MD_USBWakeUp_IRQn = 42 /*!< USB Device WakeUp from suspend through EXTI Line Interrupt */
 } STM32F10X_MD_IRQn_Type;
 
+typedef enum {
+    STM32F10X_HD_WWDG_IRQn = 0, /*!< Window WatchDog Interrupt                            */
+    STM32F10X_HD_PVD_IRQn = 1, /*!< PVD through EXTI Line detection Interrupt            */
+    STM32F10X_HD_TAMPER_IRQn = 2, /*!< Tamper Interrupt                                     */
+    STM32F10X_HD_RTC_IRQn = 3, /*!< RTC global Interrupt                                 */
+    STM32F10X_HD_FLASH_IRQn = 4, /*!< FLASH global Interrupt                               */
+    STM32F10X_HD_RCC_IRQn = 5, /*!< RCC global Interrupt                                 */
+    STM32F10X_HD_EXTI0_IRQn = 6, /*!< EXTI Line0 Interrupt                                 */
+    STM32F10X_HD_EXTI1_IRQn = 7, /*!< EXTI Line1 Interrupt                                 */
+    STM32F10X_HD_EXTI2_IRQn = 8, /*!< EXTI Line2 Interrupt                                 */
+    STM32F10X_HD_EXTI3_IRQn = 9, /*!< EXTI Line3 Interrupt                                 */
+    STM32F10X_HD_EXTI4_IRQn = 10, /*!< EXTI Line4 Interrupt                                 */
+    STM32F10X_HD_DMA1_Channel1_IRQn = 11, /*!< DMA1 Channel 1 global Interrupt                      */
+    STM32F10X_HD_DMA1_Channel2_IRQn = 12, /*!< DMA1 Channel 2 global Interrupt                      */
+    STM32F10X_HD_DMA1_Channel3_IRQn = 13, /*!< DMA1 Channel 3 global Interrupt                      */
+    STM32F10X_HD_DMA1_Channel4_IRQn = 14, /*!< DMA1 Channel 4 global Interrupt                      */
+    STM32F10X_HD_DMA1_Channel5_IRQn = 15, /*!< DMA1 Channel 5 global Interrupt                      */
+    STM32F10X_HD_DMA1_Channel6_IRQn = 16, /*!< DMA1 Channel 6 global Interrupt                      */
+    STM32F10X_HD_DMA1_Channel7_IRQn = 17, /*!< DMA1 Channel 7 global Interrupt                      */
+    STM32F10X_HD_ADC1_2_IRQn = 18, /*!< ADC1 and ADC2 global Interrupt                       */
+    STM32F10X_HD_USB_HP_CAN1_TX_IRQn = 19, /*!< USB Device High Priority or CAN1 TX Interrupts       */
+    STM32F10X_HD_USB_LP_CAN1_RX0_IRQn = 20, /*!< USB Device Low Priority or CAN1 RX0 Interrupts       */
+    STM32F10X_HD_CAN1_RX1_IRQn = 21, /*!< CAN1 RX1 Interrupt                                   */
+    STM32F10X_HD_CAN1_SCE_IRQn = 22, /*!< CAN1 SCE Interrupt                                   */
+    STM32F10X_HD_EXTI9_5_IRQn = 23, /*!< External Line[9:5] Interrupts                        */
+    STM32F10X_HD_TIM1_BRK_IRQn = 24, /*!< TIM1 Break Interrupt                                 */
+    STM32F10X_HD_TIM1_UP_IRQn = 25, /*!< TIM1 Update Interrupt                                */
+    STM32F10X_HD_TIM1_TRG_COM_IRQn = 26, /*!< TIM1 Trigger and Commutation Interrupt               */
+    STM32F10X_HD_TIM1_CC_IRQn = 27, /*!< TIM1 Capture Compare Interrupt                       */
+    STM32F10X_HD_TIM2_IRQn = 28, /*!< TIM2 global Interrupt                                */
+    STM32F10X_HD_TIM3_IRQn = 29, /*!< TIM3 global Interrupt                                */
+    STM32F10X_HD_TIM4_IRQn = 30, /*!< TIM4 global Interrupt                                */
+    STM32F10X_HD_I2C1_EV_IRQn = 31, /*!< I2C1 Event Interrupt                                 */
+    STM32F10X_HD_I2C1_ER_IRQn = 32, /*!< I2C1 Error Interrupt                                 */
+    STM32F10X_HD_I2C2_EV_IRQn = 33, /*!< I2C2 Event Interrupt                                 */
+    STM32F10X_HD_I2C2_ER_IRQn = 34, /*!< I2C2 Error Interrupt                                 */
+    STM32F10X_HD_SPI1_IRQn = 35, /*!< SPI1 global Interrupt                                */
+    STM32F10X_HD_SPI2_IRQn = 36, /*!< SPI2 global Interrupt                                */
+    STM32F10X_HD_USART1_IRQn = 37, /*!< USART1 global Interrupt                              */
+    STM32F10X_HD_USART2_IRQn = 38, /*!< USART2 global Interrupt                              */
+    STM32F10X_HD_USART3_IRQn = 39, /*!< USART3 global Interrupt                              */
+    STM32F10X_HD_EXTI15_10_IRQn = 40, /*!< External Line[15:10] Interrupts                      */
+    STM32F10X_HD_RTCAlarm_IRQn = 41, /*!< RTC Alarm through EXTI Line Interrupt                */
+    STM32F10X_HD_USBWakeUp_IRQn = 42, /*!< USB Device WakeUp from suspend through EXTI Line Interrupt */
+    STM32F10X_HD_TIM8_BRK_IRQn = 43, /*!< TIM8 Break Interrupt                                 */
+    STM32F10X_HD_TIM8_UP_IRQn = 44, /*!< TIM8 Update Interrupt                                */
+    STM32F10X_HD_TIM8_TRG_COM_IRQn = 45, /*!< TIM8 Trigger and Commutation Interrupt               */
+    STM32F10X_HD_TIM8_CC_IRQn = 46, /*!< TIM8 Capture Compare Interrupt                       */
+    STM32F10X_HD_ADC3_IRQn = 47, /*!< ADC3 global Interrupt                                */
+    STM32F10X_HD_FSMC_IRQn = 48, /*!< FSMC global Interrupt                                */
+    STM32F10X_HD_SDIO_IRQn = 49, /*!< SDIO global Interrupt                                */
+    STM32F10X_HD_TIM5_IRQn = 50, /*!< TIM5 global Interrupt                                */
+    STM32F10X_HD_SPI3_IRQn = 51, /*!< SPI3 global Interrupt                                */
+    STM32F10X_HD_UART4_IRQn = 52, /*!< UART4 global Interrupt                               */
+    STM32F10X_HD_UART5_IRQn = 53, /*!< UART5 global Interrupt                               */
+    STM32F10X_HD_TIM6_IRQn = 54, /*!< TIM6 global Interrupt                                */
+    STM32F10X_HD_TIM7_IRQn = 55, /*!< TIM7 global Interrupt                                */
+    STM32F10X_HD_DMA2_Channel1_IRQn = 56, /*!< DMA2 Channel 1 global Interrupt                      */
+    STM32F10X_HD_DMA2_Channel2_IRQn = 57, /*!< DMA2 Channel 2 global Interrupt                      */
+    STM32F10X_HD_DMA2_Channel3_IRQn = 58, /*!< DMA2 Channel 3 global Interrupt                      */
+    STM32F10X_HD_DMA2_Channel4_5_IRQn = 59 /*!< DMA2 Channel 4 and Channel 5 global Interrupt        */
+} STM32F10X_HD_IRQn_Type;
+
 typedef enum {
     STM32F10X_CL_WWDG_IRQn = 0, /*!< Window WatchDog Interrupt                            */
     STM32F10X_CL_PVD_IRQn = 1, /*!< PVD through EXTI Line detection Interrupt            */
@@ -673,6 +741,7 @@ typedef struct {
     unsigned int has_spi3 :1;
     unsigned int has_spi4 :1;
     unsigned int has_spi5 :1;
+    unsigned int has_spi6 :1;
 
     // I2S
     unsigned int has_i2s1 :1;
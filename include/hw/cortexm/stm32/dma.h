@@ -0,0 +1,181 @@
+/*
+ * STM32 MCU - DMA (direct memory access controller) emulation.
+ *
+ * Copyright (c) 2017 Liviu Ionescu.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STM32_DMA_H_
+#define STM32_DMA_H_
+
+#include "qemu/osdep.h"
+
+#include <hw/cortexm/peripheral.h>
+#include <hw/cortexm/stm32/capabilities.h>
+#include <hw/cortexm/nvic.h>
+
+#include "qemu/main-loop.h"
+
+// ----------------------------------------------------------------------------
+
+#define DEVICE_PATH_STM32_DMA DEVICE_PATH_STM32 "DMA"
+
+typedef enum {
+    STM32_DMA_1 = 0,
+    STM32_DMA_2,
+    STM32_DMA_UNDEFINED,
+} stm32_dma_index_t;
+
+// F0/F1 have up to 7 channels, F4 has 8 streams; both are called
+// channels here, numbered from 0.
+#define STM32_DMA_MAX_CHANNELS  (8)
+// The CHSEL values of the F4 streams.
+#define STM32_DMA_MAX_REQUESTS  (8)
+// The peripherals sharing a channel; on F0/F1 up to 5 peripherals
+// share the single request line of a channel.
+#define STM32_DMA_MAX_REQUESTERS (8)
+
+// The fixed DMA request mapping of a peripheral: controller, channel
+// (F0/F1, numbered from 0) or stream and CHSEL (F4); -1 if none.
+typedef struct {
+    int dma;
+    int channel;
+    int request;
+} STM32DMARoute;
+
+// Called when the request is active and the channel enabled, instead
+// of moving the items one by one via the peripheral registers.
+typedef void (*stm32_dma_bulk_handler_t)(void *opaque);
+
+// A peripheral connected to a channel, identified by its request line
+// and by its state.
+typedef struct {
+    void *opaque;
+    uint8_t request;
+    bool level;
+    // Null to move the items one by one.
+    stm32_dma_bulk_handler_t handler;
+} STM32DMARequester;
+
+// ----------------------------------------------------------------------------
+
+#define TYPE_STM32_DMA TYPE_STM32_PREFIX "dma" TYPE_PERIPHERAL_SUFFIX
+
+// ----------------------------------------------------------------------------
+
+// Parent definitions.
+#define TYPE_STM32_DMA_PARENT TYPE_PERIPHERAL
+typedef PeripheralClass STM32DMAParentClass;
+typedef PeripheralState STM32DMAParentState;
+
+// ----------------------------------------------------------------------------
+
+// Class definitions.
+#define STM32_DMA_GET_CLASS(obj) \
+    OBJECT_GET_CLASS(STM32DMAClass, (obj), TYPE_STM32_DMA)
+#define STM32_DMA_CLASS(klass) \
+    OBJECT_CLASS_CHECK(STM32DMAClass, (klass), TYPE_STM32_DMA)
+
+typedef struct {
+    // private:
+    STM32DMAParentClass parent_class;
+    // public:
+
+    // None, so far.
+} STM32DMAClass;
+
+// ----------------------------------------------------------------------------
+
+typedef struct {
+    // The channel registers; m1ar only for the F4 streams.
+    Object *cr;
+    Object *ndtr;
+    Object *par;
+    Object *mar;
+    Object *m1ar;
+
+    int irq;
+
+    // Peripheral requests, one bit per request line (CHSEL on F4,
+    // only bit 0 on F0/F1), set while any of its requesters is active.
+    uint8_t requests;
+
+    STM32DMARequester requester[STM32_DMA_MAX_REQUESTERS];
+    int num_requesters;
+
+    // The internal copies, loaded when the channel is enabled; the
+    // registers are not changed by the transfer, except NDTR.
+    uint32_t cur_par;
+    uint32_t cur_mar;
+    uint32_t total;
+    uint32_t remaining;
+} STM32DMAChannel;
+
+// Instance definitions.
+#define STM32_DMA_STATE(obj) \
+    OBJECT_CHECK(STM32DMAState, (obj), TYPE_STM32_DMA)
+
+typedef struct {
+    // private:
+    STM32DMAParentState parent_obj;
+    // public:
+
+    const STM32Capabilities *capabilities;
+
+    stm32_dma_index_t dma_index;
+
+    // Points to one RCC bitfield that enables the peripheral.
+    Object *enabling_bit;
+
+    CortexMNVICState *nvic;
+
+    // F4 streams, with LISR/HISR and LIFCR/HIFCR, or F0/F1 channels,
+    // with ISR/IFCR only in the first element.
+    bool is_stream;
+    Object *isr[2];
+    Object *ifcr[2];
+
+    int num_channels;
+    STM32DMAChannel ch[STM32_DMA_MAX_CHANNELS];
+
+    // Set while transferring, requests raised by the peripherals during
+    // the transfer are only recorded.
+    bool is_busy;
+
+    // Circular transfers with a permanent request are continued from
+    // the main loop, one buffer at a time.
+    QEMUBH *bh;
+
+} STM32DMAState;
+
+// ----- Public ---------------------------------------------------------------
+
+Object* stm32_dma_create(Object *parent, stm32_dma_index_t index);
+
+void stm32_dma_set_request(Object *obj, int channel, int request,
+        void *opaque, bool level);
+
+void stm32_dma_set_bulk_handler(Object *obj, int channel, int request,
+        stm32_dma_bulk_handler_t handler, void *opaque);
+
+uint32_t stm32_dma_get_pending(Object *obj, int channel, int request,
+        bool to_memory);
+
+uint32_t stm32_dma_transfer_block(Object *obj, int channel, void *data,
+        unsigned size, uint32_t count, bool to_memory);
+
+// ----------------------------------------------------------------------------
+
+#endif /* STM32_DMA_H_ */
@@ -623,6 +623,10 @@ typedef struct {
 
 } STM32EXTIState;
 
+// ----- Public ---------------------------------------------------------------
+
+void stm32_exti_compute_port_masks(Object *exticr[4], uint16_t *port_mask);
+
 // ----------------------------------------------------------------------------
 
 #endif /* STM32_EXTI_H_ */
@@ -24,6 +24,7 @@
 
 #include <hw/cortexm/peripheral.h>
 #include <hw/cortexm/stm32/capabilities.h>
+#include <hw/cortexm/nvic.h>
 
 // ----------------------------------------------------------------------------
 
@@ -69,6 +70,22 @@ typedef struct {
 
     const STM32Capabilities *capabilities;
 
+    CortexMNVICState *nvic;
+    int irq;
+
+    // The registers used by the program/erase logic and the access
+    // timing; the F0/F1 layouts are the same, F4 has no AR.
+    struct {
+        Object *acr;
+        Object *keyr;
+        Object *sr;
+        Object *cr;
+        Object *ar;
+    } reg;
+
+    // Position in the KEYR unlock sequence.
+    int key_index;
+
     union {
         // DO NOT EDIT! Automatically generated!
         struct {
@@ -0,0 +1,123 @@
+/*
+ * STM32 - GPIO link, a host side socket to drive and observe the pins.
+ *
+ * Copyright (c) 2017 Liviu Ionescu.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STM32_GPIO_LINK_H_
+#define STM32_GPIO_LINK_H_
+
+#include "qemu/osdep.h"
+
+#include "hw/sysbus.h"
+#include "sysemu/char.h"
+#include "qemu/main-loop.h"
+#include "qemu/notify.h"
+#include <hw/cortexm/helper.h>
+#include <hw/cortexm/stm32/capabilities.h>
+
+// ----------------------------------------------------------------------------
+
+#define DEVICE_PATH_STM32_GPIO_LINK DEVICE_PATH_STM32 "GPIO-LINK"
+
+// The protocol uses fixed size little endian messages.
+//
+// Host to emulator, 6 bytes:
+// [0] command, [1] port (0 = GPIOA), [2-3] pins mask, [4-5] value.
+#define STM32_GPIO_LINK_CMD_SIZE        (6)
+// Set the input pins in the mask to the value.
+#define STM32_GPIO_LINK_CMD_SET         (0x01)
+// Report ODR changes only for the pins in the mask (all by default).
+#define STM32_GPIO_LINK_CMD_WATCH       (0x02)
+// Report the current ODR of the port, as an event with no changes.
+#define STM32_GPIO_LINK_CMD_READ        (0x03)
+
+// Emulator to host, 16 bytes:
+// [0] event, [1] port, [2-3] ODR, [4-5] changed pins, [6-7] 0,
+// [8-15] virtual time, in ns.
+#define STM32_GPIO_LINK_EVENT_SIZE      (16)
+#define STM32_GPIO_LINK_EVENT_ODR       (0x81)
+
+#define STM32_GPIO_LINK_BUFFER_SIZE     (4096)
+
+// ----------------------------------------------------------------------------
+
+#define TYPE_STM32_GPIO_LINK TYPE_STM32_PREFIX "gpio-link"
+
+// ----------------------------------------------------------------------------
+
+// Parent definitions.
+#define TYPE_STM32_GPIO_LINK_PARENT TYPE_SYS_BUS_DEVICE
+typedef SysBusDeviceClass STM32GPIOLinkParentClass;
+typedef SysBusDevice STM32GPIOLinkParentState;
+
+// ----------------------------------------------------------------------------
+
+// Class definitions.
+#define STM32_GPIO_LINK_GET_CLASS(obj) \
+    OBJECT_GET_CLASS(STM32GPIOLinkClass, (obj), TYPE_STM32_GPIO_LINK)
+#define STM32_GPIO_LINK_CLASS(klass) \
+    OBJECT_CLASS_CHECK(STM32GPIOLinkClass, (klass), TYPE_STM32_GPIO_LINK)
+
+typedef struct {
+    // private:
+    STM32GPIOLinkParentClass parent_class;
+    // public:
+
+} STM32GPIOLinkClass;
+
+// ----------------------------------------------------------------------------
+
+// Instance definitions.
+#define STM32_GPIO_LINK_STATE(obj) \
+    OBJECT_CHECK(STM32GPIOLinkState, (obj), TYPE_STM32_GPIO_LINK)
+
+typedef struct {
+    // private:
+    STM32GPIOLinkParentState parent_obj;
+    // public:
+
+    // The host side; if not set, the link is not active.
+    CharBackend chr;
+
+    // The pins reported, per port.
+    uint16_t watch_mask[STM32_MAX_GPIO];
+
+    // Partial command, waiting for the rest of the bytes.
+    uint8_t in_buffer[STM32_GPIO_LINK_CMD_SIZE];
+    uint32_t in_count;
+
+    // Events, written once per main loop iteration.
+    uint8_t out_buffer[STM32_GPIO_LINK_BUFFER_SIZE];
+    uint32_t out_count;
+    QEMUBH *out_bh;
+
+    Notifier exit_notifier;
+
+} STM32GPIOLinkState;
+
+// ----- Public ---------------------------------------------------------------
+
+Object* stm32_gpio_link_create(Object *parent);
+
+void stm32_gpio_link_odr_changed(Object *obj, int port, uint16_t odr,
+        uint16_t changed);
+
+bool stm32_gpio_link_is_active(Object *obj);
+
+// ----------------------------------------------------------------------------
+
+#endif /* STM32_GPIO_LINK_H_ */
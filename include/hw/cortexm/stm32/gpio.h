@@ -132,6 +132,9 @@ typedef struct {
     // No more than 16 bits/port.
     uint16_t dir_mask;
 
+    // The host GPIO link, notified when output pins change, or null.
+    Object *link;
+
     // Common to F4 and F0.
     struct {
         Object *moder;
@@ -798,6 +801,10 @@ Object* stm32_gpio_create(Object *parent, stm32_gpio_index_t index);
 
 Object* stm32_gpio_get(int index);
 
+void stm32_gpio_set_inputs(Object *obj, uint16_t mask, uint16_t value);
+
+uint16_t stm32_gpio_get_odr(Object *obj);
+
 // ----------------------------------------------------------------------------
 
 #endif /* STM32_GPIO_H_ */
@@ -0,0 +1,147 @@
+/*
+ * STM32 MCU - I2C (inter-integrated circuit) emulation.
+ *
+ * Copyright (c) 2017 Liviu Ionescu.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STM32_I2C_H_
+#define STM32_I2C_H_
+
+#include "qemu/osdep.h"
+
+#include <hw/cortexm/peripheral.h>
+#include <hw/cortexm/stm32/capabilities.h>
+#include <hw/cortexm/nvic.h>
+
+#include "hw/i2c/i2c.h"
+
+// ----------------------------------------------------------------------------
+
+#define DEVICE_PATH_STM32_I2C DEVICE_PATH_STM32 "I2C"
+
+typedef enum {
+    STM32_I2C_1 = 0,
+    STM32_I2C_2,
+    STM32_I2C_3,
+    STM32_I2C_UNDEFINED,
+} stm32_i2c_index_t;
+
+// Bytes moved per bulk DMA iteration.
+#define STM32_I2C_BLOCK_SIZE    (256)
+
+// ----------------------------------------------------------------------------
+
+#define TYPE_STM32_I2C TYPE_STM32_PREFIX "i2c" TYPE_PERIPHERAL_SUFFIX
+
+// ----------------------------------------------------------------------------
+
+// Parent definitions.
+#define TYPE_STM32_I2C_PARENT TYPE_PERIPHERAL
+typedef PeripheralClass STM32I2CParentClass;
+typedef PeripheralState STM32I2CParentState;
+
+// ----------------------------------------------------------------------------
+
+// Class definitions.
+#define STM32_I2C_GET_CLASS(obj) \
+    OBJECT_GET_CLASS(STM32I2CClass, (obj), TYPE_STM32_I2C)
+#define STM32_I2C_CLASS(klass) \
+    OBJECT_CLASS_CHECK(STM32I2CClass, (klass), TYPE_STM32_I2C)
+
+typedef struct {
+    // private:
+    STM32I2CParentClass parent_class;
+    // public:
+
+    // None, so far.
+} STM32I2CClass;
+
+// ----------------------------------------------------------------------------
+
+// Instance definitions.
+#define STM32_I2C_STATE(obj) \
+    OBJECT_CHECK(STM32I2CState, (obj), TYPE_STM32_I2C)
+
+typedef struct {
+    // private:
+    STM32I2CParentState parent_obj;
+    // public:
+
+    const STM32Capabilities *capabilities;
+
+    stm32_i2c_index_t i2c_index;
+
+    // Points to one RCC bitfield that enables the peripheral.
+    Object *enabling_bit;
+
+    CortexMNVICState *nvic;
+    int irq_ev;
+    int irq_er;
+
+    struct {
+        Object *cr1;
+        Object *cr2;
+        Object *oar1;
+        Object *oar2;
+        Object *dr;
+        Object *sr1;
+        Object *sr2;
+        Object *ccr;
+        Object *trise;
+    } reg;
+
+    // The slaves, any QEMU I2C devices (like "tmp105" sensors).
+    I2CBus *bus;
+
+    // The slaves created at realize, as a list of
+    // "I2Cn=<type>@<address>" entries separated by ';', for example
+    // "I2C1=tmp105@0x48"; entries for other I2Cs are ignored.
+    char *devices;
+
+    // A slave acknowledged its address; until STOP.
+    bool is_active;
+    bool is_receiver;
+
+    // The last received byte was acknowledged, the slave sends more.
+    bool rx_ack;
+
+    // The byte received while DR is still full (BTF).
+    uint8_t rx_shift;
+    bool has_rx_shift;
+
+    // A bulk transfer is in progress.
+    bool is_busy;
+
+    // The DMA channels serving the requests, if any, and the current
+    // request levels.
+    struct {
+        Object *dma;
+        int channel;
+        int request;
+        bool level;
+    } dma_tx, dma_rx;
+
+} STM32I2CState;
+
+// ----- Public ---------------------------------------------------------------
+
+Object* stm32_i2c_create(Object *parent, stm32_i2c_index_t index);
+
+I2CBus *stm32_i2c_get_bus(Object *obj);
+
+// ----------------------------------------------------------------------------
+
+#endif /* STM32_I2C_H_ */
@@ -28,7 +28,13 @@
 #include <hw/cortexm/stm32/flash.h>
 #include <hw/cortexm/stm32/pwr.h>
 #include <hw/cortexm/stm32/gpio.h>
+#include <hw/cortexm/stm32/gpio-link.h>
 #include <hw/cortexm/stm32/usart.h>
+#include <hw/cortexm/stm32/tim.h>
+#include <hw/cortexm/stm32/dma.h>
+#include <hw/cortexm/stm32/adc.h>
+#include <hw/cortexm/stm32/spi.h>
+#include <hw/cortexm/stm32/i2c.h>
 #include <hw/cortexm/stm32/exti.h>
 #include <hw/cortexm/stm32/syscfg.h>
 #include <hw/cortexm/stm32/afio.h>
@@ -86,6 +92,10 @@ typedef struct STM32MCUState {
     uint32_t hse_freq_hz;
     uint32_t lse_freq_hz;
 
+    // Create the registers of peripherals not referred by other
+    // peripherals (GPIO, USART, FLASH, PWR) on first access.
+    bool lazy_peripherals;
+
     DeviceState *flash;
     DeviceState *pwr;
     DeviceState *exti;
@@ -95,7 +105,13 @@ typedef struct STM32MCUState {
 
     DeviceState *gpio[STM32_MAX_GPIO];
     int num_gpio;
+    DeviceState *gpio_link;
     DeviceState *usart[STM32_MAX_USART];
+    DeviceState *tim[STM32_MAX_TIM];
+    DeviceState *dma[STM32_MAX_DMA];
+    DeviceState *adc[STM32_MAX_ADC];
+    DeviceState *spi[STM32_MAX_SPI];
+    DeviceState *i2c[STM32_MAX_I2C];
 
 } STM32MCUState;
 
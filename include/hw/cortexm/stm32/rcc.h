@@ -25,6 +25,8 @@
 #include <hw/cortexm/peripheral.h>
 #include <hw/cortexm/stm32/capabilities.h>
 
+#include "qemu/notify.h"
+
 // ----------------------------------------------------------------------------
 
 #define DEVICE_PATH_STM32_RCC DEVICE_PATH_STM32 "RCC"
@@ -60,6 +62,16 @@ typedef struct {
 
 // ----------------------------------------------------------------------------
 
+// The clock tree, as seen by the peripherals; index 0 is APB1,
+// index 1 is APB2 (F0 devices have a single APB, seen as both).
+typedef struct {
+    uint32_t sysclk_hz;
+    uint32_t hclk_hz;
+    uint32_t pclk_hz[2];
+    uint32_t tim_hz[2];
+    uint32_t adc_hz;
+} STM32RCCClocks;
+
 // Instance definitions.
 #define STM32_RCC_STATE(obj) \
     OBJECT_CHECK(STM32RCCState, (obj), TYPE_STM32_RCC)
@@ -78,6 +90,10 @@ typedef struct {
     uint32_t hsi_freq_hz;
     uint32_t lsi_freq_hz;
 
+    // Recomputed only when the clock registers change.
+    STM32RCCClocks clocks;
+    NotifierList clock_notifiers;
+
     union {
         // DO NOT EDIT! Automatically generated!
         struct {
@@ -1091,6 +1107,14 @@ typedef struct {
 
 } STM32RCCState;
 
+// ----- Public ---------------------------------------------------------------
+
+uint32_t stm32_rcc_get_apb_freq_hz(STM32RCCState *state, int apb);
+uint32_t stm32_rcc_get_apb_tim_freq_hz(STM32RCCState *state, int apb);
+uint32_t stm32_rcc_get_adc_freq_hz(STM32RCCState *state);
+
+void stm32_rcc_add_clock_notifier(STM32RCCState *state, Notifier *notifier);
+
 // ----------------------------------------------------------------------------
 
 #endif /* STM32_RCC_H_ */
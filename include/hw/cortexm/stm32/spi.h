@@ -0,0 +1,136 @@
+/*
+ * STM32 MCU - SPI (serial peripheral interface) emulation.
+ *
+ * Copyright (c) 2017 Liviu Ionescu.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STM32_SPI_H_
+#define STM32_SPI_H_
+
+#include "qemu/osdep.h"
+
+#include <hw/cortexm/peripheral.h>
+#include <hw/cortexm/stm32/capabilities.h>
+#include <hw/cortexm/nvic.h>
+
+#include "hw/ssi/ssi.h"
+
+// ----------------------------------------------------------------------------
+
+#define DEVICE_PATH_STM32_SPI DEVICE_PATH_STM32 "SPI"
+
+typedef enum {
+    STM32_SPI_1 = 0,
+    STM32_SPI_2,
+    STM32_SPI_3,
+    STM32_SPI_4,
+    STM32_SPI_5,
+    STM32_SPI_6,
+    STM32_SPI_UNDEFINED,
+} stm32_spi_index_t;
+
+// Frames moved per bulk DMA iteration.
+#define STM32_SPI_BLOCK_FRAMES  (256)
+
+// ----------------------------------------------------------------------------
+
+#define TYPE_STM32_SPI TYPE_STM32_PREFIX "spi" TYPE_PERIPHERAL_SUFFIX
+
+// ----------------------------------------------------------------------------
+
+// Parent definitions.
+#define TYPE_STM32_SPI_PARENT TYPE_PERIPHERAL
+typedef PeripheralClass STM32SPIParentClass;
+typedef PeripheralState STM32SPIParentState;
+
+// ----------------------------------------------------------------------------
+
+// Class definitions.
+#define STM32_SPI_GET_CLASS(obj) \
+    OBJECT_GET_CLASS(STM32SPIClass, (obj), TYPE_STM32_SPI)
+#define STM32_SPI_CLASS(klass) \
+    OBJECT_CLASS_CHECK(STM32SPIClass, (klass), TYPE_STM32_SPI)
+
+typedef struct {
+    // private:
+    STM32SPIParentClass parent_class;
+    // public:
+
+    // None, so far.
+} STM32SPIClass;
+
+// ----------------------------------------------------------------------------
+
+// Instance definitions.
+#define STM32_SPI_STATE(obj) \
+    OBJECT_CHECK(STM32SPIState, (obj), TYPE_STM32_SPI)
+
+typedef struct {
+    // private:
+    STM32SPIParentState parent_obj;
+    // public:
+
+    const STM32Capabilities *capabilities;
+
+    stm32_spi_index_t spi_index;
+
+    // Points to one RCC bitfield that enables the peripheral.
+    Object *enabling_bit;
+
+    CortexMNVICState *nvic;
+    int irq;
+
+    struct {
+        Object *cr1;
+        Object *cr2;
+        Object *sr;
+        Object *dr;
+    } reg;
+
+    // The slaves, any QEMU SSI devices (like "m25p80" flash chips).
+    SSIBus *bus;
+
+    // The slaves created at realize, as a list of
+    // "SPIn=<type>[@<CS pin>]" entries separated by ';', for example
+    // "SPI1=n25q128@PA4"; entries for other SPIs are ignored.
+    char *devices;
+
+    // The last received frame, returned by DR reads.
+    uint32_t rx_data;
+
+    // A bulk transfer is in progress.
+    bool is_busy;
+
+    // The DMA channels serving the requests, if any, and the current
+    // request levels.
+    struct {
+        Object *dma;
+        int channel;
+        int request;
+        bool level;
+    } dma_tx, dma_rx;
+
+} STM32SPIState;
+
+// ----- Public ---------------------------------------------------------------
+
+Object* stm32_spi_create(Object *parent, stm32_spi_index_t index);
+
+SSIBus *stm32_spi_get_bus(Object *obj);
+
+// ----------------------------------------------------------------------------
+
+#endif /* STM32_SPI_H_ */
@@ -0,0 +1,162 @@
+/*
+ * STM32 MCU - TIM (timers) emulation.
+ *
+ * Copyright (c) 2017 Liviu Ionescu.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STM32_TIM_H_
+#define STM32_TIM_H_
+
+#include "qemu/osdep.h"
+
+#include <hw/cortexm/peripheral.h>
+#include <hw/cortexm/stm32/capabilities.h>
+#include <hw/cortexm/nvic.h>
+
+#include "qemu/timer.h"
+#include "qemu/notify.h"
+
+// ----------------------------------------------------------------------------
+
+#define DEVICE_PATH_STM32_TIM DEVICE_PATH_STM32 "TIM"
+
+typedef enum {
+    STM32_TIM_1 = 0,
+    STM32_TIM_2,
+    STM32_TIM_3,
+    STM32_TIM_4,
+    STM32_TIM_5,
+    STM32_TIM_6,
+    STM32_TIM_7,
+    STM32_TIM_8,
+    STM32_TIM_9,
+    STM32_TIM_10,
+    STM32_TIM_11,
+    STM32_TIM_12,
+    STM32_TIM_13,
+    STM32_TIM_14,
+    STM32_TIM_15,
+    STM32_TIM_16,
+    STM32_TIM_17,
+    STM32_TIM_UNDEFINED,
+} stm32_tim_index_t;
+
+#define STM32_TIM_MAX_CHANNELS  (4)
+
+// ----------------------------------------------------------------------------
+
+#define TYPE_STM32_TIM TYPE_STM32_PREFIX "tim" TYPE_PERIPHERAL_SUFFIX
+
+// ----------------------------------------------------------------------------
+
+// Parent definitions.
+#define TYPE_STM32_TIM_PARENT TYPE_PERIPHERAL
+typedef PeripheralClass STM32TIMParentClass;
+typedef PeripheralState STM32TIMParentState;
+
+// ----------------------------------------------------------------------------
+
+// Class definitions.
+#define STM32_TIM_GET_CLASS(obj) \
+    OBJECT_GET_CLASS(STM32TIMClass, (obj), TYPE_STM32_TIM)
+#define STM32_TIM_CLASS(klass) \
+    OBJECT_CLASS_CHECK(STM32TIMClass, (klass), TYPE_STM32_TIM)
+
+typedef struct {
+    // private:
+    STM32TIMParentClass parent_class;
+    // public:
+
+    // None, so far.
+} STM32TIMClass;
+
+// ----------------------------------------------------------------------------
+
+// Instance definitions.
+#define STM32_TIM_STATE(obj) \
+    OBJECT_CHECK(STM32TIMState, (obj), TYPE_STM32_TIM)
+
+typedef struct {
+    // private:
+    STM32TIMParentState parent_obj;
+    // public:
+
+    const STM32Capabilities *capabilities;
+
+    stm32_tim_index_t tim_index;
+
+    // Points to one RCC bitfield that enables the peripheral.
+    Object *enabling_bit;
+
+    CortexMNVICState *nvic;
+
+    // Interrupt numbers; the advanced timers have separate update
+    // and capture/compare interrupts, the others use the same.
+    int irq_update;
+    int irq_cc;
+
+    // 0xFFFF or, for the 32-bit timers, 0xFFFFFFFF.
+    uint32_t counter_mask;
+
+    // The registers common to all timers; those not present in the
+    // smaller timers are NULL.
+    struct {
+        Object *cr1;
+        Object *dier;
+        Object *sr;
+        Object *egr;
+        Object *ccmr1;
+        Object *ccmr2;
+        Object *cnt;
+        Object *psc;
+        Object *arr;
+        Object *ccr[STM32_TIM_MAX_CHANNELS];
+    } reg;
+
+    int num_channels;
+
+    // The counter is not stored, it is computed when needed from
+    // the virtual time elapsed since the base, when it had the
+    // base_count value; base_ns is moved only at update events and
+    // when the configuration changes.
+    bool is_running;
+    int64_t base_ns;
+    uint32_t base_count;
+    // Ticks since the base already accounted for in SR.
+    uint64_t done_ticks;
+
+    // The values in use; PSC (always) and ARR (with ARPE) are
+    // loaded from the registers at the update event.
+    uint32_t active_psc;
+    uint32_t active_arr;
+
+    // A single timer, armed for the next event with an enabled
+    // interrupt.
+    QEMUTimer *timer;
+
+    // The input clock, updated by the RCC clock notifier.
+    uint32_t clock_hz;
+    Notifier clock_notifier;
+
+} STM32TIMState;
+
+// ----- Public ---------------------------------------------------------------
+
+Object* stm32_tim_create(Object *parent, stm32_tim_index_t index);
+
+// ----------------------------------------------------------------------------
+
+#endif /* STM32_TIM_H_ */
@@ -37,6 +37,9 @@
 #include <hw/cortexm/peripheral.h>
 
 #include "sysemu/char.h"
+#include "qemu/timer.h"
+#include "qemu/main-loop.h"
+#include "qemu/notify.h"
 
 // ----------------------------------------------------------------------------
 
@@ -73,6 +76,13 @@ typedef enum {
 #define STM32_EXCP_UART_5    69
 #define STM32_EXCP_USART_6   87
 
+// Transmitted characters are collected and written to the chardev
+// in bursts, at most this many at once.
+#define STM32_USART_TX_BUFFER_SIZE  (256)
+
+// Received characters wait here until the application reads DR.
+#define STM32_USART_RX_FIFO_SIZE    (256)
+
 // ----------------------------------------------------------------------------
 
 #define TYPE_STM32_USART TYPE_STM32_PREFIX "usart" TYPE_PERIPHERAL_SUFFIX
@@ -120,7 +130,45 @@ typedef struct {
 
     CortexMNVICState *nvic;
 
-    CharDriverState *chr;
+    CharBackend chr;
+
+    // If true, TXE, TC and RXNE follow the character time computed
+    // from BRR and the bus clock, instead of being immediate.
+    bool baud_pacing;
+
+    // Characters written to DR, not yet passed to the chardev.
+    uint8_t tx_buffer[STM32_USART_TX_BUFFER_SIZE];
+    uint32_t tx_count;
+    QEMUBH *tx_bh;
+
+    // Virtual times (ns) when the shift register takes the last
+    // character (TXE) and when it becomes idle (TC).
+    int64_t tx_txe_ns;
+    int64_t tx_idle_ns;
+    bool txe_pending;
+    bool tc_pending;
+
+    // Characters received from the chardev, not yet in DR.
+    uint8_t rx_fifo[STM32_USART_RX_FIFO_SIZE];
+    uint32_t rx_head;
+    uint32_t rx_count;
+    // Virtual time (ns) when the next character can reach DR.
+    int64_t rx_next_ns;
+
+    // A single timer, armed for the next status change with an
+    // enabled interrupt.
+    QEMUTimer *timer;
+
+    Notifier exit_notifier;
+
+    // The DMA channels serving the TX/RX requests (DMAT/DMAR), NULL
+    // if none, and the last request levels passed to them.
+    struct {
+        Object *dma;
+        int channel;
+        int request;
+        bool level;
+    } dma_tx, dma_rx;
 
     // USART/UART peripherals seem to be very similar among all families,
     // so we have a common struct for all mcus.
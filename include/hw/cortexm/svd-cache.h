@@ -0,0 +1,174 @@
+/*
+ * Cortex-M SVD device binary cache.
+ *
+ * Copyright (c) 2017 Liviu Ionescu.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CORTEXM_SVD_CACHE_H_
+#define CORTEXM_SVD_CACHE_H_
+
+#include "qemu/osdep.h"
+
+// ----------------------------------------------------------------------------
+
+/*
+ * The processed content of the JSON SVD file, in a compact binary
+ * format that can be mapped directly from the cache file and used
+ * without any parsing.
+ *
+ * The cache is keyed by the SHA-256 of the JSON file; it is generated
+ * on first use and stored in the user cache folder.
+ *
+ * Strings are kept in a pool and referred by their offset in the pool;
+ * offset 0 is the empty string, and means 'missing'. Peripherals,
+ * registers and fields are kept in separate tables and referred by
+ * index; derived peripherals refer the registers of the original
+ * peripheral. Peripherals are sorted by name.
+ *
+ * Errors detected while processing the JSON are not fatal at this
+ * stage, since most peripherals are never used; the error messages
+ * are stored and reported only if the peripheral is used.
+ */
+
+#define SVD_CACHE_MAGIC                 "QEMU-SVD"
+#define SVD_CACHE_VERSION               (1)
+// Written in host order, to detect caches created on other hosts.
+#define SVD_CACHE_BYTE_ORDER            (0x01020304)
+
+// SHA-256 in hex, with terminator, rounded up.
+#define SVD_CACHE_SIZEOF_HASH           (72)
+
+// Offset in the strings pool; 0 means missing.
+typedef uint32_t svd_string_t;
+
+// Strings from the SVD register properties group.
+typedef struct {
+    svd_string_t size;
+    svd_string_t access;
+    svd_string_t protection;
+    svd_string_t reset_value;
+    svd_string_t reset_mask;
+} SVDGroup;
+
+typedef struct {
+    svd_string_t name;
+    svd_string_t revision;
+    svd_string_t mpu_present;
+    svd_string_t fpu_present;
+    svd_string_t itm_present;
+    svd_string_t etm_present;
+    svd_string_t num_interrupts;
+    svd_string_t nvic_prio_bits;
+} SVDCpu;
+
+#define SVD_DEVICE_HAS_DEVICE           (1 << 0)
+#define SVD_DEVICE_HAS_CPU              (1 << 1)
+
+typedef struct {
+    svd_string_t name;
+    uint32_t flags;
+    SVDGroup group;
+    SVDCpu cpu;
+} SVDDeviceInfo;
+
+#define SVD_FIELD_HAS_BIT_OFFSET        (1 << 0)
+#define SVD_FIELD_HAS_BIT_WIDTH         (1 << 1)
+
+typedef struct {
+    svd_string_t name;
+    svd_string_t access;
+    uint32_t flags;
+    uint32_t bit_offset;
+    uint32_t bit_width;
+} SVDField;
+
+#define SVD_REGISTER_HAS_OFFSET         (1 << 0)
+#define SVD_REGISTER_HAS_FIELDS         (1 << 1)
+
+typedef struct {
+    svd_string_t name;
+    SVDGroup group;
+    uint32_t flags;
+    uint32_t offset_bytes;
+    uint32_t first_field;
+    uint32_t num_fields;
+} SVDRegister;
+
+typedef struct {
+    svd_string_t name;
+    SVDGroup group;
+
+    // If the registers cannot be identified, the error message.
+    svd_string_t registers_error;
+    uint32_t first_register;
+    uint32_t num_registers;
+
+    // If the address block cannot be identified, the error message.
+    svd_string_t block_error;
+    uint32_t mmio_size_bytes;
+    uint32_t reserved;
+    uint64_t mmio_address;
+} SVDPeripheral;
+
+// All offsets are relative to the beginning of the cache and
+// are multiples of 8.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    char hash[SVD_CACHE_SIZEOF_HASH];
+
+    uint32_t total_size_bytes;
+
+    uint32_t num_peripherals;
+    uint32_t peripherals_offset;
+    uint32_t num_registers;
+    uint32_t registers_offset;
+    uint32_t num_fields;
+    uint32_t fields_offset;
+    uint32_t strings_size_bytes;
+    uint32_t strings_offset;
+
+    SVDDeviceInfo device;
+} SVDCacheHeader;
+
+// The run time device, either mapped from the cache file or
+// built in memory from the JSON file.
+typedef struct SVDDevice {
+    GMappedFile *mapped_file;
+    void *buffer;
+
+    const SVDCacheHeader *header;
+    const SVDPeripheral *peripherals;
+    const SVDRegister *registers;
+    const SVDField *fields;
+    const char *strings;
+} SVDDevice;
+
+// ----- Public ---------------------------------------------------------------
+
+SVDDevice *svd_cache_load(const char *json_file_name);
+
+// Return the string, or NULL if missing.
+static inline const char *svd_cache_string(const SVDDevice *svd,
+        svd_string_t str)
+{
+    return (str != 0) ? (svd->strings + str) : NULL;
+}
+
+// ----------------------------------------------------------------------------
+
+#endif /* CORTEXM_SVD_CACHE_H_ */
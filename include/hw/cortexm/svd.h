@@ -22,33 +22,36 @@
 
 #include "qemu/osdep.h"
 
-#include <hw/cortexm/parson.h>
+#include <hw/cortexm/svd-cache.h>
 #include <hw/cortexm/mcu.h>
 
 #include "qom/object.h"
 
 // ----------------------------------------------------------------------------
 
-void svd_validate_device_name(JSON_Object *svd, const char *name);
-bool svd_has_named_peripheral(JSON_Object *svd, const char *name);
-JSON_Object *svd_get_peripheral_by_name(JSON_Object *svd, const char *name);
+void svd_validate_device_name(SVDDevice *svd, const char *name);
+bool svd_has_named_peripheral(SVDDevice *svd, const char *name);
+const SVDPeripheral *svd_get_peripheral_by_name(SVDDevice *svd,
+        const char *name);
 void svd_set_rw_mode(Object *obj, const char *str);
-void svd_set_register_properties_group(JSON_Object *svd, Object *obj);
+void svd_set_register_properties_group(SVDDevice *svd, const SVDGroup *group,
+        Object *obj);
+void svd_set_device_properties_group(SVDDevice *svd, Object *obj);
 
 Object *svd_add_peripheral_properties_and_children(Object *obj,
-        JSON_Object *svd, JSON_Object *root);
+        const SVDPeripheral *periph, SVDDevice *svd);
 Object *svd_add_peripheral_register_properties_and_children(Object *obj,
-        JSON_Object *svd);
+        const SVDRegister *regi, SVDDevice *svd);
 Object *svd_add_register_bitfield_properties_and_children(Object *obj,
-        JSON_Object *svd);
+        const SVDField *bitfield, SVDDevice *svd);
 
-void svd_set_peripheral_address_block(JSON_Object *svd, const char* name,
+void svd_set_peripheral_address_block(SVDDevice *svd, const char* name,
         Object *obj);
 
 uint64_t svd_parse_uint(const char *str);
 bool svd_parse_bool(const char *str);
 
-void svd_process_cpu(JSON_Object *svd, CortexMCoreCapabilities *core);
+void svd_process_cpu(SVDDevice *svd, CortexMCoreCapabilities *core);
 
 // ----------------------------------------------------------------------------
 
@@ -845,6 +845,7 @@ int64_t cpu_get_icount_raw(void);
 int64_t cpu_get_icount(void);
 int64_t cpu_get_clock(void);
 int64_t cpu_icount_to_ns(int64_t icount);
+void cpu_icount_set_cycle_hz(uint32_t hz);
 
 /*******************************************/
 /* host CPU ticks (if available) */
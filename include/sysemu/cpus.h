@@ -13,6 +13,16 @@ void configure_icount(QemuOpts *opts, Error **errp);
 extern int use_icount;
 extern int icount_align_option;
 
+void configure_idle_fast_forward(bool enabled);
+
+void configure_icount_cycles(bool sleep);
+extern bool use_icount_cycles;
+
+extern bool use_lazy_flags;
+
+/* tb-cache.c */
+void tb_cache_init(const char *file_name);
+
 /* drift information for info jit command */
 extern int64_t max_delay;
 extern int64_t max_advance;
@@ -87,6 +87,11 @@
 #include "verbosity.h"
 #endif
 
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+#include "hw/cortexm/peripheral.h"
+#include "hw/cortexm/graphic.h"
+#endif
+
 /*
  * Supported types:
  *
@@ -1536,6 +1541,18 @@ static void hmp_info_mtree(Monitor *mon, const QDict *qdict)
     mtree_info((fprintf_function)monitor_printf, mon);
 }
 
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+static void hmp_info_peripherals(Monitor *mon, const QDict *qdict)
+{
+    peripheral_info((fprintf_function)monitor_printf, mon);
+}
+
+static void hmp_info_graphic(Monitor *mon, const QDict *qdict)
+{
+    cortexm_graphic_info((fprintf_function)monitor_printf, mon);
+}
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
+
 static void hmp_info_numa(Monitor *mon, const QDict *qdict)
 {
     int i;
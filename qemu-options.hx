@@ -2966,6 +2966,118 @@ The names follow the CMSIS device definitions and case is significant.
 If not specified, the board default is used.
 ETEXI
 
+DEF("idle-fast-forward", 0, QEMU_OPTION_idle_fast_forward,
+    "-idle-fast-forward\n"
+    "                when the core sleeps (WFI/WFE), advance the virtual\n"
+    "                clock directly to the next timer (SysTick, etc)\n",
+    QEMU_ARCH_ALL)
+STEXI
+@item -idle-fast-forward
+@findex -idle-fast-forward
+When the core is halted, waiting for an interrupt (WFI/WFE), and the next
+event is a virtual clock timer (like the SysTick), do not wait for it in
+real time, but advance the virtual clock directly to its deadline.
+
+Useful for long duration tests, where an application that spends most
+of the time sleeping runs much faster than real time. The skipped time
+is reported by the @code{query-idle-fast-forward} QMP command.
+
+Not compatible with @code{-icount}, which has a similar @code{sleep=off}
+option.
+ETEXI
+
+DEF("cycle-model", 0, QEMU_OPTION_cycle_model,
+    "-cycle-model    drive the virtual clock with the estimated number of\n"
+    "                core clock cycles (Cortex-M0/M3/M4 only)\n",
+    QEMU_ARCH_ALL)
+STEXI
+@item -cycle-model
+@findex -cycle-model
+Instead of following the host time, advance the virtual clock with an
+estimate of the number of core clock cycles, computed for each translated
+block from the instruction classes (single cycle ALU, multi cycle loads,
+multiplies and divides, taken branches, etc) and the flash wait states
+configured in @code{FLASH_ACR}. The cycles are converted to time with the
+core clock frequency, as configured in RCC.
+
+The result is deterministic, but it is an approximation that has not been
+calibrated against real devices: branches are estimated statically
+(backward conditional branches are assumed taken), and bus contention
+and pipeline effects are not modelled.
+
+Not compatible with @code{-icount}, which counts instructions. With
+@code{-idle-fast-forward}, the idle periods are skipped.
+ETEXI
+
+DEF("tb-cache", HAS_ARG, QEMU_OPTION_tb_cache,
+    "-tb-cache file  keep the translated code in file, and reuse it in\n"
+    "                the next runs (x86_64 Linux hosts only)\n",
+    QEMU_ARCH_ALL)
+STEXI
+@item -tb-cache @var{file}
+@findex -tb-cache
+Save the host code generated for the guest code at exit in @var{file},
+and reuse it in the next runs, instead of translating the same code again.
+Useful for repeated short runs of the same application, like unit tests,
+where the translation is a large part of the run time.
+
+The blocks are identified by the content of the guest memory pages with
+the code, so changed functions are translated again; only the blocks
+used in a run are written back. The file is ignored if created by another
+QEMU executable or on a host with different CPU features.
+
+Since the file holds executable code, it is created readable and writable
+by its owner only, and it is ignored if it belongs to another user or
+can be written by others. Damaged blocks are translated again.
+
+The cache is not used with @code{-cycle-model}, with breakpoints,
+single stepping or with the @code{-d in_asm,op,out_asm} logs.
+ETEXI
+
+DEF("no-lazy-flags", 0, QEMU_OPTION_no_lazy_flags,
+    "-no-lazy-flags  compute the C and V flags after each Thumb addition or\n"
+    "                subtraction (Cortex-M only)\n",
+    QEMU_ARCH_ALL)
+STEXI
+@item -no-lazy-flags
+@findex -no-lazy-flags
+On Cortex-M, the C and V flags set by Thumb additions, subtractions and
+compares are normally computed only when a later instruction may use them.
+With this option they are computed after each instruction, as for the
+other cores; useful to compare the translation statistics of
+@code{info jit} in a build configured with @code{--enable-profiler}.
+ETEXI
+
+DEF("profile", HAS_ARG, QEMU_OPTION_profile,
+    "-profile [file=]file[,rate=hz][,depth=n]\n"
+    "                sample the guest call stack rate times per second\n"
+    "                (default 1000) and write the folded stacks to file\n",
+    QEMU_ARCH_ALL)
+STEXI
+@item -profile [file=]@var{file}[,rate=@var{hz}][,depth=@var{n}]
+@findex -profile
+Sample the call stack of the core @var{hz} times per second of virtual
+time (default 1000), and write the stacks at exit in @var{file}, one
+line per distinct stack followed by its number of samples, in the
+folded format read by @code{flamegraph.pl}:
+
+@example
+flamegraph.pl app.folded > app.svg
+@end example
+
+The functions are named with the symbols of the ELF file passed with
+@code{-kernel} or @code{-image}. Each stack starts with the mode of the
+core, @code{[thread]}, the exception being handled (like @code{[SysTick]}
+or @code{[IRQ 37]}) or @code{[idle]}, while waiting in WFI/WFE.
+
+The callers are the return addresses found in the first 1 KB of the stack
+that follow a @code{BL} or @code{BLX} instruction; at most @var{n}
+(default 16) are kept. Since the frames are not walked, return addresses
+left in the stack by calls that already returned may show as extra
+callers. The profile can also be written while running, with the
+@code{profile-dump} QMP command.
+ETEXI
+
 STEXI
 @end table
 ETEXI
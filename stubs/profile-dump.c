@@ -0,0 +1,9 @@
+#include "qemu/osdep.h"
+#include "qemu-common.h"
+#include "qmp-commands.h"
+#include "qapi/qmp/qerror.h"
+
+void qmp_profile_dump(bool has_filename, const char *filename, Error **errp)
+{
+    error_setg(errp, QERR_UNSUPPORTED);
+}
@@ -34,6 +34,9 @@
 #include "hw/arm/arm.h"
 #include "sysemu/sysemu.h"
 #include "sysemu/kvm.h"
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+#include "sysemu/cpus.h"
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
 #include "kvm_arm.h"
 
 static void arm_cpu_set_pc(CPUState *cs, vaddr value)
@@ -999,6 +1002,32 @@ static void arm_v6m_class_init(ObjectClass *oc, void *data)
     cc->cpu_exec_interrupt = arm_v6m_cpu_exec_interrupt;
 }
 
+/* Called by the MCU flash controller when the access timing changes. */
+void arm_cpu_set_flash_timing(ARMCPU *cpu, uint32_t base, uint32_t size,
+                              int wait_states, int line_size, bool prefetch,
+                              bool cache)
+{
+    if (cpu->flash_timing.base == base && cpu->flash_timing.size == size
+            && cpu->flash_timing.wait_states == wait_states
+            && cpu->flash_timing.line_size == line_size
+            && cpu->flash_timing.prefetch == prefetch
+            && cpu->flash_timing.cache == cache) {
+        return;
+    }
+
+    cpu->flash_timing.base = base;
+    cpu->flash_timing.size = size;
+    cpu->flash_timing.wait_states = wait_states;
+    cpu->flash_timing.line_size = line_size;
+    cpu->flash_timing.prefetch = prefetch;
+    cpu->flash_timing.cache = cache;
+
+    /* The cycle costs are computed at translation time. */
+    if (use_icount_cycles) {
+        tb_flush(CPU(cpu));
+    }
+}
+
 /* cortex-m profiles */
 static void cortex_m0_initfn(Object *obj)
 {
@@ -659,6 +659,21 @@ struct ARMCPU {
 
     ARMELChangeHook *el_change_hook;
     void *el_change_hook_opaque;
+
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+    /* The flash memory access timing, used by the cycle model. */
+    struct {
+        uint32_t base;
+        uint32_t size;
+        /* Extra cycles for each access to a new flash line. */
+        int wait_states;
+        int line_size;
+        /* The sequential lines are fetched ahead, hiding the wait states. */
+        bool prefetch;
+        /* Loops are served by the instruction cache, without wait states. */
+        bool cache;
+    } flash_timing;
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
 };
 
 static inline ARMCPU *arm_env_get_cpu(CPUARMState *env)
@@ -678,6 +693,9 @@ void arm_cpu_do_interrupt(CPUState *cpu);
 void arm_v7m_cpu_do_interrupt(CPUState *cpu);
 #if defined(CONFIG_GNU_MCU_ECLIPSE)
 void arm_v6m_cpu_do_interrupt(CPUState *cpu);
+void arm_cpu_set_flash_timing(ARMCPU *cpu, uint32_t base, uint32_t size,
+                              int wait_states, int line_size, bool prefetch,
+                              bool cache);
 #endif
 bool arm_cpu_exec_interrupt(CPUState *cpu, int int_req);
 
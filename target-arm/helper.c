@@ -19,7 +19,6 @@
 #include "sysemu/kvm.h"
 
 #if defined(CONFIG_GNU_MCU_ECLIPSE)
-#include "hw/intc/gic_internal.h"
 #include <hw/cortexm/nvic.h>
 #endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
 
@@ -5925,6 +5924,7 @@ uint32_t arm_phys_excp_target_el(CPUState *cs, uint32_t excp_idx,
     return target_el;
 }
 
+#if !defined(CONFIG_GNU_MCU_ECLIPSE)
 static void v7m_push(CPUARMState *env, uint32_t val)
 {
     CPUState *cs = CPU(arm_env_get_cpu(env));
@@ -5942,6 +5942,92 @@ static uint32_t v7m_pop(CPUARMState *env)
     env->regs[13] += 4;
     return val;
 }
+#endif /* !defined(CONFIG_GNU_MCU_ECLIPSE) */
+
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+/* The basic exception frame: r0-r3, r12, lr, pc, xPSR, from the lowest
+   address up.  */
+#define V7M_FRAME_WORDS 8
+#define V7M_FRAME_SIZE  (V7M_FRAME_WORDS * 4)
+
+/* Map the exception frame at 'addr' to host memory, if it is entirely
+   in RAM; otherwise return NULL, and the frame must be accessed one word
+   at a time, through the device.  */
+static uint8_t *v7m_map_frame(CPUState *cs, uint32_t addr, bool is_write)
+{
+    MemoryRegion *mr;
+    hwaddr xlat;
+    hwaddr len = V7M_FRAME_SIZE;
+    bool is_direct;
+    uint8_t *p;
+
+    rcu_read_lock();
+    mr = address_space_translate(cs->as, addr, &xlat, &len, is_write);
+    is_direct = memory_access_is_direct(mr, is_write)
+            && len == V7M_FRAME_SIZE;
+    rcu_read_unlock();
+    if (!is_direct) {
+        return NULL;
+    }
+
+    p = address_space_map(cs->as, addr, &len, is_write);
+    if (p != NULL && len != V7M_FRAME_SIZE) {
+        address_space_unmap(cs->as, p, len, is_write, 0);
+        return NULL;
+    }
+    return p;
+}
+
+/* Push the exception frame, with a single copy if the stack is in RAM.  */
+static void v7m_push_frame(CPUARMState *env, uint32_t xpsr)
+{
+    CPUState *cs = CPU(arm_env_get_cpu(env));
+    uint32_t frame[V7M_FRAME_WORDS] = {
+        env->regs[0], env->regs[1], env->regs[2], env->regs[3],
+        env->regs[12], env->regs[14], env->regs[15], xpsr
+    };
+    uint8_t *p;
+    int i;
+
+    env->regs[13] -= V7M_FRAME_SIZE;
+
+    p = v7m_map_frame(cs, env->regs[13], true);
+    if (p != NULL) {
+        for (i = 0; i < V7M_FRAME_WORDS; i++) {
+            stl_le_p(p + i * 4, frame[i]);
+        }
+        address_space_unmap(cs->as, p, V7M_FRAME_SIZE, true, V7M_FRAME_SIZE);
+        return;
+    }
+
+    /* From the highest address down, like the individual pushes.  */
+    for (i = V7M_FRAME_WORDS - 1; i >= 0; i--) {
+        stl_phys(cs->as, env->regs[13] + i * 4, frame[i]);
+    }
+}
+
+/* Pop the exception frame, with a single copy if the stack is in RAM.  */
+static void v7m_pop_frame(CPUARMState *env, uint32_t *frame)
+{
+    CPUState *cs = CPU(arm_env_get_cpu(env));
+    uint8_t *p;
+    int i;
+
+    p = v7m_map_frame(cs, env->regs[13], false);
+    if (p != NULL) {
+        for (i = 0; i < V7M_FRAME_WORDS; i++) {
+            frame[i] = ldl_le_p(p + i * 4);
+        }
+        address_space_unmap(cs->as, p, V7M_FRAME_SIZE, false, V7M_FRAME_SIZE);
+    } else {
+        for (i = 0; i < V7M_FRAME_WORDS; i++) {
+            frame[i] = ldl_phys(cs->as, env->regs[13] + i * 4);
+        }
+    }
+
+    env->regs[13] += V7M_FRAME_SIZE;
+}
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
 
 /* Switch to V7M main or process stack pointer.  */
 static void switch_v7m_sp(CPUARMState *env, int process)
@@ -5959,6 +6045,9 @@ static void do_v7m_exception_exit(CPUARMState *env)
 {
     uint32_t type;
     uint32_t xpsr;
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+    uint32_t frame[V7M_FRAME_WORDS];
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
 
     type = env->regs[15];
     if (env->v7m.exception != 0)
@@ -5968,9 +6057,42 @@ static void do_v7m_exception_exit(CPUARMState *env)
         armv7m_nvic_complete_irq(env->nvic, env->v7m.exception);
 #endif
 
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+    /*
+     * Tail-chaining: if a pending exception can preempt the context
+     * about to be restored, take it directly; the stack frame is
+     * already there, so there is no need to pop it and push it again.
+     */
+    if (!(env->daif & PSTATE_I) && cortexm_nvic_can_tail_chain(env->nvic)) {
+        uint32_t addr;
+
+        env->v7m.exception = cortexm_nvic_acknowledge_irq(env->nvic);
+        qemu_log_mask(CPU_LOG_INT, "...tail-chaining to exception %d\n",
+                      env->v7m.exception);
+        /* Keep the same return type (stack and mode). */
+        env->regs[14] = type;
+        env->condexec_bits = 0;
+        addr = ldl_phys(CPU(arm_env_get_cpu(env))->as,
+                        env->v7m.vecbase + env->v7m.exception * 4);
+        env->regs[15] = addr & 0xfffffffe;
+        env->thumb = addr & 1;
+        return;
+    }
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
+
     /* Switch to the target stack.  */
     switch_v7m_sp(env, (type & 4) != 0);
     /* Pop registers.  */
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+    v7m_pop_frame(env, frame);
+    env->regs[0] = frame[0];
+    env->regs[1] = frame[1];
+    env->regs[2] = frame[2];
+    env->regs[3] = frame[3];
+    env->regs[12] = frame[4];
+    env->regs[14] = frame[5];
+    env->regs[15] = frame[6];
+#else
     env->regs[0] = v7m_pop(env);
     env->regs[1] = v7m_pop(env);
     env->regs[2] = v7m_pop(env);
@@ -5978,6 +6100,7 @@ static void do_v7m_exception_exit(CPUARMState *env)
     env->regs[12] = v7m_pop(env);
     env->regs[14] = v7m_pop(env);
     env->regs[15] = v7m_pop(env);
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
     if (env->regs[15] & 1) {
         qemu_log_mask(LOG_GUEST_ERROR,
                       "M profile return from interrupt with misaligned "
@@ -5988,7 +6111,11 @@ static void do_v7m_exception_exit(CPUARMState *env)
          */
         env->regs[15] &= ~1U;
     }
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+    xpsr = frame[7];
+#else
     xpsr = v7m_pop(env);
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
     xpsr_write(env, xpsr, 0xfffffdff);
     /* Undo stack alignment.  */
     if (xpsr & 0x200)
@@ -6159,6 +6286,9 @@ void arm_v7m_cpu_do_interrupt(CPUState *cs)
         xpsr |= 0x200;
     }
     /* Switch to the handler mode.  */
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+    v7m_push_frame(env, xpsr);
+#else
     v7m_push(env, xpsr);
     v7m_push(env, env->regs[15]);
     v7m_push(env, env->regs[14]);
@@ -6167,6 +6297,7 @@ void arm_v7m_cpu_do_interrupt(CPUState *cs)
     v7m_push(env, env->regs[2]);
     v7m_push(env, env->regs[1]);
     v7m_push(env, env->regs[0]);
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
     switch_v7m_sp(env, 0);
     /* Clear IT bits */
     env->condexec_bits = 0;
@@ -8393,9 +8524,7 @@ void HELPER(v7m_msr)(CPUARMState *env, uint32_t reg, uint32_t val)
 
  #if defined(CONFIG_GNU_MCU_ECLIPSE)
 
-        void* nvic = env->nvic;
-        GICState* gic = ARM_GIC_COMMON(nvic);
-        gic_update(gic);
+        cortexm_nvic_update(env->nvic);
 
 #endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
 
@@ -8409,9 +8538,7 @@ void HELPER(v7m_msr)(CPUARMState *env, uint32_t reg, uint32_t val)
         if (val != 0 && (val < env->v7m.basepri || env->v7m.basepri == 0)) {
             env->v7m.basepri = val;
 
-            void* nvic = env->nvic;
-            GICState* gic = ARM_GIC_COMMON(nvic);
-            gic_update(gic);
+            cortexm_nvic_update(env->nvic);
         }
 
 #else
@@ -0,0 +1,218 @@
+/*
+ * Thumb instruction classes for the lazy evaluation of the C and V flags.
+ *
+ * Copyright (c) 2017 Liviu Ionescu.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARM_THUMB_CC_H
+#define ARM_THUMB_CC_H
+
+/*
+ * The C and V flags set by ADDS/SUBS/CMP/CMN are computed only when
+ * needed: the translator keeps the operands of the last such instruction
+ * and emits the flag computation before the first instruction that is not
+ * known to leave C and V alone, or at the end of the block. Most of the
+ * flags written in compiled code are overwritten by the next compare
+ * without being read, and are never computed.
+ *
+ * The instructions below are classified for use outside IT blocks only.
+ * An instruction in the NONE or ARITH class must not read C or V, end the
+ * block, or leave it mid-way, since the CPU state would then be restored
+ * with stale flags.
+ */
+
+typedef enum {
+    THUMB_CC_BARRIER,   /* may read C or V, or leave the block */
+    THUMB_CC_NONE,      /* leaves C and V unchanged */
+    THUMB_CC_ARITH,     /* sets C and V as an addition or subtraction */
+} ThumbCCClass;
+
+/* Loads and stores do not leave the block (no MPU, no icount).  */
+#define THUMB_CC_MEM_OK (1 << 0)
+
+/* True if the halfword is the first half of a 32-bit instruction.  */
+static inline bool thumb_cc_insn_is_32bit(uint32_t hw1)
+{
+    return (hw1 >> 11) > 0x1c;
+}
+
+static inline ThumbCCClass thumb_cc_mem(int flags)
+{
+    return (flags & THUMB_CC_MEM_OK) ? THUMB_CC_NONE : THUMB_CC_BARRIER;
+}
+
+static inline ThumbCCClass thumb_cc_classify16(uint32_t insn, int flags)
+{
+    uint32_t op;
+
+    switch (insn >> 12) {
+    case 0: case 1:
+        if (((insn >> 11) & 3) == 3) {
+            return THUMB_CC_ARITH; /* ADDS/SUBS register or imm3 */
+        }
+        /* Shifts by immediate set C, except LSLS #0 (MOVS).  */
+        return (insn & 0xffc0) == 0 ? THUMB_CC_NONE : THUMB_CC_BARRIER;
+    case 2: case 3:
+        /* MOVS, or CMP/ADDS/SUBS imm8 */
+        return ((insn >> 11) & 3) == 0 ? THUMB_CC_NONE : THUMB_CC_ARITH;
+    case 4:
+        if (insn & (1 << 11)) {
+            return thumb_cc_mem(flags); /* LDR literal */
+        }
+        if (insn & (1 << 10)) {
+            /* High register operations */
+            op = (insn >> 8) & 3;
+            if (op == 1) {
+                return THUMB_CC_ARITH; /* CMP */
+            }
+            if (op == 3 || ((insn & 7) | ((insn >> 4) & 8)) == 15) {
+                return THUMB_CC_BARRIER; /* BX/BLX, or writes the PC */
+            }
+            return THUMB_CC_NONE; /* ADD/MOV */
+        }
+        /* Data processing register */
+        op = (insn >> 6) & 0xf;
+        if ((1 << op) & 0xf103) {
+            return THUMB_CC_NONE; /* AND/EOR/TST/ORR/MUL/BIC/MVN */
+        }
+        if ((1 << op) & 0x0e00) {
+            return THUMB_CC_ARITH; /* NEG/CMP/CMN */
+        }
+        return THUMB_CC_BARRIER; /* shifts by register, ADC, SBC */
+    case 5: case 6: case 7: case 8: case 9:
+        return thumb_cc_mem(flags); /* LDR/STR */
+    case 10:
+        return THUMB_CC_NONE; /* ADR, ADD SP */
+    case 11:
+        switch ((insn >> 8) & 0xf) {
+        case 0x0: /* ADD/SUB SP */
+        case 0x2: /* SXTH/SXTB/UXTH/UXTB */
+            return THUMB_CC_NONE;
+        case 0x4: case 0x5: case 0xc:
+            return thumb_cc_mem(flags); /* PUSH, POP without PC */
+        case 0xa:
+            /* REV/REV16/REVSH */
+            return ((insn >> 6) & 3) == 2 ? THUMB_CC_BARRIER : THUMB_CC_NONE;
+        default:
+            return THUMB_CC_BARRIER; /* CBZ, POP {pc}, IT, hints, ... */
+        }
+    case 12:
+        return thumb_cc_mem(flags); /* LDM/STM */
+    default:
+        return THUMB_CC_BARRIER; /* branches, SVC, UDF */
+    }
+}
+
+/* Data processing operations (AND, BIC, ORR, ORN, EOR, ADD, SUB, RSB)
+   that do not read C.  */
+static inline bool thumb_cc_dp_op(uint32_t op)
+{
+    return op <= 4 || op == 8 || op == 13 || op == 14;
+}
+
+/* insn is the first halfword in the high half, as in disas_thumb2_insn().  */
+static inline ThumbCCClass thumb_cc_classify32(uint32_t insn, int flags)
+{
+    uint32_t op = (insn >> 21) & 0xf;
+    uint32_t rd = (insn >> 8) & 0xf;
+    uint32_t rn = (insn >> 16) & 0xf;
+    uint32_t rt = (insn >> 12) & 0xf;
+    uint32_t shift;
+
+    if ((insn & 0xfa008000) == 0xf0000000) {
+        /* Data processing, modified immediate */
+        if (!(insn & (1 << 20))) {
+            return (rd != 15 && thumb_cc_dp_op(op))
+                    ? THUMB_CC_NONE : THUMB_CC_BARRIER;
+        }
+        if (op == 8 || op == 13 || op == 14) {
+            return THUMB_CC_ARITH; /* ADDS/SUBS/RSBS/CMN/CMP */
+        }
+        /* Logical operations set C only for rotated constants.  */
+        if (op <= 4 && (insn & 0x04004000) == 0) {
+            return THUMB_CC_NONE;
+        }
+        return THUMB_CC_BARRIER;
+    }
+    if ((insn & 0xfa008000) == 0xf2000000) {
+        /* Data processing, plain binary immediate */
+        op = (insn >> 20) & 0x1f;
+        if (rd != 15 && (op == 0x00 || op == 0x04 || op == 0x0a
+                         || op == 0x0c)) {
+            return THUMB_CC_NONE; /* ADDW/MOVW/SUBW/MOVT */
+        }
+        return THUMB_CC_BARRIER;
+    }
+    if ((insn & 0xfe000000) == 0xea000000) {
+        /* Data processing, shifted register */
+        shift = ((insn >> 6) & 3) | ((insn >> 10) & 0x1c);
+        if (((insn >> 4) & 3) == 3 && shift == 0) {
+            return THUMB_CC_BARRIER; /* RRX */
+        }
+        if (!(insn & (1 << 20))) {
+            return (rd != 15 && thumb_cc_dp_op(op))
+                    ? THUMB_CC_NONE : THUMB_CC_BARRIER;
+        }
+        if (op == 8 || op == 13 || op == 14) {
+            return THUMB_CC_ARITH;
+        }
+        /* Logical operations set C unless the shift is LSL #0.  */
+        if (op <= 4 && (insn & 0x70f0) == 0) {
+            return THUMB_CC_NONE;
+        }
+        return THUMB_CC_BARRIER;
+    }
+    if ((insn & 0xfff00000) == 0xfb000000) {
+        /* MUL/MLA/MLS */
+        return rd != 15 ? THUMB_CC_NONE : THUMB_CC_BARRIER;
+    }
+    if ((insn & 0xfe400000) == 0xe8000000) {
+        /* LDM/STM (IA or DB), not loading the PC */
+        op = (insn >> 23) & 3;
+        if ((op == 1 || op == 2) && rn != 15
+            && !((insn & (1 << 20)) && (insn & (1 << 15)))
+            && !((insn & (1 << 21)) && (insn & (1 << rn)))) {
+            return thumb_cc_mem(flags);
+        }
+        return THUMB_CC_BARRIER;
+    }
+    if ((insn & 0xfe000000) == 0xf8000000) {
+        /* Load/store single data item */
+        if (rt == 15 || (insn & 0x01100000) == 0x01000000
+            || ((insn >> 21) & 3) == 3
+            || ((insn & (1 << 24)) && ((insn >> 21) & 3) == 2)
+            || (!(insn & (1 << 20)) && rn == 15)) {
+            return THUMB_CC_BARRIER; /* hints, loads to PC, or UNDEF */
+        }
+        if (rn != 15 && !(insn & (1 << 23))) {
+            switch ((insn >> 8) & 0xf) {
+            case 0x0:
+                if (((insn >> 4) & 0xf) > 3) {
+                    return THUMB_CC_BARRIER;
+                }
+                break;
+            case 0x9: case 0xb: case 0xc: case 0xd: case 0xe: case 0xf:
+                break;
+            default:
+                return THUMB_CC_BARRIER;
+            }
+        }
+        return thumb_cc_mem(flags);
+    }
+    return THUMB_CC_BARRIER;
+}
+
+#endif /* ARM_THUMB_CC_H */
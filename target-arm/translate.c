@@ -35,6 +35,10 @@
 
 #include "trace-tcg.h"
 #include "exec/log.h"
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+#include "sysemu/cpus.h"
+#include "thumb_cc.h"
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
 
 
 #define ENABLE_ARCH_4T    arm_dc_feature(s, ARM_FEATURE_V4T)
@@ -70,6 +74,19 @@ TCGv_i64 cpu_exclusive_val;
 static TCGv_i32 cpu_F0s, cpu_F1s;
 static TCGv_i64 cpu_F0d, cpu_F1d;
 
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+/* Operands of the last flag setting addition or subtraction, whose C and
+   V flags are not computed yet (see thumb_cc.h).  */
+static TCGv_i32 cpu_cc_a, cpu_cc_b;
+static enum {
+    LAZY_CC_NONE,
+    LAZY_CC_ADD,
+    LAZY_CC_SUB,
+} lazy_cc_op;
+/* Set while translating an instruction allowed to defer C and V.  */
+static bool lazy_cc;
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
+
 #include "exec/gen-icount.h"
 
 static const char *regnames[] =
@@ -177,7 +194,11 @@ static void store_reg(DisasContext *s, int reg, TCGv_i32 var)
          * We choose to ignore [1:0] in ARM mode for all architecture versions.
          */
         tcg_gen_andi_i32(var, var, s->thumb ? ~1 : ~3);
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+        s->is_jmp = DISAS_INDIRECT;
+#else
         s->is_jmp = DISAS_JUMP;
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
     }
     tcg_gen_mov_i32(cpu_R[reg], var);
     tcg_temp_free_i32(var);
@@ -444,7 +465,25 @@ static void gen_sub_carry(TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1)
 /* dest = T0 + T1. Compute C, N, V and Z flags */
 static void gen_add_CC(TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1)
 {
-    TCGv_i32 tmp = tcg_temp_new_i32();
+    TCGv_i32 tmp;
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+    if (lazy_cc) {
+        tcg_gen_mov_i32(cpu_cc_a, t0);
+        tcg_gen_mov_i32(cpu_cc_b, t1);
+        tcg_gen_add_i32(cpu_NF, cpu_cc_a, cpu_cc_b);
+        tcg_gen_mov_i32(cpu_ZF, cpu_NF);
+        tcg_gen_mov_i32(dest, cpu_NF);
+        lazy_cc_op = LAZY_CC_ADD;
+#ifdef CONFIG_PROFILER
+        tcg_ctx.cc_deferred_count++;
+#endif
+        return;
+    }
+#ifdef CONFIG_PROFILER
+    tcg_ctx.cc_eager_count++;
+#endif
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
+    tmp = tcg_temp_new_i32();
     tcg_gen_movi_i32(tmp, 0);
     tcg_gen_add2_i32(cpu_NF, cpu_CF, t0, tmp, t1, tmp);
     tcg_gen_mov_i32(cpu_ZF, cpu_NF);
@@ -487,6 +526,23 @@ static void gen_adc_CC(TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1)
 static void gen_sub_CC(TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1)
 {
     TCGv_i32 tmp;
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+    if (lazy_cc) {
+        tcg_gen_mov_i32(cpu_cc_a, t0);
+        tcg_gen_mov_i32(cpu_cc_b, t1);
+        tcg_gen_sub_i32(cpu_NF, cpu_cc_a, cpu_cc_b);
+        tcg_gen_mov_i32(cpu_ZF, cpu_NF);
+        tcg_gen_mov_i32(dest, cpu_NF);
+        lazy_cc_op = LAZY_CC_SUB;
+#ifdef CONFIG_PROFILER
+        tcg_ctx.cc_deferred_count++;
+#endif
+        return;
+    }
+#ifdef CONFIG_PROFILER
+    tcg_ctx.cc_eager_count++;
+#endif
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
     tcg_gen_sub_i32(cpu_NF, t0, t1);
     tcg_gen_mov_i32(cpu_ZF, cpu_NF);
     tcg_gen_setcond_i32(TCG_COND_GEU, cpu_CF, t0, t1);
@@ -507,6 +563,91 @@ static void gen_sbc_CC(TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1)
     tcg_temp_free_i32(tmp);
 }
 
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+/* Compute the C and V flags of the last deferred addition or
+   subtraction, as gen_add_CC() and gen_sub_CC() would have done.  */
+static void gen_lazy_cc_flush(void)
+{
+    TCGv_i32 res, tmp;
+
+    if (lazy_cc_op == LAZY_CC_NONE) {
+        return;
+    }
+#ifdef CONFIG_PROFILER
+    tcg_ctx.cc_flush_count++;
+#endif
+    res = tcg_temp_new_i32();
+    tmp = tcg_temp_new_i32();
+    if (lazy_cc_op == LAZY_CC_ADD) {
+        tcg_gen_movi_i32(tmp, 0);
+        tcg_gen_add2_i32(res, cpu_CF, cpu_cc_a, tmp, cpu_cc_b, tmp);
+        tcg_gen_xor_i32(cpu_VF, res, cpu_cc_a);
+        tcg_gen_xor_i32(tmp, cpu_cc_a, cpu_cc_b);
+        tcg_gen_andc_i32(cpu_VF, cpu_VF, tmp);
+    } else {
+        tcg_gen_sub_i32(res, cpu_cc_a, cpu_cc_b);
+        tcg_gen_setcond_i32(TCG_COND_GEU, cpu_CF, cpu_cc_a, cpu_cc_b);
+        tcg_gen_xor_i32(cpu_VF, res, cpu_cc_a);
+        tcg_gen_xor_i32(tmp, cpu_cc_a, cpu_cc_b);
+        tcg_gen_and_i32(cpu_VF, cpu_VF, tmp);
+    }
+    tcg_temp_free_i32(tmp);
+    tcg_temp_free_i32(res);
+    lazy_cc_op = LAZY_CC_NONE;
+}
+
+/* Classify the Thumb instruction at pc, outside IT blocks (see
+   thumb_cc.h).  */
+static ThumbCCClass thumb_cc_classify(CPUARMState *env, DisasContext *s,
+                                      target_ulong pc, int flags)
+{
+    uint32_t insn;
+
+    insn = arm_lduw_code(env, pc, s->sctlr_b);
+    if (thumb_cc_insn_is_32bit(insn)) {
+        insn = (insn << 16) | arm_lduw_code(env, pc + 2, s->sctlr_b);
+        return thumb_cc_classify32(insn, flags);
+    }
+    return thumb_cc_classify16(insn, flags);
+}
+
+/* Before translating the next instruction, compute the deferred C and V
+   flags if it may need them, or let it defer its own.  */
+static void gen_lazy_cc_prepare(CPUARMState *env, DisasContext *s,
+                                int flags, target_ulong next_page_start)
+{
+    target_ulong next_pc;
+
+    if (s->condexec_mask) {
+        gen_lazy_cc_flush();
+        return;
+    }
+    switch (thumb_cc_classify(env, s, s->pc, flags)) {
+    case THUMB_CC_BARRIER:
+        gen_lazy_cc_flush();
+        break;
+    case THUMB_CC_ARITH:
+        /* The flags are computed right away if the following instruction
+           (typically a conditional branch) needs them. Any deferred flags
+           are overwritten.  */
+        next_pc = s->pc + 2;
+        if (thumb_cc_insn_is_32bit(arm_lduw_code(env, s->pc, s->sctlr_b))) {
+            next_pc += 2;
+        }
+        if (next_pc + 4 <= next_page_start
+            && thumb_cc_classify(env, s, next_pc, flags)
+               != THUMB_CC_BARRIER) {
+            lazy_cc = true;
+        } else {
+            lazy_cc_op = LAZY_CC_NONE;
+        }
+        break;
+    default:
+        break;
+    }
+}
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
+
 #define GEN_SHIFT(name)                                               \
 static void gen_##name(TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1)       \
 {                                                                     \
@@ -878,7 +1019,11 @@ static inline void gen_bx_im(DisasContext *s, uint32_t addr)
 /* Set PC and Thumb state from var.  var is marked as dead.  */
 static inline void gen_bx(DisasContext *s, TCGv_i32 var)
 {
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+    s->is_jmp = DISAS_INDIRECT;
+#else
     s->is_jmp = DISAS_JUMP;
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
     tcg_gen_andi_i32(cpu_R[15], var, ~1);
     tcg_gen_andi_i32(var, var, 1);
     store_cpu_field(var, thumb);
@@ -11588,6 +11733,216 @@ static bool insn_crosses_page(CPUARMState *env, DisasContext *s)
     return false;
 }
 
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+/* Cycle model for the Cortex-M cores (-cycle-model), using the timings
+ * from the M0/M3/M4 Technical Reference Manuals. The cost is accumulated
+ * at translation time, so branches are estimated statically: unconditional
+ * and backward conditional branches are assumed taken, forward conditional
+ * branches not taken.
+ */
+
+/* A taken branch, including the pipeline refill. */
+#define THUMB_M_BRANCH_CYCLES 3
+#define THUMB_M_REFILL_CYCLES (THUMB_M_BRANCH_CYCLES - 1)
+
+static int thumb_m_insn16_cycles(uint32_t insn)
+{
+    int rd;
+
+    switch (insn >> 12) {
+    case 0x4:
+        if ((insn & 0xf800) == 0x4800) {
+            /* LDR (literal) */
+            return 2;
+        }
+        if ((insn & 0xfc00) == 0x4400) {
+            if ((insn & 0x0300) == 0x0300) {
+                /* BX, BLX (register) */
+                return THUMB_M_BRANCH_CYCLES;
+            }
+            rd = (insn & 7) | ((insn >> 4) & 8);
+            if (rd == 15 && (insn & 0x0300) != 0x0100) {
+                /* ADD, MOV to PC */
+                return THUMB_M_BRANCH_CYCLES;
+            }
+        }
+        return 1;
+    case 0x5: case 0x6: case 0x7: case 0x8: case 0x9:
+        /* Load/store single */
+        return 2;
+    case 0xb:
+        if ((insn & 0xfe00) == 0xb400) {
+            /* PUSH */
+            return 1 + ctpop32(insn & 0x1ff);
+        }
+        if ((insn & 0xfe00) == 0xbc00) {
+            /* POP */
+            return 1 + ctpop32(insn & 0x1ff)
+                    + ((insn & 0x100) ? THUMB_M_REFILL_CYCLES : 0);
+        }
+        /* CBZ/CBNZ (forward only), IT, hints, extends */
+        return 1;
+    case 0xc:
+        /* LDM/STM */
+        return 1 + ctpop32(insn & 0xff);
+    case 0xd:
+        if ((insn & 0x0e00) != 0x0e00 && (insn & 0x80)) {
+            /* Backward B<c> */
+            return THUMB_M_BRANCH_CYCLES;
+        }
+        return 1;
+    case 0xe:
+        /* B */
+        return THUMB_M_BRANCH_CYCLES;
+    default:
+        /* Shifts, add/sub/compare/move immediate, data processing */
+        return 1;
+    }
+}
+
+static int thumb_m_vfp_cycles(uint32_t insn)
+{
+    if ((insn & 0x0fb00e50) == 0x0e800a00
+            || (insn & 0x0fbf0ed0) == 0x0eb10ac0) {
+        /* VDIV, VSQRT */
+        return 14;
+    }
+    if ((insn & 0x0fa00e10) == 0x0e000a00
+            || (insn & 0x0fb00e10) == 0x0ea00a00
+            || (insn & 0x0fb00e10) == 0x0e900a00) {
+        /* VMLA/VMLS/VNMLA/VNMLS, VFMA/VFMS/VFNMA/VFNMS */
+        return 3;
+    }
+    if ((insn & 0x0f200e00) == 0x0d000a00
+            || (insn & 0x0fe00e00) == 0x0c400a00) {
+        /* VLDR/VSTR, VMOV to/from two core registers */
+        return 2;
+    }
+    if ((insn & 0x0e000e00) == 0x0c000a00) {
+        /* VLDM/VSTM/VPUSH/VPOP, one cycle per word */
+        return 1 + (insn & 0xff);
+    }
+    return 1;
+}
+
+static int thumb_m_insn32_cycles(uint32_t insn, bool v7m, bool dsp)
+{
+    uint32_t hw1 = insn >> 16;
+    uint32_t hw2 = insn & 0xffff;
+    int op;
+
+    if ((hw1 & 0xec00) == 0xec00) {
+        return thumb_m_vfp_cycles(insn);
+    }
+
+    if ((hw1 & 0xf800) == 0xf000 && (hw2 & 0x8000)) {
+        /* Branches and miscellaneous control */
+        if (hw2 & 0x5000) {
+            /* B.W, BL */
+            return THUMB_M_BRANCH_CYCLES + ((v7m || !(hw2 & 0x4000)) ? 0 : 1);
+        }
+        if ((hw1 & 0x0380) != 0x0380) {
+            /* B<c>.W, assumed taken if backward */
+            return (hw1 & 0x0400) ? THUMB_M_BRANCH_CYCLES : 1;
+        }
+        if ((hw1 & 0xfff0) == 0xf3a0) {
+            /* NOP and other hints */
+            return 1;
+        }
+        /* MSR, MRS, barriers */
+        return v7m ? 2 : 4;
+    }
+
+    switch (hw1 & 0xfe40) {
+    case 0xe800:
+        /* LDM/STM */
+        return 1 + ctpop32(hw2)
+                + ((hw1 & 0x0010) && (hw2 & 0x8000) ? THUMB_M_REFILL_CYCLES
+                                                    : 0);
+    case 0xe840:
+        if ((hw1 & 0xfff0) == 0xe8d0 && (hw2 & 0xffe0) == 0xf000) {
+            /* TBB/TBH */
+            return 2 + THUMB_M_BRANCH_CYCLES;
+        }
+        if (hw1 & 0x0120) {
+            /* LDRD/STRD */
+            return 3;
+        }
+        /* Exclusives */
+        return 2;
+    }
+
+    if ((hw1 & 0xfe00) == 0xf800) {
+        /* Load/store single */
+        return 2;
+    }
+
+    if ((hw1 & 0xff80) == 0xfb00) {
+        op = (hw1 >> 4) & 7;
+        if (op == 0 && (hw2 & 0xf030) != 0xf000) {
+            /* MLA/MLS */
+            return dsp ? 1 : 2;
+        }
+        /* MUL and the DSP multiplies */
+        return 1;
+    }
+
+    if ((hw1 & 0xff80) == 0xfb80) {
+        op = (hw1 >> 4) & 7;
+        if (op == 1 || op == 3) {
+            /* SDIV/UDIV, between 2 and 12 cycles */
+            return 6;
+        }
+        if (dsp) {
+            return 1;
+        }
+        /* SMULL/UMULL, SMLAL/UMLAL */
+        return (op & 4) ? 5 : 4;
+    }
+
+    /* Data processing */
+    return 1;
+}
+
+static int thumb_m_insn_cycles(CPUARMState *env, DisasContext *s)
+{
+    bool v7m = arm_dc_feature(s, ARM_FEATURE_V7);
+    bool dsp = arm_dc_feature(s, ARM_FEATURE_THUMB_DSP);
+    uint32_t insn = arm_lduw_code(env, s->pc, s->sctlr_b);
+
+    if ((insn >> 11) < 0x1d) {
+        return thumb_m_insn16_cycles(insn);
+    }
+    insn = (insn << 16) | arm_lduw_code(env, s->pc + 2, s->sctlr_b);
+    return thumb_m_insn32_cycles(insn, v7m, dsp);
+}
+
+/* The flash wait states of a block, not hidden by prefetch or cache. */
+static int thumb_m_flash_cycles(ARMCPU *cpu, uint32_t start, uint32_t end)
+{
+    uint32_t size = cpu->flash_timing.size;
+    int ws = cpu->flash_timing.wait_states;
+    int line = cpu->flash_timing.line_size;
+    int cycles;
+
+    if (ws == 0 || cpu->flash_timing.cache || end <= start) {
+        return 0;
+    }
+    /* Also the flash alias at address 0, when booting from flash. */
+    if (start - cpu->flash_timing.base >= size && start >= size) {
+        return 0;
+    }
+
+    /* The first fetch, after a branch. */
+    cycles = ws;
+    if (!cpu->flash_timing.prefetch && line > 0) {
+        /* Each new line of sequential code. */
+        cycles += ws * ((end - 1) / line - start / line);
+    }
+    return cycles;
+}
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
+
 /* generate intermediate code for basic block 'tb'.  */
 void gen_intermediate_code(CPUARMState *env, TranslationBlock *tb)
 {
@@ -11599,9 +11954,24 @@ void gen_intermediate_code(CPUARMState *env, TranslationBlock *tb)
     int num_insns;
     int max_insns;
     bool end_of_page;
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+    bool cycle_model;
+    int cycles;
+    int max_cycles;
+    bool lazy_cc_tb;
+    int lazy_cc_flags;
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
 
     /* generate intermediate code */
 
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+    /* A translation that longjmp'ed out of an instruction (like a fault
+     * on the code fetch) left the deferral state of that instruction.
+     */
+    lazy_cc = false;
+    lazy_cc_op = LAZY_CC_NONE;
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
+
     /* The A64 decoder has its own top level loop, because it doesn't need
      * the A32/T32 complexity to do with conditional execution/IT blocks/etc.
      */
@@ -11672,6 +12042,10 @@ void gen_intermediate_code(CPUARMState *env, TranslationBlock *tb)
     cpu_V1 = cpu_F1d;
     /* FIXME: cpu_M0 can probably be the same as cpu_V0.  */
     cpu_M0 = tcg_temp_new_i64();
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+    cpu_cc_a = tcg_temp_new_i32();
+    cpu_cc_b = tcg_temp_new_i32();
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
     next_page_start = (pc_start & TARGET_PAGE_MASK) + TARGET_PAGE_SIZE;
     num_insns = 0;
     max_insns = tb->cflags & CF_COUNT_MASK;
@@ -11682,6 +12056,36 @@ void gen_intermediate_code(CPUARMState *env, TranslationBlock *tb)
         max_insns = TCG_MAX_INSNS;
     }
 
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+    cycle_model = use_icount_cycles && (tb->cflags & CF_USE_ICOUNT)
+            && arm_dc_feature(dc, ARM_FEATURE_M);
+    cycles = 0;
+    /* Blocks executed with the remaining budget (cpu_exec_nocache())
+     * must not cost more, or they would never run. The count of
+     * blocks recompiled for I/O is in instructions.
+     */
+    max_cycles = CF_COUNT_MASK;
+    if ((tb->cflags & CF_COUNT_MASK) && !(tb->cflags & CF_LAST_IO)) {
+        max_cycles = tb->cflags & CF_COUNT_MASK;
+    }
+
+    /* Defer the C and V flags on M profile cores, unless disabled with
+     * -no-lazy-flags or the debugger may stop in the middle of the block.
+     * Memory accesses leave the block only to recompile it for I/O with
+     * icount, or on MPU faults.
+     */
+    lazy_cc_tb = use_lazy_flags
+            && arm_dc_feature(dc, ARM_FEATURE_M) && dc->thumb
+            && QTAILQ_EMPTY(&cs->breakpoints)
+            && QTAILQ_EMPTY(&cs->watchpoints)
+            && !cs->singlestep_enabled && !singlestep;
+    lazy_cc_flags = 0;
+    if (!(tb->cflags & CF_USE_ICOUNT)
+        && !arm_dc_feature(dc, ARM_FEATURE_MPU)) {
+        lazy_cc_flags |= THUMB_CC_MEM_OK;
+    }
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
+
     gen_tb_start(tb);
 
     tcg_clear_temp_count();
@@ -11797,8 +12201,21 @@ void gen_intermediate_code(CPUARMState *env, TranslationBlock *tb)
             goto done_generating;
         }
 
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+        if (cycle_model && dc->thumb) {
+            cycles += thumb_m_insn_cycles(env, dc);
+        }
+
+        if (lazy_cc_tb) {
+            gen_lazy_cc_prepare(env, dc, lazy_cc_flags, next_page_start);
+        }
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
+
         if (dc->thumb) {
             disas_thumb_insn(env, dc);
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+            lazy_cc = false;
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
             if (dc->condexec_mask) {
                 dc->condexec_cond = (dc->condexec_cond & 0xe)
                                    | ((dc->condexec_mask >> 4) & 1);
@@ -11840,6 +12257,11 @@ void gen_intermediate_code(CPUARMState *env, TranslationBlock *tb)
         end_of_page = (dc->pc >= next_page_start) ||
             ((dc->pc >= next_page_start - 3) && insn_crosses_page(env, dc));
 
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+        if (cycle_model && cycles >= max_cycles) {
+            break;
+        }
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
     } while (!dc->is_jmp && !tcg_op_buf_full() &&
              !cs->singlestep_enabled &&
              !singlestep &&
@@ -11847,6 +12269,10 @@ void gen_intermediate_code(CPUARMState *env, TranslationBlock *tb)
              !end_of_page &&
              num_insns < max_insns);
 
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+    gen_lazy_cc_flush();
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
+
     if (tb->cflags & CF_LAST_IO) {
         if (dc->condjmp) {
             /* FIXME:  This can theoretically happen with self-modifying
@@ -11922,6 +12348,12 @@ void gen_intermediate_code(CPUARMState *env, TranslationBlock *tb)
             /* indicate that the hash table must be used to find the next TB */
             tcg_gen_exit_tb(0);
             break;
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+        case DISAS_INDIRECT:
+            /* Jump to the next TB directly, if already translated.  */
+            tcg_gen_lookup_and_goto_ptr(cpu_R[15]);
+            break;
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
         case DISAS_TB_JUMP:
             /* nothing more to generate */
             break;
@@ -11958,7 +12390,19 @@ void gen_intermediate_code(CPUARMState *env, TranslationBlock *tb)
     }
 
 done_generating:
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+    if (cycle_model) {
+        cycles += thumb_m_flash_cycles(cpu, pc_start, dc->pc);
+        /* Charge the block in cycles; tb->icount remains the number
+         * of instructions.
+         */
+        gen_tb_end(tb, MIN(cycles, max_cycles));
+    } else {
+        gen_tb_end(tb, num_insns);
+    }
+#else
     gen_tb_end(tb, num_insns);
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
 
 #ifdef DEBUG_DISAS
     if (qemu_loglevel_mask(CPU_LOG_TB_IN_ASM) &&
@@ -120,6 +120,13 @@ static inline int default_exception_el(DisasContext *s)
 #define DISAS_HVC 8
 #define DISAS_SMC 9
 #define DISAS_YIELD 10
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+/* Indirect branch (BX, POP {pc}, etc); only pc and the Thumb bit were
+ * modified, so the next TB can be looked up without returning to the
+ * main loop.
+ */
+#define DISAS_INDIRECT 11
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
 
 #ifdef TARGET_AARCH64
 void a64_translate_init(void);
@@ -0,0 +1,702 @@
+/*
+ * Persistent translation cache.
+ *
+ * Copyright (c) 2017 Liviu Ionescu.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu-common.h"
+#include "cpu.h"
+#include "exec/exec-all.h"
+#include "exec/memory.h"
+#include "exec/semihost.h"
+#include "exec/tb-cache.h"
+#include "qemu/error-report.h"
+#include "qemu/log.h"
+#include "sysemu/cpus.h"
+#include "sysemu/sysemu.h"
+#include "tcg.h"
+
+#if defined(CONFIG_VERBOSE)
+#include "verbosity.h"
+#endif
+
+bool tb_cache_enabled;
+
+#if defined(TCG_TARGET_HAS_CODE_CACHE)
+
+/*
+ * The file has a header, followed by the blocks; each block has a fixed
+ * size descriptor, followed by the relocations, the host code and the
+ * search data (see encode_search()), padded to 8 bytes. Everything is
+ * in host order.
+ *
+ * Only the blocks used in a run are written back, so the file follows
+ * the application, and does not grow with older versions of it.
+ *
+ * The host code is executed as is, so the file is created readable by
+ * its owner only, and is ignored if owned by another user or writable
+ * by others. Each block has a hash of its relocations, code and search
+ * data, checked before the code is used, to catch damaged files.
+ */
+
+#define TB_CACHE_MAGIC      "QEMU-TBC"
+#define TB_CACHE_VERSION    2
+
+#define TB_CACHE_HASH_INIT  0xcbf29ce484222325ULL
+#define TB_CACHE_HASH_PRIME 0x100000001b3ULL
+
+typedef struct TBCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t nb_blocks;
+    uint64_t build_key;
+    uint64_t size;
+} TBCacheHeader;
+
+/* What the relocated addresses are relative to.  */
+enum {
+    TB_CACHE_BASE_TEXT,         /* the QEMU executable (helpers) */
+    TB_CACHE_BASE_PROLOGUE,     /* the TCG prologue/epilogue */
+    TB_CACHE_BASE_TB,           /* the TranslationBlock */
+};
+
+typedef struct TBCacheReloc {
+    uint32_t offset;
+    uint16_t type;              /* TCGCodeRelocType */
+    uint16_t base;
+    int64_t value;
+} TBCacheReloc;
+
+typedef struct TBCacheBlock {
+    /* The key.  */
+    uint64_t pc;
+    uint64_t cs_base;
+    uint64_t page_hash;
+    uint32_t flags;
+    uint32_t cflags;
+    uint32_t config_hash;
+
+    uint16_t size;
+    uint16_t icount;
+    /* Only if the guest code spans two pages.  */
+    uint64_t page2_hash;
+    /* The relocations, the host code and the search data.  */
+    uint64_t body_hash;
+    uint16_t icount_cost;
+    uint16_t nb_relocs;
+    uint16_t code_size;
+    uint16_t search_size;
+    uint16_t jmp_reset_offset[2];
+    uint16_t jmp_insn_offset[2];
+} TBCacheBlock;
+
+typedef struct TBCacheSlot {
+    TBCacheBlock *block;
+    /* Not in the loaded file.  */
+    bool allocated;
+    /* The body hash was checked.  */
+    bool verified;
+    /* Loaded or stored in this run, written back at exit.  */
+    bool used;
+} TBCacheSlot;
+
+typedef struct TBCacheState {
+    char *file_name;
+    uint8_t *loaded;
+    uint32_t nb_loaded;
+
+    /* TBCacheBlock key -> TBCacheSlot.  */
+    GHashTable *slots;
+
+    uint64_t build_key;
+    uintptr_t text_start;
+    uintptr_t text_end;
+
+    /* The key of the block being translated.  */
+    TBCacheBlock pending;
+
+    Notifier exit_notifier;
+
+    unsigned hits;
+    unsigned misses;
+    unsigned stored;
+    unsigned uncacheable;
+} TBCacheState;
+
+static TBCacheState tb_cache;
+
+/* Provided by the linker.  */
+extern const char __executable_start[];
+extern const char etext[];
+
+static uint64_t tb_cache_hash(uint64_t h, const void *data, size_t size)
+{
+    const uint8_t *p = data;
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        h = (h ^ p[i]) * TB_CACHE_HASH_PRIME;
+    }
+    return h;
+}
+
+static uint64_t tb_cache_hash_page(tb_page_addr_t addr)
+{
+    const uint8_t *p = qemu_map_ram_ptr(NULL, addr & TARGET_PAGE_MASK);
+    uint64_t h = TB_CACHE_HASH_INIT;
+    int i;
+
+    for (i = 0; i < TARGET_PAGE_SIZE; i += 8) {
+        h = (h ^ ldq_he_p(p + i)) * TB_CACHE_HASH_PRIME;
+        h ^= h >> 32;
+    }
+    return h;
+}
+
+static guint tb_cache_slot_hash(gconstpointer key)
+{
+    const TBCacheBlock *b = key;
+
+    return b->pc ^ b->flags ^ b->page_hash ^ (b->page_hash >> 32);
+}
+
+static gboolean tb_cache_slot_equal(gconstpointer a, gconstpointer b)
+{
+    const TBCacheBlock *x = a;
+    const TBCacheBlock *y = b;
+
+    return x->pc == y->pc && x->cs_base == y->cs_base
+           && x->page_hash == y->page_hash && x->flags == y->flags
+           && x->cflags == y->cflags && x->config_hash == y->config_hash;
+}
+
+static void tb_cache_slot_free(gpointer data)
+{
+    TBCacheSlot *slot = data;
+
+    if (slot->allocated) {
+        g_free(slot->block);
+    }
+    g_free(slot);
+}
+
+static size_t tb_cache_block_length(const TBCacheBlock *b)
+{
+    return ROUND_UP(sizeof(*b) + b->nb_relocs * sizeof(TBCacheReloc)
+                    + b->code_size + b->search_size, 8);
+}
+
+static inline TBCacheReloc *tb_cache_block_relocs(TBCacheBlock *b)
+{
+    return (TBCacheReloc *)(b + 1);
+}
+
+static inline uint8_t *tb_cache_block_code(TBCacheBlock *b)
+{
+    return (uint8_t *)(tb_cache_block_relocs(b) + b->nb_relocs);
+}
+
+static uint64_t tb_cache_block_body_hash(TBCacheBlock *b)
+{
+    return tb_cache_hash(TB_CACHE_HASH_INIT, tb_cache_block_relocs(b),
+                         b->nb_relocs * sizeof(TBCacheReloc)
+                         + b->code_size + b->search_size);
+}
+
+/* The executable, the target and the host features used by the code.
+   Returns false if the executable cannot be identified.  */
+static bool tb_cache_get_build_key(uint64_t *key)
+{
+    uint64_t h = TB_CACHE_HASH_INIT;
+    uint64_t values[6];
+    struct stat st;
+
+    h = tb_cache_hash(h, QEMU_VERSION, strlen(QEMU_VERSION));
+    h = tb_cache_hash(h, TARGET_NAME, strlen(TARGET_NAME));
+
+    if (stat("/proc/self/exe", &st) != 0) {
+        return false;
+    }
+
+    values[0] = st.st_size;
+    values[1] = st.st_mtime;
+    values[2] = tb_cache.text_end - tb_cache.text_start;
+    values[3] = sizeof(CPUArchState);
+    values[4] = TARGET_PAGE_BITS;
+    values[5] = tcg_target_code_cache_features();
+
+    *key = tb_cache_hash(h, values, sizeof(values));
+    return true;
+}
+
+/* Host state that changes the translation, but is not in the flags.  */
+static uint32_t tb_cache_get_config_hash(CPUState *cpu)
+{
+    const char *type = object_get_typename(OBJECT(cpu));
+    uint64_t h;
+
+    h = tb_cache_hash(TB_CACHE_HASH_INIT, type, strlen(type));
+    h = tb_cache_hash(h, &(uint8_t) { semihosting_enabled() }, 1);
+    h = tb_cache_hash(h, &(uint8_t) { use_lazy_flags }, 1);
+    return h ^ (h >> 32);
+}
+
+static bool tb_cache_validate(const uint8_t *data, size_t size)
+{
+    const TBCacheHeader *header = (const TBCacheHeader *)data;
+    size_t offset;
+    uint32_t i, j;
+
+    if (size < sizeof(*header)
+        || memcmp(header->magic, TB_CACHE_MAGIC, sizeof(header->magic)) != 0
+        || header->version != TB_CACHE_VERSION
+        || header->build_key != tb_cache.build_key
+        || header->size != size) {
+        return false;
+    }
+
+    offset = sizeof(*header);
+    for (i = 0; i < header->nb_blocks; i++) {
+        TBCacheBlock *b = (TBCacheBlock *)(data + offset);
+        TBCacheReloc *r;
+
+        if (size - offset < sizeof(*b)
+            || size - offset < tb_cache_block_length(b)
+            || b->code_size == 0 || b->size == 0) {
+            return false;
+        }
+        for (j = 0; j < 2; j++) {
+            if (b->jmp_reset_offset[j] != TB_JMP_RESET_OFFSET_INVALID
+                && (b->jmp_reset_offset[j] > b->code_size
+                    || b->jmp_insn_offset[j] + 4 > b->code_size)) {
+                return false;
+            }
+        }
+        r = tb_cache_block_relocs(b);
+        for (j = 0; j < b->nb_relocs; j++) {
+            unsigned width = r[j].type == TCG_CODE_RELOC_REL32 ? 4 : 8;
+
+            if (r[j].offset + width > b->code_size
+                || r[j].type > TCG_CODE_RELOC_TB
+                || r[j].base > TB_CACHE_BASE_TB) {
+                return false;
+            }
+        }
+        offset += tb_cache_block_length(b);
+    }
+    return offset == size;
+}
+
+static void tb_cache_load_file(void)
+{
+    const TBCacheHeader *header;
+    uint8_t *data;
+    size_t size, offset;
+    struct stat st;
+    uint32_t i;
+    int fd;
+
+    fd = open(tb_cache.file_name, O_RDONLY | O_NOFOLLOW);
+    if (fd < 0) {
+        if (errno != ENOENT) {
+            qemu_log_mask(LOG_UNIMP, "Cannot read translation cache '%s': "
+                          "%s.\n", tb_cache.file_name, strerror(errno));
+        }
+        return;
+    }
+
+    /* Read, not mapped, so the file cannot change once validated.  */
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)
+        || st.st_uid != getuid() || (st.st_mode & (S_IWGRP | S_IWOTH))) {
+        qemu_log_mask(LOG_UNIMP, "Translation cache '%s' not a regular "
+                      "file of the user, ignored.\n", tb_cache.file_name);
+        close(fd);
+        return;
+    }
+    size = st.st_size;
+    data = g_malloc(size);
+    if (read(fd, data, size) != size) {
+        qemu_log_mask(LOG_UNIMP, "Cannot read translation cache '%s'.\n",
+                      tb_cache.file_name);
+        g_free(data);
+        close(fd);
+        return;
+    }
+    close(fd);
+
+    if (!tb_cache_validate(data, size)) {
+        /* Another build, or damaged; rewritten at exit.  */
+        qemu_log_mask(LOG_UNIMP, "Translation cache '%s' not valid, "
+                      "ignored.\n", tb_cache.file_name);
+        g_free(data);
+        return;
+    }
+    tb_cache.loaded = data;
+
+    header = (const TBCacheHeader *)data;
+    offset = sizeof(*header);
+    for (i = 0; i < header->nb_blocks; i++) {
+        TBCacheSlot *slot = g_new0(TBCacheSlot, 1);
+
+        slot->block = (TBCacheBlock *)(data + offset);
+        g_hash_table_replace(tb_cache.slots, slot->block, slot);
+        offset += tb_cache_block_length(slot->block);
+    }
+    tb_cache.nb_loaded = header->nb_blocks;
+}
+
+static void tb_cache_save(Notifier *notifier, void *data)
+{
+    GHashTableIter iter;
+    TBCacheSlot *slot;
+    TBCacheHeader header;
+    GByteArray *buf;
+    char *tmp_name;
+    int fd;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TB_CACHE_MAGIC, sizeof(header.magic));
+    header.version = TB_CACHE_VERSION;
+    header.build_key = tb_cache.build_key;
+
+    g_hash_table_iter_init(&iter, tb_cache.slots);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&slot)) {
+        if (slot->used) {
+            header.nb_blocks++;
+        }
+    }
+    if (tb_cache.stored == 0 && header.nb_blocks == tb_cache.nb_loaded) {
+        /* Nothing changed.  */
+        return;
+    }
+
+    buf = g_byte_array_new();
+    g_byte_array_append(buf, (guint8 *)&header, sizeof(header));
+    g_hash_table_iter_init(&iter, tb_cache.slots);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&slot)) {
+        if (slot->used) {
+            g_byte_array_append(buf, (guint8 *)slot->block,
+                                tb_cache_block_length(slot->block));
+        }
+    }
+    ((TBCacheHeader *)buf->data)->size = buf->len;
+
+    /* The cache is only an optimisation; failing to write it is not
+       an error. The file is written to a temporary file, created with
+       mode 0600, and renamed, so concurrent instances are safe.  */
+    tmp_name = g_strdup_printf("%s.XXXXXX", tb_cache.file_name);
+    fd = g_mkstemp(tmp_name);
+    if (fd < 0 || qemu_write_full(fd, buf->data, buf->len) != buf->len
+        || close(fd) != 0 || rename(tmp_name, tb_cache.file_name) != 0) {
+        qemu_log_mask(LOG_UNIMP, "Cannot write translation cache '%s': "
+                      "%s.\n", tb_cache.file_name, strerror(errno));
+        if (fd >= 0) {
+            unlink(tmp_name);
+        }
+    }
+    g_free(tmp_name);
+    g_byte_array_free(buf, TRUE);
+}
+
+static bool tb_cache_usable(CPUState *cpu, TranslationBlock *tb)
+{
+    /* The cycle model code depends on the flash configuration, and
+       debugging needs the translation itself (breakpoints, and the
+       lazily computed flags in target-arm with watchpoints).  */
+    return !(tb->cflags & CF_NOCACHE) && !use_icount_cycles
+           && !singlestep && !cpu->singlestep_enabled
+           && QTAILQ_EMPTY(&cpu->breakpoints)
+           && QTAILQ_EMPTY(&cpu->watchpoints)
+           && !qemu_loglevel_mask(CPU_LOG_TB_IN_ASM | CPU_LOG_TB_OP
+                                  | CPU_LOG_TB_OP_OPT | CPU_LOG_TB_OUT_ASM);
+}
+
+/* Returns the base of the relocated address, or -1 if not relocatable.  */
+static int tb_cache_reloc_base(TranslationBlock *tb, TCGCodeReloc *r,
+                               int64_t *value)
+{
+    uintptr_t prologue = (uintptr_t)tcg_ctx.code_gen_prologue;
+
+    if (r->type == TCG_CODE_RELOC_TB) {
+        /* The exit index, in the low bits.  */
+        *value = r->value - (uintptr_t)tb;
+        return (*value >= 0 && *value <= TB_EXIT_MASK) ? TB_CACHE_BASE_TB
+                                                       : -1;
+    }
+    if (r->value >= prologue
+        && r->value < (uintptr_t)tcg_ctx.code_gen_buffer) {
+        *value = r->value - prologue;
+        return TB_CACHE_BASE_PROLOGUE;
+    }
+    if (r->value >= tb_cache.text_start && r->value < tb_cache.text_end) {
+        *value = r->value - tb_cache.text_start;
+        return TB_CACHE_BASE_TEXT;
+    }
+    return -1;
+}
+
+static bool tb_cache_relocate(TranslationBlock *tb, TBCacheBlock *b,
+                              uint8_t *code)
+{
+    TBCacheReloc *r = tb_cache_block_relocs(b);
+    uintptr_t target;
+    int64_t disp;
+    uint32_t i;
+
+    for (i = 0; i < b->nb_relocs; i++) {
+        switch (r[i].base) {
+        case TB_CACHE_BASE_TEXT:
+            target = tb_cache.text_start + r[i].value;
+            break;
+        case TB_CACHE_BASE_PROLOGUE:
+            target = (uintptr_t)tcg_ctx.code_gen_prologue + r[i].value;
+            break;
+        default:
+            target = (uintptr_t)tb + r[i].value;
+            break;
+        }
+        if (r[i].type == TCG_CODE_RELOC_REL32) {
+            disp = target - (uintptr_t)(code + r[i].offset + 4);
+            if (disp != (int32_t)disp) {
+                return false;
+            }
+            stl_he_p(code + r[i].offset, disp);
+        } else {
+            stq_he_p(code + r[i].offset, target);
+        }
+    }
+    return true;
+}
+
+void tb_cache_init(const char *file_name)
+{
+    if (!tcg_enabled()) {
+        error_report("-tb-cache requires TCG");
+        exit(1);
+    }
+
+    tb_cache.text_start = (uintptr_t)__executable_start;
+    tb_cache.text_end = (uintptr_t)etext;
+    if (!tb_cache_get_build_key(&tb_cache.build_key)) {
+        /* A key without the executable would match other builds.  */
+        error_report("warning: cannot identify the QEMU executable, "
+                     "-tb-cache disabled");
+        return;
+    }
+
+    tb_cache.file_name = g_strdup(file_name);
+    tb_cache.slots = g_hash_table_new_full(tb_cache_slot_hash,
+                                           tb_cache_slot_equal, NULL,
+                                           tb_cache_slot_free);
+
+    tb_cache_load_file();
+
+#if defined(CONFIG_VERBOSE)
+    if (verbosity_level >= VERBOSITY_DETAILED) {
+        printf("Translation cache: '%s', %u blocks.\n", file_name,
+               tb_cache.nb_loaded);
+    }
+#endif
+
+    tb_cache.exit_notifier.notify = tb_cache_save;
+    qemu_add_exit_notifier(&tb_cache.exit_notifier);
+
+    tb_cache_enabled = true;
+}
+
+int tb_cache_lookup(CPUState *cpu, TranslationBlock *tb,
+                    tb_page_addr_t phys_pc, int *gen_code_size,
+                    int *search_size)
+{
+    CPUArchState *env = cpu->env_ptr;
+    TBCacheBlock *key = &tb_cache.pending;
+    TBCacheSlot *slot;
+    TBCacheBlock *b;
+    target_ulong virt_page2;
+    uint8_t *code = (uint8_t *)tb->tc_ptr;
+
+    tcg_ctx.code_cache_recording = false;
+    if (!tb_cache_usable(cpu, tb)) {
+        return 0;
+    }
+
+    memset(key, 0, sizeof(*key));
+    key->pc = tb->pc;
+    key->cs_base = tb->cs_base;
+    key->flags = tb->flags;
+    key->cflags = tb->cflags;
+    key->config_hash = tb_cache_get_config_hash(cpu);
+    key->page_hash = tb_cache_hash_page(phys_pc);
+
+    slot = g_hash_table_lookup(tb_cache.slots, key);
+    if (slot == NULL) {
+        goto miss;
+    }
+    b = slot->block;
+
+    virt_page2 = (tb->pc + b->size - 1) & TARGET_PAGE_MASK;
+    if ((tb->pc & TARGET_PAGE_MASK) != virt_page2
+        && tb_cache_hash_page(get_page_addr_code(env, virt_page2))
+           != b->page2_hash) {
+        goto miss;
+    }
+
+    if (!slot->verified) {
+        if (tb_cache_block_body_hash(b) != b->body_hash) {
+            /* Damaged; translated and replaced.  */
+            g_hash_table_remove(tb_cache.slots, b);
+            goto miss;
+        }
+        slot->verified = true;
+    }
+
+    if ((void *)(code + b->code_size + b->search_size)
+        > tcg_ctx.code_gen_highwater) {
+        return -1;
+    }
+    memcpy(code, tb_cache_block_code(b), b->code_size + b->search_size);
+    if (!tb_cache_relocate(tb, b, code)) {
+        goto miss;
+    }
+    flush_icache_range((uintptr_t)code, (uintptr_t)code + b->code_size);
+
+    tb->size = b->size;
+    tb->icount = b->icount;
+    tb->icount_cost = b->icount_cost;
+    tb->jmp_reset_offset[0] = b->jmp_reset_offset[0];
+    tb->jmp_reset_offset[1] = b->jmp_reset_offset[1];
+    tb->jmp_insn_offset[0] = b->jmp_insn_offset[0];
+    tb->jmp_insn_offset[1] = b->jmp_insn_offset[1];
+
+    *gen_code_size = b->code_size;
+    *search_size = b->search_size;
+
+    slot->used = true;
+    tb_cache.hits++;
+    return 1;
+
+ miss:
+    tb_cache.misses++;
+    tcg_ctx.code_cache_recording = true;
+    tcg_ctx.code_cache_uncacheable = false;
+    tcg_ctx.nb_code_relocs = 0;
+    return 0;
+}
+
+void tb_cache_store(CPUState *cpu, TranslationBlock *tb,
+                    tb_page_addr_t phys_pc, tb_page_addr_t phys_page2,
+                    int gen_code_size, int search_size)
+{
+    TBCacheSlot *slot;
+    TBCacheBlock *b;
+    TBCacheReloc *r;
+    int base, i;
+    int64_t value;
+
+    if (!tcg_ctx.code_cache_recording) {
+        return;
+    }
+    tcg_ctx.code_cache_recording = false;
+
+    if (tcg_ctx.code_cache_uncacheable || gen_code_size > UINT16_MAX
+        || search_size > UINT16_MAX) {
+        tb_cache.uncacheable++;
+        return;
+    }
+
+    b = g_malloc0(ROUND_UP(sizeof(*b)
+                           + tcg_ctx.nb_code_relocs * sizeof(*r)
+                           + gen_code_size + search_size, 8));
+    *b = tb_cache.pending;
+    b->size = tb->size;
+    b->icount = tb->icount;
+    b->icount_cost = tb->icount_cost;
+    if (phys_page2 != -1) {
+        b->page2_hash = tb_cache_hash_page(phys_page2);
+    }
+    b->nb_relocs = tcg_ctx.nb_code_relocs;
+    b->code_size = gen_code_size;
+    b->search_size = search_size;
+    for (i = 0; i < 2; i++) {
+        b->jmp_reset_offset[i] = tb->jmp_reset_offset[i];
+        b->jmp_insn_offset[i] = tb->jmp_insn_offset[i];
+    }
+
+    r = tb_cache_block_relocs(b);
+    for (i = 0; i < tcg_ctx.nb_code_relocs; i++) {
+        base = tb_cache_reloc_base(tb, &tcg_ctx.code_relocs[i], &value);
+        if (base < 0) {
+            g_free(b);
+            tb_cache.uncacheable++;
+            return;
+        }
+        r[i].offset = tcg_ctx.code_relocs[i].offset;
+        r[i].type = tcg_ctx.code_relocs[i].type;
+        r[i].base = base;
+        r[i].value = value;
+    }
+    memcpy(tb_cache_block_code(b), tb->tc_ptr, gen_code_size + search_size);
+    b->body_hash = tb_cache_block_body_hash(b);
+
+    slot = g_new0(TBCacheSlot, 1);
+    slot->block = b;
+    slot->allocated = true;
+    slot->verified = true;
+    slot->used = true;
+    g_hash_table_replace(tb_cache.slots, b, slot);
+    tb_cache.stored++;
+}
+
+void tb_cache_dump_info(FILE *f, fprintf_function cpu_fprintf)
+{
+    unsigned lookups = tb_cache.hits + tb_cache.misses;
+
+    if (!tb_cache_enabled) {
+        return;
+    }
+    cpu_fprintf(f, "TB cache hits       %u (%u%%) misses %u stored %u "
+                "uncacheable %u\n", tb_cache.hits,
+                lookups ? tb_cache.hits * 100 / lookups : 0,
+                tb_cache.misses, tb_cache.stored, tb_cache.uncacheable);
+}
+
+#else
+
+void tb_cache_init(const char *file_name)
+{
+    error_report("-tb-cache is not supported on this host");
+    exit(1);
+}
+
+int tb_cache_lookup(CPUState *cpu, TranslationBlock *tb,
+                    tb_page_addr_t phys_pc, int *gen_code_size,
+                    int *search_size)
+{
+    return 0;
+}
+
+void tb_cache_store(CPUState *cpu, TranslationBlock *tb,
+                    tb_page_addr_t phys_pc, tb_page_addr_t phys_page2,
+                    int gen_code_size, int search_size)
+{
+}
+
+void tb_cache_dump_info(FILE *f, fprintf_function cpu_fprintf)
+{
+}
+
+#endif /* defined(TCG_TARGET_HAS_CODE_CACHE) */
@@ -27,6 +27,10 @@
 #include "exec/helper-proto.h"
 #include "exec/cpu_ldst.h"
 #include "exec/exec-all.h"
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+#include "exec/tb-hash.h"
+#include "tcg.h"
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
 
 /* 32-bit helpers */
 
@@ -106,6 +110,38 @@ void HELPER(exit_atomic)(CPUArchState *env)
     cpu_loop_exit_atomic(ENV_GET_CPU(env), GETPC());
 }
 
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+/* Return the host code of the TB for the current CPU state, at addr,
+   or the epilogue, which returns to cpu_exec().  */
+void *HELPER(lookup_tb_ptr)(CPUArchState *env, target_ulong addr)
+{
+    CPUState *cpu = ENV_GET_CPU(env);
+    TBContext *tb_ctx = &tcg_ctx.tb_ctx;
+    TranslationBlock *tb;
+    target_ulong cs_base, pc;
+    uint32_t flags;
+
+    cpu_get_tb_cpu_state(env, &pc, &cs_base, &flags);
+
+    tb = atomic_rcu_read(&cpu->tb_jmp_cache[tb_jmp_cache_hash_func(addr)]);
+    if (likely(tb && tb->pc == addr && tb->cs_base == cs_base
+               && tb->flags == flags)) {
+        tb_ctx->tb_lookup_jmp_cache_count++;
+        return tb->tc_ptr;
+    }
+
+    tb = tb_htable_lookup(cpu, addr, cs_base, flags);
+    if (tb == NULL) {
+        /* Not translated yet.  */
+        tb_ctx->tb_lookup_miss_count++;
+        return tcg_ctx.code_gen_epilogue;
+    }
+    atomic_set(&cpu->tb_jmp_cache[tb_jmp_cache_hash_func(addr)], tb);
+    tb_ctx->tb_lookup_htable_count++;
+    return tb->tc_ptr;
+}
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
+
 #ifndef CONFIG_SOFTMMU
 /* The softmmu versions of these helpers are in cputlb.c.  */
 
@@ -144,6 +144,16 @@ extern bool have_bmi1;
 # define TCG_AREG0 TCG_REG_EBP
 #endif
 
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+#define TCG_TARGET_HAS_goto_ptr         1
+
+/* The generated code can be made relocatable, and saved in the
+   persistent translation cache (see tb-cache.c).  */
+#if TCG_TARGET_REG_BITS == 64 && defined(CONFIG_LINUX)
+# define TCG_TARGET_HAS_CODE_CACHE
+#endif
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
+
 static inline void flush_icache_range(uintptr_t start, uintptr_t stop)
 {
 }
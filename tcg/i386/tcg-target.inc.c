@@ -662,7 +662,13 @@ static void tcg_out_movi(TCGContext *s, TCGType type,
 
     /* Try a 7 byte pc-relative lea before the 10 byte movq.  */
     diff = arg - ((uintptr_t)s->code_ptr + 7);
+#if defined(TCG_TARGET_HAS_CODE_CACHE)
+    /* Not for blocks that may be cached, since this depends on
+       where the block is placed.  */
+    if (diff == (int32_t)diff && !s->code_cache_recording) {
+#else
     if (diff == (int32_t)diff) {
+#endif
         tcg_out_opc(s, OPC_LEA | P_REXW, ret, 0, 0);
         tcg_out8(s, (LOWREGMASK(ret) << 3) | 5);
         tcg_out32(s, diff);
@@ -673,6 +679,42 @@ static void tcg_out_movi(TCGContext *s, TCGType type,
     tcg_out64(s, arg);
 }
 
+#if defined(TCG_TARGET_HAS_CODE_CACHE)
+/* Load a host address with a 10 byte movq, and record it to be
+   relocated when the block is loaded from the translation cache.  */
+static void tcg_out_movi_reloc(TCGContext *s, TCGReg ret,
+                               TCGCodeRelocType type, uintptr_t arg)
+{
+    tcg_out_opc(s, OPC_MOVL_Iv + P_REXW + LOWREGMASK(ret), 0, ret, 0);
+    tcg_code_cache_reloc(s, s->code_ptr, type, arg);
+    tcg_out64(s, arg);
+}
+
+uint32_t tcg_target_code_cache_features(void)
+{
+    return have_cmov | (have_movbe << 1) | (have_bmi1 << 2)
+           | (have_bmi2 << 3);
+}
+#endif
+
+#if defined(CONFIG_SOFTMMU)
+/* Load the address of generated code, like the return address of
+   the slow path.  */
+static void tcg_out_movi_code(TCGContext *s, TCGReg ret, tcg_insn_unit *ptr)
+{
+#if defined(TCG_TARGET_HAS_CODE_CACHE)
+    /* Always pc-relative in blocks that may be cached.  */
+    if (s->code_cache_recording) {
+        tcg_out_opc(s, OPC_LEA | P_REXW, ret, 0, 0);
+        tcg_out8(s, (LOWREGMASK(ret) << 3) | 5);
+        tcg_out32(s, tcg_pcrel_diff(s, ptr) - 4);
+        return;
+    }
+#endif
+    tcg_out_movi(s, TCG_TYPE_PTR, ret, (uintptr_t)ptr);
+}
+#endif
+
 static inline void tcg_out_pushi(TCGContext *s, tcg_target_long val)
 {
     if (val == (int8_t)val) {
@@ -1122,6 +1164,25 @@ static void tcg_out_branch(TCGContext *s, int call, tcg_insn_unit *dest)
 {
     intptr_t disp = tcg_pcrel_diff(s, dest) - 5;
 
+#if defined(TCG_TARGET_HAS_CODE_CACHE)
+    /* Record the calls and jumps outside the block.  */
+    if (s->code_cache_recording
+        && (dest < s->code_buf || dest > s->code_ptr)) {
+        if (disp == (int32_t)disp) {
+            tcg_out_opc(s, call ? OPC_CALL_Jz : OPC_JMP_long, 0, 0, 0);
+            tcg_code_cache_reloc(s, s->code_ptr, TCG_CODE_RELOC_REL32,
+                                 (uintptr_t)dest);
+            tcg_out32(s, disp);
+        } else {
+            tcg_out_movi_reloc(s, TCG_REG_R10, TCG_CODE_RELOC_ABS64,
+                               (uintptr_t)dest);
+            tcg_out_modrm(s, OPC_GRP5,
+                          call ? EXT5_CALLN_Ev : EXT5_JMPN_Ev, TCG_REG_R10);
+        }
+        return;
+    }
+#endif
+
     if (disp == (int32_t)disp) {
         tcg_out_opc(s, call ? OPC_CALL_Jz : OPC_JMP_long, 0, 0, 0);
         tcg_out32(s, disp);
@@ -1352,8 +1413,7 @@ static void tcg_out_qemu_ld_slow_path(TCGContext *s, TCGLabelQemuLdst *l)
         tcg_out_mov(s, TCG_TYPE_PTR, tcg_target_call_iarg_regs[0], TCG_AREG0);
         /* The second argument is already loaded with addrlo.  */
         tcg_out_movi(s, TCG_TYPE_I32, tcg_target_call_iarg_regs[2], oi);
-        tcg_out_movi(s, TCG_TYPE_PTR, tcg_target_call_iarg_regs[3],
-                     (uintptr_t)l->raddr);
+        tcg_out_movi_code(s, tcg_target_call_iarg_regs[3], l->raddr);
     }
 
     tcg_out_call(s, qemu_ld_helpers[opc & (MO_BSWAP | MO_SIZE)]);
@@ -1451,10 +1511,10 @@ static void tcg_out_qemu_st_slow_path(TCGContext *s, TCGLabelQemuLdst *l)
 
         if (ARRAY_SIZE(tcg_target_call_iarg_regs) > 4) {
             retaddr = tcg_target_call_iarg_regs[4];
-            tcg_out_movi(s, TCG_TYPE_PTR, retaddr, (uintptr_t)l->raddr);
+            tcg_out_movi_code(s, retaddr, l->raddr);
         } else {
             retaddr = TCG_REG_RAX;
-            tcg_out_movi(s, TCG_TYPE_PTR, retaddr, (uintptr_t)l->raddr);
+            tcg_out_movi_code(s, retaddr, l->raddr);
             tcg_out_st(s, TCG_TYPE_PTR, retaddr, TCG_REG_ESP,
                        TCG_TARGET_CALL_STACK_OFFSET);
         }
@@ -1809,6 +1869,13 @@ static inline void tcg_out_op(TCGContext *s, TCGOpcode opc,
 
     switch(opc) {
     case INDEX_op_exit_tb:
+#if defined(TCG_TARGET_HAS_CODE_CACHE)
+        if (s->code_cache_recording && args[0] != 0) {
+            tcg_out_movi_reloc(s, TCG_REG_EAX, TCG_CODE_RELOC_TB, args[0]);
+            tcg_out_jmp(s, tb_ret_addr);
+            break;
+        }
+#endif
         tcg_out_movi(s, TCG_TYPE_PTR, TCG_REG_EAX, args[0]);
         tcg_out_jmp(s, tb_ret_addr);
         break;
@@ -1833,6 +1900,12 @@ static inline void tcg_out_op(TCGContext *s, TCGOpcode opc,
         }
         s->tb_jmp_reset_offset[args[0]] = tcg_current_code_size(s);
         break;
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+    case INDEX_op_goto_ptr:
+        /* jmp to the given host address (could be epilogue) */
+        tcg_out_modrm(s, OPC_GRP5, EXT5_JMPN_Ev, args[0]);
+        break;
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
     case INDEX_op_br:
         tcg_out_jxx(s, JCC_JMP, arg_label(args[0]), 0);
         break;
@@ -2161,6 +2234,9 @@ static inline void tcg_out_op(TCGContext *s, TCGOpcode opc,
 static const TCGTargetOpDef x86_op_defs[] = {
     { INDEX_op_exit_tb, { } },
     { INDEX_op_goto_tb, { } },
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+    { INDEX_op_goto_ptr, { "r" } },
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
     { INDEX_op_br, { } },
     { INDEX_op_ld8u_i32, { "r", "r" } },
     { INDEX_op_ld8s_i32, { "r", "r" } },
@@ -2358,6 +2434,13 @@ static void tcg_target_qemu_prologue(TCGContext *s)
     tcg_out_modrm(s, OPC_GRP5, EXT5_JMPN_Ev, tcg_target_call_iarg_regs[1]);
 #endif
 
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+    /* Return path for goto_ptr. Set return value to 0, a-la exit_tb,
+       and fall through to the rest of the epilogue.  */
+    s->code_gen_epilogue = s->code_ptr;
+    tcg_out_movi(s, TCG_TYPE_REG, TCG_REG_EAX, 0);
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
+
     /* TB epilogue */
     tb_ret_addr = s->code_ptr;
 
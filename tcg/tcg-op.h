@@ -772,6 +772,19 @@ static inline void tcg_gen_exit_tb(uintptr_t val)
  */
 void tcg_gen_goto_tb(unsigned idx);
 
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+/**
+ * tcg_gen_lookup_and_goto_ptr() - look up a TB and jump to it if valid
+ * @addr: Guest address of the target TB
+ *
+ * For indirect branches, like function returns: if the TB for the new
+ * CPU state is in the jump cache (or the hash table), jump to it
+ * directly, otherwise return to cpu_exec(). Must be used after the
+ * CPU state was fully saved, like before exit_tb(0).
+ */
+void tcg_gen_lookup_and_goto_ptr(TCGv addr);
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
+
 #if TARGET_LONG_BITS == 32
 #define tcg_temp_new() tcg_temp_new_i32()
 #define tcg_global_reg_new tcg_global_reg_new_i32
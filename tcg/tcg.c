@@ -2743,6 +2743,13 @@ void tcg_dump_info(FILE *f, fprintf_function cpu_fprintf)
                 s->restore_count);
     cpu_fprintf(f, "  avg cycles        %0.1f\n",
                 s->restore_count ? (double)s->restore_time / s->restore_count : 0);
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+    cpu_fprintf(f, "C/V flags/TB        eager %0.2f deferred %0.2f "
+                "flushed %0.2f\n",
+                (double)s->cc_eager_count / tb_div_count,
+                (double)s->cc_deferred_count / tb_div_count,
+                (double)s->cc_flush_count / tb_div_count);
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
 }
 #else
 void tcg_dump_info(FILE *f, fprintf_function cpu_fprintf)
@@ -124,6 +124,12 @@ typedef uint64_t TCGRegSet;
 #define TCG_TARGET_HAS_sub2_i32         1
 #endif
 
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+#ifndef TCG_TARGET_HAS_goto_ptr
+#define TCG_TARGET_HAS_goto_ptr         0
+#endif
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
+
 #ifndef TCG_TARGET_deposit_i32_valid
 #define TCG_TARGET_deposit_i32_valid(ofs, len) 1
 #endif
@@ -637,6 +643,27 @@ QEMU_BUILD_BUG_ON(OPPARAM_BUF_SIZE > (1 << 14));
 /* Make sure that we don't overflow 64 bits without noticing.  */
 QEMU_BUILD_BUG_ON(sizeof(TCGOp) > 8);
 
+#if defined(TCG_TARGET_HAS_CODE_CACHE)
+typedef enum TCGCodeRelocType {
+    /* 32-bit pc-relative displacement of a call or jump.  */
+    TCG_CODE_RELOC_REL32,
+    /* 64-bit absolute address of a call or jump.  */
+    TCG_CODE_RELOC_ABS64,
+    /* 64-bit TranslationBlock address plus exit index (exit_tb).  */
+    TCG_CODE_RELOC_TB,
+} TCGCodeRelocType;
+
+/* A host address stored in the generated code.  */
+typedef struct TCGCodeReloc {
+    uint32_t offset;            /* from the start of the block */
+    TCGCodeRelocType type;
+    uintptr_t value;
+} TCGCodeReloc;
+
+/* Blocks with more relocations are not cached.  */
+#define TCG_MAX_CODE_RELOCS 512
+#endif
+
 struct TCGContext {
     uint8_t *pool_cur, *pool_end;
     TCGPool *pool_first, *pool_current, *pool_first_large;
@@ -679,6 +706,12 @@ struct TCGContext {
     int64_t opt_time;
     int64_t restore_count;
     int64_t restore_time;
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+    /* C and V flags of additions and subtractions.  */
+    int64_t cc_eager_count;
+    int64_t cc_deferred_count;
+    int64_t cc_flush_count;
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
 #endif
 
 #ifdef CONFIG_DEBUG_TCG
@@ -695,6 +728,10 @@ struct TCGContext {
        extension that allows arithmetic on void*.  */
     int code_gen_max_blocks;
     void *code_gen_prologue;
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+    /* Returns 0 to cpu_exec(), the goto_ptr target when lookup fails.  */
+    void *code_gen_epilogue;
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
     void *code_gen_buffer;
     size_t code_gen_buffer_size;
     void *code_gen_ptr;
@@ -723,6 +760,17 @@ struct TCGContext {
 
     uint16_t gen_insn_end_off[TCG_MAX_INSNS];
     target_ulong gen_insn_data[TCG_MAX_INSNS][TARGET_INSN_START_WORDS];
+
+#if defined(TCG_TARGET_HAS_CODE_CACHE)
+    /* Set while generating a block that may be saved in the persistent
+       translation cache; the backend then emits position independent
+       code and records all host addresses outside the block.  */
+    bool code_cache_recording;
+    /* The block refers host data that cannot be relocated.  */
+    bool code_cache_uncacheable;
+    int nb_code_relocs;
+    TCGCodeReloc code_relocs[TCG_MAX_CODE_RELOCS];
+#endif
 };
 
 extern TCGContext tcg_ctx;
@@ -734,6 +782,28 @@ static inline void tcg_set_insn_param(int op_idx, int arg, TCGArg v)
     tcg_ctx.gen_opparam_buf[op_argi + arg] = v;
 }
 
+#if defined(TCG_TARGET_HAS_CODE_CACHE)
+/* Record a host address, stored at PTR in the code being generated.  */
+static inline void tcg_code_cache_reloc(TCGContext *s, void *ptr,
+                                        TCGCodeRelocType type,
+                                        uintptr_t value)
+{
+    TCGCodeReloc *r;
+
+    if (s->nb_code_relocs == TCG_MAX_CODE_RELOCS) {
+        s->code_cache_uncacheable = true;
+        return;
+    }
+    r = &s->code_relocs[s->nb_code_relocs++];
+    r->offset = (uint8_t *)ptr - (uint8_t *)s->code_buf;
+    r->type = type;
+    r->value = value;
+}
+
+/* The host CPU features used by the generated code.  */
+uint32_t tcg_target_code_cache_features(void);
+#endif
+
 /* The number of opcodes emitted so far.  */
 static inline int tcg_op_buf_count(void)
 {
@@ -914,7 +984,13 @@ void tcg_add_target_add_op_defs(const TCGTargetOpDef *tdefs);
 #define TCGV_NAT_TO_PTR(n) MAKE_TCGV_PTR(GET_TCGV_I64(n))
 #define TCGV_PTR_TO_NAT(n) MAKE_TCGV_I64(GET_TCGV_PTR(n))
 
+#if defined(TCG_TARGET_HAS_CODE_CACHE)
+/* Host pointers cannot be relocated, the block is not cached.  */
+#define tcg_const_ptr(V) (tcg_ctx.code_cache_uncacheable = true, \
+                          TCGV_NAT_TO_PTR(tcg_const_i64((intptr_t)(V))))
+#else
 #define tcg_const_ptr(V) TCGV_NAT_TO_PTR(tcg_const_i64((intptr_t)(V)))
+#endif
 #define tcg_global_reg_new_ptr(R, N) \
     TCGV_NAT_TO_PTR(tcg_global_reg_new_i64((R), (N)))
 #define tcg_global_mem_new_ptr(R, O, N) \
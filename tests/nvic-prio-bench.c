@@ -0,0 +1,321 @@
+/*
+ * NVIC priority engine micro-benchmark.
+ *
+ * Copyright (c) 2017 Liviu Ionescu.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Compares the bitmap based priority engine with a linear scan of all
+ * vectors (as done by the GIC emulation previously used for the NVIC),
+ * measuring the host time of a complete interrupt cycle: set pending,
+ * check preemption, acknowledge, complete.
+ */
+#include "qemu/osdep.h"
+#include "hw/cortexm/nvic-prio.h"
+
+/* The reference, one entry per vector, scanned every time. */
+struct ref_state {
+    uint32_t num_vectors;
+    uint8_t priority_mask;
+    uint8_t prigroup;
+    int priority[NVIC_PRIO_MAX_VECTORS];
+    bool enabled[NVIC_PRIO_MAX_VECTORS];
+    bool pending[NVIC_PRIO_MAX_VECTORS];
+    bool active[NVIC_PRIO_MAX_VECTORS];
+};
+
+static unsigned long n_cycles = 1000000;
+static unsigned int n_irqs = 240;
+static unsigned int n_background = 8;
+static int priority_bits = 4;
+
+static const char commands_string[] =
+    " -n = number of interrupt cycles\n"
+    " -i = number of interrupts (max 512)\n"
+    " -p = number of interrupts kept pending at lower priority\n"
+    " -b = number of priority bits (1-8)";
+
+static void usage_complete(char *argv[])
+{
+    fprintf(stderr, "Usage: %s [options]\n", argv[0]);
+    fprintf(stderr, "options:\n%s\n", commands_string);
+}
+
+/*
+ * From: https://en.wikipedia.org/wiki/Xorshift
+ */
+static uint64_t xorshift64star(uint64_t x)
+{
+    x ^= x >> 12; /* a */
+    x ^= x << 25; /* b */
+    x ^= x >> 27; /* c */
+    return x * UINT64_C(2685821657736338717);
+}
+
+static int ref_group_priority(struct ref_state *r, int priority)
+{
+    if (priority < 0) {
+        return priority;
+    }
+    return priority & ~((2 << r->prigroup) - 1);
+}
+
+static int ref_highest_pending(struct ref_state *r)
+{
+    int best = 0;
+    int vector;
+
+    for (vector = 1; vector < r->num_vectors; vector++) {
+        if (r->enabled[vector] && r->pending[vector]
+            && (best == 0 || r->priority[vector] < r->priority[best])) {
+            best = vector;
+        }
+    }
+    return best;
+}
+
+static int ref_execution_priority(struct ref_state *r, uint32_t basepri)
+{
+    int priority = NVIC_PRIO_THREAD;
+    int vector;
+
+    for (vector = 1; vector < r->num_vectors; vector++) {
+        if (r->active[vector]) {
+            int group = ref_group_priority(r, r->priority[vector]);
+            if (group < priority) {
+                priority = group;
+            }
+        }
+    }
+    basepri &= r->priority_mask;
+    if (basepri != 0 && ref_group_priority(r, basepri) < priority) {
+        priority = ref_group_priority(r, basepri);
+    }
+    return priority;
+}
+
+static int ref_preempting(struct ref_state *r, uint32_t basepri)
+{
+    int vector = ref_highest_pending(r);
+
+    if (vector == 0 || ref_group_priority(r, r->priority[vector])
+                       >= ref_execution_priority(r, basepri)) {
+        return 0;
+    }
+    return vector;
+}
+
+static void ref_init(struct ref_state *r, NVICPrio *p)
+{
+    int vector;
+
+    memset(r, 0, sizeof(*r));
+    r->num_vectors = p->num_vectors;
+    r->priority_mask = p->priority_mask;
+    r->prigroup = p->prigroup;
+    for (vector = 1; vector < r->num_vectors; vector++) {
+        r->priority[vector] = p->priority[vector];
+        r->enabled[vector] = nvic_prio_is_enabled(p, vector);
+        r->pending[vector] = nvic_prio_is_pending(p, vector);
+        r->active[vector] = nvic_prio_is_active(p, vector);
+    }
+}
+
+/*
+ * All interrupts enabled, with random priorities; the background ones
+ * get the lowest priority and stay pending, to be skipped at each scan.
+ */
+static void setup(NVICPrio *p, struct ref_state *r)
+{
+    uint64_t x = 1;
+    int i;
+
+    nvic_prio_init(p, 16 + n_irqs, priority_bits);
+    nvic_prio_set_prigroup(p, 3);
+    for (i = 0; i < n_irqs; i++) {
+        x = xorshift64star(x);
+        nvic_prio_set_priority(p, 16 + i, i < n_background ? 0xFF : x >> 56);
+        nvic_prio_set_enabled(p, 16 + i, true);
+        if (i < n_background) {
+            nvic_prio_set_pending(p, 16 + i, true);
+        }
+    }
+    /* One active at the lowest priority, the others cannot preempt it. */
+    if (n_background > 0) {
+        nvic_prio_set_pending(p, 16, false);
+        nvic_prio_set_active(p, 16, true);
+    }
+    ref_init(r, p);
+}
+
+static void run_engine(NVICPrio *p, double *ns)
+{
+    uint64_t x = 1;
+    unsigned long i;
+    int64_t t0, t1;
+
+    t0 = g_get_monotonic_time();
+    for (i = 0; i < n_cycles; i++) {
+        int vector;
+
+        x = xorshift64star(x);
+        vector = 16 + n_background + (x >> 32) % (n_irqs - n_background);
+        nvic_prio_set_pending(p, vector, true);
+        if (nvic_prio_preempting(p, 0) != 0) {
+            vector = nvic_prio_acknowledge(p);
+            nvic_prio_set_active(p, vector, false);
+        }
+    }
+    t1 = g_get_monotonic_time();
+
+    *ns = (double)(t1 - t0) * 1000 / n_cycles;
+}
+
+static void run_reference(struct ref_state *r, double *ns)
+{
+    uint64_t x = 1;
+    unsigned long i;
+    int64_t t0, t1;
+
+    t0 = g_get_monotonic_time();
+    for (i = 0; i < n_cycles; i++) {
+        int vector;
+
+        x = xorshift64star(x);
+        vector = 16 + n_background + (x >> 32) % (n_irqs - n_background);
+        r->pending[vector] = true;
+        if (ref_preempting(r, 0) != 0) {
+            vector = ref_highest_pending(r);
+            r->pending[vector] = false;
+            r->active[vector] = false;
+        }
+    }
+    t1 = g_get_monotonic_time();
+
+    *ns = (double)(t1 - t0) * 1000 / n_cycles;
+}
+
+/* Random operations, the engine must select the same vectors. */
+static void check_engine(void)
+{
+    NVICPrio *p = g_new0(NVICPrio, 1);
+    struct ref_state *r = g_new0(struct ref_state, 1);
+    uint64_t x = 1;
+    int i;
+
+    nvic_prio_init(p, 16 + n_irqs, priority_bits);
+    ref_init(r, p);
+
+    for (i = 0; i < 1000000; i++) {
+        int vector;
+        uint32_t basepri;
+        bool state;
+
+        x = xorshift64star(x);
+        vector = 1 + (x >> 40) % (p->num_vectors - 1);
+        state = (x >> 20) & 1;
+        basepri = (x >> 4) & 0x1 ? (x >> 8) & 0xFF : 0;
+
+        switch ((x >> 24) % 6) {
+        case 0:
+            nvic_prio_set_priority(p, vector, x >> 56);
+            if (vector > NVIC_EXCEPTION_HARD_FAULT) {
+                r->priority[vector] = (x >> 56) & r->priority_mask;
+            }
+            break;
+        case 1:
+            nvic_prio_set_enabled(p, vector, state);
+            r->enabled[vector] = state;
+            break;
+        case 2:
+        case 3:
+            nvic_prio_set_pending(p, vector, state);
+            r->pending[vector] = state;
+            break;
+        case 4:
+            nvic_prio_set_active(p, vector, state);
+            r->active[vector] = state;
+            break;
+        default:
+            nvic_prio_set_prigroup(p, x >> 61);
+            r->prigroup = x >> 61;
+            break;
+        }
+
+        if (nvic_prio_highest_pending(p) != ref_highest_pending(r)
+            || nvic_prio_preempting(p, basepri) != ref_preempting(r, basepri)
+            || nvic_prio_execution_priority(p, basepri)
+               != ref_execution_priority(r, basepri)) {
+            fprintf(stderr, "mismatch at step %d\n", i);
+            exit(1);
+        }
+    }
+
+    g_free(r);
+    g_free(p);
+}
+
+static void parse_args(int argc, char *argv[])
+{
+    int c;
+
+    for (;;) {
+        c = getopt(argc, argv, "hn:i:p:b:");
+        if (c < 0) {
+            break;
+        }
+        switch (c) {
+        case 'h':
+            usage_complete(argv);
+            exit(0);
+        case 'n':
+            n_cycles = atol(optarg);
+            break;
+        case 'i':
+            n_irqs = atoi(optarg);
+            break;
+        case 'p':
+            n_background = atoi(optarg);
+            break;
+        case 'b':
+            priority_bits = atoi(optarg);
+            break;
+        }
+    }
+    if (n_irqs < 1 || n_irqs > NVIC_PRIO_MAX_IRQ || n_background >= n_irqs) {
+        usage_complete(argv);
+        exit(1);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    NVICPrio *p = g_new0(NVICPrio, 1);
+    struct ref_state *r = g_new0(struct ref_state, 1);
+    double ns_engine, ns_reference;
+
+    parse_args(argc, argv);
+
+    printf("Parameters:\n");
+    printf(" cycles:            %lu\n", n_cycles);
+    printf(" interrupts:        %u\n", n_irqs);
+    printf(" pending:           %u\n", n_background);
+    printf(" priority bits:     %d\n", priority_bits);
+
+    check_engine();
+
+    setup(p, r);
+    run_engine(p, &ns_engine);
+    run_reference(r, &ns_reference);
+
+    printf("Results:\n");
+    printf(" bitmap engine:     %8.2f ns/interrupt\n", ns_engine);
+    printf(" linear scan:       %8.2f ns/interrupt\n", ns_reference);
+
+    g_free(r);
+    g_free(p);
+    return 0;
+}
@@ -0,0 +1,273 @@
+/*
+ * Peripheral register auto bits micro-benchmark.
+ *
+ * Copyright (c) 2017 Liviu Ionescu.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Compares the register write path with no auto bits, with the
+ * rules walked as a list (as done before the rules were compiled),
+ * and with the compiled program.
+ */
+#include "qemu/osdep.h"
+#include "hw/cortexm/peripheral-auto-bits.h"
+
+struct reg_desc {
+    const char *name;
+    uint64_t writable_bits;
+    uint64_t persistent_bits;
+    /* Zero mask terminated. */
+    const PeripheralRegisterAutoBits *rules;
+};
+
+/* STM32F4 RCC CR: the xxxRDY bits follow the xxxON bits. */
+static const PeripheralRegisterAutoBits rcc_cr_rules[] = {
+    { 0x05010001, 1, PERIPHERAL_REGISTER_AUTO_BITS_TYPE_FOLLOWS },
+    { 0, 0, 0 }
+};
+
+/* STM32F4 RCC CFGR: SWS follows SW. */
+static const PeripheralRegisterAutoBits rcc_cfgr_rules[] = {
+    { 0x00000003, 2, PERIPHERAL_REGISTER_AUTO_BITS_TYPE_FOLLOWS },
+    { 0, 0, 0 }
+};
+
+/* Synthetic, all types and both directions. */
+static const PeripheralRegisterAutoBits mixed_rules[] = {
+    { 0x00000001, 1, PERIPHERAL_REGISTER_AUTO_BITS_TYPE_FOLLOWS },
+    { 0x00000100, -4, PERIPHERAL_REGISTER_AUTO_BITS_TYPE_FOLLOWS },
+    { 0x00010000, 2, PERIPHERAL_REGISTER_AUTO_BITS_TYPE_CLEARED_BY },
+    { 0x01000000, -3, PERIPHERAL_REGISTER_AUTO_BITS_TYPE_CLEARED_BY },
+    { 0x00001000, 8, PERIPHERAL_REGISTER_AUTO_BITS_TYPE_SET_BY },
+    { 0x80000000, -16, PERIPHERAL_REGISTER_AUTO_BITS_TYPE_SET_BY },
+    { 0, 0, 0 }
+};
+
+static const struct reg_desc regs[] = {
+    { "rcc-cr", 0x0D0D00F9, 0xFFFFFFFF, rcc_cr_rules },
+    { "rcc-cfgr", 0xFFFFFFF3, 0xFFFFFFFF, rcc_cfgr_rules },
+    { "mixed", 0xFFFFFFFF, 0xFFFFFFFF, mixed_rules },
+};
+
+static unsigned long n_writes = 10000000;
+
+static const char commands_string[] =
+    " -n = number of writes per register and method";
+
+static void usage_complete(char *argv[])
+{
+    fprintf(stderr, "Usage: %s [options]\n", argv[0]);
+    fprintf(stderr, "options:\n%s\n", commands_string);
+}
+
+/*
+ * From: https://en.wikipedia.org/wiki/Xorshift
+ */
+static uint64_t xorshift64star(uint64_t x)
+{
+    x ^= x >> 12; /* a */
+    x ^= x << 25; /* b */
+    x ^= x >> 27; /* c */
+    return x * UINT64_C(2685821657736338717);
+}
+
+/* The rules walked one by one, branching on type and shift sign. */
+static uint64_t run_list(const PeripheralRegisterAutoBits *rules,
+                         uint64_t value)
+{
+    const PeripheralRegisterAutoBits *p;
+
+    for (p = rules; p->mask; p++) {
+        if (p->type == PERIPHERAL_REGISTER_AUTO_BITS_TYPE_FOLLOWS) {
+            if (p->shift > 0) {
+                value &= ~(p->mask << p->shift);
+                value |= ((value & p->mask) << p->shift);
+            } else if (p->shift < 0) {
+                value &= ~(p->mask >> -p->shift);
+                value |= ((value & p->mask) >> -p->shift);
+            }
+        } else if (p->type == PERIPHERAL_REGISTER_AUTO_BITS_TYPE_CLEARED_BY) {
+            if (p->shift > 0) {
+                value &= ~((value & p->mask) << p->shift);
+            } else if (p->shift < 0) {
+                value &= ~((value & p->mask) >> -p->shift);
+            }
+        } else if (p->type == PERIPHERAL_REGISTER_AUTO_BITS_TYPE_SET_BY) {
+            if (p->shift > 0) {
+                value |= ((value & p->mask) << p->shift);
+            } else if (p->shift < 0) {
+                value |= ((value & p->mask) >> -p->shift);
+            }
+        }
+    }
+    return value;
+}
+
+enum method {
+    METHOD_NONE,
+    METHOD_LIST,
+    METHOD_COMPILED,
+};
+
+static const char * const method_names[] = {
+    [METHOD_NONE] = "no auto bits",
+    [METHOD_LIST] = "rules list",
+    [METHOD_COMPILED] = "compiled",
+};
+
+/* Emulate the value computation of peripheral_register_direct_write(). */
+static uint64_t run_writes(const struct reg_desc *desc,
+                           const PeripheralAutoBitsProgram *program,
+                           enum method method, double *mops)
+{
+    uint64_t value = 0;
+    uint64_t r = 1;
+    unsigned long i;
+    int64_t t0, t1;
+
+    t0 = g_get_monotonic_time();
+    for (i = 0; i < n_writes; i++) {
+        uint64_t full_value;
+
+        r = xorshift64star(r);
+        full_value = (value & ~desc->writable_bits) |
+                     (r & desc->writable_bits);
+
+        switch (method) {
+        case METHOD_LIST:
+            full_value = run_list(desc->rules, full_value);
+            break;
+        case METHOD_COMPILED:
+            full_value = peripheral_auto_bits_run(program, full_value);
+            break;
+        default:
+            break;
+        }
+        value = full_value & desc->persistent_bits;
+    }
+    t1 = g_get_monotonic_time();
+
+    *mops = (t1 > t0) ? (double)n_writes / (t1 - t0) : 0;
+    return value;
+}
+
+/*
+ * Writes spread over all registers, as done by the clock setup code;
+ * the rules differ from one write to the next.
+ */
+static void run_interleaved(PeripheralAutoBitsProgram **programs,
+                            enum method method, double *mops)
+{
+    uint64_t values[ARRAY_SIZE(regs)] = { 0 };
+    uint64_t r = 1;
+    unsigned long i;
+    int64_t t0, t1;
+
+    t0 = g_get_monotonic_time();
+    for (i = 0; i < n_writes; i++) {
+        const struct reg_desc *desc;
+        uint64_t full_value;
+        unsigned int index;
+
+        r = xorshift64star(r);
+        index = (r >> 60) % ARRAY_SIZE(regs);
+        desc = &regs[index];
+        full_value = (values[index] & ~desc->writable_bits) |
+                     (r & desc->writable_bits);
+
+        switch (method) {
+        case METHOD_LIST:
+            full_value = run_list(desc->rules, full_value);
+            break;
+        case METHOD_COMPILED:
+            full_value = peripheral_auto_bits_run(programs[index], full_value);
+            break;
+        default:
+            break;
+        }
+        values[index] = full_value & desc->persistent_bits;
+    }
+    t1 = g_get_monotonic_time();
+
+    *mops = (t1 > t0) ? (double)n_writes / (t1 - t0) : 0;
+}
+
+/* The compiled program must give the same results as the list. */
+static void check_program(const struct reg_desc *desc,
+                          const PeripheralAutoBitsProgram *program)
+{
+    uint64_t r = 1;
+    int i;
+
+    for (i = 0; i < 100000; i++) {
+        r = xorshift64star(r);
+        if (run_list(desc->rules, r) !=
+            peripheral_auto_bits_run(program, r)) {
+            fprintf(stderr, "%s: mismatch for 0x%016" PRIX64 "\n",
+                    desc->name, r);
+            exit(1);
+        }
+    }
+}
+
+static void parse_args(int argc, char *argv[])
+{
+    int c;
+
+    for (;;) {
+        c = getopt(argc, argv, "hn:");
+        if (c < 0) {
+            break;
+        }
+        switch (c) {
+        case 'h':
+            usage_complete(argv);
+            exit(0);
+        case 'n':
+            n_writes = atol(optarg);
+            break;
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    PeripheralAutoBitsProgram *programs[ARRAY_SIZE(regs)];
+    double mops;
+    enum method m;
+    int i;
+
+    parse_args(argc, argv);
+
+    printf("Parameters:\n");
+    printf(" writes:            %lu\n", n_writes);
+    printf("Results:\n");
+
+    for (i = 0; i < ARRAY_SIZE(regs); i++) {
+        programs[i] = peripheral_auto_bits_compile(regs[i].rules);
+        g_assert(programs[i] != NULL);
+        check_program(&regs[i], programs[i]);
+
+        for (m = METHOD_NONE; m <= METHOD_COMPILED; m++) {
+            uint64_t last;
+
+            last = run_writes(&regs[i], programs[i], m, &mops);
+            printf(" %-12s %-14s %8.2f Mwrites/s (0x%08" PRIX64 ")\n",
+                   regs[i].name, method_names[m], mops, last);
+        }
+    }
+
+    for (m = METHOD_NONE; m <= METHOD_COMPILED; m++) {
+        run_interleaved(programs, m, &mops);
+        printf(" %-12s %-14s %8.2f Mwrites/s\n", "interleaved",
+               method_names[m], mops);
+    }
+
+    for (i = 0; i < ARRAY_SIZE(regs); i++) {
+        g_free(programs[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,124 @@
+/*
+ * QTest testcase for the STM32 F1 DMA channels shared by peripherals.
+ *
+ * Copyright (c) 2017 Liviu Ionescu.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * On F1 each DMA channel has a single request line, shared by several
+ * peripherals; DMA1 channel 4 serves USART1 TX and SPI2 RX, channel 5
+ * USART1 RX and SPI2 TX. SPI2 moves its frames in blocks, USART1 item
+ * by item; both must complete when used together.
+ */
+#include "qemu/osdep.h"
+#include "libqtest.h"
+
+#define RCC_BASE            0x40021000
+#define RCC_AHBENR          (RCC_BASE + 0x14)
+#define RCC_APB2ENR         (RCC_BASE + 0x18)
+#define RCC_APB1ENR         (RCC_BASE + 0x1C)
+
+#define DMA1_BASE           0x40020000
+#define DMA_ISR             (DMA1_BASE + 0x00)
+/* Channels numbered from 1, as in the reference manual.  */
+#define DMA_CCR(x)          (DMA1_BASE + 0x08 + 0x14 * ((x) - 1))
+#define DMA_CNDTR(x)        (DMA1_BASE + 0x0C + 0x14 * ((x) - 1))
+#define DMA_CPAR(x)         (DMA1_BASE + 0x10 + 0x14 * ((x) - 1))
+#define DMA_CMAR(x)         (DMA1_BASE + 0x14 + 0x14 * ((x) - 1))
+#define DMA_ISR_TCIF(x)     (1 << (4 * ((x) - 1) + 1))
+#define DMA_CCR_EN          (1 << 0)
+#define DMA_CCR_DIR         (1 << 4)
+#define DMA_CCR_MINC        (1 << 7)
+
+#define USART1_BASE         0x40013800
+#define USART_DR            (USART1_BASE + 0x04)
+#define USART_BRR           (USART1_BASE + 0x08)
+#define USART_CR1           (USART1_BASE + 0x0C)
+#define USART_CR3           (USART1_BASE + 0x14)
+#define USART_CR1_UE        (1 << 13)
+#define USART_CR1_TE        (1 << 3)
+#define USART_CR3_DMAT      (1 << 7)
+
+#define SPI2_BASE           0x40003800
+#define SPI_CR1             (SPI2_BASE + 0x00)
+#define SPI_CR2             (SPI2_BASE + 0x04)
+#define SPI_DR              (SPI2_BASE + 0x0C)
+#define SPI_CR1_MSTR        (1 << 2)
+#define SPI_CR1_SPE         (1 << 6)
+#define SPI_CR1_SSI         (1 << 8)
+#define SPI_CR1_SSM         (1 << 9)
+#define SPI_CR2_TXDMAEN     (1 << 1)
+
+#define USART_TX_CHANNEL    4
+#define SPI_TX_CHANNEL      5
+
+#define USART_BUF           0x20000100
+#define USART_BUF_SIZE      8
+#define SPI_BUF             0x20000200
+#define SPI_BUF_SIZE        64
+
+static void dma_setup(int channel, uint32_t par, uint32_t mar, uint32_t count)
+{
+    writel(DMA_CPAR(channel), par);
+    writel(DMA_CMAR(channel), mar);
+    writel(DMA_CNDTR(channel), count);
+    writel(DMA_CCR(channel), DMA_CCR_MINC | DMA_CCR_DIR | DMA_CCR_EN);
+}
+
+static void test_usart1_spi2_dma(void)
+{
+    int i;
+
+    writel(RCC_AHBENR, readl(RCC_AHBENR) | (1 << 0));
+    writel(RCC_APB2ENR, readl(RCC_APB2ENR) | (1 << 14));
+    writel(RCC_APB1ENR, readl(RCC_APB1ENR) | (1 << 14));
+
+    for (i = 0; i < USART_BUF_SIZE; i++) {
+        writeb(USART_BUF + i, 'A' + i);
+    }
+    for (i = 0; i < SPI_BUF_SIZE; i++) {
+        writeb(SPI_BUF + i, i);
+    }
+
+    dma_setup(USART_TX_CHANNEL, USART_DR, USART_BUF, USART_BUF_SIZE);
+    dma_setup(SPI_TX_CHANNEL, SPI_DR, SPI_BUF, SPI_BUF_SIZE);
+
+    /* SPI2 is enabled first, its handler must not take the USART1 items.  */
+    writel(SPI_CR2, SPI_CR2_TXDMAEN);
+    writel(SPI_CR1, SPI_CR1_SSM | SPI_CR1_SSI | SPI_CR1_SPE | SPI_CR1_MSTR);
+
+    writel(USART_BRR, 0x45);
+    writel(USART_CR3, USART_CR3_DMAT);
+    writel(USART_CR1, USART_CR1_UE | USART_CR1_TE);
+
+    /* The USART sends one character every 87 us at 115200 baud.  */
+    for (i = 0; i < 100 && readl(DMA_CNDTR(USART_TX_CHANNEL)) != 0; i++) {
+        clock_step(1000 * 1000);
+    }
+
+    g_assert_cmpuint(readl(DMA_CNDTR(SPI_TX_CHANNEL)), ==, 0);
+    g_assert_cmpuint(readl(DMA_CNDTR(USART_TX_CHANNEL)), ==, 0);
+    g_assert_cmphex(readl(DMA_ISR) & DMA_ISR_TCIF(SPI_TX_CHANNEL), ==,
+            DMA_ISR_TCIF(SPI_TX_CHANNEL));
+    g_assert_cmphex(readl(DMA_ISR) & DMA_ISR_TCIF(USART_TX_CHANNEL), ==,
+            DMA_ISR_TCIF(USART_TX_CHANNEL));
+}
+
+int main(int argc, char **argv)
+{
+    int ret;
+
+    g_test_init(&argc, &argv, NULL);
+
+    qtest_start("-M NUCLEO-F103RB -L " CONFIG_DEVICES_DATADIR);
+    qtest_add_func("/stm32/dma/f1-usart1-spi2", test_usart1_spi2_dma);
+
+    ret = g_test_run();
+
+    qtest_end();
+
+    return ret;
+}
@@ -0,0 +1,114 @@
+/*
+ * Thumb instruction classes for the lazy C and V flags.
+ *
+ * Copyright (c) 2017 Liviu Ionescu.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The classes must match the decoding of the Thumb translator: an
+ * instruction wrongly classified as leaving C and V alone would read
+ * or save stale flags.
+ */
+#include "qemu/osdep.h"
+#include "target-arm/thumb_cc.h"
+
+typedef struct Check {
+    uint32_t insn;
+    ThumbCCClass class;
+    ThumbCCClass class_mem;
+} Check;
+
+#define B THUMB_CC_BARRIER
+#define N THUMB_CC_NONE
+#define A THUMB_CC_ARITH
+
+/* 32-bit instructions have the first halfword in the high half.  */
+static const Check checks[] = {
+    { 0x1c45, A, A },       /* adds r5, r0, #1 */
+    { 0x1ad2, A, A },       /* subs r2, r2, r3 */
+    { 0x2b2c, A, A },       /* cmp r3, #44 */
+    { 0x2400, N, N },       /* movs r4, #0 */
+    { 0x0018, N, N },       /* movs r0, r3 */
+    { 0x0840, B, B },       /* lsrs r0, r0, #1 */
+    { 0x4043, N, N },       /* eors r3, r0 */
+    { 0x4148, B, B },       /* adcs r0, r1 */
+    { 0x4088, B, B },       /* lsls r0, r1 */
+    { 0x4248, A, A },       /* negs r0, r1 */
+    { 0x42c8, A, A },       /* cmn r0, r1 */
+    { 0x4543, A, A },       /* cmp r3, r8 */
+    { 0x443c, N, N },       /* add r4, r7 */
+    { 0x4487, B, B },       /* add pc, r0 */
+    { 0x4770, B, B },       /* bx lr */
+    { 0x6843, B, N },       /* ldr r3, [r0, #4] */
+    { 0x9101, B, N },       /* str r1, [sp, #4] */
+    { 0xb2d2, N, N },       /* uxtb r2, r2 */
+    { 0xba00, N, N },       /* rev r0, r0 */
+    { 0xb570, B, N },       /* push {r4-r6, lr} */
+    { 0xbd70, B, B },       /* pop {r4-r6, pc} */
+    { 0xb108, B, B },       /* cbz r0 */
+    { 0xbf18, B, B },       /* it ne */
+    { 0xd1f8, B, B },       /* bne */
+    { 0xf1a30230, N, N },   /* sub.w r2, r3, #48 */
+    { 0xf1b30f30, A, A },   /* cmp.w r3, #48 */
+    { 0xf0130f01, N, N },   /* tst.w r3, #1 */
+    { 0xf0134f80, B, B },   /* tst.w r3, #0x40000000 */
+    { 0xf1430301, B, B },   /* adc.w r3, r3, #1 */
+    { 0xf24033e8, N, N },   /* movw r3, #1000 */
+    { 0xeb030381, N, N },   /* add.w r3, r3, r1, lsl #2 */
+    { 0xebb20301, A, A },   /* subs.w r3, r2, r1 */
+    { 0xea530301, N, N },   /* orrs.w r3, r3, r1 */
+    { 0xea530341, B, B },   /* orrs.w r3, r3, r1, lsl #1 */
+    { 0xea4f0330, B, B },   /* rrx r3, r0 */
+    { 0xf8d03008, B, N },   /* ldr.w r3, [r0, #8] */
+    { 0xf9315013, B, N },   /* ldrsh.w r5, [r1, r3, lsl #1] */
+    { 0xf8d0f008, B, B },   /* ldr.w pc, [r0, #8] */
+    { 0xe92d41f0, B, N },   /* push.w {r4-r8, lr} */
+    { 0xe8bd81f0, B, B },   /* pop.w {r4-r8, pc} */
+    { 0xfb050006, N, N },   /* mla r0, r5, r6, r0 */
+    { 0xf7fffffe, B, B },   /* bl */
+};
+
+#undef B
+#undef N
+#undef A
+
+static ThumbCCClass classify(uint32_t insn, int flags)
+{
+    if (insn > 0xffff) {
+        g_assert(thumb_cc_insn_is_32bit(insn >> 16));
+        return thumb_cc_classify32(insn, flags);
+    }
+    g_assert(!thumb_cc_insn_is_32bit(insn));
+    return thumb_cc_classify16(insn, flags);
+}
+
+static void test_classify(void)
+{
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(checks); i++) {
+        g_assert_cmpint(classify(checks[i].insn, 0), ==, checks[i].class);
+    }
+}
+
+/* Loads and stores leave C and V alone when they cannot fault.  */
+static void test_classify_mem_ok(void)
+{
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(checks); i++) {
+        g_assert_cmpint(classify(checks[i].insn, THUMB_CC_MEM_OK), ==,
+                        checks[i].class_mem);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/thumb-cc/classify", test_classify);
+    g_test_add_func("/thumb-cc/classify-mem-ok", test_classify_mem_ok);
+    return g_test_run();
+}
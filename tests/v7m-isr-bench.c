@@ -0,0 +1,190 @@
+/*
+ * Cortex-M exception round-trip benchmark.
+ *
+ * Copyright (c) 2017 Liviu Ionescu.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Runs a hand-assembled Thumb image on the NUCLEO-F103RB board, which
+ * sets PENDSVSET in a loop; the empty PendSV handler is taken at each
+ * iteration, with the frame pushed and popped on the main stack, in
+ * SRAM. The same image is run a second time writing 0 to ICSR, which
+ * takes no exception; the difference of the host times, divided by the
+ * number of iterations, is the cost of one exception entry and return.
+ * The image ends with a semihosting SYS_EXIT, so the host times include
+ * the emulator start-up, which cancels out.
+ *
+ * To compare two versions of the emulator, run the benchmark with -b
+ * pointing to each build.
+ */
+#include "qemu/osdep.h"
+#include "qemu/bswap.h"
+
+#define IMAGE_SIZE          0x80
+/* Offsets of the literals patched in the image.  */
+#define IMAGE_ICSR_VALUE    0x5C
+#define IMAGE_COUNT         0x60
+
+#define ICSR_PENDSVSET      (1 << 28)
+
+static unsigned long n_iterations = 1000000;
+static const char *qemu_binary =
+    "gnuarmeclipse-softmmu/qemu-system-gnuarmeclipse";
+static const char *data_dir = CONFIG_DEVICES_DATADIR;
+
+static const char commands_string[] =
+    " -n = number of exceptions\n"
+    " -b = emulator binary\n"
+    " -L = directory with the devices/ JSON files";
+
+static void usage_complete(char *argv[])
+{
+    fprintf(stderr, "Usage: %s [options]\n", argv[0]);
+    fprintf(stderr, "options:\n%s\n", commands_string);
+}
+
+/*
+ * 0x00 vectors: initial SP, Reset at 0x40, PendSV at 0x54, the others
+ *      at the 'b .' at 0x52
+ * 0x40 ldr   r0, [pc, #20]     @ =0xE000ED04 (ICSR)
+ * 0x42 ldr   r1, [pc, #24]     @ =PENDSVSET, or 0
+ * 0x44 ldr   r2, [pc, #24]     @ =count
+ * 0x46 str   r1, [r0]
+ * 0x48 subs  r2, #1
+ * 0x4A bne   0x46
+ * 0x4C movs  r0, #0x18         @ SYS_EXIT
+ * 0x4E ldr   r1, [pc, #20]     @ =ADP_Stopped_ApplicationExit
+ * 0x50 bkpt  0xAB
+ * 0x52 b     .
+ * 0x54 bx    lr                @ PendSV
+ * 0x56 nop
+ * 0x58 literals
+ */
+static void build_image(uint8_t *image, uint32_t icsr_value, uint32_t count)
+{
+    static const uint16_t code[] = {
+        0x4805, 0x4906, 0x4A06, 0x6001, 0x3A01, 0xD1FC, 0x2018, 0x4905,
+        0xBEAB, 0xE7FE, 0x4770, 0xBF00,
+    };
+    int i;
+
+    memset(image, 0, IMAGE_SIZE);
+
+    stl_le_p(image, 0x20005000);
+    for (i = 1; i < 16; i++) {
+        stl_le_p(image + 4 * i, 0x52 | 1);
+    }
+    stl_le_p(image + 4 * 1, 0x40 | 1);
+    stl_le_p(image + 4 * 14, 0x54 | 1);
+
+    for (i = 0; i < ARRAY_SIZE(code); i++) {
+        stw_le_p(image + 0x40 + 2 * i, code[i]);
+    }
+
+    stl_le_p(image + 0x58, 0xE000ED04);
+    stl_le_p(image + IMAGE_ICSR_VALUE, icsr_value);
+    stl_le_p(image + IMAGE_COUNT, count);
+    stl_le_p(image + 0x64, 0x20026);
+}
+
+/* Return the host time of a complete run, in nanoseconds.  */
+static double run_image(uint32_t icsr_value)
+{
+    uint8_t image[IMAGE_SIZE];
+    GError *err = NULL;
+    gchar *image_name;
+    gchar *errors = NULL;
+    int64_t t0, t1;
+    int status;
+    int fd;
+
+    build_image(image, icsr_value, n_iterations);
+
+    fd = g_file_open_tmp("v7m-isr-bench-XXXXXX", &image_name, &err);
+    if (fd < 0 || write(fd, image, sizeof(image)) != sizeof(image)) {
+        fprintf(stderr, "cannot write the image\n");
+        exit(1);
+    }
+    close(fd);
+
+    const gchar *args[] = {
+        qemu_binary, "-M", "NUCLEO-F103RB", "-L", data_dir,
+        "-kernel", image_name, "-nographic", "-monitor", "none",
+        "-semihosting-config", "enable=on,target=native", NULL,
+    };
+
+    t0 = g_get_monotonic_time();
+    if (!g_spawn_sync(NULL, (gchar **) args, NULL,
+            G_SPAWN_SEARCH_PATH | G_SPAWN_STDOUT_TO_DEV_NULL, NULL, NULL,
+            NULL, &errors, &status, &err)) {
+        fprintf(stderr, "cannot run %s: %s\n", qemu_binary, err->message);
+        exit(1);
+    }
+    t1 = g_get_monotonic_time();
+
+    unlink(image_name);
+    g_free(image_name);
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "%s failed:\n%s", qemu_binary, errors);
+        exit(1);
+    }
+    g_free(errors);
+
+    return (double)(t1 - t0) * 1000;
+}
+
+static void parse_args(int argc, char *argv[])
+{
+    int c;
+
+    for (;;) {
+        c = getopt(argc, argv, "hn:b:L:");
+        if (c < 0) {
+            break;
+        }
+        switch (c) {
+        case 'h':
+            usage_complete(argv);
+            exit(0);
+        case 'n':
+            n_iterations = atol(optarg);
+            break;
+        case 'b':
+            qemu_binary = optarg;
+            break;
+        case 'L':
+            data_dir = optarg;
+            break;
+        }
+    }
+    if (n_iterations < 1 || n_iterations > UINT32_MAX) {
+        usage_complete(argv);
+        exit(1);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    double ns_isr, ns_base;
+
+    parse_args(argc, argv);
+
+    printf("Parameters:\n");
+    printf(" exceptions:        %lu\n", n_iterations);
+    printf(" emulator:          %s\n", qemu_binary);
+
+    ns_isr = run_image(ICSR_PENDSVSET);
+    ns_base = run_image(0);
+
+    printf("Results:\n");
+    printf(" with PendSV:       %8.3f s\n", ns_isr / 1e9);
+    printf(" without:           %8.3f s\n", ns_base / 1e9);
+    printf(" round trip:        %8.2f ns/exception\n",
+           (ns_isr - ns_base) / n_iterations);
+
+    return 0;
+}
@@ -56,6 +56,9 @@
 #include "qemu/bitmap.h"
 #include "qemu/timer.h"
 #include "exec/log.h"
+#if defined(CONFIG_GNU_MCU_ECLIPSE) && !defined(CONFIG_USER_ONLY)
+#include "exec/tb-cache.h"
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
 
 /* #define DEBUG_TB_INVALIDATE */
 /* #define DEBUG_TB_FLUSH */
@@ -309,6 +312,8 @@ static int encode_search(TranslationBlock *tb, uint8_t *block)
 }
 
 /* The cpu state corresponding to 'searched_pc' is restored.
+ * Returns the number of instructions executed in the block before
+ * 'searched_pc', or -1 if not found.
  * Called with tb_lock held.
  */
 static int cpu_restore_state_from_tb(CPUState *cpu, TranslationBlock *tb,
@@ -346,18 +351,27 @@ static int cpu_restore_state_from_tb(CPUState *cpu, TranslationBlock *tb,
     if (tb->cflags & CF_USE_ICOUNT) {
         assert(use_icount);
         /* Reset the cycle counter to the start of the block.  */
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+        cpu->icount_decr.u16.low += tb->icount_cost;
+#else
         cpu->icount_decr.u16.low += num_insns;
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
         /* Clear the IO flag.  */
         cpu->can_do_io = 0;
     }
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+    /* With a cycle cost, charge the executed part proportionally.  */
+    cpu->icount_decr.u16.low -= i * tb->icount_cost / num_insns;
+#else
     cpu->icount_decr.u16.low -= i;
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
     restore_state_to_opc(env, tb, data);
 
 #ifdef CONFIG_PROFILER
     tcg_ctx.restore_time += profile_getclock() - ti;
     tcg_ctx.restore_count++;
 #endif
-    return 0;
+    return i;
 }
 
 bool cpu_restore_state(CPUState *cpu, uintptr_t retaddr)
@@ -1277,6 +1291,9 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
 #ifdef CONFIG_PROFILER
     int64_t ti;
 #endif
+#if defined(CONFIG_GNU_MCU_ECLIPSE) && !defined(CONFIG_USER_ONLY)
+    bool from_cache = false;
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
     assert_memory_lock();
 
     phys_pc = get_page_addr_code(env, pc);
@@ -1299,6 +1316,20 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     tb->flags = flags;
     tb->cflags = cflags;
 
+#if defined(CONFIG_GNU_MCU_ECLIPSE) && !defined(CONFIG_USER_ONLY)
+    if (tb_cache_enabled) {
+        int ret = tb_cache_lookup(cpu, tb, phys_pc, &gen_code_size,
+                                  &search_size);
+        if (unlikely(ret < 0)) {
+            goto buffer_overflow;
+        }
+        if (ret > 0) {
+            from_cache = true;
+            goto code_ready;
+        }
+    }
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
+
 #ifdef CONFIG_PROFILER
     tcg_ctx.tb_count1++; /* includes aborted translations because of
                        exceptions */
@@ -1364,6 +1395,9 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     }
 #endif
 
+#if defined(CONFIG_GNU_MCU_ECLIPSE) && !defined(CONFIG_USER_ONLY)
+ code_ready:
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
     tcg_ctx.code_gen_ptr = (void *)
         ROUND_UP((uintptr_t)gen_code_buf + gen_code_size + search_size,
                  CODE_GEN_ALIGN);
@@ -1388,6 +1422,12 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     if ((pc & TARGET_PAGE_MASK) != virt_page2) {
         phys_page2 = get_page_addr_code(env, virt_page2);
     }
+#if defined(CONFIG_GNU_MCU_ECLIPSE) && !defined(CONFIG_USER_ONLY)
+    if (tb_cache_enabled && !from_cache) {
+        tb_cache_store(cpu, tb, phys_pc, phys_page2, gen_code_size,
+                       search_size);
+    }
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
     /* As long as consistency of the TB stuff is provided by tb_lock in user
      * mode and is implicit in single-threaded softmmu emulation, no explicit
      * memory barrier is required before tb_link_page() makes the TB visible
@@ -1760,11 +1800,17 @@ void cpu_io_recompile(CPUState *cpu, uintptr_t retaddr)
         cpu_abort(cpu, "cpu_io_recompile: could not find TB for pc=%p",
                   (void *)retaddr);
     }
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+    /* The counter may be in cycles; count the instructions
+       executed before the fault occurred.  */
+    n = cpu_restore_state_from_tb(cpu, tb, retaddr);
+#else
     n = cpu->icount_decr.u16.low + tb->icount;
     cpu_restore_state_from_tb(cpu, tb, retaddr);
     /* Calculate how many instructions had been executed before the fault
        occurred.  */
     n = n - cpu->icount_decr.u16.low;
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
     /* Generate a new TB ending on the I/O insn.  */
     n++;
     /* On MIPS and SH, delay slot instructions can only be restarted if
@@ -1941,6 +1987,21 @@ void dump_exec_info(FILE *f, fprintf_function cpu_fprintf)
     cpu_fprintf(f, "TB invalidate count %d\n",
             tcg_ctx.tb_ctx.tb_phys_invalidate_count);
     cpu_fprintf(f, "TLB flush count     %d\n", tlb_flush_count);
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+    {
+        unsigned hits = tcg_ctx.tb_ctx.tb_lookup_jmp_cache_count;
+        unsigned htable = tcg_ctx.tb_ctx.tb_lookup_htable_count;
+        unsigned total = hits + htable + tcg_ctx.tb_ctx.tb_lookup_miss_count;
+
+        cpu_fprintf(f, "TB ptr lookup count %u (jmp cache %u%%, "
+                    "hash table %u%%)\n", total,
+                    total ? (unsigned)((uint64_t)hits * 100 / total) : 0,
+                    total ? (unsigned)((uint64_t)htable * 100 / total) : 0);
+    }
+#if !defined(CONFIG_USER_ONLY)
+    tb_cache_dump_info(f, cpu_fprintf);
+#endif
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
     tcg_dump_info(f, cpu_fprintf);
 
     tb_unlock();
@@ -203,6 +203,7 @@ int main(int argc, char **argv)
 #if defined(CONFIG_GNU_MCU_ECLIPSE)
 #include <strings.h>
 #include <hw/cortexm/helper.h>
+#include <hw/cortexm/profiler.h>
 #endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
 
 #if defined(CONFIG_VERBOSE)
@@ -231,6 +232,10 @@ int autostart;
 #if defined(CONFIG_GNU_MCU_ECLIPSE)
 int with_gdb;
 const char *mcu_device = NULL;
+static bool idle_fast_forward;
+static bool cycle_model;
+static const char *tb_cache_file;
+static QemuOpts *profile_opts;
 #endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
 
 #if defined(CONFIG_VERBOSE)
@@ -590,6 +595,27 @@ static QemuOptsList qemu_semihosting_config_opts = {
     },
 };
 
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+static QemuOptsList qemu_profile_opts = {
+    .name = "profile",
+    .implied_opt_name = "file",
+    .head = QTAILQ_HEAD_INITIALIZER(qemu_profile_opts.head),
+    .desc = {
+        {
+            .name = "file",
+            .type = QEMU_OPT_STRING,
+        }, {
+            .name = "rate",
+            .type = QEMU_OPT_NUMBER,
+        }, {
+            .name = "depth",
+            .type = QEMU_OPT_NUMBER,
+        },
+        { /* end of list */ }
+    },
+};
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
+
 static QemuOptsList qemu_fw_cfg_opts = {
     .name = "fw_cfg",
     .implied_opt_name = "name",
@@ -3439,6 +3465,9 @@ int main(int argc, char **argv, char **envp)
     qemu_add_opts(&qemu_icount_opts);
     qemu_add_opts(&qemu_semihosting_config_opts);
     qemu_add_opts(&qemu_fw_cfg_opts);
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+    qemu_add_opts(&qemu_profile_opts);
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
 #ifdef CONFIG_LIBISCSI
     qemu_add_opts(&qemu_iscsi_opts);
 #endif
@@ -3552,6 +3581,25 @@ int main(int argc, char **argv, char **envp)
             case QEMU_OPTION_mcu:
                 mcu_device = optarg;
                 break;
+            case QEMU_OPTION_idle_fast_forward:
+                idle_fast_forward = true;
+                break;
+            case QEMU_OPTION_cycle_model:
+                cycle_model = true;
+                break;
+            case QEMU_OPTION_tb_cache:
+                tb_cache_file = optarg;
+                break;
+            case QEMU_OPTION_no_lazy_flags:
+                use_lazy_flags = false;
+                break;
+            case QEMU_OPTION_profile:
+                profile_opts = qemu_opts_parse_noisily(
+                        qemu_find_opts("profile"), optarg, true);
+                if (!profile_opts) {
+                    exit(1);
+                }
+                break;
 #endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
 
             case QEMU_OPTION_hda:
@@ -4915,6 +4963,51 @@ int main(int argc, char **argv, char **envp)
         qemu_opts_del(icount_opts);
     }
 
+#if defined(CONFIG_GNU_MCU_ECLIPSE)
+    if (cycle_model) {
+        if (use_icount) {
+            error_report("-cycle-model is not allowed with -icount");
+            exit(1);
+        }
+        /* Idle fast-forward is the icount sleep=off behaviour.  */
+        configure_icount_cycles(!idle_fast_forward);
+    } else if (idle_fast_forward) {
+        if (use_icount) {
+            error_report("-idle-fast-forward is not allowed with -icount, "
+                         "use -icount sleep=off");
+            exit(1);
+        }
+        configure_idle_fast_forward(true);
+    }
+
+    if (tb_cache_file) {
+        tb_cache_init(tb_cache_file);
+    }
+
+    if (profile_opts) {
+        const char *file = qemu_opt_get(profile_opts, "file");
+        int64_t rate = qemu_opt_get_number(profile_opts, "rate",
+                                           CORTEXM_PROFILER_DEFAULT_RATE);
+        int64_t depth = qemu_opt_get_number(profile_opts, "depth",
+                                            CORTEXM_PROFILER_DEFAULT_DEPTH);
+
+        if (!file) {
+            error_report("-profile needs a file name");
+            exit(1);
+        }
+        if (rate <= 0 || rate > 1000000) {
+            error_report("-profile rate must be between 1 and 1000000");
+            exit(1);
+        }
+        if (depth <= 0 || depth > CORTEXM_PROFILER_MAX_DEPTH) {
+            error_report("-profile depth must be between 1 and %d",
+                         CORTEXM_PROFILER_MAX_DEPTH);
+            exit(1);
+        }
+        cortexm_profiler_init(file, rate, depth);
+    }
+#endif /* defined(CONFIG_GNU_MCU_ECLIPSE) */
+
     if (default_net) {
         QemuOptsList *net = qemu_find_opts("net");
         qemu_opts_set(net, NULL, "type", "nic", &error_abort);